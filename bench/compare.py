@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+"""Compare two httpsfv_bench JSON results.
+
+usage: compare.py [--threshold PERCENT] baseline.json current.json
+
+Prints the ns/op of every benchmark in both files and the relative change.
+Exits with status 1 when any benchmark got slower by more than the
+threshold (default 10%).
+"""
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {b["name"]: b["ns_per_op"] for b in json.load(f)["benchmarks"]}
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed slowdown in percent")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    regressions = 0
+    print("%-40s %12s %12s %9s" % ("benchmark", "baseline", "current", "change"))
+    for name in sorted(set(baseline) | set(current)):
+        if name not in baseline:
+            print("%-40s %12s %12.1f %9s" % (name, "-", current[name], "new"))
+            continue
+        if name not in current:
+            print("%-40s %12.1f %12s %9s" % (name, baseline[name], "-", "removed"))
+            continue
+        if baseline[name] == 0:
+            print("%-40s %12.1f %12.1f %9s" % (name, baseline[name], current[name], "n/a"))
+            continue
+        change = (current[name] - baseline[name]) / baseline[name] * 100
+        mark = ""
+        if change > args.threshold:
+            mark = " !"
+            regressions += 1
+        print("%-40s %12.1f %12.1f %+8.1f%%%s" % (name, baseline[name], current[name], change, mark))
+
+    if regressions:
+        print("%d benchmark(s) slower than %.1f%%" % (regressions, args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
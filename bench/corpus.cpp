@@ -0,0 +1,180 @@
+#include "corpus.h"
+#include <linux/limits.h>
+#include <yyjson.h>
+
+#define PATH_SEPARATOR "/"
+
+static const char *default_test_data_dir =
+    "." PATH_SEPARATOR "HttpwgTests-prefix" PATH_SEPARATOR "src" PATH_SEPARATOR "HttpwgTests";
+
+static const char *json_files[] = {
+    "binary.json",          "boolean.json",           "dictionary.json",  "examples.json",      "item.json",
+    "key-generated.json",   "large-generated.json",   "list.json",        "listlist.json",      "number-generated.json",
+    "number.json",          "param-dict.json",        "param-list.json",  "param-listlist.json", "string-generated.json",
+    "string.json",          "token-generated.json",   "token.json",
+};
+
+static const corpus_entry_t builtin_entries[] = {
+    {"cache-status", HSFV_FIELD_VALUE_TYPE_LIST, "ExampleCache; hit; ttl=376, OriginCache; fwd=stale; fwd-status=304; stored"},
+    {"cdn-cache-control", HSFV_FIELD_VALUE_TYPE_DICTIONARY, "max-age=3600, stale-while-revalidate=60, must-revalidate"},
+    {"cache-control", HSFV_FIELD_VALUE_TYPE_DICTIONARY, "private, no-cache, no-store, max-age=0"},
+    {"priority", HSFV_FIELD_VALUE_TYPE_DICTIONARY, "u=1, i"},
+    {"signature-input", HSFV_FIELD_VALUE_TYPE_DICTIONARY,
+     "sig1=(\"@method\" \"@authority\" \"@path\" \"content-digest\" \"content-type\" \"content-length\");created=1618884475;"
+     "keyid=\"test-key-ecc-p256\""},
+    {"signature", HSFV_FIELD_VALUE_TYPE_DICTIONARY,
+     "sig1=:wXcm+8AaXkOAbD8F4n/Mge0sHtmVu6XPFjc+dfgNqhQ8BzThLZGRXO0XJqwPyAanDPgGaq1djzIGuOsMu2IFxg==:"},
+    {"content-digest", HSFV_FIELD_VALUE_TYPE_DICTIONARY,
+     "sha-256=:X48E9qOokqqrvdts8nOJRJN3OWDUoyWxBf7kbu9DBPE=:, sha-512=:WZDPaVn/7XgHaAy8pmojAkGWoRx2UFChF41A2svX+TaPm+AbwAgBWnrIiYllu7BNNyealdVLvRwEmTHWXvJwew==:"},
+    {"permissions-policy", HSFV_FIELD_VALUE_TYPE_DICTIONARY,
+     "geolocation=(self \"https://example.com\"), camera=(), microphone=(), fullscreen=*, payment=(self)"},
+    {"accept-ch", HSFV_FIELD_VALUE_TYPE_LIST, "Sec-CH-UA-Platform-Version, Sec-CH-UA-Model, Sec-CH-UA-Arch, Sec-CH-UA-Full-Version-List"},
+    {"example-decimal", HSFV_FIELD_VALUE_TYPE_ITEM, "4.5;q=0.9"},
+};
+
+static bool combine_field_lines(yyjson_val *raw, std::string *out)
+{
+    size_t idx, max;
+    yyjson_val *val;
+    yyjson_arr_foreach(raw, idx, max, val)
+    {
+        if (!yyjson_is_str(val)) {
+            return false;
+        }
+        if (idx > 0) {
+            out->append(", ");
+        }
+        out->append(yyjson_get_str(val), yyjson_get_len(val));
+    }
+    return true;
+}
+
+static bool get_header_type(yyjson_val *case_obj, hsfv_field_value_type_t *out_type)
+{
+    const char *header_type = yyjson_get_str(yyjson_obj_get(case_obj, "header_type"));
+    if (!header_type) {
+        return false;
+    }
+    if (!strcmp(header_type, "item")) {
+        *out_type = HSFV_FIELD_VALUE_TYPE_ITEM;
+    } else if (!strcmp(header_type, "dictionary")) {
+        *out_type = HSFV_FIELD_VALUE_TYPE_DICTIONARY;
+    } else if (!strcmp(header_type, "list")) {
+        *out_type = HSFV_FIELD_VALUE_TYPE_LIST;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static void load_json_file(const char *path, std::vector<corpus_entry_t> *corpus)
+{
+    yyjson_read_err err;
+    yyjson_doc *doc = yyjson_read_file(path, YYJSON_READ_NOFLAG, NULL, &err);
+    if (!doc) {
+        return;
+    }
+
+    yyjson_val *arr = yyjson_doc_get_root(doc);
+    yyjson_arr_iter iter;
+    yyjson_arr_iter_init(arr, &iter);
+    yyjson_val *case_obj;
+    while ((case_obj = yyjson_arr_iter_next(&iter))) {
+        if (yyjson_get_bool(yyjson_obj_get(case_obj, "must_fail"))) {
+            continue;
+        }
+        yyjson_val *raw = yyjson_obj_get(case_obj, "raw");
+        if (!yyjson_is_arr(raw) || yyjson_arr_size(raw) == 0) {
+            continue;
+        }
+
+        corpus_entry_t entry;
+        if (!get_header_type(case_obj, &entry.type)) {
+            continue;
+        }
+        if (entry.type == HSFV_FIELD_VALUE_TYPE_ITEM && yyjson_arr_size(raw) > 1) {
+            continue;
+        }
+        if (!combine_field_lines(raw, &entry.input)) {
+            continue;
+        }
+        const char *name = yyjson_get_str(yyjson_obj_get(case_obj, "name"));
+        entry.name = name ? name : "";
+
+        /* keep only the inputs the parser accepts so that every mode does the same work */
+        hsfv_field_value_t field_value;
+        const char *input = entry.input.data();
+        if (hsfv_parse_field_value(&field_value, entry.type, &hsfv_global_allocator, input, input + entry.input.size(), NULL)) {
+            continue;
+        }
+        hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+        corpus->push_back(entry);
+    }
+    yyjson_doc_free(doc);
+}
+
+std::vector<corpus_entry_t> load_corpus(const char *test_dir)
+{
+    std::vector<corpus_entry_t> corpus(std::begin(builtin_entries), std::end(builtin_entries));
+
+    if (!test_dir) {
+        test_dir = getenv("HTTPWG_TEST_DIR");
+    }
+    if (!test_dir) {
+        test_dir = default_test_data_dir;
+    }
+
+    for (const char *json_file : json_files) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s%s%s", test_dir, PATH_SEPARATOR, json_file);
+        load_json_file(path, &corpus);
+    }
+    return corpus;
+}
+
+static bool skip_list(const char *input, const char *input_end, bool is_dictionary)
+{
+    while (input < input_end) {
+        if (is_dictionary) {
+            if (!hsfv_skip_key(input, input_end, &input) || !hsfv_skip_dictionary_member_value(input, input_end, &input)) {
+                return false;
+            }
+        } else if (*input == '(') {
+            if (!hsfv_skip_inner_list(input, input_end, &input)) {
+                return false;
+            }
+        } else {
+            if (!hsfv_skip_item(input, input_end, &input)) {
+                return false;
+            }
+        }
+
+        if (!hsfv_skip_ows_comma_ows(input, input_end, &input)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool skip_field_value(hsfv_field_value_type_t type, const char *input, const char *input_end)
+{
+    if (!hsfv_is_ascii_string(input, input_end)) {
+        return false;
+    }
+
+    hsfv_skip_sp(input, input_end, &input);
+    while (input < input_end && input_end[-1] == ' ') {
+        --input_end;
+    }
+
+    switch (type) {
+    case HSFV_FIELD_VALUE_TYPE_LIST:
+        return skip_list(input, input_end, false);
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY:
+        return skip_list(input, input_end, true);
+    case HSFV_FIELD_VALUE_TYPE_ITEM:
+        return hsfv_skip_item(input, input_end, &input) && input == input_end;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef hsfv_bench_corpus_h
+#define hsfv_bench_corpus_h
+
+#include "hsfv.h"
+#include <string>
+#include <vector>
+
+struct corpus_entry_t {
+    std::string name;
+    hsfv_field_value_type_t type;
+    std::string input;
+};
+
+/**
+ * Returns a set of realistic header values followed by every must_fail=false
+ * case of the httpwg structured-field-tests found under test_dir. When
+ * test_dir is NULL, HTTPWG_TEST_DIR or the directory used by httpsfv_tests
+ * is searched. Missing JSON files are skipped silently.
+ */
+std::vector<corpus_entry_t> load_corpus(const char *test_dir);
+
+/**
+ * Validates input without allocating by using the hsfv_skip_* functions.
+ */
+bool skip_field_value(hsfv_field_value_type_t type, const char *input, const char *input_end);
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Reports how much memory each representation of a parsed field value
+ * takes for a corpus of header values: the hsfv_field_value_t tree, the
+ * tape and the compact layout. The bytes counted are those still allocated
+ * after parsing plus the size of the top-level struct, so growth slack in
+ * member arrays is included.
+ *
+ * usage: httpsfv_footprint_bench [-d httpwg_test_dir]
+ */
+#include "corpus.h"
+#include <unistd.h>
+
+enum representation_t {
+    REPRESENTATION_TREE = 0,
+    REPRESENTATION_TAPE,
+    REPRESENTATION_COMPACT,
+    REPRESENTATION_COUNT,
+};
+
+static const char *representation_names[] = {"tree", "tape", "compact"};
+
+/* returns the bytes used by entry parsed into representation, or 0 on error */
+static size_t footprint(representation_t representation, const corpus_entry_t &entry)
+{
+    const char *input = entry.input.data();
+    const char *input_end = input + entry.input.size();
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    size_t bytes = 0;
+
+    switch (representation) {
+    case REPRESENTATION_TREE: {
+        hsfv_field_value_t field_value;
+        if (hsfv_parse_field_value(&field_value, entry.type, &counter.allocator, input, input_end, NULL) == HSFV_OK) {
+            bytes = sizeof(field_value) + counter.live_bytes;
+            hsfv_field_value_deinit(&field_value, &counter.allocator);
+        }
+        break;
+    }
+    case REPRESENTATION_TAPE: {
+        hsfv_tape_t tape = (hsfv_tape_t){0};
+        if (hsfv_parse_tape(&tape, entry.type, &counter.allocator, input, input_end, NULL) == HSFV_OK) {
+            bytes = sizeof(tape) + counter.live_bytes;
+        }
+        hsfv_tape_deinit(&tape, &counter.allocator);
+        break;
+    }
+    case REPRESENTATION_COMPACT: {
+        hsfv_compact_t compact = (hsfv_compact_t){0};
+        if (hsfv_parse_compact(&compact, entry.type, &counter.allocator, input, input_end, NULL) == HSFV_OK) {
+            bytes = sizeof(compact) + counter.live_bytes;
+        }
+        hsfv_compact_deinit(&compact, &counter.allocator);
+        break;
+    }
+    default:
+        break;
+    }
+    return bytes;
+}
+
+int main(int argc, char **argv)
+{
+    const char *test_dir = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:")) != -1) {
+        switch (opt) {
+        case 'd':
+            test_dir = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-d httpwg_test_dir]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<corpus_entry_t> corpus = load_corpus(test_dir);
+    size_t totals[REPRESENTATION_COUNT] = {0};
+    size_t input_bytes = 0, values = 0, skipped = 0;
+
+    for (const corpus_entry_t &entry : corpus) {
+        size_t bytes[REPRESENTATION_COUNT];
+        bool ok = true;
+        for (int r = 0; r < REPRESENTATION_COUNT; r++) {
+            bytes[r] = footprint((representation_t)r, entry);
+            ok = ok && bytes[r] != 0;
+        }
+        /* only compare values every representation accepts */
+        if (!ok) {
+            skipped++;
+            continue;
+        }
+        for (int r = 0; r < REPRESENTATION_COUNT; r++) {
+            totals[r] += bytes[r];
+        }
+        input_bytes += entry.input.size();
+        values++;
+    }
+
+    printf("corpus: %zu values (%zu skipped), %zu input bytes\n", values, skipped, input_bytes);
+    printf("node sizes: key %zu/%zu, bare item %zu/%zu, parameter %zu/%zu, item %zu/%zu, dictionary member %zu/%zu "
+           "(tree/compact)\n",
+           sizeof(hsfv_key_t), sizeof(hsfv_compact_span_t), sizeof(hsfv_bare_item_t), sizeof(hsfv_compact_bare_item_t),
+           sizeof(hsfv_parameter_t), sizeof(hsfv_compact_parameter_t), sizeof(hsfv_item_t), sizeof(hsfv_compact_item_t),
+           sizeof(hsfv_dict_member_t), sizeof(hsfv_compact_member_t));
+    printf("%-8s %12s %12s %9s\n", "layout", "bytes", "bytes/value", "vs tree");
+    for (int r = 0; r < REPRESENTATION_COUNT; r++) {
+        printf("%-8s %12zu %12.1f %8.1f%%\n", representation_names[r], totals[r], values ? (double)totals[r] / values : 0.0,
+               totals[REPRESENTATION_TREE] ? 100.0 * totals[r] / totals[REPRESENTATION_TREE] : 0.0);
+    }
+    return 0;
+}
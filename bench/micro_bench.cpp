@@ -0,0 +1,461 @@
+/*
+ * Microbenchmarks for the parse, skip and serialize functions.
+ *
+ * usage: httpsfv_bench [-f filter] [-m min_time_sec] [-r repetitions] [-o results.json]
+ *
+ * Each benchmark is run for at least min_time_sec per repetition and the
+ * median ns/op over the repetitions is reported. Parse benchmarks also report
+ * how many allocations (alloc plus realloc calls) one iteration makes and how
+ * many bytes it has allocated at most. The
+ * JSON written with -o can be compared against a saved baseline with
+ * bench/compare.py.
+ */
+#include "hsfv.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct bench_t {
+    std::string name;
+    std::function<bool()> fn;
+    bool counts_allocations;
+};
+
+struct bench_result_t {
+    std::string name;
+    double ns_per_op;
+    uint64_t iterations;
+    bool ok;
+    size_t allocs_per_op;
+    size_t peak_bytes_per_op;
+};
+
+static std::vector<bench_t> benches;
+
+/* benchmarks which allocate through this are counted once after timing */
+static hsfv_allocator_t *bench_allocator = &hsfv_global_allocator;
+
+static void do_not_optimize(const void *p)
+{
+    asm volatile("" : : "r"(p) : "memory");
+}
+
+static void add_bench(const std::string &name, std::function<bool()> fn, bool counts_allocations = false)
+{
+    benches.push_back(bench_t{name, fn, counts_allocations});
+}
+
+/* Inputs */
+
+static const char *dictionary_input = "max-age=3600, stale-while-revalidate=60, must-revalidate";
+static const char *list_input = "ExampleCache; hit; ttl=376, OriginCache; fwd=stale; fwd-status=304; stored";
+static const char *inner_list_input = "(\"@method\" \"@authority\" \"@path\" \"content-digest\");created=1618884475;keyid=\"test-key\"";
+static const char *item_input = "\"foo\";a=1;b=?0;c=tok";
+static const char *parameters_input = ";a=1;b=2;c=tok;d=\"str\"";
+/* typical values, where no item has more than two parameters */
+static const char *cache_status_input = "ExampleCache; hit; ttl=376, OriginCache; fwd=uri-miss";
+static const char *signature_input_input = "sig1=(\"@method\" \"@authority\" \"@path\");created=1618884475;keyid=\"test-key-rsa\"";
+static const char *token_input = "sha-256";
+static const char *key_input = "max-age";
+static const char *uninterned_key_input = "x-max-age";
+static const char *boolean_input = "?1";
+static const char *integer_input = "-1618884475";
+static const char *non_negative_integer_input = "1618884475";
+static const char *decimal_input = "-123.456";
+static const char *string_input = "\"hello \\\"world\\\", this is a string\"";
+static const char *byte_seq_input = ":X48E9qOokqqrvdts8nOJRJN3OWDUoyWxBf7kbu9DBPE=:";
+static const char *targeted_cache_control_input = "max-age=3600, must-revalidate, private, no-cache, s-maxage=60";
+
+static const char *end_of(const char *input)
+{
+    return input + strlen(input);
+}
+
+/* Parse */
+
+#define ADD_PARSE_BENCH(name, type_t, deinit, input, call)                                                                        \
+    add_bench(name, [] {                                                                                                           \
+        hsfv_allocator_t *allocator = bench_allocator;                                                                             \
+        const char *input_end = end_of(input);                                                                                     \
+        type_t value;                                                                                                              \
+        hsfv_err_t err = call;                                                                                                     \
+        do_not_optimize(&value);                                                                                                   \
+        if (err) {                                                                                                                 \
+            return false;                                                                                                          \
+        }                                                                                                                          \
+        deinit(&value, allocator);                                                                                                 \
+        return true;                                                                                                               \
+    }, true)
+
+static void no_deinit(const void *value, hsfv_allocator_t *allocator)
+{
+}
+
+static void register_parse_benches()
+{
+    ADD_PARSE_BENCH("parse_field_value/dictionary", hsfv_field_value_t, hsfv_field_value_deinit, dictionary_input,
+                    hsfv_parse_field_value(&value, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, dictionary_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_field_value/list", hsfv_field_value_t, hsfv_field_value_deinit, list_input,
+                    hsfv_parse_field_value(&value, HSFV_FIELD_VALUE_TYPE_LIST, allocator, list_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_field_value/item", hsfv_field_value_t, hsfv_field_value_deinit, item_input,
+                    hsfv_parse_field_value(&value, HSFV_FIELD_VALUE_TYPE_ITEM, allocator, item_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_field_value/cache_status", hsfv_field_value_t, hsfv_field_value_deinit, cache_status_input,
+                    hsfv_parse_field_value(&value, HSFV_FIELD_VALUE_TYPE_LIST, allocator, cache_status_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_field_value/signature_input", hsfv_field_value_t, hsfv_field_value_deinit, signature_input_input,
+                    hsfv_parse_field_value(&value, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, signature_input_input, input_end,
+                                           NULL));
+    ADD_PARSE_BENCH("parse_dictionary", hsfv_dictionary_t, hsfv_dictionary_deinit, dictionary_input,
+                    hsfv_parse_dictionary(&value, allocator, dictionary_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_list", hsfv_list_t, hsfv_list_deinit, list_input,
+                    hsfv_parse_list(&value, allocator, list_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_inner_list", hsfv_inner_list_t, hsfv_inner_list_deinit, inner_list_input,
+                    hsfv_parse_inner_list(&value, allocator, inner_list_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_item", hsfv_item_t, hsfv_item_deinit, item_input,
+                    hsfv_parse_item(&value, allocator, item_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_parameters", hsfv_parameters_t, hsfv_parameters_deinit, parameters_input,
+                    hsfv_parse_parameters(&value, allocator, parameters_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_bare_item", hsfv_bare_item_t, hsfv_bare_item_deinit, token_input,
+                    hsfv_parse_bare_item(&value, allocator, token_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_boolean", hsfv_bare_item_t, no_deinit, boolean_input,
+                    hsfv_parse_boolean(&value, boolean_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_number/integer", hsfv_bare_item_t, no_deinit, integer_input,
+                    hsfv_parse_number(&value, integer_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_number/decimal", hsfv_bare_item_t, no_deinit, decimal_input,
+                    hsfv_parse_number(&value, decimal_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_string", hsfv_bare_item_t, hsfv_bare_item_deinit, string_input,
+                    hsfv_parse_string(&value, allocator, string_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_token", hsfv_bare_item_t, hsfv_bare_item_deinit, token_input,
+                    hsfv_parse_token(&value, allocator, token_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_byte_seq", hsfv_bare_item_t, hsfv_bare_item_deinit, byte_seq_input,
+                    hsfv_parse_byte_seq(&value, allocator, byte_seq_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_key", hsfv_key_t, hsfv_key_deinit, key_input, hsfv_parse_key(&value, allocator, key_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_key/uninterned", hsfv_key_t, hsfv_key_deinit, uninterned_key_input,
+                    hsfv_parse_key(&value, allocator, uninterned_key_input, input_end, NULL));
+    ADD_PARSE_BENCH("parse_non_negative_integer", int64_t, no_deinit, non_negative_integer_input,
+                    hsfv_parse_non_negative_integer(non_negative_integer_input, input_end, &value, NULL));
+    ADD_PARSE_BENCH("parse_integer", int64_t, no_deinit, integer_input, hsfv_parse_integer(integer_input, input_end, &value, NULL));
+    ADD_PARSE_BENCH("parse_decimal", double, no_deinit, decimal_input, hsfv_parse_decimal(decimal_input, input_end, &value, NULL));
+
+    add_bench("parse_batch", [] {
+        static hsfv_arena_t arena;
+        static bool initialized;
+        if (!initialized) {
+            hsfv_arena_init(&arena, &hsfv_global_allocator, 0);
+            initialized = true;
+        }
+        hsfv_batch_entry_t entries[] = {
+            {.input = dictionary_input, .input_end = end_of(dictionary_input), .type = HSFV_FIELD_VALUE_TYPE_DICTIONARY},
+            {.input = list_input, .input_end = end_of(list_input), .type = HSFV_FIELD_VALUE_TYPE_LIST},
+            {.input = item_input, .input_end = end_of(item_input), .type = HSFV_FIELD_VALUE_TYPE_ITEM},
+        };
+        size_t failed = hsfv_parse_batch(entries, sizeof(entries) / sizeof(entries[0]), &arena);
+        do_not_optimize(entries);
+        hsfv_arena_reset(&arena);
+        return failed == 0;
+    });
+
+    /* the tape keeps its block between iterations, as a long-lived caller would */
+    add_bench("parse_tape/dictionary", [] {
+        static hsfv_tape_t tape;
+        hsfv_err_t err = hsfv_parse_tape(&tape, HSFV_FIELD_VALUE_TYPE_DICTIONARY, &hsfv_global_allocator, dictionary_input,
+                                         end_of(dictionary_input), NULL);
+        do_not_optimize(tape.entries);
+        return err == HSFV_OK;
+    });
+    add_bench("parse_tape/list", [] {
+        static hsfv_tape_t tape;
+        hsfv_err_t err =
+            hsfv_parse_tape(&tape, HSFV_FIELD_VALUE_TYPE_LIST, &hsfv_global_allocator, list_input, end_of(list_input), NULL);
+        do_not_optimize(tape.entries);
+        return err == HSFV_OK;
+    });
+
+    add_bench("cache_parse/hit", [] {
+        static hsfv_cache_t *cache = hsfv_cache_create(&hsfv_global_allocator, 0);
+        const hsfv_field_value_t *value;
+        hsfv_err_t err = hsfv_cache_parse(cache, HSFV_FIELD_VALUE_TYPE_LIST, list_input, end_of(list_input), &value);
+        do_not_optimize(value);
+        if (err) {
+            return false;
+        }
+        hsfv_cache_release(value);
+        return true;
+    });
+
+    add_bench("parse_targeted_cache_control", [] {
+        hsfv_targeted_cache_control_t cc = {0};
+        bool ok = parse_targeted_cache_control(targeted_cache_control_input, end_of(targeted_cache_control_input), &cc, NULL);
+        do_not_optimize(&cc);
+        return ok;
+    });
+}
+
+/* Skip */
+
+#define ADD_SKIP_BENCH(name, func, input)                                                                                          \
+    add_bench(name, [] {                                                                                                           \
+        const char *rest;                                                                                                          \
+        bool ok = func(input, end_of(input), &rest);                                                                               \
+        do_not_optimize(rest);                                                                                                     \
+        return ok;                                                                                                                 \
+    })
+
+static void register_skip_benches()
+{
+    ADD_SKIP_BENCH("skip_boolean", hsfv_skip_boolean, boolean_input);
+    ADD_SKIP_BENCH("skip_number", hsfv_skip_number, decimal_input);
+    ADD_SKIP_BENCH("skip_string", hsfv_skip_string, string_input);
+    ADD_SKIP_BENCH("skip_token", hsfv_skip_token, token_input);
+    ADD_SKIP_BENCH("skip_key", hsfv_skip_key, key_input);
+    ADD_SKIP_BENCH("skip_byte_seq", hsfv_skip_byte_seq, byte_seq_input);
+    ADD_SKIP_BENCH("skip_bare_item", hsfv_skip_bare_item, string_input);
+    ADD_SKIP_BENCH("skip_parameters", hsfv_skip_parameters, parameters_input);
+    ADD_SKIP_BENCH("skip_item", hsfv_skip_item, item_input);
+    ADD_SKIP_BENCH("skip_inner_list", hsfv_skip_inner_list, inner_list_input);
+    ADD_SKIP_BENCH("skip_dictionary_member_value", hsfv_skip_dictionary_member_value, "=(\"@method\" \"@path\");created=1618884475");
+    ADD_SKIP_BENCH("skip_ows_comma_ows", hsfv_skip_ows_comma_ows, " \t, \tnext");
+
+    add_bench("skip_sp", [] {
+        const char *input = "        next";
+        const char *rest;
+        hsfv_skip_sp(input, end_of(input), &rest);
+        do_not_optimize(rest);
+        return true;
+    });
+    add_bench("skip_ows", [] {
+        const char *input = " \t \t \t \tnext";
+        const char *rest;
+        hsfv_skip_ows(input, end_of(input), &rest);
+        do_not_optimize(rest);
+        return true;
+    });
+}
+
+/* Serialize */
+
+static hsfv_buffer_t serialize_buf;
+
+static hsfv_field_value_t parsed_field_value(hsfv_field_value_type_t type, const char *input)
+{
+    hsfv_field_value_t value;
+    hsfv_err_t err = hsfv_parse_field_value(&value, type, &hsfv_global_allocator, input, end_of(input), NULL);
+    if (err) {
+        fprintf(stderr, "cannot parse benchmark input: %s\n", input);
+        exit(1);
+    }
+    return value;
+}
+
+#define ADD_SERIALIZE_BENCH(name, call)                                                                                            \
+    add_bench(name, [=] {                                                                                                          \
+        hsfv_allocator_t *allocator = &hsfv_global_allocator;                                                                     \
+        serialize_buf.bytes.len = 0;                                                                                               \
+        hsfv_err_t err = call;                                                                                                     \
+        do_not_optimize(serialize_buf.bytes.base);                                                                                 \
+        return err == HSFV_OK;                                                                                                     \
+    })
+
+static void register_serialize_benches()
+{
+    /* These values are kept until the process exits. */
+    static hsfv_field_value_t dictionary = parsed_field_value(HSFV_FIELD_VALUE_TYPE_DICTIONARY, dictionary_input);
+    static hsfv_field_value_t list = parsed_field_value(HSFV_FIELD_VALUE_TYPE_LIST, list_input);
+    static hsfv_field_value_t inner_list = parsed_field_value(HSFV_FIELD_VALUE_TYPE_LIST, inner_list_input);
+    static hsfv_field_value_t item = parsed_field_value(HSFV_FIELD_VALUE_TYPE_ITEM, item_input);
+    static hsfv_field_value_t string = parsed_field_value(HSFV_FIELD_VALUE_TYPE_ITEM, string_input);
+    static hsfv_field_value_t token = parsed_field_value(HSFV_FIELD_VALUE_TYPE_ITEM, token_input);
+    static hsfv_field_value_t byte_seq = parsed_field_value(HSFV_FIELD_VALUE_TYPE_ITEM, byte_seq_input);
+    static hsfv_key_t key = {.base = key_input, .len = strlen(key_input)};
+
+    static hsfv_tape_t dictionary_tape;
+    if (hsfv_parse_tape(&dictionary_tape, HSFV_FIELD_VALUE_TYPE_DICTIONARY, &hsfv_global_allocator, dictionary_input,
+                        end_of(dictionary_input), NULL)) {
+        fprintf(stderr, "cannot parse benchmark input: %s\n", dictionary_input);
+        exit(1);
+    }
+
+    static hsfv_buffer_t list_binary;
+    if (hsfv_encode_binary(&list, &hsfv_global_allocator, &list_binary)) {
+        fprintf(stderr, "cannot encode benchmark input: %s\n", list_input);
+        exit(1);
+    }
+
+    ADD_SERIALIZE_BENCH("encode_binary", hsfv_encode_binary(&list, allocator, &serialize_buf));
+    add_bench(
+        "decode_binary",
+        [] {
+            hsfv_field_value_t value;
+            hsfv_err_t err = hsfv_decode_binary(&value, bench_allocator, list_binary.bytes.base, list_binary.bytes.len);
+            do_not_optimize(&value);
+            if (err) {
+                return false;
+            }
+            hsfv_field_value_deinit(&value, bench_allocator);
+            return true;
+        },
+        true);
+    /* what a cache does when serving an object: find one parameter without decoding */
+    add_bench("binary_view/lookup", [] {
+        hsfv_field_value_type_t type;
+        hsfv_binary_cursor_t root;
+        hsfv_binary_member_t member, param;
+        if (hsfv_binary_view(list_binary.bytes.base, list_binary.bytes.len, &type, &root) ||
+            hsfv_binary_next(&root, &member) || hsfv_binary_lookup(&member.parameters, "ttl", 3, &param)) {
+            return false;
+        }
+        do_not_optimize(&param);
+        return true;
+    });
+    ADD_SERIALIZE_BENCH("serialize_tape", hsfv_serialize_tape(&dictionary_tape, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_field_value", hsfv_serialize_field_value(&dictionary, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_dictionary", hsfv_serialize_dictionary(&dictionary.dictionary, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_list", hsfv_serialize_list(&list.list, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_inner_list",
+                        hsfv_serialize_inner_list(&inner_list.list.members[0].inner_list, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_item", hsfv_serialize_item(&item.item, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_parameters", hsfv_serialize_parameters(&item.item.parameters, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_key", hsfv_serialize_key(&key, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_bare_item", hsfv_serialize_bare_item(&token.item.bare_item, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_boolean", hsfv_serialize_boolean(true, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_byte_seq", hsfv_serialize_byte_seq(&byte_seq.item.bare_item.byte_seq, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_token", hsfv_serialize_token(&token.item.bare_item.token, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_string", hsfv_serialize_string(&string.item.bare_item.string, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_decimal", hsfv_serialize_decimal(-123.456, allocator, &serialize_buf));
+    ADD_SERIALIZE_BENCH("serialize_integer", hsfv_serialize_integer(-1618884475, allocator, &serialize_buf));
+}
+
+/* Runner */
+
+static bench_result_t run_bench(const bench_t &bench, double min_time, int repetitions)
+{
+    bench_result_t result = {bench.name, 0, 0, true, 0};
+    std::vector<double> samples;
+
+    /* warm up caches and the allocator */
+    for (int i = 0; i < 100; i++) {
+        if (!bench.fn()) {
+            result.ok = false;
+            return result;
+        }
+    }
+
+    for (int r = 0; r < repetitions; r++) {
+        uint64_t iterations = 0;
+        uint64_t batch = 64;
+        double elapsed = 0;
+        bench_clock::time_point start = bench_clock::now();
+        while (elapsed < min_time) {
+            for (uint64_t i = 0; i < batch; i++) {
+                bench.fn();
+            }
+            iterations += batch;
+            batch *= 2;
+            elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        }
+        samples.push_back(elapsed * 1e9 / iterations);
+        result.iterations += iterations;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    result.ns_per_op = samples[samples.size() / 2];
+
+    if (bench.counts_allocations) {
+        hsfv_counting_allocator_t counter;
+        hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+        bench_allocator = &counter.allocator;
+        bench.fn();
+        bench_allocator = &hsfv_global_allocator;
+        result.allocs_per_op = counter.alloc_count + counter.realloc_count;
+        result.peak_bytes_per_op = counter.peak_bytes;
+    }
+    return result;
+}
+
+static bool write_json(const char *path, const std::vector<bench_result_t> &results, double min_time, int repetitions)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        return false;
+    }
+
+    fprintf(fp, "{\n  \"min_time\": %g,\n  \"repetitions\": %d,\n  \"benchmarks\": [\n", min_time, repetitions);
+    for (size_t i = 0; i < results.size(); i++) {
+        const bench_result_t &r = results[i];
+        fprintf(fp,
+                "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"iterations\": %llu, \"allocs_per_op\": %zu, \"peak_bytes_per_op\": %zu}%s\n",
+                r.name.c_str(), r.ns_per_op, (unsigned long long)r.iterations, r.allocs_per_op, r.peak_bytes_per_op,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    return fclose(fp) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = NULL;
+    const char *output = NULL;
+    double min_time = 0.1;
+    int repetitions = 5;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:m:r:o:")) != -1) {
+        switch (opt) {
+        case 'f':
+            filter = optarg;
+            break;
+        case 'm':
+            min_time = atof(optarg);
+            break;
+        case 'r':
+            repetitions = atoi(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-f filter] [-m min_time_sec] [-r repetitions] [-o results.json]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (repetitions < 1) {
+        repetitions = 1;
+    }
+
+    register_parse_benches();
+    register_skip_benches();
+    register_serialize_benches();
+
+    std::vector<bench_result_t> results;
+    int status = 0;
+    for (const bench_t &bench : benches) {
+        if (filter && bench.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        bench_result_t result = run_bench(bench, min_time, repetitions);
+        if (!result.ok) {
+            fprintf(stderr, "%s: failed\n", bench.name.c_str());
+            status = 1;
+            continue;
+        }
+        if (bench.counts_allocations) {
+            printf("%-40s %12.1f ns/op %6zu allocs/op %8zu peak bytes/op\n", result.name.c_str(), result.ns_per_op, result.allocs_per_op,
+                   result.peak_bytes_per_op);
+        } else {
+            printf("%-40s %12.1f ns/op\n", result.name.c_str(), result.ns_per_op);
+        }
+        results.push_back(result);
+    }
+
+    hsfv_buffer_deinit(&serialize_buf, &hsfv_global_allocator);
+
+    if (output && !write_json(output, results, min_time, repetitions)) {
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,215 @@
+/*
+ * Replays a corpus of header values across 1..N threads and reports
+ * throughput and per-operation latency for each allocation strategy and
+ * for lookups in the parse caches.
+ *
+ * usage: httpsfv_mt_bench [-t max_threads] [-n passes] [-d httpwg_test_dir]
+ */
+#include "corpus.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+
+enum bench_mode_t {
+    BENCH_MODE_GLOBAL = 0,
+    BENCH_MODE_ARENA,
+    BENCH_MODE_POOL,
+    BENCH_MODE_BORROWED,
+    BENCH_MODE_CACHE,
+    BENCH_MODE_SHARED_CACHE,
+};
+
+static const char *bench_mode_names[] = {"global", "arena", "pool", "borrowed", "cache", "shared"};
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct thread_result_t {
+    std::vector<uint32_t> latencies_ns;
+    size_t errors;
+};
+
+/*
+ * global:   parse and serialize with hsfv_global_allocator, freeing every tree.
+ * arena:    parse and serialize into a per-thread hsfv_arena_t reset after
+ *           every value, so malloc is only hit while the arena warms up.
+ * pool:     parse and serialize with one hsfv_pool_t shared by every thread,
+ *           freeing every tree. Compared with global this shows how much
+ *           the per-thread free lists save once malloc itself contends.
+ * borrowed: validate with the hsfv_skip_* functions, which borrow the input
+ *           and never allocate; this is the contention-free floor.
+ * cache:    look the value up in a per-thread hsfv_cache_t and release it.
+ * shared:   look the value up in one hsfv_shared_cache_t used by every
+ *           thread and release it. Both caches hold the whole corpus, so
+ *           after the first pass every lookup is a hit.
+ */
+static bool run_one(bench_mode_t mode, const corpus_entry_t &entry, hsfv_arena_t *arena, hsfv_pool_t *pool, hsfv_cache_t *cache,
+                    hsfv_shared_cache_t *shared_cache)
+{
+    const char *input = entry.input.data();
+    const char *input_end = input + entry.input.size();
+    hsfv_allocator_t *allocator;
+    hsfv_field_value_t field_value;
+    const hsfv_field_value_t *cached;
+    hsfv_buffer_t buf = (hsfv_buffer_t){0};
+    hsfv_err_t err;
+
+    switch (mode) {
+    case BENCH_MODE_GLOBAL:
+        allocator = &hsfv_global_allocator;
+        break;
+    case BENCH_MODE_ARENA:
+        allocator = &arena->allocator;
+        break;
+    case BENCH_MODE_POOL:
+        allocator = hsfv_pool_allocator(pool);
+        break;
+    case BENCH_MODE_BORROWED:
+        return skip_field_value(entry.type, input, input_end);
+    case BENCH_MODE_CACHE:
+        err = hsfv_cache_parse(cache, entry.type, input, input_end, &cached);
+        if (err) {
+            return false;
+        }
+        hsfv_cache_release(cached);
+        return true;
+    case BENCH_MODE_SHARED_CACHE:
+        err = hsfv_shared_cache_parse(shared_cache, entry.type, input, input_end, &cached);
+        if (err) {
+            return false;
+        }
+        hsfv_cache_release(cached);
+        return true;
+    default:
+        return false;
+    }
+
+    err = hsfv_parse_field_value(&field_value, entry.type, allocator, input, input_end, NULL);
+    if (err) {
+        return false;
+    }
+    err = hsfv_serialize_field_value(&field_value, allocator, &buf);
+
+    if (mode == BENCH_MODE_ARENA) {
+        hsfv_arena_reset(arena);
+    } else {
+        hsfv_buffer_deinit(&buf, allocator);
+        hsfv_field_value_deinit(&field_value, allocator);
+    }
+    return err == HSFV_OK;
+}
+
+static void worker(bench_mode_t mode, const std::vector<corpus_entry_t> *corpus, int passes, hsfv_pool_t *pool,
+                   hsfv_shared_cache_t *shared_cache, thread_result_t *result)
+{
+    hsfv_arena_t arena;
+    hsfv_arena_init(&arena, &hsfv_global_allocator, 0);
+    /* only the cache mode uses a per-thread cache, so the other modes do not pay for building and freeing one */
+    hsfv_cache_t *cache = mode == BENCH_MODE_CACHE ? hsfv_cache_create(&hsfv_global_allocator, corpus->size()) : NULL;
+
+    result->latencies_ns.reserve(corpus->size() * passes);
+    result->errors = 0;
+    for (int i = 0; i < passes; i++) {
+        for (const corpus_entry_t &entry : *corpus) {
+            bench_clock::time_point start = bench_clock::now();
+            bool ok = run_one(mode, entry, &arena, pool, cache, shared_cache);
+            bench_clock::time_point end = bench_clock::now();
+            result->latencies_ns.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            if (!ok) {
+                result->errors++;
+            }
+        }
+    }
+
+    hsfv_cache_destroy(cache);
+    hsfv_arena_deinit(&arena);
+}
+
+static uint32_t percentile(const std::vector<uint32_t> &sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t i = (size_t)(p * (sorted.size() - 1));
+    return sorted[i];
+}
+
+static void run_mode(bench_mode_t mode, int threads, const std::vector<corpus_entry_t> &corpus, int passes)
+{
+    std::vector<thread_result_t> results(threads);
+    std::vector<std::thread> workers;
+    /* leave room in every shard so that the shared cache never evicts */
+    hsfv_shared_cache_t *shared_cache =
+        mode == BENCH_MODE_SHARED_CACHE
+            ? hsfv_shared_cache_create(&hsfv_global_allocator, std::max<size_t>(corpus.size() * 4, HSFV_CACHE_DEFAULT_CAPACITY), 0)
+            : NULL;
+
+    hsfv_pool_t *pool = hsfv_pool_create(&hsfv_global_allocator);
+
+    bench_clock::time_point start = bench_clock::now();
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(worker, mode, &corpus, passes, pool, shared_cache, &results[i]);
+    }
+    for (std::thread &t : workers) {
+        t.join();
+    }
+    double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+    hsfv_shared_cache_destroy(shared_cache);
+    hsfv_pool_destroy(pool);
+
+    std::vector<uint32_t> latencies;
+    size_t errors = 0;
+    for (const thread_result_t &r : results) {
+        latencies.insert(latencies.end(), r.latencies_ns.begin(), r.latencies_ns.end());
+        errors += r.errors;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("%-8s %7d %14.0f %14.0f %9u %9u %7zu\n", bench_mode_names[mode], threads, latencies.size() / elapsed,
+           latencies.size() / elapsed / threads, percentile(latencies, 0.50), percentile(latencies, 0.99), errors);
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = (int)std::thread::hardware_concurrency();
+    int passes = 200;
+    const char *test_dir = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:n:d:")) != -1) {
+        switch (opt) {
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 'n':
+            passes = atoi(optarg);
+            break;
+        case 'd':
+            test_dir = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t max_threads] [-n passes] [-d httpwg_test_dir]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+
+    std::vector<corpus_entry_t> corpus = load_corpus(test_dir);
+    printf("corpus: %zu values, %d passes per thread\n", corpus.size(), passes);
+    printf("%-8s %7s %14s %14s %9s %9s %7s\n", "mode", "threads", "ops/s", "ops/s/thread", "p50(ns)", "p99(ns)", "errors");
+
+    std::vector<int> thread_counts;
+    for (int t = 1; t < max_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(max_threads);
+
+    for (int threads : thread_counts) {
+        for (int mode = BENCH_MODE_GLOBAL; mode <= BENCH_MODE_SHARED_CACHE; mode++) {
+            run_mode((bench_mode_t)mode, threads, corpus, passes);
+        }
+    }
+    return 0;
+}
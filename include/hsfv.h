@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,12 +33,61 @@ typedef enum {
 
 typedef struct st_hsfv_allocator_t hsfv_allocator_t;
 
+/**
+ * allocator interface used by every function which allocates. alloc, realloc
+ * and free are required. The remaining members are optional and may be left
+ * NULL; call them through the hsfv_allocator_* functions below, which fall
+ * back to the required ones.
+ */
 struct st_hsfv_allocator_t {
     void *(*alloc)(hsfv_allocator_t *self, size_t size);
     void *(*realloc)(hsfv_allocator_t *self, void *ptr, size_t size);
     void (*free)(hsfv_allocator_t *self, void *ptr);
+    /** frees ptr, which was allocated or last reallocated with size bytes */
+    void (*free_sized)(hsfv_allocator_t *self, void *ptr, size_t size);
+    /** allocates size bytes aligned to alignment, a power of two; the block is freed with free */
+    void *(*alloc_aligned)(hsfv_allocator_t *self, size_t size, size_t alignment);
+    /** grows or shrinks ptr to size bytes without moving it, returning false if that is not possible */
+    bool (*try_expand_in_place)(hsfv_allocator_t *self, void *ptr, size_t size);
 };
 
+/** alignment of every block returned by alloc and realloc */
+#define HSFV_ALLOCATOR_MIN_ALIGNMENT 8
+
+/**
+ * frees ptr with free_sized if the allocator has one, or with free. The
+ * library passes the size it last requested for ptr: the length of a key,
+ * string, token or byte sequence that is not inline, and the capacity of a
+ * member, item or parameter array times its element size. Trees built by
+ * hand must keep those consistent for allocators which rely on the size.
+ */
+static inline void hsfv_allocator_free_sized(hsfv_allocator_t *allocator, void *ptr, size_t size)
+{
+    if (allocator->free_sized) {
+        allocator->free_sized(allocator, ptr, size);
+    } else {
+        allocator->free(allocator, ptr);
+    }
+}
+
+/**
+ * allocates size bytes aligned to alignment. Allocators without
+ * alloc_aligned can only serve alignments up to HSFV_ALLOCATOR_MIN_ALIGNMENT,
+ * and NULL is returned for larger ones.
+ */
+static inline void *hsfv_allocator_alloc_aligned(hsfv_allocator_t *allocator, size_t size, size_t alignment)
+{
+    if (allocator->alloc_aligned) {
+        return allocator->alloc_aligned(allocator, size, alignment);
+    }
+    return alignment <= HSFV_ALLOCATOR_MIN_ALIGNMENT ? allocator->alloc(allocator, size) : NULL;
+}
+
+static inline bool hsfv_allocator_try_expand_in_place(hsfv_allocator_t *allocator, void *ptr, size_t size)
+{
+    return allocator->try_expand_in_place && allocator->try_expand_in_place(allocator, ptr, size);
+}
+
 extern hsfv_allocator_t hsfv_global_allocator;
 
 typedef struct {
@@ -48,6 +98,51 @@ typedef struct {
 
 extern hsfv_failing_allocator_t hsfv_failing_allocator;
 
+/**
+ * allocator which forwards to a backing allocator and records how it is
+ * used. size_histogram[i] counts alloc and realloc requests whose size is
+ * in (2^(i-1), 2^i]; the last bucket also counts every larger request.
+ */
+#define HSFV_COUNTING_ALLOCATOR_HISTOGRAM_SIZE 16
+
+typedef struct st_hsfv_counting_allocator_t {
+    hsfv_allocator_t allocator;
+    hsfv_allocator_t *backing;
+    size_t alloc_count;
+    size_t realloc_count;
+    size_t free_count;
+    size_t live_bytes;
+    size_t peak_bytes;
+    /** calls to free_sized whose size differs from the one the block was allocated with */
+    size_t free_size_mismatches;
+    size_t size_histogram[HSFV_COUNTING_ALLOCATOR_HISTOGRAM_SIZE];
+} hsfv_counting_allocator_t;
+
+void hsfv_counting_allocator_init(hsfv_counting_allocator_t *counter, hsfv_allocator_t *backing);
+void hsfv_counting_allocator_reset_stats(hsfv_counting_allocator_t *counter);
+void hsfv_counting_allocator_report(const hsfv_counting_allocator_t *counter, FILE *fp);
+
+/**
+ * bump allocator which carves allocations out of large chunks taken from
+ * a backing allocator. free is a no-op except for the most recent block,
+ * and every block is released at once by hsfv_arena_reset or
+ * hsfv_arena_deinit.
+ */
+typedef struct st_hsfv_arena_chunk_t hsfv_arena_chunk_t;
+
+typedef struct st_hsfv_arena_t {
+    hsfv_allocator_t allocator;
+    hsfv_allocator_t *backing;
+    hsfv_arena_chunk_t *chunks;
+    size_t chunk_size;
+} hsfv_arena_t;
+
+#define HSFV_ARENA_DEFAULT_CHUNK_SIZE 4096
+
+void hsfv_arena_init(hsfv_arena_t *arena, hsfv_allocator_t *backing, size_t chunk_size);
+void hsfv_arena_reset(hsfv_arena_t *arena);
+void hsfv_arena_deinit(hsfv_arena_t *arena);
+
 typedef unsigned char hsfv_byte_t;
 
 hsfv_byte_t *hsfv_bytes_dup(hsfv_allocator_t *allocator, const hsfv_byte_t *src, size_t len);
@@ -106,6 +201,157 @@ void hsfv_string_deinit(hsfv_string_t *v, hsfv_allocator_t *allocator);
 void hsfv_token_deinit(hsfv_token_t *v, hsfv_allocator_t *allocator);
 void hsfv_byte_seq_deinit(hsfv_byte_seq_t *v, hsfv_allocator_t *allocator);
 
+/**
+ * the parser stores keys, strings, tokens and byte sequences of at most
+ * HSFV_INLINE_CAPACITY bytes inside the struct instead of allocating them.
+ * An inline value has HSFV_INLINE_FLAG set in len, its length in the rest
+ * of the top byte of len, and its bytes from the start of the struct, so
+ * base must not be used. Reading base and len of a parsed value directly is
+ * unsupported; use hsfv_key_base, hsfv_key_len and the like, which handle
+ * both forms. Values made by setting base and len directly are never inline.
+ */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HSFV_INLINE_CAPACITY (sizeof(const char *) + sizeof(size_t) - 1)
+#else
+#define HSFV_INLINE_CAPACITY sizeof(const char *)
+#endif
+#define HSFV_INLINE_LEN_SHIFT (sizeof(size_t) * 8 - 8)
+#define HSFV_INLINE_FLAG ((size_t)0x80 << HSFV_INLINE_LEN_SHIFT)
+
+static inline size_t hsfv_inline_len(size_t len)
+{
+    return (len & HSFV_INLINE_FLAG) ? (len >> HSFV_INLINE_LEN_SHIFT) & 0x7f : len;
+}
+
+/**
+ * stores len bytes of src inline in span, which is a hsfv_key_t,
+ * hsfv_string_t, hsfv_token_t or hsfv_byte_seq_t. len must not exceed
+ * HSFV_INLINE_CAPACITY.
+ */
+static inline void hsfv_inline_set(void *span, const void *src, size_t len)
+{
+    hsfv_byte_t bytes[sizeof(hsfv_key_t)] = {0};
+    size_t tagged_len;
+
+    memcpy(bytes, src, len);
+    memcpy(&tagged_len, bytes + offsetof(hsfv_key_t, len), sizeof(size_t));
+    tagged_len = (tagged_len & ~((size_t)0xff << HSFV_INLINE_LEN_SHIFT)) | HSFV_INLINE_FLAG | (len << HSFV_INLINE_LEN_SHIFT);
+    memcpy(bytes + offsetof(hsfv_key_t, len), &tagged_len, sizeof(size_t));
+    memcpy(span, bytes, sizeof(bytes));
+}
+
+static inline const char *hsfv_key_base(const hsfv_key_t *key)
+{
+    return (key->len & HSFV_INLINE_FLAG) ? (const char *)key : key->base;
+}
+
+static inline size_t hsfv_key_len(const hsfv_key_t *key)
+{
+    return hsfv_inline_len(key->len);
+}
+
+static inline const char *hsfv_string_base(const hsfv_string_t *string)
+{
+    return (string->len & HSFV_INLINE_FLAG) ? (const char *)string : string->base;
+}
+
+static inline size_t hsfv_string_len(const hsfv_string_t *string)
+{
+    return hsfv_inline_len(string->len);
+}
+
+static inline const char *hsfv_token_base(const hsfv_token_t *token)
+{
+    return (token->len & HSFV_INLINE_FLAG) ? (const char *)token : token->base;
+}
+
+static inline size_t hsfv_token_len(const hsfv_token_t *token)
+{
+    return hsfv_inline_len(token->len);
+}
+
+static inline const hsfv_byte_t *hsfv_byte_seq_base(const hsfv_byte_seq_t *byte_seq)
+{
+    return (byte_seq->len & HSFV_INLINE_FLAG) ? (const hsfv_byte_t *)byte_seq : byte_seq->base;
+}
+
+static inline size_t hsfv_byte_seq_len(const hsfv_byte_seq_t *byte_seq)
+{
+    return hsfv_inline_len(byte_seq->len);
+}
+
+/**
+ * keys and tokens from this vocabulary are interned: parsing them points
+ * the key or token at static storage instead of allocating a copy, and
+ * hsfv_key_id and hsfv_token_id return their id so that callers can switch
+ * on it instead of comparing bytes. Ids of this vocabulary are fixed;
+ * hsfv_intern_register adds more at startup.
+ */
+// clang-format off
+#define HSFV_INTERN_VOCABULARY(X)                                                                                                  \
+    /* Cache-Control, CDN-Cache-Control */                                                                                         \
+    X(MAX_AGE, "max-age") X(S_MAXAGE, "s-maxage") X(NO_CACHE, "no-cache") X(NO_STORE, "no-store")                                  \
+    X(NO_TRANSFORM, "no-transform") X(MUST_REVALIDATE, "must-revalidate") X(PROXY_REVALIDATE, "proxy-revalidate")                  \
+    X(MUST_UNDERSTAND, "must-understand") X(PRIVATE, "private") X(PUBLIC, "public") X(IMMUTABLE, "immutable")                      \
+    X(STALE_WHILE_REVALIDATE, "stale-while-revalidate") X(STALE_IF_ERROR, "stale-if-error")                                        \
+    /* Priority */                                                                                                                 \
+    X(U, "u") X(I, "i")                                                                                                            \
+    /* Cache-Status */                                                                                                             \
+    X(HIT, "hit") X(FWD, "fwd") X(FWD_STATUS, "fwd-status") X(TTL, "ttl") X(STORED, "stored") X(COLLAPSED, "collapsed")            \
+    X(KEY, "key") X(DETAIL, "detail") X(BYPASS, "bypass") X(METHOD, "method") X(URI_MISS, "uri-miss")                              \
+    X(VARY_MISS, "vary-miss") X(MISS, "miss") X(REQUEST, "request") X(STALE, "stale") X(PARTIAL, "partial")                        \
+    /* Signature-Input, Content-Digest */                                                                                          \
+    X(SIG1, "sig1") X(CREATED, "created") X(EXPIRES, "expires") X(KEYID, "keyid") X(ALG, "alg") X(NONCE, "nonce")                  \
+    X(TAG, "tag") X(SHA_256, "sha-256") X(SHA_512, "sha-512")                                                                      \
+    /* Permissions-Policy */                                                                                                       \
+    X(SELF, "self") X(STAR, "*") X(GEOLOCATION, "geolocation") X(CAMERA, "camera") X(MICROPHONE, "microphone")                    \
+    X(FULLSCREEN, "fullscreen") X(PAYMENT, "payment")
+// clang-format on
+
+typedef enum {
+    HSFV_ID_NONE = 0,
+#define HSFV_INTERN_ENUM(name, str) HSFV_ID_##name,
+    HSFV_INTERN_VOCABULARY(HSFV_INTERN_ENUM)
+#undef HSFV_INTERN_ENUM
+    HSFV_ID_VOCABULARY_END,
+} hsfv_id_t;
+
+/* interned strings are at most HSFV_INTERN_MAX_LEN bytes long */
+#define HSFV_INTERN_MAX_LEN 31
+#define HSFV_INTERN_CAPACITY 128
+
+/**
+ * returns the interned copy of s, or NULL if s is not interned.
+ */
+const char *hsfv_intern_lookup(const char *s, size_t len);
+/**
+ * interns s unless it already is, and sets its id to out_id. This is not
+ * thread-safe and must be called before other threads parse.
+ */
+hsfv_err_t hsfv_intern_register(const char *s, size_t len, hsfv_id_t *out_id);
+bool hsfv_is_interned(const char *p);
+hsfv_id_t hsfv_intern_id(const char *p);
+
+static inline hsfv_id_t hsfv_key_id(const hsfv_key_t *key)
+{
+    return (key->len & HSFV_INLINE_FLAG) ? HSFV_ID_NONE : hsfv_intern_id(key->base);
+}
+
+static inline hsfv_id_t hsfv_token_id(const hsfv_token_t *token)
+{
+    return (token->len & HSFV_INLINE_FLAG) ? HSFV_ID_NONE : hsfv_intern_id(token->base);
+}
+
+/** returns a key which refers to s, or to its interned copy, without copying it */
+static inline hsfv_key_t hsfv_key_ref(const char *s, size_t len)
+{
+    const char *interned = hsfv_intern_lookup(s, len);
+    hsfv_key_t key;
+    key.base = interned ? interned : s;
+    key.len = len;
+    return key;
+}
+
 typedef struct st_hsfv_buffer_t {
     hsfv_iovec_t bytes;
     size_t capacity;
@@ -268,6 +514,191 @@ void hsfv_bare_item_deinit(hsfv_bare_item_t *bare_item, hsfv_allocator_t *alloca
 
 hsfv_err_t hsfv_parse_field_value(hsfv_field_value_t *field_value, hsfv_field_value_type_t field_type, hsfv_allocator_t *allocator,
                                   const char *input, const char *input_end, const char **out_rest);
+
+/**
+ * one (input, type) pair for hsfv_parse_batch. input, input_end and type are
+ * set by the caller, field_value and err are set by hsfv_parse_batch.
+ * field_value is allocated in the arena passed to hsfv_parse_batch and is
+ * released together with it.
+ */
+typedef struct st_hsfv_batch_entry_t {
+    const char *input;
+    const char *input_end;
+    hsfv_field_value_type_t type;
+    hsfv_field_value_t field_value;
+    hsfv_err_t err;
+} hsfv_batch_entry_t;
+
+/**
+ * parses each of the n entries as hsfv_parse_field_value does, allocating
+ * in arena, and returns the number of entries that failed. A failed entry
+ * has its error in err and an empty field_value, and does not stop the
+ * others. The entries share only the arena: each input is still validated
+ * and parsed on its own, so a batch costs what the same calls with an
+ * arena allocator would.
+ */
+size_t hsfv_parse_batch(hsfv_batch_entry_t *entries, size_t n, hsfv_arena_t *arena);
+
+/**
+ * frees the members of field_value with allocator and leaves an empty value
+ * of the same type: an empty list or dictionary, or the integer 0 for an
+ * item.
+ */
+void hsfv_field_value_clear(hsfv_field_value_t *field_value, hsfv_allocator_t *allocator);
+
+typedef struct st_hsfv_spare_block_t hsfv_spare_block_t;
+
+/* kept buffers are sorted by capacity into powers of two from 16 bytes up */
+#define HSFV_PARSE_TARGET_SIZE_CLASSES 32
+
+/**
+ * field value that is parsed into over and over, such as one per worker for
+ * a header seen on every request. Parsing into it clears the previous value
+ * but keeps the member, parameter and string buffers that held it, and later
+ * allocations take a kept buffer whenever one is large enough, finding it
+ * in constant time. Buffers are rounded up to a power of two. Once the
+ * target has seen its largest value, parsing allocates nothing. Kept
+ * buffers are released by hsfv_parse_target_deinit.
+ */
+typedef struct st_hsfv_parse_target_t {
+    hsfv_allocator_t allocator;
+    hsfv_allocator_t *backing;
+    hsfv_spare_block_t *spare[HSFV_PARSE_TARGET_SIZE_CLASSES];
+    hsfv_field_value_t field_value;
+} hsfv_parse_target_t;
+
+void hsfv_parse_target_init(hsfv_parse_target_t *target, hsfv_allocator_t *backing);
+void hsfv_parse_target_deinit(hsfv_parse_target_t *target);
+/**
+ * parses input into target->field_value, reusing the buffers of the value
+ * parsed before. On error target->field_value is left empty as by
+ * hsfv_field_value_clear.
+ */
+hsfv_err_t hsfv_parse_field_value_into(hsfv_parse_target_t *target, hsfv_field_value_type_t field_type, const char *input,
+                                       const char *input_end, const char **out_rest);
+
+/**
+ * returns the size of the block that hsfv_field_value_clone allocates for a
+ * copy of src.
+ */
+size_t hsfv_field_value_clone_size(const hsfv_field_value_t *src);
+/**
+ * copies src into one block allocated with allocator: the field value
+ * itself, its member, item and parameter arrays, and the bytes of every key,
+ * token, string and byte sequence which is neither inline nor interned.
+ * *out_clone points to the start of the block. Release it with a single
+ * allocator->free (or hsfv_allocator_free_sized with
+ * hsfv_field_value_clone_size), never with hsfv_field_value_deinit, and do
+ * not add members to it.
+ */
+hsfv_err_t hsfv_field_value_clone(const hsfv_field_value_t *src, hsfv_allocator_t *allocator, hsfv_field_value_t **out_clone);
+/**
+ * writes a clone of src into block, which must hold
+ * hsfv_field_value_clone_size(src) bytes and be aligned for a pointer, for
+ * callers which embed the clone in a larger allocation. Returns block.
+ */
+hsfv_field_value_t *hsfv_field_value_clone_to(void *block, const hsfv_field_value_t *src);
+/**
+ * fixes up the pointers inside a clone after its block was copied with
+ * memcpy from old_block, which need not be readable any more.
+ */
+void hsfv_field_value_clone_relocate(hsfv_field_value_t *clone, const void *old_block);
+
+/**
+ * immutable field value which any number of threads may read at once. It is
+ * a reference count followed by a clone of the value in one block, so
+ * acquire and release touch a single counter and the last release frees
+ * the whole tree with one call to the allocator, which must be safe to
+ * call from the thread that drops the last reference.
+ */
+typedef struct st_hsfv_shared_field_value_t hsfv_shared_field_value_t;
+
+/** creates a shared copy of src holding one reference */
+hsfv_err_t hsfv_shared_field_value_create(const hsfv_field_value_t *src, hsfv_allocator_t *allocator,
+                                          hsfv_shared_field_value_t **out_shared);
+/** parses input and stores the result in a new shared value holding one reference */
+hsfv_err_t hsfv_shared_field_value_parse(hsfv_field_value_type_t field_type, hsfv_allocator_t *allocator, const char *input,
+                                         const char *input_end, hsfv_shared_field_value_t **out_shared);
+/** returns the value, which stays valid while the caller holds a reference */
+const hsfv_field_value_t *hsfv_shared_field_value_get(const hsfv_shared_field_value_t *shared);
+/** adds a reference and returns shared */
+hsfv_shared_field_value_t *hsfv_shared_field_value_acquire(hsfv_shared_field_value_t *shared);
+void hsfv_shared_field_value_release(hsfv_shared_field_value_t *shared);
+
+/**
+ * copy-on-write edits. Each writes to dest a copy of src with one member
+ * set or removed, in which only the member or parameter array is new: the
+ * keys, items, inner lists and parameters of the other members are shared
+ * with src, and the key and value passed in are referenced, not copied
+ * (keys in the intern vocabulary refer to the interned copy). dest is
+ * therefore only valid while src and the values set into it are, which
+ * suits sources held by a shared or cached reference. Setting an existing
+ * key replaces its value in place; a new key is appended.
+ *
+ * dest may be src when src was itself made by an edit, which updates its
+ * array in place. Release the result with hsfv_dictionary_edit_deinit or
+ * hsfv_parameters_edit_deinit, which free only the array, never with the
+ * deinit functions. To edit the parameters of a member, copy its value,
+ * set the parameters of the copy and set the copy back into the
+ * dictionary; the parameters are then released separately.
+ */
+hsfv_err_t hsfv_dictionary_set(hsfv_dictionary_t *dest, const hsfv_dictionary_t *src, const char *key, size_t key_len,
+                               const hsfv_dict_member_value_t *value, hsfv_allocator_t *allocator);
+/** returns HSFV_ERR_EOF and leaves dest untouched if src has no member with key */
+hsfv_err_t hsfv_dictionary_remove(hsfv_dictionary_t *dest, const hsfv_dictionary_t *src, const char *key, size_t key_len,
+                                  hsfv_allocator_t *allocator);
+void hsfv_dictionary_edit_deinit(hsfv_dictionary_t *edited, hsfv_allocator_t *allocator);
+hsfv_err_t hsfv_parameters_set(hsfv_parameters_t *dest, const hsfv_parameters_t *src, const char *key, size_t key_len,
+                               const hsfv_bare_item_t *value, hsfv_allocator_t *allocator);
+void hsfv_parameters_edit_deinit(hsfv_parameters_t *edited, hsfv_allocator_t *allocator);
+
+/* Dictionary diff */
+
+typedef enum {
+    HSFV_DICT_CHANGE_ADDED = 0,
+    HSFV_DICT_CHANGE_REMOVED,
+    HSFV_DICT_CHANGE_CHANGED,
+} hsfv_dict_change_type_t;
+
+/* the index of a change on the side which has no such member */
+#define HSFV_DICT_DIFF_NONE SIZE_MAX
+
+typedef struct st_hsfv_dict_change_t {
+    hsfv_dict_change_type_t type;
+    /* index of the member in a, or HSFV_DICT_DIFF_NONE if it was added */
+    size_t a_index;
+    /* index of the member in b, or HSFV_DICT_DIFF_NONE if it was removed */
+    size_t b_index;
+} hsfv_dict_change_t;
+
+typedef struct st_hsfv_dictionary_diff_t {
+    hsfv_dict_change_t *changes;
+    size_t len;
+    size_t capacity;
+} hsfv_dictionary_diff_t;
+
+/**
+ * stores in diff the keys added, removed or given another value going from
+ * a to b: added and changed members in the order of b, then removed ones in
+ * the order of a. The keys of a are looked up through a hash table, so the
+ * diff takes time linear in the sizes of a and b, and the table only
+ * allocates for dictionaries of more than 32 members. Changes refer to
+ * members by index, so a and b must outlive diff.
+ */
+hsfv_err_t hsfv_dictionary_diff(const hsfv_dictionary_t *a, const hsfv_dictionary_t *b, hsfv_allocator_t *allocator,
+                                hsfv_dictionary_diff_t *diff);
+void hsfv_dictionary_diff_deinit(hsfv_dictionary_diff_t *diff, hsfv_allocator_t *allocator);
+/**
+ * serializes diff as two field values: upserts gets a dictionary of the
+ * added and changed members as they are in b, and removals a list of the
+ * removed keys as tokens. Setting each member of upserts and removing each
+ * key of removals with hsfv_dictionary_set and hsfv_dictionary_remove turns
+ * a into b, except that added members go to the end. Both buffers are left
+ * as they were on error.
+ */
+hsfv_err_t hsfv_serialize_dictionary_diff(const hsfv_dictionary_diff_t *diff, const hsfv_dictionary_t *a, const hsfv_dictionary_t *b,
+                                          hsfv_allocator_t *allocator, hsfv_buffer_t *upserts, hsfv_buffer_t *removals);
+
 hsfv_err_t hsfv_parse_dictionary(hsfv_dictionary_t *dictionary, hsfv_allocator_t *allocator, const char *input,
                                  const char *input_end, const char **out_rest);
 hsfv_err_t hsfv_parse_list(hsfv_list_t *list, hsfv_allocator_t *allocator, const char *input, const char *input_end,
@@ -295,6 +726,426 @@ hsfv_err_t hsfv_parse_non_negative_integer(const char *input, const char *input_
 hsfv_err_t hsfv_parse_integer(const char *input, const char *input_end, int64_t *out_integer, const char **out_rest);
 hsfv_err_t hsfv_parse_decimal(const char *input, const char *input_end, double *out_decimal, const char **out_rest);
 
+/* Tape */
+
+typedef enum {
+    HSFV_TAPE_TYPE_LIST = 0,
+    HSFV_TAPE_TYPE_DICTIONARY,
+    HSFV_TAPE_TYPE_INNER_LIST,
+    HSFV_TAPE_TYPE_PARAMETERS,
+    HSFV_TAPE_TYPE_KEY,
+    HSFV_TAPE_TYPE_INTEGER,
+    HSFV_TAPE_TYPE_DECIMAL,
+    HSFV_TAPE_TYPE_STRING,
+    HSFV_TAPE_TYPE_TOKEN,
+    HSFV_TAPE_TYPE_BYTE_SEQ,
+    HSFV_TAPE_TYPE_BOOLEAN,
+} hsfv_tape_type_t;
+
+/* set on a bare item or an inner list entry which is followed by parameters */
+#define HSFV_TAPE_FLAG_HAS_PARAMETERS 0x1
+
+/**
+ * 16-byte entry of a tape.
+ *
+ * Containers (list, dictionary, inner list and parameters) store their member
+ * count in len and the number of entries they span, including themselves, in
+ * skip. A dictionary or parameters entry is followed by pairs of a key and a
+ * value. An inner list entry is followed by its items and then by its
+ * parameters entry, if any.
+ *
+ * Keys, strings, tokens and byte sequences store their length in len and
+ * their offset in the string area in offset. Bare items and inner lists with
+ * parameters have HSFV_TAPE_FLAG_HAS_PARAMETERS set in flags.
+ */
+typedef struct st_hsfv_tape_entry_t {
+    uint8_t type;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t len;
+    union {
+        int64_t integer;
+        double decimal;
+        uint64_t offset;
+        uint64_t skip;
+        bool boolean;
+    };
+} hsfv_tape_entry_t;
+
+/**
+ * flat representation of a field value: one array of entries in document
+ * order followed by a string area, both in a single block. Nothing in the
+ * block is a pointer, so a tape can be copied with memcpy.
+ *
+ * The root entry is the list or dictionary entry, or the bare item of an
+ * item field value.
+ */
+typedef struct st_hsfv_tape_t {
+    hsfv_tape_entry_t *entries;
+    size_t len;
+    size_t capacity;
+    const char *strings;
+    size_t strings_len;
+    size_t strings_capacity;
+} hsfv_tape_t;
+
+/**
+ * parses input into tape. tape must be zero-initialized or have been used by
+ * a previous call, in which case its block is reused when it is large
+ * enough. Call hsfv_tape_deinit when the tape is no longer used, whether or
+ * not parsing succeeded.
+ */
+hsfv_err_t hsfv_parse_tape(hsfv_tape_t *tape, hsfv_field_value_type_t field_type, hsfv_allocator_t *allocator, const char *input,
+                           const char *input_end, const char **out_rest);
+hsfv_err_t hsfv_serialize_tape(const hsfv_tape_t *tape, hsfv_allocator_t *allocator, hsfv_buffer_t *dest);
+hsfv_err_t hsfv_tape_clone(hsfv_tape_t *dest, const hsfv_tape_t *src, hsfv_allocator_t *allocator);
+void hsfv_tape_deinit(hsfv_tape_t *tape, hsfv_allocator_t *allocator);
+
+static inline const hsfv_tape_entry_t *hsfv_tape_root(const hsfv_tape_t *tape)
+{
+    return tape->len ? tape->entries : NULL;
+}
+
+static inline const char *hsfv_tape_chars(const hsfv_tape_t *tape, const hsfv_tape_entry_t *entry)
+{
+    return tape->strings + entry->offset;
+}
+
+static inline bool hsfv_tape_is_container(const hsfv_tape_entry_t *entry)
+{
+    return entry->type <= HSFV_TAPE_TYPE_PARAMETERS;
+}
+
+/**
+ * returns the first entry after entry and everything it contains, including
+ * the parameters of a bare item.
+ */
+static inline const hsfv_tape_entry_t *hsfv_tape_next(const hsfv_tape_entry_t *entry)
+{
+    if (hsfv_tape_is_container(entry)) {
+        return entry + entry->skip;
+    }
+    if (entry->flags & HSFV_TAPE_FLAG_HAS_PARAMETERS) {
+        return entry + 1 + entry[1].skip;
+    }
+    return entry + 1;
+}
+
+/**
+ * returns the end of the members of a container entry.
+ */
+static inline const hsfv_tape_entry_t *hsfv_tape_end(const hsfv_tape_entry_t *container)
+{
+    return container + container->skip;
+}
+
+/**
+ * returns the parameters entry of a bare item or inner list entry, or NULL.
+ */
+const hsfv_tape_entry_t *hsfv_tape_parameters(const hsfv_tape_entry_t *entry);
+
+/* Compact layout */
+
+/**
+ * bytes or array in the pool of a hsfv_compact_t, as a 32-bit offset from
+ * the start of the pool and a 32-bit count of bytes or elements.
+ */
+typedef struct st_hsfv_compact_span_t {
+    uint32_t offset;
+    uint32_t len;
+} hsfv_compact_span_t;
+
+/* type of a hsfv_compact_item_t which is an inner list */
+#define HSFV_COMPACT_TYPE_INNER_LIST 0xff
+
+/**
+ * bare item with the same type values as hsfv_bare_item_t. Strings, tokens
+ * and byte sequences are spans of bytes in bytes.
+ */
+typedef struct st_hsfv_compact_bare_item_t {
+    uint32_t type;
+    uint32_t reserved;
+    union {
+        int64_t integer;
+        double decimal;
+        hsfv_compact_span_t bytes;
+        bool boolean;
+    };
+} hsfv_compact_bare_item_t;
+
+typedef struct st_hsfv_compact_parameter_t {
+    hsfv_compact_span_t key;
+    hsfv_compact_bare_item_t value;
+} hsfv_compact_parameter_t;
+
+/**
+ * item, or inner list when bare_item.type is HSFV_COMPACT_TYPE_INNER_LIST, in
+ * which case bare_item.bytes spans its hsfv_compact_item_t items.
+ * parameters spans hsfv_compact_parameter_t elements.
+ */
+typedef struct st_hsfv_compact_item_t {
+    hsfv_compact_bare_item_t bare_item;
+    hsfv_compact_span_t parameters;
+} hsfv_compact_item_t;
+
+typedef struct st_hsfv_compact_member_t {
+    hsfv_compact_span_t key;
+    hsfv_compact_item_t value;
+} hsfv_compact_member_t;
+
+/**
+ * field value whose nodes and bytes all live in one pool and refer to each
+ * other by 32-bit offsets, which makes its nodes about a third of the size
+ * of the hsfv_field_value_t ones. Unlike a tape, a compact field value
+ * indexes members directly. members spans the hsfv_compact_item_t members
+ * of a list or the hsfv_compact_member_t members of a dictionary, and item
+ * holds an item field value.
+ */
+typedef struct st_hsfv_compact_t {
+    hsfv_byte_t *pool;
+    uint32_t pool_len;
+    uint32_t pool_capacity;
+    hsfv_field_value_type_t type;
+    hsfv_compact_span_t members;
+    hsfv_compact_item_t item;
+} hsfv_compact_t;
+
+/**
+ * parses input into compact. Like hsfv_parse_tape, compact must be
+ * zero-initialized or have been used by a previous call, whose pool is
+ * reused when it is large enough. Returns HSFV_ERR_NUMBER_OUT_OF_RANGE if
+ * the pool would not be addressable with 32-bit offsets.
+ */
+hsfv_err_t hsfv_parse_compact(hsfv_compact_t *compact, hsfv_field_value_type_t field_type, hsfv_allocator_t *allocator,
+                              const char *input, const char *input_end, const char **out_rest);
+/**
+ * builds compact from a parsed tape, for callers that keep a tape around.
+ */
+hsfv_err_t hsfv_compact_from_tape(hsfv_compact_t *compact, const hsfv_tape_t *tape, hsfv_allocator_t *allocator);
+hsfv_err_t hsfv_serialize_compact(const hsfv_compact_t *compact, hsfv_allocator_t *allocator, hsfv_buffer_t *dest);
+void hsfv_compact_deinit(hsfv_compact_t *compact, hsfv_allocator_t *allocator);
+
+static inline const char *hsfv_compact_bytes(const hsfv_compact_t *compact, hsfv_compact_span_t span)
+{
+    return (const char *)compact->pool + span.offset;
+}
+
+static inline const hsfv_compact_item_t *hsfv_compact_items(const hsfv_compact_t *compact, hsfv_compact_span_t span)
+{
+    return (const hsfv_compact_item_t *)(compact->pool + span.offset);
+}
+
+static inline const hsfv_compact_member_t *hsfv_compact_members(const hsfv_compact_t *compact, hsfv_compact_span_t span)
+{
+    return (const hsfv_compact_member_t *)(compact->pool + span.offset);
+}
+
+static inline const hsfv_compact_parameter_t *hsfv_compact_parameters(const hsfv_compact_t *compact, hsfv_compact_span_t span)
+{
+    return (const hsfv_compact_parameter_t *)(compact->pool + span.offset);
+}
+
+/* Binary encoding */
+
+/**
+ * compact binary form of a field value for storing in caches. It starts
+ * with HSFV_BINARY_VERSION and the field value type, and uses no pointers,
+ * so it can be read in place from shared or memory-mapped storage.
+ * Integers are zigzag varints, decimals are zigzag varints of the value
+ * times 1000, and strings, tokens, byte sequences, keys and containers are
+ * prefixed with their length in bytes so that readers skip what they do not
+ * need. Items and inner lists without parameters take no space for them.
+ */
+#define HSFV_BINARY_VERSION 1
+
+hsfv_err_t hsfv_encode_binary(const hsfv_field_value_t *field_value, hsfv_allocator_t *allocator, hsfv_buffer_t *dest);
+hsfv_err_t hsfv_decode_binary(hsfv_field_value_t *field_value, hsfv_allocator_t *allocator, const hsfv_byte_t *input,
+                              size_t len);
+
+typedef enum {
+    HSFV_BINARY_CURSOR_TYPE_LIST = 0,
+    HSFV_BINARY_CURSOR_TYPE_DICTIONARY,
+    HSFV_BINARY_CURSOR_TYPE_INNER_LIST,
+    HSFV_BINARY_CURSOR_TYPE_PARAMETERS,
+} hsfv_binary_cursor_type_t;
+
+/**
+ * position in the members of an encoded container. The root cursor of an
+ * item field value is a list cursor with one member.
+ */
+typedef struct st_hsfv_binary_cursor_t {
+    const hsfv_byte_t *pos;
+    const hsfv_byte_t *end;
+    size_t remaining;
+    hsfv_binary_cursor_type_t type;
+} hsfv_binary_cursor_t;
+
+/**
+ * member read from a cursor without copying: key and the bytes of
+ * bare_item point into the encoded input and must not be deinitialized.
+ * key is set for dictionary members and parameters, items for inner
+ * lists, and parameters for everything except parameters.
+ */
+typedef struct st_hsfv_binary_member_t {
+    hsfv_key_t key;
+    bool is_inner_list;
+    hsfv_bare_item_t bare_item;
+    hsfv_binary_cursor_t items;
+    hsfv_binary_cursor_t parameters;
+} hsfv_binary_member_t;
+
+hsfv_err_t hsfv_binary_view(const hsfv_byte_t *input, size_t len, hsfv_field_value_type_t *out_type, hsfv_binary_cursor_t *out_root);
+/**
+ * reads the next member and advances cursor. Returns HSFV_ERR_EOF after the
+ * last member and HSFV_ERR_INVALID if the input is malformed.
+ */
+hsfv_err_t hsfv_binary_next(hsfv_binary_cursor_t *cursor, hsfv_binary_member_t *out_member);
+/**
+ * finds the member with key in a dictionary or parameters cursor without
+ * advancing it. Returns HSFV_ERR_EOF if there is no such member.
+ */
+hsfv_err_t hsfv_binary_lookup(const hsfv_binary_cursor_t *cursor, const char *key, size_t key_len, hsfv_binary_member_t *out_member);
+
+/* Parse cache */
+
+/**
+ * bounded cache of parsed field values keyed by field type and input bytes.
+ * hsfv_cache_parse returns a read-only field value shared with the cache
+ * and with every other caller which passed the same bytes. It stays valid
+ * until it is passed to hsfv_cache_release, even if the cache has evicted
+ * it or has been destroyed by then. A full cache evicts with the CLOCK
+ * algorithm: the hand skips, and clears the mark of, entries which have
+ * been hit since it last passed them. Inputs which fail to parse are not
+ * cached. A cache must not be used by more than one thread at a time, but
+ * values may be retained and released from any thread.
+ */
+typedef struct st_hsfv_cache_t hsfv_cache_t;
+
+#define HSFV_CACHE_DEFAULT_CAPACITY 256
+
+typedef struct st_hsfv_cache_stats_t {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t len;
+    size_t capacity;
+} hsfv_cache_stats_t;
+
+/** creates a cache of at most capacity entries, or HSFV_CACHE_DEFAULT_CAPACITY if capacity is 0 */
+hsfv_cache_t *hsfv_cache_create(hsfv_allocator_t *allocator, size_t capacity);
+void hsfv_cache_destroy(hsfv_cache_t *cache);
+hsfv_err_t hsfv_cache_parse(hsfv_cache_t *cache, hsfv_field_value_type_t field_type, const char *input, const char *input_end,
+                            const hsfv_field_value_t **out_field_value);
+void hsfv_cache_stats(const hsfv_cache_t *cache, hsfv_cache_stats_t *out_stats);
+
+/** adds a reference to a field value returned by hsfv_cache_parse */
+void hsfv_cache_retain(const hsfv_field_value_t *field_value);
+void hsfv_cache_release(const hsfv_field_value_t *field_value);
+
+/**
+ * parse cache which any number of threads may use at once. Entries are
+ * spread over shards by hash. Lookups take no lock: they walk the shard's
+ * hash chains inside an epoch-based read section, and entries removed by
+ * eviction are freed only after every read section which may have seen
+ * them has ended. Misses parse outside the shard lock and take it only to
+ * insert. Values are released with hsfv_cache_release as for hsfv_cache_t.
+ * The allocator must be safe to call from every thread which uses the cache.
+ */
+typedef struct st_hsfv_shared_cache_t hsfv_shared_cache_t;
+
+#define HSFV_SHARED_CACHE_DEFAULT_SHARD_COUNT 16
+
+/**
+ * creates a cache of about capacity entries split over shard_count shards,
+ * rounded up to a power of two. 0 selects the defaults. The cache is
+ * allocated with hsfv_allocator_alloc_aligned on a cache line boundary, so
+ * allocator must have alloc_aligned.
+ */
+hsfv_shared_cache_t *hsfv_shared_cache_create(hsfv_allocator_t *allocator, size_t capacity, size_t shard_count);
+/** must not be called while other threads are still using the cache */
+void hsfv_shared_cache_destroy(hsfv_shared_cache_t *cache);
+hsfv_err_t hsfv_shared_cache_parse(hsfv_shared_cache_t *cache, hsfv_field_value_type_t field_type, const char *input,
+                                   const char *input_end, const hsfv_field_value_t **out_field_value);
+void hsfv_shared_cache_stats(const hsfv_shared_cache_t *cache, hsfv_cache_stats_t *out_stats);
+
+/* Pool allocator */
+
+/**
+ * allocator for field values which are kept for varying lifetimes, where an
+ * arena could never be reset. Requests are rounded up to a small set of size
+ * classes matching the string buffers and the member, item and parameter
+ * arrays the parser asks for, and freed blocks go on free lists owned by the
+ * calling thread. When a thread holds more than
+ * HSFV_POOL_THREAD_CACHE_LIMIT free blocks of a class, it moves
+ * HSFV_POOL_BATCH_SIZE of them to a depot shared by every thread in one
+ * locked step, and a thread whose list is empty takes a whole batch back
+ * the same way. Requests larger than every class go to the backing
+ * allocator. A block may be freed by a different thread from the one which
+ * allocated it.
+ */
+typedef struct st_hsfv_pool_t hsfv_pool_t;
+
+#define HSFV_POOL_BATCH_SIZE 32
+#define HSFV_POOL_THREAD_CACHE_LIMIT (2 * HSFV_POOL_BATCH_SIZE)
+
+typedef struct st_hsfv_pool_stats_t {
+    /** blocks of a size class allocated from the backing allocator */
+    uint64_t backing_allocs;
+    /** batches moved from a thread to the depot */
+    uint64_t depot_pushes;
+    /** batches moved from the depot to a thread */
+    uint64_t depot_pops;
+} hsfv_pool_stats_t;
+
+/** the backing allocator must be safe to call from every thread which uses the pool */
+hsfv_pool_t *hsfv_pool_create(hsfv_allocator_t *backing);
+/**
+ * frees the blocks held by every thread and the depot. It must not be
+ * called while other threads are still using the pool, and blocks still
+ * allocated from the pool are not freed.
+ */
+void hsfv_pool_destroy(hsfv_pool_t *pool);
+hsfv_allocator_t *hsfv_pool_allocator(hsfv_pool_t *pool);
+void hsfv_pool_stats(const hsfv_pool_t *pool, hsfv_pool_stats_t *out_stats);
+
+/* Statistics */
+
+#define HSFV_STATS_ERR_COUNT 7
+
+/**
+ * counters of the hot paths in the parse and serialize functions. They are
+ * only updated when the library is built with HSFV_ENABLE_STATS defined;
+ * otherwise hsfv_stats_snapshot returns all zeros and the counters cost
+ * nothing. raw_key_rescans counts the extra passes the raw functions make
+ * over a dictionary or parameter list with more distinct keys than they
+ * index at once. parse_errors is indexed by -err for an hsfv_err_t err and
+ * is only updated by hsfv_parse_field_value and hsfv_parse_batch.
+ */
+typedef struct st_hsfv_stats_t {
+    uint64_t parsed_field_values;
+    uint64_t parsed_keys;
+    uint64_t parsed_tokens;
+    uint64_t parsed_strings;
+    uint64_t parsed_escaped_strings;
+    uint64_t parsed_byte_seqs;
+    uint64_t parsed_integers;
+    uint64_t parsed_decimals;
+    uint64_t parsed_booleans;
+    uint64_t interned_keys;
+    uint64_t interned_tokens;
+    uint64_t dictionary_duplicate_keys;
+    uint64_t parameter_duplicate_keys;
+    uint64_t reallocs;
+    uint64_t serialized_field_values;
+    uint64_t serialized_strings;
+    uint64_t serialized_escaped_strings;
+    uint64_t raw_key_rescans;
+    uint64_t parse_errors[HSFV_STATS_ERR_COUNT];
+} hsfv_stats_t;
+
+bool hsfv_stats_enabled(void);
+void hsfv_stats_snapshot(hsfv_stats_t *out);
+
 typedef struct st_hsfv_targeted_cache_control_t {
     int64_t max_age;
     bool must_revalidate;
@@ -306,6 +1157,95 @@ typedef struct st_hsfv_targeted_cache_control_t {
 bool parse_targeted_cache_control(const char *input, const char *input_end, hsfv_targeted_cache_control_t *out_cc,
                                   const char **rest);
 
+/* Raw dictionary edits */
+
+/**
+ * edit the text of a dictionary field value without building a tree. input
+ * is walked once with the skip functions, which also validate it, every
+ * member that is not edited is copied to dest byte for byte along with the
+ * separator before it, and dest is grown at most once. value is what
+ * follows the key in a member: "=" and an item or inner list with its
+ * parameters, or just parameters (possibly none) for a true boolean.
+ *
+ * Only the first member with key is kept, as a parser would, and later
+ * duplicates are dropped. remove and replace return HSFV_ERR_EOF if input
+ * has no such member, and all three return HSFV_ERR_INVALID if input, key
+ * or value is not valid. dest is left as it was on error.
+ */
+hsfv_err_t hsfv_raw_dict_remove(const char *input, const char *input_end, const char *key, size_t key_len,
+                                hsfv_allocator_t *allocator, hsfv_buffer_t *dest);
+hsfv_err_t hsfv_raw_dict_replace(const char *input, const char *input_end, const char *key, size_t key_len, const char *value,
+                                 size_t value_len, hsfv_allocator_t *allocator, hsfv_buffer_t *dest);
+/** appends a member with key and value, removing any member with key from input first */
+hsfv_err_t hsfv_raw_dict_append(const char *input, const char *input_end, const char *key, size_t key_len, const char *value,
+                                size_t value_len, hsfv_allocator_t *allocator, hsfv_buffer_t *dest);
+
+/* Canonical form */
+
+/**
+ * returns whether input is a valid field value of field_type which
+ * hsfv_serialize_field_value would write back byte for byte, without
+ * allocating. Input is validated in one pass; each dictionary or parameter
+ * list with more than one member is then checked for duplicate keys as
+ * hsfv_raw_field_value_eq looks them up, in O(n log n) time for n members
+ * with up to 128 distinct keys and in O(n^2 / 128) at worst.
+ */
+bool hsfv_is_canonical(hsfv_field_value_type_t field_type, const char *input, const char *input_end);
+/**
+ * sets *out and *out_len to the canonical form of input: input itself when
+ * it already is canonical, which allocates nothing, or else the
+ * serialization of the parsed value, appended to buf.
+ */
+hsfv_err_t hsfv_canonicalize(hsfv_field_value_type_t field_type, const char *input, const char *input_end,
+                             hsfv_allocator_t *allocator, hsfv_buffer_t *buf, const char **out, size_t *out_len);
+/**
+ * appends the canonical form of input to dest in one pass, without building
+ * a tree: whitespace is normalized, "=?1" is dropped, numbers and byte
+ * sequences are written as hsfv_serialize_field_value writes them, and the
+ * value of a duplicate key replaces the first one in place. The output is
+ * the same as parsing and serializing input, and input is rejected where
+ * the parser would reject it, though not always with the same error. dest
+ * is left as it was on error.
+ */
+hsfv_err_t hsfv_transcode(hsfv_field_value_type_t field_type, const char *input, const char *input_end, hsfv_allocator_t *allocator,
+                          hsfv_buffer_t *dest);
+
+/* Semantic hashing */
+
+/**
+ * returns a 64-bit hash of field_value seeded with seed. Values which
+ * serialize the same hash the same, so the hash can be used as a cache key
+ * for field values; it is not a cryptographic hash.
+ */
+uint64_t hsfv_field_value_hash(const hsfv_field_value_t *field_value, uint64_t seed);
+/**
+ * sets *out_hash to what hsfv_field_value_hash returns for input parsed as
+ * field_type, reading input once with the skip functions and without
+ * allocating, so inputs with the same canonical form hash the same. Returns
+ * false if input is not a valid field value. The keys of a dictionary or
+ * parameter list are looked up in a sorted index of 128 keys on the stack,
+ * so a container of n members is hashed in O(n log n) time with up to 128
+ * distinct keys and in O(n^2 / 128) at worst, one more pass over it per
+ * further 128 keys.
+ */
+bool hsfv_raw_semantic_hash(hsfv_field_value_type_t field_type, const char *input, const char *input_end, uint64_t seed,
+                            uint64_t *out_hash);
+
+/* Raw equality */
+
+/**
+ * returns whether a and b are valid field values of field_type which parse
+ * to equal values, as hsfv_field_value_eq compares them, without parsing
+ * or allocating. Both inputs are read together and the comparison stops at
+ * the first difference; values are unescaped, decoded or parsed only where
+ * their text differs. The keys of a dictionary or parameter list are
+ * looked up in a sorted index of 128 keys on the stack, so a container of
+ * n members is compared in O(n log n) time with up to 128 distinct keys and
+ * in O(n^2 / 128) at worst, one more pass over it per further 128 keys.
+ */
+bool hsfv_raw_field_value_eq(hsfv_field_value_type_t field_type, const char *a, const char *a_end, const char *b,
+                             const char *b_end);
+
 hsfv_err_t hsfv_serialize_field_value(const hsfv_field_value_t *field_value, hsfv_allocator_t *allocator, hsfv_buffer_t *dest);
 hsfv_err_t hsfv_serialize_dictionary(const hsfv_dictionary_t *dictionary, hsfv_allocator_t *allocator, hsfv_buffer_t *dest);
 hsfv_err_t hsfv_serialize_list(const hsfv_list_t *list, hsfv_allocator_t *allocator, hsfv_buffer_t *dest);
@@ -354,6 +1294,8 @@ extern const char hsfv_base64_char_map[256];
 void hsfv_encode_base64(hsfv_iovec_t *dst, const hsfv_iovec_const_t *src);
 hsfv_err_t hsfv_decode_base64(hsfv_iovec_t *dst, const hsfv_iovec_const_t *src);
 bool hsfv_is_base64_decodable(const hsfv_iovec_const_t *src);
+/** returns whether src is exactly what hsfv_encode_base64 writes for the bytes it decodes to */
+bool hsfv_is_base64_canonical(const hsfv_iovec_const_t *src);
 
 extern const char hsfv_key_leading_char_map[256];
 extern const char hsfv_key_trailing_char_map[256];
@@ -15,10 +15,23 @@ static void global_allocator_free(hsfv_allocator_t *_self, void *ptr)
     free(ptr);
 }
 
+static void global_allocator_free_sized(hsfv_allocator_t *_self, void *ptr, size_t _size)
+{
+    free(ptr);
+}
+
+static void *global_allocator_alloc_aligned(hsfv_allocator_t *_self, size_t size, size_t alignment)
+{
+    /* C11 requires the size to be a multiple of the alignment */
+    return aligned_alloc(alignment, hsfv_align(size, alignment));
+}
+
 hsfv_allocator_t hsfv_global_allocator = {
     .alloc = global_allocator_alloc,
     .realloc = global_allocator_realloc,
     .free = global_allocator_free,
+    .free_sized = global_allocator_free_sized,
+    .alloc_aligned = global_allocator_alloc_aligned,
 };
 
 static void *failing_allocator_alloc(hsfv_allocator_t *self, size_t size)
@@ -56,6 +69,349 @@ hsfv_failing_allocator_t hsfv_failing_allocator = {
     .fail_index = -1,
 };
 
+/* Counting allocator */
+
+/*
+ * each block is preceded by a header holding its size and the offset of
+ * the block from the start of the backing allocation. The offset is the
+ * header size, which keeps the alignment of the backing allocator for the
+ * block, or the alignment of an aligned block.
+ */
+#define COUNTING_BLOCK_HEADER_SIZE 16
+
+static size_t *counting_block_header(void *ptr)
+{
+    return (size_t *)((hsfv_byte_t *)ptr - COUNTING_BLOCK_HEADER_SIZE);
+}
+
+static void *counting_block_init(hsfv_byte_t *backing_block, size_t offset, size_t size)
+{
+    hsfv_byte_t *ptr = backing_block + offset;
+    counting_block_header(ptr)[0] = size;
+    counting_block_header(ptr)[1] = offset;
+    return ptr;
+}
+
+static hsfv_byte_t *counting_backing_block(void *ptr)
+{
+    return (hsfv_byte_t *)ptr - counting_block_header(ptr)[1];
+}
+
+static void counting_allocator_record_size(hsfv_counting_allocator_t *counter, size_t size)
+{
+    size_t i = 0;
+    while (i < HSFV_COUNTING_ALLOCATOR_HISTOGRAM_SIZE - 1 && ((size_t)1 << i) < size) {
+        i++;
+    }
+    counter->size_histogram[i]++;
+}
+
+static void counting_allocator_add_live_bytes(hsfv_counting_allocator_t *counter, size_t old_size, size_t new_size)
+{
+    counter->live_bytes = counter->live_bytes - old_size + new_size;
+    if (counter->live_bytes > counter->peak_bytes) {
+        counter->peak_bytes = counter->live_bytes;
+    }
+}
+
+static void *counting_allocator_alloc(hsfv_allocator_t *self, size_t size)
+{
+    hsfv_counting_allocator_t *counter = (hsfv_counting_allocator_t *)self;
+    hsfv_byte_t *block = counter->backing->alloc(counter->backing, COUNTING_BLOCK_HEADER_SIZE + size);
+    if (block == NULL) {
+        return NULL;
+    }
+    counter->alloc_count++;
+    counting_allocator_record_size(counter, size);
+    counting_allocator_add_live_bytes(counter, 0, size);
+    return counting_block_init(block, COUNTING_BLOCK_HEADER_SIZE, size);
+}
+
+static void *counting_allocator_alloc_aligned(hsfv_allocator_t *self, size_t size, size_t alignment)
+{
+    hsfv_counting_allocator_t *counter = (hsfv_counting_allocator_t *)self;
+    size_t offset = hsfv_max(alignment, COUNTING_BLOCK_HEADER_SIZE);
+    hsfv_byte_t *block = hsfv_allocator_alloc_aligned(counter->backing, offset + size, alignment);
+    if (block == NULL) {
+        return NULL;
+    }
+    counter->alloc_count++;
+    counting_allocator_record_size(counter, size);
+    counting_allocator_add_live_bytes(counter, 0, size);
+    return counting_block_init(block, offset, size);
+}
+
+static void *counting_allocator_realloc(hsfv_allocator_t *self, void *ptr, size_t size)
+{
+    hsfv_counting_allocator_t *counter = (hsfv_counting_allocator_t *)self;
+    hsfv_byte_t *block = ptr ? counting_backing_block(ptr) : NULL;
+    size_t old_size = ptr ? counting_block_header(ptr)[0] : 0;
+    size_t offset = ptr ? counting_block_header(ptr)[1] : COUNTING_BLOCK_HEADER_SIZE;
+
+    block = counter->backing->realloc(counter->backing, block, offset + size);
+    if (block == NULL) {
+        return NULL;
+    }
+    counter->realloc_count++;
+    counting_allocator_record_size(counter, size);
+    counting_allocator_add_live_bytes(counter, old_size, size);
+    return counting_block_init(block, offset, size);
+}
+
+static void counting_allocator_free(hsfv_allocator_t *self, void *ptr)
+{
+    hsfv_counting_allocator_t *counter = (hsfv_counting_allocator_t *)self;
+    if (ptr == NULL) {
+        return;
+    }
+    counter->free_count++;
+    counter->live_bytes -= counting_block_header(ptr)[0];
+    counter->backing->free(counter->backing, counting_backing_block(ptr));
+}
+
+static void counting_allocator_free_sized(hsfv_allocator_t *self, void *ptr, size_t size)
+{
+    hsfv_counting_allocator_t *counter = (hsfv_counting_allocator_t *)self;
+    if (ptr != NULL && counting_block_header(ptr)[0] != size) {
+        counter->free_size_mismatches++;
+    }
+    counting_allocator_free(self, ptr);
+}
+
+static bool counting_allocator_try_expand_in_place(hsfv_allocator_t *self, void *ptr, size_t size)
+{
+    hsfv_counting_allocator_t *counter = (hsfv_counting_allocator_t *)self;
+    size_t old_size = counting_block_header(ptr)[0];
+    size_t offset = counting_block_header(ptr)[1];
+
+    if (!hsfv_allocator_try_expand_in_place(counter->backing, counting_backing_block(ptr), offset + size)) {
+        return false;
+    }
+    counting_block_header(ptr)[0] = size;
+    counting_allocator_add_live_bytes(counter, old_size, size);
+    return true;
+}
+
+void hsfv_counting_allocator_init(hsfv_counting_allocator_t *counter, hsfv_allocator_t *backing)
+{
+    *counter = (hsfv_counting_allocator_t){
+        .allocator =
+            {
+                .alloc = counting_allocator_alloc,
+                .realloc = counting_allocator_realloc,
+                .free = counting_allocator_free,
+                .free_sized = counting_allocator_free_sized,
+                .alloc_aligned = counting_allocator_alloc_aligned,
+                .try_expand_in_place = counting_allocator_try_expand_in_place,
+            },
+        .backing = backing,
+    };
+}
+
+void hsfv_counting_allocator_reset_stats(hsfv_counting_allocator_t *counter)
+{
+    counter->alloc_count = 0;
+    counter->realloc_count = 0;
+    counter->free_count = 0;
+    counter->free_size_mismatches = 0;
+    counter->peak_bytes = counter->live_bytes;
+    memset(counter->size_histogram, 0, sizeof(counter->size_histogram));
+}
+
+void hsfv_counting_allocator_report(const hsfv_counting_allocator_t *counter, FILE *fp)
+{
+    fprintf(fp, "allocs=%zu reallocs=%zu frees=%zu live_bytes=%zu peak_bytes=%zu free_size_mismatches=%zu\n", counter->alloc_count,
+            counter->realloc_count, counter->free_count, counter->live_bytes, counter->peak_bytes, counter->free_size_mismatches);
+    for (size_t i = 0; i < HSFV_COUNTING_ALLOCATOR_HISTOGRAM_SIZE; i++) {
+        if (counter->size_histogram[i]) {
+            fprintf(fp, "  size<=%zu%s: %zu\n", (size_t)1 << i, i == HSFV_COUNTING_ALLOCATOR_HISTOGRAM_SIZE - 1 ? "+" : "",
+                    counter->size_histogram[i]);
+        }
+    }
+}
+
+/* Arena */
+
+struct st_hsfv_arena_chunk_t {
+    hsfv_arena_chunk_t *next;
+    size_t capacity;
+    size_t used;
+};
+
+#define ARENA_ALIGN 8
+#define ARENA_BLOCK_HEADER_SIZE hsfv_align(sizeof(size_t), ARENA_ALIGN)
+
+static hsfv_byte_t *arena_chunk_data(hsfv_arena_chunk_t *chunk)
+{
+    return (hsfv_byte_t *)chunk + hsfv_align(sizeof(hsfv_arena_chunk_t), ARENA_ALIGN);
+}
+
+static size_t arena_block_size(void *ptr)
+{
+    return *(size_t *)((hsfv_byte_t *)ptr - ARENA_BLOCK_HEADER_SIZE);
+}
+
+static bool arena_is_last_block(hsfv_arena_t *arena, void *ptr)
+{
+    hsfv_arena_chunk_t *chunk = arena->chunks;
+    return chunk && (hsfv_byte_t *)ptr + hsfv_align(arena_block_size(ptr), ARENA_ALIGN) == arena_chunk_data(chunk) + chunk->used;
+}
+
+static hsfv_arena_chunk_t *arena_add_chunk(hsfv_arena_t *arena, size_t min_capacity)
+{
+    size_t capacity = hsfv_max(arena->chunk_size, min_capacity);
+    hsfv_arena_chunk_t *chunk =
+        arena->backing->alloc(arena->backing, hsfv_align(sizeof(hsfv_arena_chunk_t), ARENA_ALIGN) + capacity);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    chunk->next = arena->chunks;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    arena->chunks = chunk;
+    return chunk;
+}
+
+static void *arena_alloc(hsfv_allocator_t *self, size_t size)
+{
+    hsfv_arena_t *arena = (hsfv_arena_t *)self;
+    size_t block_size = ARENA_BLOCK_HEADER_SIZE + hsfv_align(size, ARENA_ALIGN);
+    hsfv_arena_chunk_t *chunk = arena->chunks;
+
+    if (chunk == NULL || chunk->capacity - chunk->used < block_size) {
+        chunk = arena_add_chunk(arena, block_size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+    }
+
+    hsfv_byte_t *block = arena_chunk_data(chunk) + chunk->used;
+    chunk->used += block_size;
+    *(size_t *)block = size;
+    return block + ARENA_BLOCK_HEADER_SIZE;
+}
+
+static void *arena_alloc_aligned(hsfv_allocator_t *self, size_t size, size_t alignment)
+{
+    hsfv_arena_t *arena = (hsfv_arena_t *)self;
+    size_t block_size = ARENA_BLOCK_HEADER_SIZE + hsfv_align(size, ARENA_ALIGN);
+    hsfv_arena_chunk_t *chunk = arena->chunks;
+
+    if (alignment <= ARENA_ALIGN) {
+        return arena_alloc(self, size);
+    }
+    /* blocks start ARENA_ALIGN-aligned, so this much padding always suffices */
+    if (chunk == NULL || chunk->capacity - chunk->used < block_size + alignment - ARENA_ALIGN) {
+        chunk = arena_add_chunk(arena, block_size + alignment - ARENA_ALIGN);
+        if (chunk == NULL) {
+            return NULL;
+        }
+    }
+    uintptr_t start = (uintptr_t)(arena_chunk_data(chunk) + chunk->used + ARENA_BLOCK_HEADER_SIZE);
+    chunk->used += hsfv_align(start, (uintptr_t)alignment) - start;
+    return arena_alloc(self, size);
+}
+
+static bool arena_try_expand_in_place(hsfv_allocator_t *self, void *ptr, size_t size)
+{
+    hsfv_arena_t *arena = (hsfv_arena_t *)self;
+
+    if (arena_is_last_block(arena, ptr)) {
+        hsfv_arena_chunk_t *chunk = arena->chunks;
+        size_t start = (hsfv_byte_t *)ptr - arena_chunk_data(chunk);
+        if (start + hsfv_align(size, ARENA_ALIGN) <= chunk->capacity) {
+            chunk->used = start + hsfv_align(size, ARENA_ALIGN);
+            *(size_t *)((hsfv_byte_t *)ptr - ARENA_BLOCK_HEADER_SIZE) = size;
+            return true;
+        }
+        return false;
+    }
+    return size <= arena_block_size(ptr);
+}
+
+static void *arena_realloc(hsfv_allocator_t *self, void *ptr, size_t size)
+{
+    if (ptr == NULL) {
+        return arena_alloc(self, size);
+    }
+    if (arena_try_expand_in_place(self, ptr, size)) {
+        return ptr;
+    }
+
+    size_t old_size = arena_block_size(ptr);
+    void *ptr2 = arena_alloc(self, size);
+    if (ptr2 == NULL) {
+        return NULL;
+    }
+    memcpy(ptr2, ptr, hsfv_min(old_size, size));
+    return ptr2;
+}
+
+static void arena_free(hsfv_allocator_t *self, void *ptr)
+{
+    hsfv_arena_t *arena = (hsfv_arena_t *)self;
+
+    if (ptr != NULL && arena_is_last_block(arena, ptr)) {
+        arena->chunks->used = (hsfv_byte_t *)ptr - ARENA_BLOCK_HEADER_SIZE - arena_chunk_data(arena->chunks);
+    }
+}
+
+void hsfv_arena_init(hsfv_arena_t *arena, hsfv_allocator_t *backing, size_t chunk_size)
+{
+    *arena = (hsfv_arena_t){
+        .allocator =
+            {
+                .alloc = arena_alloc,
+                .realloc = arena_realloc,
+                .free = arena_free,
+                .alloc_aligned = arena_alloc_aligned,
+                .try_expand_in_place = arena_try_expand_in_place,
+            },
+        .backing = backing,
+        .chunk_size = chunk_size ? chunk_size : HSFV_ARENA_DEFAULT_CHUNK_SIZE,
+    };
+}
+
+static void arena_free_chunks(hsfv_arena_t *arena)
+{
+    hsfv_arena_chunk_t *chunk, *next;
+    for (chunk = arena->chunks; chunk; chunk = next) {
+        next = chunk->next;
+        hsfv_allocator_free_sized(arena->backing, chunk, hsfv_align(sizeof(hsfv_arena_chunk_t), ARENA_ALIGN) + chunk->capacity);
+    }
+    arena->chunks = NULL;
+}
+
+void hsfv_arena_reset(hsfv_arena_t *arena)
+{
+    hsfv_arena_chunk_t *chunk = arena->chunks;
+
+    if (chunk == NULL) {
+        return;
+    }
+
+    /*
+     * Merge multiple chunks into one so that the next round of allocations
+     * fits in a single chunk and does not hit the backing allocator again.
+     */
+    if (chunk->next) {
+        size_t total = 0;
+        for (; chunk; chunk = chunk->next) {
+            total += chunk->capacity;
+        }
+        arena_free_chunks(arena);
+        arena_add_chunk(arena, total);
+        return;
+    }
+
+    chunk->used = 0;
+}
+
+void hsfv_arena_deinit(hsfv_arena_t *arena)
+{
+    arena_free_chunks(arena);
+}
+
 hsfv_byte_t *hsfv_bytes_dup(hsfv_allocator_t *allocator, const hsfv_byte_t *src, size_t len)
 {
     hsfv_byte_t *copy = allocator->alloc(allocator, len);
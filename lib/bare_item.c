@@ -1,4 +1,5 @@
 #include "hsfv.h"
+#include "stats.h"
 
 #include <fenv.h>
 #include <math.h>
@@ -71,42 +72,54 @@ const char hsfv_base64_char_map[256] = {
 
 bool hsfv_string_eq(const hsfv_string_t *self, const hsfv_string_t *other)
 {
-    return self->len == other->len && !memcmp(self->base, other->base, self->len);
+    size_t len = hsfv_string_len(self);
+    return len == hsfv_string_len(other) && !memcmp(hsfv_string_base(self), hsfv_string_base(other), len);
 }
 
 bool hsfv_key_eq(const hsfv_key_t *self, const hsfv_key_t *other)
 {
-    return self->len == other->len && !memcmp(self->base, other->base, self->len);
+    size_t len = hsfv_key_len(self);
+    return len == hsfv_key_len(other) && !memcmp(hsfv_key_base(self), hsfv_key_base(other), len);
 }
 
 bool hsfv_token_eq(const hsfv_token_t *self, const hsfv_token_t *other)
 {
-    return self->len == other->len && !memcmp(self->base, other->base, self->len);
+    size_t len = hsfv_token_len(self);
+    return len == hsfv_token_len(other) && !memcmp(hsfv_token_base(self), hsfv_token_base(other), len);
 }
 
 bool hsfv_byte_seq_eq(const hsfv_byte_seq_t *self, const hsfv_byte_seq_t *other)
 {
-    return self->len == other->len && !memcmp(self->base, other->base, self->len);
+    size_t len = hsfv_byte_seq_len(self);
+    return len == hsfv_byte_seq_len(other) && !memcmp(hsfv_byte_seq_base(self), hsfv_byte_seq_base(other), len);
 }
 
 void hsfv_key_deinit(hsfv_key_t *v, hsfv_allocator_t *allocator)
 {
-    allocator->free(allocator, (void *)v->base);
+    if (!(v->len & HSFV_INLINE_FLAG) && !hsfv_is_interned(v->base)) {
+        hsfv_allocator_free_sized(allocator, (void *)v->base, v->len);
+    }
 }
 
 void hsfv_string_deinit(hsfv_string_t *v, hsfv_allocator_t *allocator)
 {
-    allocator->free(allocator, (void *)v->base);
+    if (!(v->len & HSFV_INLINE_FLAG)) {
+        hsfv_allocator_free_sized(allocator, (void *)v->base, v->len);
+    }
 }
 
 void hsfv_token_deinit(hsfv_token_t *v, hsfv_allocator_t *allocator)
 {
-    allocator->free(allocator, (void *)v->base);
+    if (!(v->len & HSFV_INLINE_FLAG) && !hsfv_is_interned(v->base)) {
+        hsfv_allocator_free_sized(allocator, (void *)v->base, v->len);
+    }
 }
 
 void hsfv_byte_seq_deinit(hsfv_byte_seq_t *v, hsfv_allocator_t *allocator)
 {
-    allocator->free(allocator, (void *)v->base);
+    if (!(v->len & HSFV_INLINE_FLAG)) {
+        hsfv_allocator_free_sized(allocator, (void *)v->base, v->len);
+    }
 }
 
 bool hsfv_bare_item_eq(const hsfv_bare_item_t *self, const hsfv_bare_item_t *other)
@@ -182,6 +195,7 @@ hsfv_err_t hsfv_parse_boolean(hsfv_bare_item_t *item, const char *input, const c
     if (*input == '1') {
         item->type = HSFV_BARE_ITEM_TYPE_BOOLEAN;
         item->boolean = true;
+        HSFV_STATS_INC(parsed_booleans);
         if (out_rest) {
             *out_rest = ++input;
         }
@@ -190,6 +204,7 @@ hsfv_err_t hsfv_parse_boolean(hsfv_bare_item_t *item, const char *input, const c
     if (*input == '0') {
         item->type = HSFV_BARE_ITEM_TYPE_BOOLEAN;
         item->boolean = false;
+        HSFV_STATS_INC(parsed_booleans);
         if (out_rest) {
             *out_rest = ++input;
         }
@@ -326,6 +341,7 @@ hsfv_err_t hsfv_parse_number(hsfv_bare_item_t *item, const char *input, const ch
         temp[input_len] = '\0';
         item->decimal = strtod(temp, NULL);
         item->type = HSFV_BARE_ITEM_TYPE_DECIMAL;
+        HSFV_STATS_INC(parsed_decimals);
     } else {
         char temp[1 + HSFV_MAX_INT_LEN + 1];
         size_t input_len = end - input;
@@ -333,6 +349,7 @@ hsfv_err_t hsfv_parse_number(hsfv_bare_item_t *item, const char *input, const ch
         temp[input_len] = '\0';
         item->integer = strtoll(temp, NULL, 10);
         item->type = HSFV_BARE_ITEM_TYPE_INTEGER;
+        HSFV_STATS_INC(parsed_integers);
     }
     if (out_rest) {
         *out_rest = end;
@@ -505,10 +522,11 @@ hsfv_err_t hsfv_parse_decimal(const char *input, const char *input_end, double *
 
 hsfv_err_t hsfv_serialize_string(const hsfv_string_t *string, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
 {
+    const char *base = hsfv_string_base(string), *end = base + hsfv_string_len(string);
     hsfv_err_t err;
     size_t escape_count = 0;
 
-    for (const char *p = string->base; p < string->base + string->len; ++p) {
+    for (const char *p = base; p < end; ++p) {
         if (*p <= '\x1f' || '\x7f' <= *p) {
             return HSFV_ERR_INVALID;
         }
@@ -517,13 +535,18 @@ hsfv_err_t hsfv_serialize_string(const hsfv_string_t *string, hsfv_allocator_t *
         }
     }
 
-    err = hsfv_buffer_ensure_unused_bytes(dest, allocator, string->len + escape_count + 2);
+    err = hsfv_buffer_ensure_unused_bytes(dest, allocator, (end - base) + escape_count + 2);
     if (err) {
         return err;
     }
 
+    HSFV_STATS_INC(serialized_strings);
+    if (escape_count) {
+        HSFV_STATS_INC(serialized_escaped_strings);
+    }
+
     hsfv_buffer_append_byte_unchecked(dest, '"');
-    for (const char *p = string->base; p < string->base + string->len; ++p) {
+    for (const char *p = base; p < end; ++p) {
         if (*p == '\\' || *p == '"') {
             hsfv_buffer_append_byte_unchecked(dest, '\\');
         }
@@ -534,97 +557,122 @@ hsfv_err_t hsfv_serialize_string(const hsfv_string_t *string, hsfv_allocator_t *
     return HSFV_OK;
 }
 
-#define STRING_INITIAL_CAPACITY 8
-
-hsfv_err_t hsfv_parse_string(hsfv_bare_item_t *item, hsfv_allocator_t *allocator, const char *input, const char *input_end,
-                             const char **out_rest)
+/*
+ * finds the closing quote of the string which starts after the opening
+ * quote at start and counts the escapes before it.
+ */
+static hsfv_err_t scan_string(const char *start, const char *input_end, const char **out_end, size_t *out_escape_count)
 {
-    hsfv_err_t err;
-    hsfv_buffer_t buf;
+    size_t escape_count = 0;
     char c;
 
-    err = hsfv_buffer_alloc(&buf, allocator, STRING_INITIAL_CAPACITY);
-    if (err) {
-        return err;
-    }
-
-    c = *input;
-    if (c != '"') {
-        err = HSFV_ERR_INVALID;
-        goto error;
-    }
-    ++input;
-
-    for (; input < input_end; ++input) {
-        c = *input;
+    for (const char *p = start; p < input_end; ++p) {
+        c = *p;
         if (c == '"') {
-            item->type = HSFV_BARE_ITEM_TYPE_STRING;
-            item->string.base = (const char *)buf.bytes.base;
-            item->string.len = buf.bytes.len;
-            if (out_rest) {
-                *out_rest = ++input;
-            }
+            *out_end = p;
+            *out_escape_count = escape_count;
             return HSFV_OK;
         }
 
         if (c == '\\') {
-            ++input;
-            if (input == input_end) {
-                err = HSFV_ERR_INVALID;
-                goto error;
+            ++p;
+            if (p == input_end) {
+                return HSFV_ERR_INVALID;
             }
-            c = *input;
+            c = *p;
             if (c != '"' && c != '\\') {
-                err = HSFV_ERR_INVALID;
-                goto error;
-            }
-            err = hsfv_buffer_append_byte(&buf, allocator, c);
-            if (err) {
-                goto error;
+                return HSFV_ERR_INVALID;
             }
+            escape_count++;
             continue;
         }
 
         if (c <= '\x1f' || '\x7f' <= c) {
             break;
         }
+    }
+    return HSFV_ERR_EOF;
+}
 
-        err = hsfv_buffer_append_byte(&buf, allocator, c);
-        if (err) {
-            goto error;
+static void unescape_string(char *dest, const char *start, const char *end, size_t escape_count)
+{
+    if (escape_count == 0) {
+        memcpy(dest, start, end - start);
+        return;
+    }
+    for (const char *p = start; p < end; ++p) {
+        if (*p == '\\') {
+            ++p;
         }
+        *dest++ = *p;
     }
+}
 
-    err = HSFV_ERR_EOF;
+hsfv_err_t hsfv_parse_string(hsfv_bare_item_t *item, hsfv_allocator_t *allocator, const char *input, const char *input_end,
+                             const char **out_rest)
+{
+    const char *start, *end;
+    size_t escape_count, len;
+    hsfv_err_t err;
+
+    if (*input != '"') {
+        return HSFV_ERR_INVALID;
+    }
+    start = input + 1;
+    err = scan_string(start, input_end, &end, &escape_count);
+    if (err) {
+        return err;
+    }
 
-error:
-    hsfv_buffer_deinit(&buf, allocator);
-    return err;
+    len = (end - start) - escape_count;
+    if (len <= HSFV_INLINE_CAPACITY) {
+        char bytes[HSFV_INLINE_CAPACITY];
+        unescape_string(bytes, start, end, escape_count);
+        hsfv_inline_set(&item->string, bytes, len);
+    } else {
+        char *base = allocator->alloc(allocator, len);
+        if (base == NULL) {
+            return HSFV_ERR_OUT_OF_MEMORY;
+        }
+        unescape_string(base, start, end, escape_count);
+        item->string.base = base;
+        item->string.len = len;
+    }
+    item->type = HSFV_BARE_ITEM_TYPE_STRING;
+    if (out_rest) {
+        *out_rest = end + 1;
+    }
+    HSFV_STATS_INC(parsed_strings);
+    if (escape_count) {
+        HSFV_STATS_INC(parsed_escaped_strings);
+    }
+    return HSFV_OK;
 }
 
 /* Token */
 
 hsfv_err_t hsfv_serialize_token(const hsfv_token_t *token, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
 {
-    const char *p;
+    const char *base = hsfv_token_base(token), *p;
+    size_t len = hsfv_token_len(token);
     hsfv_err_t err;
 
-    p = token->base;
+    p = base;
     if (!HSFV_IS_TOKEN_LEADING_CHAR(*p)) {
         return HSFV_ERR_INVALID;
     }
-    for (++p; p < token->base + token->len; ++p) {
+    for (++p; p < base + len; ++p) {
         if (!HSFV_IS_TOKEN_TRAILING_CHAR(*p)) {
             return HSFV_ERR_INVALID;
         }
     }
 
-    err = hsfv_buffer_ensure_unused_bytes(dest, allocator, token->len);
+    err = hsfv_buffer_ensure_unused_bytes(dest, allocator, len);
     if (err) {
         return err;
     }
 
-    hsfv_buffer_append_bytes_unchecked(dest, token->base, token->len);
+    hsfv_buffer_append_bytes_unchecked(dest, base, len);
 
     return HSFV_OK;
 }
@@ -634,7 +682,8 @@ hsfv_err_t hsfv_serialize_token(const hsfv_token_t *token, hsfv_allocator_t *all
 hsfv_err_t hsfv_parse_token(hsfv_bare_item_t *item, hsfv_allocator_t *allocator, const char *input, const char *input_end,
                             const char **out_rest)
 {
-    const char *p = input;
+    const char *p = input, *interned;
+    size_t len;
 
     if (p == input_end) {
         return HSFV_ERR_EOF;
@@ -649,12 +698,23 @@ hsfv_err_t hsfv_parse_token(hsfv_bare_item_t *item, hsfv_allocator_t *allocator,
         }
     }
 
-    item->token.base = (const char *)hsfv_bytes_dup(allocator, (const hsfv_byte_t *)input, p - input);
-    if (item->token.base == NULL) {
-        return HSFV_ERR_OUT_OF_MEMORY;
+    len = p - input;
+    interned = hsfv_intern_lookup(input, len);
+    if (interned) {
+        item->token.base = interned;
+        item->token.len = len;
+        HSFV_STATS_INC(interned_tokens);
+    } else if (len <= HSFV_INLINE_CAPACITY) {
+        hsfv_inline_set(&item->token, input, len);
+    } else {
+        item->token.base = (const char *)hsfv_bytes_dup(allocator, (const hsfv_byte_t *)input, len);
+        if (item->token.base == NULL) {
+            return HSFV_ERR_OUT_OF_MEMORY;
+        }
+        item->token.len = len;
     }
-    item->token.len = p - input;
     item->type = HSFV_BARE_ITEM_TYPE_TOKEN;
+    HSFV_STATS_INC(parsed_tokens);
     if (out_rest) {
         *out_rest = p;
     }
@@ -665,17 +725,18 @@ hsfv_err_t hsfv_parse_token(hsfv_bare_item_t *item, hsfv_allocator_t *allocator,
 
 hsfv_err_t hsfv_serialize_key(const hsfv_key_t *key, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
 {
-    const char *p = key->base;
-    if (!p || key->len == 0 || !HSFV_IS_KEY_LEADING_CHAR(*p)) {
+    const char *base = hsfv_key_base(key), *p = base;
+    size_t len = hsfv_key_len(key);
+    if (!p || len == 0 || !HSFV_IS_KEY_LEADING_CHAR(*p)) {
         return HSFV_ERR_INVALID;
     }
-    for (++p; p < key->base + key->len; ++p) {
+    for (++p; p < base + len; ++p) {
         if (!HSFV_IS_KEY_TRAILING_CHAR(*p)) {
             return HSFV_ERR_INVALID;
         }
     }
 
-    return hsfv_buffer_append_bytes(dest, allocator, key->base, key->len);
+    return hsfv_buffer_append_bytes(dest, allocator, base, len);
 }
 
 #define KEY_INITIAL_CAPACITY 8
@@ -683,7 +744,8 @@ hsfv_err_t hsfv_serialize_key(const hsfv_key_t *key, hsfv_allocator_t *allocator
 hsfv_err_t hsfv_parse_key(hsfv_key_t *key, hsfv_allocator_t *allocator, const char *input, const char *input_end,
                           const char **out_rest)
 {
-    const char *p = input;
+    const char *p = input, *interned;
+    size_t len;
 
     if (p == input_end) {
         return HSFV_ERR_EOF;
@@ -698,11 +760,22 @@ hsfv_err_t hsfv_parse_key(hsfv_key_t *key, hsfv_allocator_t *allocator, const ch
         }
     }
 
-    key->base = (const char *)hsfv_bytes_dup(allocator, (const hsfv_byte_t *)input, p - input);
-    if (key->base == NULL) {
-        return HSFV_ERR_OUT_OF_MEMORY;
+    len = p - input;
+    interned = hsfv_intern_lookup(input, len);
+    if (interned) {
+        key->base = interned;
+        key->len = len;
+        HSFV_STATS_INC(interned_keys);
+    } else if (len <= HSFV_INLINE_CAPACITY) {
+        hsfv_inline_set(key, input, len);
+    } else {
+        key->base = (const char *)hsfv_bytes_dup(allocator, (const hsfv_byte_t *)input, len);
+        if (key->base == NULL) {
+            return HSFV_ERR_OUT_OF_MEMORY;
+        }
+        key->len = len;
     }
-    key->len = p - input;
+    HSFV_STATS_INC(parsed_keys);
     if (out_rest) {
         *out_rest = p;
     }
@@ -713,7 +786,8 @@ hsfv_err_t hsfv_parse_key(hsfv_key_t *key, hsfv_allocator_t *allocator, const ch
 
 hsfv_err_t hsfv_serialize_byte_seq(const hsfv_byte_seq_t *byte_seq, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
 {
-    size_t encoded_len = HSFV_BASE64_ENCODED_LENGTH(byte_seq->len);
+    size_t len = hsfv_byte_seq_len(byte_seq);
+    size_t encoded_len = HSFV_BASE64_ENCODED_LENGTH(len);
     hsfv_err_t err;
 
     err = hsfv_buffer_ensure_unused_bytes(dest, allocator, encoded_len + 2);
@@ -723,7 +797,7 @@ hsfv_err_t hsfv_serialize_byte_seq(const hsfv_byte_seq_t *byte_seq, hsfv_allocat
 
     hsfv_buffer_append_byte_unchecked(dest, ':');
 
-    hsfv_iovec_const_t src_vec = {.base = byte_seq->base, .len = byte_seq->len};
+    hsfv_iovec_const_t src_vec = {.base = hsfv_byte_seq_base(byte_seq), .len = len};
     hsfv_iovec_t dest_vec = {.base = &dest->bytes.base[dest->bytes.len], .len = encoded_len};
     hsfv_encode_base64(&dest_vec, &src_vec);
     dest->bytes.len += encoded_len;
@@ -738,11 +812,12 @@ hsfv_err_t hsfv_parse_byte_seq(hsfv_bare_item_t *item, hsfv_allocator_t *allocat
                                const char **out_rest)
 {
     hsfv_err_t err;
-    const char *start;
+    const char *start, *padding;
     char c;
     hsfv_iovec_t temp;
     uint64_t encoded_len, decoded_len;
     hsfv_iovec_const_t src;
+    hsfv_byte_t inline_bytes[HSFV_INLINE_CAPACITY];
 
     if (input == input_end) {
         return HSFV_ERR_EOF;
@@ -757,10 +832,20 @@ hsfv_err_t hsfv_parse_byte_seq(hsfv_bare_item_t *item, hsfv_allocator_t *allocat
         c = *input;
         if (c == ':') {
             encoded_len = input - start;
-            decoded_len = HSFV_BASE64_DECODED_LENGTH(encoded_len);
-            temp.base = allocator->alloc(allocator, decoded_len);
-            if (temp.base == NULL) {
-                return HSFV_ERR_OUT_OF_MEMORY;
+            /*
+             * The decoder stops at the first '=', so the decoded length is
+             * known exactly and a heap copy is allocated with the size it is
+             * later freed with.
+             */
+            padding = memchr(start, '=', encoded_len);
+            decoded_len = (padding ? (uint64_t)(padding - start) : encoded_len) * 3 / 4;
+            if (decoded_len <= sizeof(inline_bytes)) {
+                temp.base = inline_bytes;
+            } else {
+                temp.base = allocator->alloc(allocator, decoded_len);
+                if (temp.base == NULL) {
+                    return HSFV_ERR_OUT_OF_MEMORY;
+                }
             }
             temp.len = decoded_len;
 
@@ -768,12 +853,19 @@ hsfv_err_t hsfv_parse_byte_seq(hsfv_bare_item_t *item, hsfv_allocator_t *allocat
             src.len = encoded_len;
             err = hsfv_decode_base64(&temp, &src);
             if (err) {
-                allocator->free(allocator, temp.base);
+                if (temp.base != inline_bytes) {
+                    hsfv_allocator_free_sized(allocator, temp.base, decoded_len);
+                }
                 return HSFV_ERR_INVALID;
             }
+            if (temp.base == inline_bytes) {
+                hsfv_inline_set(&item->byte_seq, temp.base, temp.len);
+            } else {
+                item->byte_seq.base = temp.base;
+                item->byte_seq.len = temp.len;
+            }
             item->type = HSFV_BARE_ITEM_TYPE_BYTE_SEQ;
-            item->byte_seq.base = temp.base;
-            item->byte_seq.len = temp.len;
+            HSFV_STATS_INC(parsed_byte_seqs);
             if (out_rest) {
                 *out_rest = ++input;
             }
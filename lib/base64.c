@@ -4,6 +4,7 @@ static void hsfv_encode_base64_internal(hsfv_iovec_t *dst, const hsfv_iovec_cons
                                         uint64_t padding);
 static hsfv_err_t hsfv_decode_base64_internal(hsfv_iovec_t *dst, const hsfv_iovec_const_t *src, const hsfv_byte_t *basis);
 static bool hsfv_is_base64_decodable_internal(const hsfv_iovec_const_t *src, const hsfv_byte_t *basis);
+static bool hsfv_is_base64_canonical_internal(const hsfv_iovec_const_t *src, const hsfv_byte_t *basis);
 
 void hsfv_encode_base64(hsfv_iovec_t *dst, const hsfv_iovec_const_t *src)
 {
@@ -141,3 +142,43 @@ static bool hsfv_is_base64_decodable_internal(const hsfv_iovec_const_t *src, con
 
     return true;
 }
+
+bool hsfv_is_base64_canonical(const hsfv_iovec_const_t *src)
+{
+    return hsfv_is_base64_canonical_internal(src, basis64);
+}
+
+static bool hsfv_is_base64_canonical_internal(const hsfv_iovec_const_t *src, const hsfv_byte_t *basis)
+{
+    size_t len;
+
+    if (src->len % 4 != 0) {
+        return false;
+    }
+    for (len = 0; len < src->len; len++) {
+        if (src->base[len] == '=') {
+            break;
+        }
+        if (basis[src->base[len]] == 77) {
+            return false;
+        }
+    }
+    if (src->len - len > 2) {
+        return false;
+    }
+    for (size_t i = len; i < src->len; i++) {
+        if (src->base[i] != '=') {
+            return false;
+        }
+    }
+
+    /* the bits of the last character which fall beyond the decoded bytes must be zero */
+    switch (len % 4) {
+    case 2:
+        return (basis[src->base[len - 1]] & 0x0f) == 0;
+    case 3:
+        return (basis[src->base[len - 1]] & 0x03) == 0;
+    default:
+        return true;
+    }
+}
@@ -0,0 +1,779 @@
+#include "hsfv.h"
+
+#include <fenv.h>
+#include <math.h>
+
+#define VARINT_MAX_LEN 10
+
+enum {
+    TAG_INTEGER = 1,
+    TAG_DECIMAL,
+    TAG_STRING,
+    TAG_TOKEN,
+    TAG_BYTE_SEQ,
+    TAG_FALSE,
+    TAG_TRUE,
+    TAG_INNER_LIST,
+};
+
+/* set on the tag of an item or inner list which is followed by parameters */
+#define TAG_HAS_PARAMETERS 0x80
+#define TAG_MASK 0x7f
+
+/* Encode */
+
+static size_t varint_len(uint64_t v)
+{
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static void put_varint_unchecked(hsfv_byte_t *dest, uint64_t v)
+{
+    while (v >= 0x80) {
+        *dest++ = (hsfv_byte_t)(v | 0x80);
+        v >>= 7;
+    }
+    *dest = (hsfv_byte_t)v;
+}
+
+static hsfv_err_t put_varint(hsfv_buffer_t *dest, hsfv_allocator_t *allocator, uint64_t v)
+{
+    hsfv_err_t err;
+    size_t n = varint_len(v);
+
+    err = hsfv_buffer_ensure_unused_bytes(dest, allocator, n);
+    if (err) {
+        return err;
+    }
+    put_varint_unchecked(dest->bytes.base + dest->bytes.len, v);
+    dest->bytes.len += n;
+    return HSFV_OK;
+}
+
+static uint64_t zigzag_encode(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static hsfv_err_t put_span(hsfv_buffer_t *dest, hsfv_allocator_t *allocator, const void *base, size_t len)
+{
+    hsfv_err_t err;
+
+    err = put_varint(dest, allocator, len);
+    if (err) {
+        return err;
+    }
+    return hsfv_buffer_append_bytes(dest, allocator, base, len);
+}
+
+/*
+ * Containers are written as their byte length, member count and members.
+ * The members are encoded first and then moved to make room for the
+ * prefix, since its length is not known in advance. An empty container is
+ * a single zero byte.
+ */
+static hsfv_err_t end_container(hsfv_buffer_t *dest, hsfv_allocator_t *allocator, size_t start, size_t count)
+{
+    hsfv_err_t err;
+    size_t content_len = dest->bytes.len - start;
+
+    if (count == 0) {
+        return hsfv_buffer_append_byte(dest, allocator, 0);
+    }
+
+    size_t count_len = varint_len(count);
+    size_t byte_len = count_len + content_len;
+    size_t prefix_len = varint_len(byte_len) + count_len;
+    err = hsfv_buffer_ensure_unused_bytes(dest, allocator, prefix_len);
+    if (err) {
+        return err;
+    }
+    hsfv_byte_t *base = dest->bytes.base + start;
+    memmove(base + prefix_len, base, content_len);
+    put_varint_unchecked(base, byte_len);
+    put_varint_unchecked(base + prefix_len - count_len, count);
+    dest->bytes.len += prefix_len;
+    return HSFV_OK;
+}
+
+#pragma STDC FENV_ACCESS ON
+static hsfv_err_t decimal_to_milli(double decimal, int64_t *out_milli)
+{
+    int prev_rounding = fegetround();
+    if (prev_rounding != FE_TONEAREST && fesetround(FE_TONEAREST)) {
+        return HSFV_ERR_FLOAT_ROUNDING_MODE;
+    }
+
+    double rounded = rint(decimal * 1000);
+
+    if (prev_rounding != FE_TONEAREST && fesetround(prev_rounding)) {
+        return HSFV_ERR_FLOAT_ROUNDING_MODE;
+    }
+
+    if (rounded < HSFV_MIN_DEC_INT * 1000.0 - 999 || HSFV_MAX_DEC_INT * 1000.0 + 999 < rounded) {
+        return HSFV_ERR_INVALID;
+    }
+    *out_milli = (int64_t)rounded;
+    return HSFV_OK;
+}
+#pragma STDC FENV_ACCESS OFF
+
+static hsfv_err_t encode_bare_item(const hsfv_bare_item_t *item, hsfv_byte_t flags, hsfv_allocator_t *allocator,
+                                   hsfv_buffer_t *dest)
+{
+    hsfv_err_t err;
+    int64_t milli;
+
+    switch (item->type) {
+    case HSFV_BARE_ITEM_TYPE_INTEGER:
+        if (item->integer < HSFV_MIN_INT || HSFV_MAX_INT < item->integer) {
+            return HSFV_ERR_INVALID;
+        }
+        err = hsfv_buffer_append_byte(dest, allocator, TAG_INTEGER | flags);
+        if (err) {
+            return err;
+        }
+        return put_varint(dest, allocator, zigzag_encode(item->integer));
+    case HSFV_BARE_ITEM_TYPE_DECIMAL:
+        err = decimal_to_milli(item->decimal, &milli);
+        if (err) {
+            return err;
+        }
+        err = hsfv_buffer_append_byte(dest, allocator, TAG_DECIMAL | flags);
+        if (err) {
+            return err;
+        }
+        return put_varint(dest, allocator, zigzag_encode(milli));
+    case HSFV_BARE_ITEM_TYPE_STRING:
+        err = hsfv_buffer_append_byte(dest, allocator, TAG_STRING | flags);
+        if (err) {
+            return err;
+        }
+        return put_span(dest, allocator, hsfv_string_base(&item->string), hsfv_string_len(&item->string));
+    case HSFV_BARE_ITEM_TYPE_TOKEN:
+        err = hsfv_buffer_append_byte(dest, allocator, TAG_TOKEN | flags);
+        if (err) {
+            return err;
+        }
+        return put_span(dest, allocator, hsfv_token_base(&item->token), hsfv_token_len(&item->token));
+    case HSFV_BARE_ITEM_TYPE_BYTE_SEQ:
+        err = hsfv_buffer_append_byte(dest, allocator, TAG_BYTE_SEQ | flags);
+        if (err) {
+            return err;
+        }
+        return put_span(dest, allocator, hsfv_byte_seq_base(&item->byte_seq), hsfv_byte_seq_len(&item->byte_seq));
+    case HSFV_BARE_ITEM_TYPE_BOOLEAN:
+        return hsfv_buffer_append_byte(dest, allocator, (item->boolean ? TAG_TRUE : TAG_FALSE) | flags);
+    default:
+        return HSFV_ERR_INVALID;
+    }
+}
+
+static hsfv_err_t encode_parameters(const hsfv_parameters_t *parameters, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    hsfv_err_t err;
+    size_t start = dest->bytes.len;
+
+    for (size_t i = 0; i < parameters->len; i++) {
+        err = put_span(dest, allocator, hsfv_key_base(&parameters->params[i].key), hsfv_key_len(&parameters->params[i].key));
+        if (err) {
+            return err;
+        }
+        err = encode_bare_item(&parameters->params[i].value, 0, allocator, dest);
+        if (err) {
+            return err;
+        }
+    }
+    return end_container(dest, allocator, start, parameters->len);
+}
+
+static hsfv_err_t encode_item(const hsfv_item_t *item, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    hsfv_err_t err;
+
+    err = encode_bare_item(&item->bare_item, item->parameters.len ? TAG_HAS_PARAMETERS : 0, allocator, dest);
+    if (err || item->parameters.len == 0) {
+        return err;
+    }
+    return encode_parameters(&item->parameters, allocator, dest);
+}
+
+static hsfv_err_t encode_inner_list(const hsfv_inner_list_t *inner_list, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    hsfv_err_t err;
+    size_t start;
+
+    err = hsfv_buffer_append_byte(dest, allocator, TAG_INNER_LIST | (inner_list->parameters.len ? TAG_HAS_PARAMETERS : 0));
+    if (err) {
+        return err;
+    }
+    start = dest->bytes.len;
+    for (size_t i = 0; i < inner_list->len; i++) {
+        err = encode_item(&inner_list->items[i], allocator, dest);
+        if (err) {
+            return err;
+        }
+    }
+    err = end_container(dest, allocator, start, inner_list->len);
+    if (err || inner_list->parameters.len == 0) {
+        return err;
+    }
+    return encode_parameters(&inner_list->parameters, allocator, dest);
+}
+
+static hsfv_err_t encode_list(const hsfv_list_t *list, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    hsfv_err_t err;
+    size_t start = dest->bytes.len;
+
+    for (size_t i = 0; i < list->len; i++) {
+        const hsfv_list_member_t *member = &list->members[i];
+        switch (member->type) {
+        case HSFV_LIST_MEMBER_TYPE_ITEM:
+            err = encode_item(&member->item, allocator, dest);
+            break;
+        case HSFV_LIST_MEMBER_TYPE_INNER_LIST:
+            err = encode_inner_list(&member->inner_list, allocator, dest);
+            break;
+        default:
+            err = HSFV_ERR_INVALID;
+            break;
+        }
+        if (err) {
+            return err;
+        }
+    }
+    return end_container(dest, allocator, start, list->len);
+}
+
+static hsfv_err_t encode_dictionary(const hsfv_dictionary_t *dictionary, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    hsfv_err_t err;
+    size_t start = dest->bytes.len;
+
+    for (size_t i = 0; i < dictionary->len; i++) {
+        const hsfv_dict_member_t *member = &dictionary->members[i];
+        err = put_span(dest, allocator, hsfv_key_base(&member->key), hsfv_key_len(&member->key));
+        if (err) {
+            return err;
+        }
+        switch (member->value.type) {
+        case HSFV_DICT_MEMBER_TYPE_ITEM:
+            err = encode_item(&member->value.item, allocator, dest);
+            break;
+        case HSFV_DICT_MEMBER_TYPE_INNER_LIST:
+            err = encode_inner_list(&member->value.inner_list, allocator, dest);
+            break;
+        default:
+            err = HSFV_ERR_INVALID;
+            break;
+        }
+        if (err) {
+            return err;
+        }
+    }
+    return end_container(dest, allocator, start, dictionary->len);
+}
+
+hsfv_err_t hsfv_encode_binary(const hsfv_field_value_t *field_value, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    hsfv_err_t err;
+    size_t start = dest->bytes.len;
+
+    err = hsfv_buffer_ensure_unused_bytes(dest, allocator, 2);
+    if (err) {
+        return err;
+    }
+    hsfv_buffer_append_byte_unchecked(dest, HSFV_BINARY_VERSION);
+    hsfv_buffer_append_byte_unchecked(dest, field_value->type);
+
+    switch (field_value->type) {
+    case HSFV_FIELD_VALUE_TYPE_LIST:
+        err = encode_list(&field_value->list, allocator, dest);
+        break;
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY:
+        err = encode_dictionary(&field_value->dictionary, allocator, dest);
+        break;
+    case HSFV_FIELD_VALUE_TYPE_ITEM:
+        err = encode_item(&field_value->item, allocator, dest);
+        break;
+    default:
+        err = HSFV_ERR_INVALID;
+        break;
+    }
+    if (err) {
+        dest->bytes.len = start;
+    }
+    return err;
+}
+
+/* View */
+
+static bool read_varint(const hsfv_byte_t **pos, const hsfv_byte_t *end, uint64_t *out)
+{
+    const hsfv_byte_t *p = *pos;
+    uint64_t v = 0;
+
+    for (int shift = 0; p < end && shift < VARINT_MAX_LEN * 7; shift += 7) {
+        hsfv_byte_t b = *p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            *pos = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool read_span(const hsfv_byte_t **pos, const hsfv_byte_t *end, const hsfv_byte_t **out_base, size_t *out_len)
+{
+    uint64_t len;
+
+    if (!read_varint(pos, end, &len) || len > (uint64_t)(end - *pos)) {
+        return false;
+    }
+    *out_base = *pos;
+    *out_len = len;
+    *pos += len;
+    return true;
+}
+
+static bool read_container(const hsfv_byte_t **pos, const hsfv_byte_t *end, hsfv_binary_cursor_type_t type,
+                           hsfv_binary_cursor_t *out_cursor)
+{
+    const hsfv_byte_t *p = *pos, *container_end;
+    uint64_t byte_len, count;
+
+    if (!read_varint(&p, end, &byte_len) || byte_len > (uint64_t)(end - p)) {
+        return false;
+    }
+    container_end = p + byte_len;
+    count = 0;
+    if (byte_len) {
+        /* every member takes at least one byte */
+        if (!read_varint(&p, container_end, &count) || count == 0 || count > (uint64_t)(container_end - p)) {
+            return false;
+        }
+    }
+
+    *out_cursor = (hsfv_binary_cursor_t){.pos = p, .end = container_end, .remaining = count, .type = type};
+    *pos = container_end;
+    return true;
+}
+
+static bool read_bare_item(const hsfv_byte_t **pos, const hsfv_byte_t *end, hsfv_byte_t tag, hsfv_bare_item_t *out_item)
+{
+    const hsfv_byte_t *base;
+    uint64_t v;
+    size_t len;
+
+    switch (tag) {
+    case TAG_INTEGER:
+        if (!read_varint(pos, end, &v)) {
+            return false;
+        }
+        out_item->type = HSFV_BARE_ITEM_TYPE_INTEGER;
+        out_item->integer = zigzag_decode(v);
+        return HSFV_MIN_INT <= out_item->integer && out_item->integer <= HSFV_MAX_INT;
+    case TAG_DECIMAL:
+        if (!read_varint(pos, end, &v)) {
+            return false;
+        }
+        out_item->type = HSFV_BARE_ITEM_TYPE_DECIMAL;
+        out_item->decimal = (double)zigzag_decode(v) / 1000;
+        return HSFV_MIN_DEC_INT - 1 < out_item->decimal && out_item->decimal < HSFV_MAX_DEC_INT + 1;
+    case TAG_STRING:
+        if (!read_span(pos, end, &base, &len)) {
+            return false;
+        }
+        out_item->type = HSFV_BARE_ITEM_TYPE_STRING;
+        out_item->string.base = (const char *)base;
+        out_item->string.len = len;
+        return true;
+    case TAG_TOKEN:
+        if (!read_span(pos, end, &base, &len) || len == 0) {
+            return false;
+        }
+        out_item->type = HSFV_BARE_ITEM_TYPE_TOKEN;
+        out_item->token.base = (const char *)base;
+        out_item->token.len = len;
+        return true;
+    case TAG_BYTE_SEQ:
+        if (!read_span(pos, end, &base, &len)) {
+            return false;
+        }
+        out_item->type = HSFV_BARE_ITEM_TYPE_BYTE_SEQ;
+        out_item->byte_seq.base = base;
+        out_item->byte_seq.len = len;
+        return true;
+    case TAG_FALSE:
+    case TAG_TRUE:
+        out_item->type = HSFV_BARE_ITEM_TYPE_BOOLEAN;
+        out_item->boolean = tag == TAG_TRUE;
+        return true;
+    default:
+        return false;
+    }
+}
+
+hsfv_err_t hsfv_binary_view(const hsfv_byte_t *input, size_t len, hsfv_field_value_type_t *out_type, hsfv_binary_cursor_t *out_root)
+{
+    const hsfv_byte_t *pos, *end = input + len;
+
+    if (len < 2 || input[0] != HSFV_BINARY_VERSION) {
+        return HSFV_ERR_INVALID;
+    }
+    pos = input + 2;
+
+    switch (input[1]) {
+    case HSFV_FIELD_VALUE_TYPE_LIST:
+        if (!read_container(&pos, end, HSFV_BINARY_CURSOR_TYPE_LIST, out_root) || pos != end) {
+            return HSFV_ERR_INVALID;
+        }
+        break;
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY:
+        if (!read_container(&pos, end, HSFV_BINARY_CURSOR_TYPE_DICTIONARY, out_root) || pos != end) {
+            return HSFV_ERR_INVALID;
+        }
+        break;
+    case HSFV_FIELD_VALUE_TYPE_ITEM:
+        *out_root = (hsfv_binary_cursor_t){.pos = pos, .end = end, .remaining = 1, .type = HSFV_BINARY_CURSOR_TYPE_LIST};
+        break;
+    default:
+        return HSFV_ERR_INVALID;
+    }
+    *out_type = (hsfv_field_value_type_t)input[1];
+    return HSFV_OK;
+}
+
+hsfv_err_t hsfv_binary_next(hsfv_binary_cursor_t *cursor, hsfv_binary_member_t *out_member)
+{
+    const hsfv_byte_t *pos = cursor->pos, *end = cursor->end, *key;
+    hsfv_byte_t tag;
+
+    if (cursor->remaining == 0) {
+        return pos == end ? HSFV_ERR_EOF : HSFV_ERR_INVALID;
+    }
+
+    *out_member = (hsfv_binary_member_t){0};
+    if (cursor->type == HSFV_BINARY_CURSOR_TYPE_DICTIONARY || cursor->type == HSFV_BINARY_CURSOR_TYPE_PARAMETERS) {
+        if (!read_span(&pos, end, &key, &out_member->key.len) || out_member->key.len == 0) {
+            return HSFV_ERR_INVALID;
+        }
+        out_member->key.base = (const char *)key;
+    }
+
+    if (pos == end) {
+        return HSFV_ERR_INVALID;
+    }
+    tag = *pos++;
+    if ((tag & TAG_HAS_PARAMETERS) && cursor->type == HSFV_BINARY_CURSOR_TYPE_PARAMETERS) {
+        return HSFV_ERR_INVALID;
+    }
+    if ((tag & TAG_MASK) == TAG_INNER_LIST) {
+        if (cursor->type == HSFV_BINARY_CURSOR_TYPE_INNER_LIST || cursor->type == HSFV_BINARY_CURSOR_TYPE_PARAMETERS) {
+            return HSFV_ERR_INVALID;
+        }
+        if (!read_container(&pos, end, HSFV_BINARY_CURSOR_TYPE_INNER_LIST, &out_member->items)) {
+            return HSFV_ERR_INVALID;
+        }
+        out_member->is_inner_list = true;
+    } else if (!read_bare_item(&pos, end, tag & TAG_MASK, &out_member->bare_item)) {
+        return HSFV_ERR_INVALID;
+    }
+
+    if (tag & TAG_HAS_PARAMETERS) {
+        /* an empty parameters container would have been written without the flag */
+        if (!read_container(&pos, end, HSFV_BINARY_CURSOR_TYPE_PARAMETERS, &out_member->parameters) ||
+            out_member->parameters.remaining == 0) {
+            return HSFV_ERR_INVALID;
+        }
+    } else {
+        out_member->parameters = (hsfv_binary_cursor_t){.pos = pos, .end = pos, .type = HSFV_BINARY_CURSOR_TYPE_PARAMETERS};
+    }
+
+    cursor->pos = pos;
+    cursor->remaining--;
+    return HSFV_OK;
+}
+
+hsfv_err_t hsfv_binary_lookup(const hsfv_binary_cursor_t *cursor, const char *key, size_t key_len, hsfv_binary_member_t *out_member)
+{
+    hsfv_binary_cursor_t c = *cursor;
+    hsfv_err_t err;
+
+    if (c.type != HSFV_BINARY_CURSOR_TYPE_DICTIONARY && c.type != HSFV_BINARY_CURSOR_TYPE_PARAMETERS) {
+        return HSFV_ERR_INVALID;
+    }
+    while ((err = hsfv_binary_next(&c, out_member)) == HSFV_OK) {
+        if (out_member->key.len == key_len && !memcmp(out_member->key.base, key, key_len)) {
+            return HSFV_OK;
+        }
+    }
+    return err;
+}
+
+/* Decode */
+
+/*
+ * copies src into span, a string or byte sequence whose base and len are
+ * out_base and out_len, storing it inline when it is short enough as the
+ * parser does.
+ */
+static hsfv_err_t copy_span(hsfv_allocator_t *allocator, const void *src, size_t len, void *span, const void **out_base,
+                            size_t *out_len)
+{
+    hsfv_byte_t *copy;
+
+    if (len <= HSFV_INLINE_CAPACITY) {
+        hsfv_inline_set(span, src, len);
+        return HSFV_OK;
+    }
+    copy = allocator->alloc(allocator, len);
+    if (copy == NULL) {
+        return HSFV_ERR_OUT_OF_MEMORY;
+    }
+    memcpy(copy, src, len);
+    *out_base = copy;
+    *out_len = len;
+    return HSFV_OK;
+}
+
+static hsfv_err_t copy_key_or_token(hsfv_allocator_t *allocator, const char *src, size_t len, void *span, const char **out_base,
+                                    size_t *out_len)
+{
+    const char *interned = hsfv_intern_lookup(src, len);
+    if (interned) {
+        *out_base = interned;
+        *out_len = len;
+        return HSFV_OK;
+    }
+    return copy_span(allocator, src, len, span, (const void **)out_base, out_len);
+}
+
+static hsfv_err_t decode_bare_item(const hsfv_bare_item_t *view, hsfv_allocator_t *allocator, hsfv_bare_item_t *out_item)
+{
+    *out_item = *view;
+    switch (view->type) {
+    case HSFV_BARE_ITEM_TYPE_STRING:
+        return copy_span(allocator, view->string.base, view->string.len, &out_item->string, (const void **)&out_item->string.base,
+                         &out_item->string.len);
+    case HSFV_BARE_ITEM_TYPE_TOKEN:
+        return copy_key_or_token(allocator, view->token.base, view->token.len, &out_item->token, &out_item->token.base,
+                                 &out_item->token.len);
+    case HSFV_BARE_ITEM_TYPE_BYTE_SEQ:
+        return copy_span(allocator, view->byte_seq.base, view->byte_seq.len, &out_item->byte_seq,
+                         (const void **)&out_item->byte_seq.base, &out_item->byte_seq.len);
+    default:
+        return HSFV_OK;
+    }
+}
+
+static void *alloc_array(hsfv_allocator_t *allocator, size_t count, size_t size)
+{
+    return count ? allocator->alloc(allocator, count * size) : NULL;
+}
+
+static hsfv_err_t decode_parameters(hsfv_binary_cursor_t *cursor, hsfv_allocator_t *allocator, hsfv_parameters_t *out_parameters)
+{
+    hsfv_binary_member_t member;
+    hsfv_parameter_t *param;
+    hsfv_err_t err;
+
+    *out_parameters = (hsfv_parameters_t){0};
+    out_parameters->params = alloc_array(allocator, cursor->remaining, sizeof(hsfv_parameter_t));
+    if (cursor->remaining && out_parameters->params == NULL) {
+        return HSFV_ERR_OUT_OF_MEMORY;
+    }
+    out_parameters->capacity = cursor->remaining;
+
+    while ((err = hsfv_binary_next(cursor, &member)) == HSFV_OK) {
+        param = &out_parameters->params[out_parameters->len];
+        err = copy_key_or_token(allocator, member.key.base, member.key.len, &param->key, &param->key.base, &param->key.len);
+        if (err) {
+            goto error;
+        }
+        err = decode_bare_item(&member.bare_item, allocator, &param->value);
+        if (err) {
+            hsfv_key_deinit(&param->key, allocator);
+            goto error;
+        }
+        out_parameters->len++;
+    }
+    if (err == HSFV_ERR_EOF) {
+        return HSFV_OK;
+    }
+
+error:
+    hsfv_parameters_deinit(out_parameters, allocator);
+    *out_parameters = (hsfv_parameters_t){0};
+    return err;
+}
+
+static hsfv_err_t decode_item(hsfv_binary_member_t *member, hsfv_allocator_t *allocator, hsfv_item_t *out_item)
+{
+    hsfv_err_t err;
+
+    err = decode_bare_item(&member->bare_item, allocator, &out_item->bare_item);
+    if (err) {
+        return err;
+    }
+    err = decode_parameters(&member->parameters, allocator, &out_item->parameters);
+    if (err) {
+        hsfv_bare_item_deinit(&out_item->bare_item, allocator);
+    }
+    return err;
+}
+
+static hsfv_err_t decode_inner_list(hsfv_binary_member_t *member, hsfv_allocator_t *allocator, hsfv_inner_list_t *out_inner_list)
+{
+    hsfv_binary_member_t item;
+    hsfv_err_t err;
+
+    *out_inner_list = (hsfv_inner_list_t){0};
+    out_inner_list->items = alloc_array(allocator, member->items.remaining, sizeof(hsfv_item_t));
+    if (member->items.remaining && out_inner_list->items == NULL) {
+        return HSFV_ERR_OUT_OF_MEMORY;
+    }
+    out_inner_list->capacity = member->items.remaining;
+
+    while ((err = hsfv_binary_next(&member->items, &item)) == HSFV_OK) {
+        err = decode_item(&item, allocator, &out_inner_list->items[out_inner_list->len]);
+        if (err) {
+            goto error;
+        }
+        out_inner_list->len++;
+    }
+    if (err != HSFV_ERR_EOF) {
+        goto error;
+    }
+
+    err = decode_parameters(&member->parameters, allocator, &out_inner_list->parameters);
+    if (err) {
+        goto error;
+    }
+    return HSFV_OK;
+
+error:
+    hsfv_inner_list_deinit(out_inner_list, allocator);
+    return err;
+}
+
+static hsfv_err_t decode_list(hsfv_binary_cursor_t *cursor, hsfv_allocator_t *allocator, hsfv_list_t *out_list)
+{
+    hsfv_binary_member_t member;
+    hsfv_list_member_t *list_member;
+    hsfv_err_t err;
+
+    *out_list = (hsfv_list_t){0};
+    out_list->members = alloc_array(allocator, cursor->remaining, sizeof(hsfv_list_member_t));
+    if (cursor->remaining && out_list->members == NULL) {
+        return HSFV_ERR_OUT_OF_MEMORY;
+    }
+    out_list->capacity = cursor->remaining;
+
+    while ((err = hsfv_binary_next(cursor, &member)) == HSFV_OK) {
+        list_member = &out_list->members[out_list->len];
+        if (member.is_inner_list) {
+            list_member->type = HSFV_LIST_MEMBER_TYPE_INNER_LIST;
+            err = decode_inner_list(&member, allocator, &list_member->inner_list);
+        } else {
+            list_member->type = HSFV_LIST_MEMBER_TYPE_ITEM;
+            err = decode_item(&member, allocator, &list_member->item);
+        }
+        if (err) {
+            goto error;
+        }
+        out_list->len++;
+    }
+    if (err == HSFV_ERR_EOF) {
+        return HSFV_OK;
+    }
+
+error:
+    hsfv_list_deinit(out_list, allocator);
+    return err;
+}
+
+static hsfv_err_t decode_dictionary(hsfv_binary_cursor_t *cursor, hsfv_allocator_t *allocator, hsfv_dictionary_t *out_dictionary)
+{
+    hsfv_binary_member_t member;
+    hsfv_dict_member_t *dict_member;
+    hsfv_err_t err;
+
+    *out_dictionary = (hsfv_dictionary_t){0};
+    out_dictionary->members = alloc_array(allocator, cursor->remaining, sizeof(hsfv_dict_member_t));
+    if (cursor->remaining && out_dictionary->members == NULL) {
+        return HSFV_ERR_OUT_OF_MEMORY;
+    }
+    out_dictionary->capacity = cursor->remaining;
+
+    while ((err = hsfv_binary_next(cursor, &member)) == HSFV_OK) {
+        dict_member = &out_dictionary->members[out_dictionary->len];
+        err = copy_key_or_token(allocator, member.key.base, member.key.len, &dict_member->key, &dict_member->key.base,
+                                &dict_member->key.len);
+        if (err) {
+            goto error;
+        }
+        if (member.is_inner_list) {
+            dict_member->value.type = HSFV_DICT_MEMBER_TYPE_INNER_LIST;
+            err = decode_inner_list(&member, allocator, &dict_member->value.inner_list);
+        } else {
+            dict_member->value.type = HSFV_DICT_MEMBER_TYPE_ITEM;
+            err = decode_item(&member, allocator, &dict_member->value.item);
+        }
+        if (err) {
+            hsfv_key_deinit(&dict_member->key, allocator);
+            goto error;
+        }
+        out_dictionary->len++;
+    }
+    if (err == HSFV_ERR_EOF) {
+        return HSFV_OK;
+    }
+
+error:
+    hsfv_dictionary_deinit(out_dictionary, allocator);
+    return err;
+}
+
+hsfv_err_t hsfv_decode_binary(hsfv_field_value_t *field_value, hsfv_allocator_t *allocator, const hsfv_byte_t *input, size_t len)
+{
+    hsfv_binary_cursor_t root;
+    hsfv_binary_member_t member;
+    hsfv_field_value_type_t type;
+    hsfv_err_t err;
+
+    err = hsfv_binary_view(input, len, &type, &root);
+    if (err) {
+        return err;
+    }
+
+    field_value->type = type;
+    switch (type) {
+    case HSFV_FIELD_VALUE_TYPE_LIST:
+        return decode_list(&root, allocator, &field_value->list);
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY:
+        return decode_dictionary(&root, allocator, &field_value->dictionary);
+    default:
+        err = hsfv_binary_next(&root, &member);
+        if (err) {
+            return HSFV_ERR_INVALID;
+        }
+        if (member.is_inner_list || root.pos != root.end) {
+            return HSFV_ERR_INVALID;
+        }
+        return decode_item(&member, allocator, &field_value->item);
+    }
+}
@@ -1,4 +1,5 @@
 #include "hsfv.h"
+#include "stats.h"
 
 hsfv_err_t hsfv_buffer_alloc(hsfv_buffer_t *buf, hsfv_allocator_t *allocator, size_t capacity)
 {
@@ -22,12 +23,13 @@ hsfv_err_t hsfv_buffer_realloc(hsfv_buffer_t *buf, hsfv_allocator_t *allocator,
     }
     buf->capacity = capacity;
     buf->bytes.base = base2;
+    HSFV_STATS_INC(reallocs);
     return HSFV_OK;
 }
 
 void hsfv_buffer_deinit(hsfv_buffer_t *buf, hsfv_allocator_t *allocator)
 {
-    allocator->free(allocator, buf->bytes.base);
+    hsfv_allocator_free_sized(allocator, buf->bytes.base, buf->capacity);
     buf->bytes.base = NULL;
     buf->bytes.len = 0;
     buf->capacity = 0;
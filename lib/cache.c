@@ -0,0 +1,545 @@
+#include "hsfv.h"
+
+#include <pthread.h>
+
+/*
+ * Each entry owns an arena holding the parsed field value, a copy of the
+ * input bytes and the entry itself, so creating an entry takes one or two
+ * allocations and freeing it releases the whole arena. Entries are found
+ * through a chained hash table and evicted in the order of a CLOCK ring.
+ * The cache holds one reference to every entry it contains and each value
+ * handed out holds another.
+ */
+typedef struct st_hsfv_cache_entry_t hsfv_cache_entry_t;
+
+struct st_hsfv_cache_entry_t {
+    /* first so that a field value returned to callers converts back to its entry */
+    hsfv_field_value_t field_value;
+    size_t refcnt;
+    hsfv_arena_t arena;
+    hsfv_cache_entry_t *next;
+    hsfv_cache_entry_t *retired_next;
+    uint64_t hash;
+    const char *input;
+    size_t input_len;
+    bool referenced;
+};
+
+/*
+ * hash table and CLOCK ring shared by hsfv_cache_t and the shards of
+ * hsfv_shared_cache_t. Chains are read with acquire loads and published
+ * with release stores so that lookups in a shared cache can walk them
+ * while the shard owner inserts and evicts.
+ */
+typedef struct st_cache_table_t {
+    hsfv_cache_entry_t **ring;
+    hsfv_cache_entry_t **buckets;
+    size_t capacity;
+    size_t len;
+    size_t hand;
+    size_t bucket_mask;
+    uint64_t misses;
+    uint64_t evictions;
+} cache_table_t;
+
+struct st_hsfv_cache_t {
+    hsfv_allocator_t *allocator;
+    cache_table_t table;
+    uint64_t hits;
+};
+
+#define CACHE_ENTRY_MIN_CHUNK_SIZE 1024
+
+static uint64_t cache_hash(hsfv_field_value_type_t field_type, const char *input, size_t len)
+{
+    const uint64_t m = 0xff51afd7ed558ccdULL;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ ((uint64_t)len << 8) ^ (uint64_t)field_type;
+    uint64_t w;
+
+    for (; len >= 8; input += 8, len -= 8) {
+        memcpy(&w, input, 8);
+        h = (h ^ w) * m;
+        h ^= h >> 32;
+    }
+    if (len) {
+        w = 0;
+        memcpy(&w, input, len);
+        h = (h ^ w) * m;
+    }
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static hsfv_err_t cache_entry_create(hsfv_allocator_t *allocator, hsfv_field_value_type_t field_type, uint64_t hash,
+                                     const char *input, size_t len, hsfv_cache_entry_t **out_entry)
+{
+    hsfv_arena_t arena;
+    hsfv_field_value_t field_value;
+    hsfv_cache_entry_t *entry;
+    hsfv_err_t err;
+
+    hsfv_arena_init(&arena, allocator, hsfv_max(CACHE_ENTRY_MIN_CHUNK_SIZE, len * 8));
+    err = hsfv_parse_field_value(&field_value, field_type, &arena.allocator, input, input + len, NULL);
+    if (err) {
+        goto error;
+    }
+
+    entry = arena.allocator.alloc(&arena.allocator, sizeof(hsfv_cache_entry_t) + len);
+    if (entry == NULL) {
+        err = HSFV_ERR_OUT_OF_MEMORY;
+        goto error;
+    }
+    memcpy(entry + 1, input, len);
+    *entry = (hsfv_cache_entry_t){
+        .field_value = field_value,
+        .refcnt = 1,
+        .arena = arena,
+        .hash = hash,
+        .input = (const char *)(entry + 1),
+        .input_len = len,
+    };
+    *out_entry = entry;
+    return HSFV_OK;
+
+error:
+    hsfv_arena_deinit(&arena);
+    return err;
+}
+
+static void cache_entry_retain(hsfv_cache_entry_t *entry)
+{
+    __atomic_add_fetch(&entry->refcnt, 1, __ATOMIC_RELAXED);
+}
+
+static void cache_entry_release(hsfv_cache_entry_t *entry)
+{
+    if (__atomic_sub_fetch(&entry->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
+        /* the arena lives in the block it is about to free */
+        hsfv_arena_t arena = entry->arena;
+        hsfv_arena_deinit(&arena);
+    }
+}
+
+static void cache_entry_mark_referenced(hsfv_cache_entry_t *entry)
+{
+    /* check first so that hits on a marked entry do not write to it */
+    if (!__atomic_load_n(&entry->referenced, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&entry->referenced, true, __ATOMIC_RELAXED);
+    }
+}
+
+/* Table */
+
+static size_t cache_table_bucket_count(size_t capacity)
+{
+    size_t bucket_count = 1;
+    while (bucket_count < capacity) {
+        bucket_count <<= 1;
+    }
+    return bucket_count;
+}
+
+static size_t cache_table_memory_size(size_t capacity)
+{
+    return (capacity + cache_table_bucket_count(capacity)) * sizeof(hsfv_cache_entry_t *);
+}
+
+/* memory must be cache_table_memory_size(capacity) bytes */
+static void cache_table_init(cache_table_t *table, void *memory, size_t capacity)
+{
+    size_t bucket_count = cache_table_bucket_count(capacity);
+
+    *table = (cache_table_t){
+        .ring = memory,
+        .buckets = (hsfv_cache_entry_t **)memory + capacity,
+        .capacity = capacity,
+        .bucket_mask = bucket_count - 1,
+    };
+    memset(table->buckets, 0, bucket_count * sizeof(hsfv_cache_entry_t *));
+}
+
+static void cache_table_release_entries(cache_table_t *table)
+{
+    for (size_t i = 0; i < table->len; i++) {
+        cache_entry_release(table->ring[i]);
+    }
+}
+
+static hsfv_cache_entry_t *cache_table_find(const cache_table_t *table, hsfv_field_value_type_t field_type, uint64_t hash,
+                                            const char *input, size_t len)
+{
+    hsfv_cache_entry_t *entry = __atomic_load_n(&table->buckets[hash & table->bucket_mask], __ATOMIC_ACQUIRE);
+
+    for (; entry; entry = __atomic_load_n(&entry->next, __ATOMIC_ACQUIRE)) {
+        if (entry->hash == hash && entry->field_value.type == field_type && entry->input_len == len &&
+            !memcmp(entry->input, input, len)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void cache_table_unlink(cache_table_t *table, hsfv_cache_entry_t *entry)
+{
+    hsfv_cache_entry_t **p = &table->buckets[entry->hash & table->bucket_mask];
+    while (*p != entry) {
+        p = &(*p)->next;
+    }
+    /* entry->next is left as it is for lookups which are standing on entry */
+    __atomic_store_n(p, entry->next, __ATOMIC_RELEASE);
+}
+
+/*
+ * adds entry and returns the entry evicted to make room for it, or NULL.
+ * When the cache is full, the hand clears the mark of every marked entry it
+ * passes and evicts the first unmarked one.
+ */
+static hsfv_cache_entry_t *cache_table_insert(cache_table_t *table, hsfv_cache_entry_t *entry)
+{
+    hsfv_cache_entry_t *evicted = NULL;
+    hsfv_cache_entry_t **bucket;
+    size_t slot;
+
+    if (table->len < table->capacity) {
+        slot = table->len;
+        __atomic_store_n(&table->len, table->len + 1, __ATOMIC_RELAXED);
+    } else {
+        for (;;) {
+            slot = table->hand;
+            evicted = table->ring[slot];
+            table->hand = slot + 1 == table->capacity ? 0 : slot + 1;
+            if (!__atomic_load_n(&evicted->referenced, __ATOMIC_RELAXED)) {
+                break;
+            }
+            __atomic_store_n(&evicted->referenced, false, __ATOMIC_RELAXED);
+        }
+        cache_table_unlink(table, evicted);
+        __atomic_add_fetch(&table->evictions, 1, __ATOMIC_RELAXED);
+    }
+
+    table->ring[slot] = entry;
+    bucket = &table->buckets[entry->hash & table->bucket_mask];
+    entry->next = *bucket;
+    __atomic_store_n(bucket, entry, __ATOMIC_RELEASE);
+    return evicted;
+}
+
+/* Cache */
+
+hsfv_cache_t *hsfv_cache_create(hsfv_allocator_t *allocator, size_t capacity)
+{
+    hsfv_cache_t *cache;
+
+    if (capacity == 0) {
+        capacity = HSFV_CACHE_DEFAULT_CAPACITY;
+    }
+
+    cache = allocator->alloc(allocator, sizeof(hsfv_cache_t) + cache_table_memory_size(capacity));
+    if (cache == NULL) {
+        return NULL;
+    }
+    *cache = (hsfv_cache_t){.allocator = allocator};
+    cache_table_init(&cache->table, cache + 1, capacity);
+    return cache;
+}
+
+void hsfv_cache_destroy(hsfv_cache_t *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    cache_table_release_entries(&cache->table);
+    hsfv_allocator_free_sized(cache->allocator, cache, sizeof(hsfv_cache_t) + cache_table_memory_size(cache->table.capacity));
+}
+
+hsfv_err_t hsfv_cache_parse(hsfv_cache_t *cache, hsfv_field_value_type_t field_type, const char *input, const char *input_end,
+                            const hsfv_field_value_t **out_field_value)
+{
+    size_t len = input_end - input;
+    uint64_t hash = cache_hash(field_type, input, len);
+    hsfv_cache_entry_t *entry, *evicted;
+    hsfv_err_t err;
+
+    entry = cache_table_find(&cache->table, field_type, hash, input, len);
+    if (entry) {
+        cache->hits++;
+        cache_entry_mark_referenced(entry);
+        cache_entry_retain(entry);
+        *out_field_value = &entry->field_value;
+        return HSFV_OK;
+    }
+
+    cache->table.misses++;
+    err = cache_entry_create(cache->allocator, field_type, hash, input, len, &entry);
+    if (err) {
+        return err;
+    }
+
+    /* one reference for the cache and one for the caller */
+    entry->refcnt = 2;
+    evicted = cache_table_insert(&cache->table, entry);
+    if (evicted) {
+        cache_entry_release(evicted);
+    }
+    *out_field_value = &entry->field_value;
+    return HSFV_OK;
+}
+
+void hsfv_cache_stats(const hsfv_cache_t *cache, hsfv_cache_stats_t *out_stats)
+{
+    *out_stats = (hsfv_cache_stats_t){
+        .hits = cache->hits,
+        .misses = cache->table.misses,
+        .evictions = cache->table.evictions,
+        .len = cache->table.len,
+        .capacity = cache->table.capacity,
+    };
+}
+
+void hsfv_cache_retain(const hsfv_field_value_t *field_value)
+{
+    cache_entry_retain((hsfv_cache_entry_t *)field_value);
+}
+
+void hsfv_cache_release(const hsfv_field_value_t *field_value)
+{
+    if (field_value == NULL) {
+        return;
+    }
+    cache_entry_release((hsfv_cache_entry_t *)field_value);
+}
+
+/* Shared cache */
+
+/*
+ * Readers announce themselves in one of a fixed number of slots, chosen per
+ * thread, by incrementing the counter for the parity of the current epoch.
+ * An entry evicted from a shard is unlinked at once but only retired: it is
+ * moved to draining when the epoch is next advanced, and the cache drops
+ * its reference once no slot has a reader left in the parity it had before
+ * the advance. A reader which loaded the old epoch but counted itself after
+ * the check sees the new epoch when it checks again, and retries. Retired
+ * entries are processed whenever another entry is evicted and when the
+ * cache is destroyed.
+ */
+#define SHARED_CACHE_READER_SLOT_COUNT 64
+#define SHARED_CACHE_LINE_SIZE 64
+
+typedef struct st_shared_cache_reader_slot_t {
+    uint64_t active[2];
+    uint64_t hits;
+    char padding[SHARED_CACHE_LINE_SIZE - 3 * sizeof(uint64_t)];
+} shared_cache_reader_slot_t;
+
+typedef struct st_shared_cache_shard_t {
+    pthread_mutex_t mutex;
+    cache_table_t table;
+} shared_cache_shard_t;
+
+struct st_hsfv_shared_cache_t {
+    /* first, so that each slot fills one cache line when the block is aligned */
+    shared_cache_reader_slot_t readers[SHARED_CACHE_READER_SLOT_COUNT];
+    hsfv_allocator_t *allocator;
+    shared_cache_shard_t *shards;
+    size_t shard_mask;
+    uint64_t epoch;
+    pthread_mutex_t reclaim_mutex;
+    hsfv_cache_entry_t *retired;
+    hsfv_cache_entry_t *draining;
+    unsigned draining_parity;
+};
+
+static uint32_t shared_cache_thread_count;
+/* reader slot of this thread plus one, or zero before its first lookup */
+static _Thread_local uint32_t shared_cache_thread_slot;
+
+static shared_cache_reader_slot_t *shared_cache_reader_slot(hsfv_shared_cache_t *cache)
+{
+    if (shared_cache_thread_slot == 0) {
+        shared_cache_thread_slot = __atomic_add_fetch(&shared_cache_thread_count, 1, __ATOMIC_RELAXED);
+    }
+    return &cache->readers[(shared_cache_thread_slot - 1) % SHARED_CACHE_READER_SLOT_COUNT];
+}
+
+static unsigned shared_cache_read_begin(hsfv_shared_cache_t *cache, shared_cache_reader_slot_t *slot)
+{
+    for (;;) {
+        uint64_t epoch = __atomic_load_n(&cache->epoch, __ATOMIC_SEQ_CST);
+        unsigned parity = epoch & 1;
+        __atomic_add_fetch(&slot->active[parity], 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&cache->epoch, __ATOMIC_SEQ_CST) == epoch) {
+            return parity;
+        }
+        __atomic_sub_fetch(&slot->active[parity], 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void shared_cache_read_end(shared_cache_reader_slot_t *slot, unsigned parity)
+{
+    __atomic_sub_fetch(&slot->active[parity], 1, __ATOMIC_RELEASE);
+}
+
+static void shared_cache_release_list(hsfv_cache_entry_t *entry)
+{
+    hsfv_cache_entry_t *next;
+    for (; entry; entry = next) {
+        next = entry->retired_next;
+        cache_entry_release(entry);
+    }
+}
+
+/* called with reclaim_mutex held */
+static void shared_cache_reclaim(hsfv_shared_cache_t *cache)
+{
+    if (cache->draining) {
+        for (size_t i = 0; i < SHARED_CACHE_READER_SLOT_COUNT; i++) {
+            if (__atomic_load_n(&cache->readers[i].active[cache->draining_parity], __ATOMIC_ACQUIRE)) {
+                return;
+            }
+        }
+        shared_cache_release_list(cache->draining);
+        cache->draining = NULL;
+    }
+    if (cache->retired) {
+        cache->draining = cache->retired;
+        cache->retired = NULL;
+        cache->draining_parity = cache->epoch & 1;
+        __atomic_store_n(&cache->epoch, cache->epoch + 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void shared_cache_retire(hsfv_shared_cache_t *cache, hsfv_cache_entry_t *entry)
+{
+    pthread_mutex_lock(&cache->reclaim_mutex);
+    entry->retired_next = cache->retired;
+    cache->retired = entry;
+    shared_cache_reclaim(cache);
+    pthread_mutex_unlock(&cache->reclaim_mutex);
+}
+
+static size_t shared_cache_memory_size(size_t shard_count, size_t shard_capacity)
+{
+    return sizeof(hsfv_shared_cache_t) + shard_count * (sizeof(shared_cache_shard_t) + cache_table_memory_size(shard_capacity));
+}
+
+hsfv_shared_cache_t *hsfv_shared_cache_create(hsfv_allocator_t *allocator, size_t capacity, size_t shard_count)
+{
+    size_t shard_capacity, table_size, n = 1;
+    hsfv_shared_cache_t *cache;
+    hsfv_byte_t *tables;
+
+    if (capacity == 0) {
+        capacity = HSFV_CACHE_DEFAULT_CAPACITY;
+    }
+    if (shard_count == 0) {
+        shard_count = HSFV_SHARED_CACHE_DEFAULT_SHARD_COUNT;
+    }
+    while (n < shard_count) {
+        n <<= 1;
+    }
+    shard_count = n;
+    shard_capacity = (capacity + shard_count - 1) / shard_count;
+    table_size = cache_table_memory_size(shard_capacity);
+
+    cache = hsfv_allocator_alloc_aligned(allocator, shared_cache_memory_size(shard_count, shard_capacity), SHARED_CACHE_LINE_SIZE);
+    if (cache == NULL) {
+        return NULL;
+    }
+    *cache = (hsfv_shared_cache_t){
+        .allocator = allocator,
+        .shards = (shared_cache_shard_t *)(cache + 1),
+        .shard_mask = shard_count - 1,
+    };
+    pthread_mutex_init(&cache->reclaim_mutex, NULL);
+    tables = (hsfv_byte_t *)(cache->shards + shard_count);
+    for (size_t i = 0; i < shard_count; i++) {
+        pthread_mutex_init(&cache->shards[i].mutex, NULL);
+        cache_table_init(&cache->shards[i].table, tables + i * table_size, shard_capacity);
+    }
+    return cache;
+}
+
+void hsfv_shared_cache_destroy(hsfv_shared_cache_t *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    for (size_t i = 0; i <= cache->shard_mask; i++) {
+        cache_table_release_entries(&cache->shards[i].table);
+        pthread_mutex_destroy(&cache->shards[i].mutex);
+    }
+    shared_cache_release_list(cache->draining);
+    shared_cache_release_list(cache->retired);
+    pthread_mutex_destroy(&cache->reclaim_mutex);
+    hsfv_allocator_free_sized(cache->allocator, cache, shared_cache_memory_size(cache->shard_mask + 1, cache->shards[0].table.capacity));
+}
+
+hsfv_err_t hsfv_shared_cache_parse(hsfv_shared_cache_t *cache, hsfv_field_value_type_t field_type, const char *input,
+                                   const char *input_end, const hsfv_field_value_t **out_field_value)
+{
+    size_t len = input_end - input;
+    uint64_t hash = cache_hash(field_type, input, len);
+    /* the low bits pick the bucket, so pick the shard with the high bits */
+    shared_cache_shard_t *shard = &cache->shards[(hash >> 32) & cache->shard_mask];
+    shared_cache_reader_slot_t *slot = shared_cache_reader_slot(cache);
+    hsfv_cache_entry_t *entry, *created, *evicted;
+    unsigned parity;
+    hsfv_err_t err;
+
+    parity = shared_cache_read_begin(cache, slot);
+    entry = cache_table_find(&shard->table, field_type, hash, input, len);
+    if (entry) {
+        /* the cache's own reference cannot be dropped before the read section ends */
+        cache_entry_mark_referenced(entry);
+        cache_entry_retain(entry);
+    }
+    shared_cache_read_end(slot, parity);
+    if (entry) {
+        __atomic_add_fetch(&slot->hits, 1, __ATOMIC_RELAXED);
+        *out_field_value = &entry->field_value;
+        return HSFV_OK;
+    }
+
+    __atomic_add_fetch(&shard->table.misses, 1, __ATOMIC_RELAXED);
+    err = cache_entry_create(cache->allocator, field_type, hash, input, len, &created);
+    if (err) {
+        return err;
+    }
+
+    pthread_mutex_lock(&shard->mutex);
+    /* another thread may have inserted the same input while this one was parsing */
+    entry = cache_table_find(&shard->table, field_type, hash, input, len);
+    if (entry) {
+        cache_entry_retain(entry);
+        pthread_mutex_unlock(&shard->mutex);
+        cache_entry_release(created);
+        *out_field_value = &entry->field_value;
+        return HSFV_OK;
+    }
+    created->refcnt = 2;
+    evicted = cache_table_insert(&shard->table, created);
+    pthread_mutex_unlock(&shard->mutex);
+
+    if (evicted) {
+        shared_cache_retire(cache, evicted);
+    }
+    *out_field_value = &created->field_value;
+    return HSFV_OK;
+}
+
+void hsfv_shared_cache_stats(const hsfv_shared_cache_t *cache, hsfv_cache_stats_t *out_stats)
+{
+    *out_stats = (hsfv_cache_stats_t){0};
+    for (size_t i = 0; i < SHARED_CACHE_READER_SLOT_COUNT; i++) {
+        out_stats->hits += __atomic_load_n(&cache->readers[i].hits, __ATOMIC_RELAXED);
+    }
+    for (size_t i = 0; i <= cache->shard_mask; i++) {
+        const cache_table_t *table = &cache->shards[i].table;
+        out_stats->misses += __atomic_load_n(&table->misses, __ATOMIC_RELAXED);
+        out_stats->evictions += __atomic_load_n(&table->evictions, __ATOMIC_RELAXED);
+        out_stats->len += __atomic_load_n(&table->len, __ATOMIC_RELAXED);
+        out_stats->capacity += table->capacity;
+    }
+}
@@ -0,0 +1,246 @@
+#include "hsfv.h"
+#include "keyed.h"
+
+/*
+ * The checks below accept exactly the text hsfv_serialize_field_value
+ * writes: single separators, no "=?1" for true booleans in dictionaries and
+ * parameters, numbers without leading zeros or trailing fractional zeros,
+ * padded base64 and no duplicate keys, which the parser would merge. The
+ * skip functions do the validation and the checks only reject text which is
+ * valid but would be written differently. Duplicate keys are looked for once
+ * a dictionary or parameter list has been validated.
+ */
+
+/* whether count valid members of a dictionary or parameter list have count distinct keys */
+static bool canonical_keys_distinct(hsfv_keyed_next_t next, const char *input, const char *input_end, size_t count)
+{
+    hsfv_keyed_iter_t iter;
+    hsfv_keyed_member_t member;
+    size_t distinct = 0;
+
+    if (count < 2) {
+        return true;
+    }
+    hsfv_keyed_iter_init(&iter, next, input, input_end);
+    while (hsfv_keyed_iter_next(&iter, &member)) {
+        ++distinct;
+    }
+    return distinct == count;
+}
+
+static bool canonical_number(const char *input, const char *input_end, const char **out_rest)
+{
+    const char *end, *digits, *dot;
+
+    if (!hsfv_skip_number(input, input_end, &end)) {
+        return false;
+    }
+    digits = *input == '-' ? input + 1 : input;
+    dot = memchr(digits, '.', end - digits);
+    if (dot == NULL) {
+        /* -0 is written as 0 */
+        if (*digits == '0' && (end - digits > 1 || digits != input)) {
+            return false;
+        }
+    } else if ((*digits == '0' && dot - digits > 1) || (end - dot > 2 && end[-1] == '0')) {
+        return false;
+    }
+    *out_rest = end;
+    return true;
+}
+
+static bool canonical_byte_seq(const char *input, const char *input_end, const char **out_rest)
+{
+    const char *end;
+
+    if (!hsfv_skip_byte_seq(input, input_end, &end)) {
+        return false;
+    }
+    hsfv_iovec_const_t encoded = {.base = (const hsfv_byte_t *)input + 1, .len = end - input - 2};
+    if (!hsfv_is_base64_canonical(&encoded)) {
+        return false;
+    }
+    *out_rest = end;
+    return true;
+}
+
+static bool canonical_bare_item(const char *input, const char *input_end, bool *out_is_true, const char **out_rest)
+{
+    *out_is_true = false;
+    if (input == input_end) {
+        return false;
+    }
+    switch (*input) {
+    case '"':
+        /* the parser accepts only the two escapes the serializer writes */
+        return hsfv_skip_string(input, input_end, out_rest);
+    case ':':
+        return canonical_byte_seq(input, input_end, out_rest);
+    case '?':
+        *out_is_true = input + 1 < input_end && input[1] == '1';
+        return hsfv_skip_boolean(input, input_end, out_rest);
+    default:
+        if (*input == '-' || HSFV_IS_DIGIT(*input)) {
+            return canonical_number(input, input_end, out_rest);
+        }
+        return hsfv_skip_token(input, input_end, out_rest);
+    }
+}
+
+static bool canonical_parameters(const char *input, const char *input_end, const char **out_rest)
+{
+    const char *start = input;
+    size_t count = 0;
+    bool is_true;
+
+    while (input < input_end && *input == ';') {
+        ++input;
+        if (!hsfv_skip_key(input, input_end, &input)) {
+            return false;
+        }
+        ++count;
+        if (input < input_end && *input == '=') {
+            ++input;
+            if (!canonical_bare_item(input, input_end, &is_true, &input) || is_true) {
+                return false;
+            }
+        }
+    }
+    if (!canonical_keys_distinct(hsfv_keyed_next_param, start, input, count)) {
+        return false;
+    }
+    *out_rest = input;
+    return true;
+}
+
+static bool canonical_item(const char *input, const char *input_end, const char **out_rest)
+{
+    bool is_true;
+    return canonical_bare_item(input, input_end, &is_true, &input) && canonical_parameters(input, input_end, out_rest);
+}
+
+static bool canonical_inner_list(const char *input, const char *input_end, const char **out_rest)
+{
+    if (input == input_end || *input != '(') {
+        return false;
+    }
+    ++input;
+    if (input < input_end && *input != ')') {
+        for (;;) {
+            if (!canonical_item(input, input_end, &input) || input == input_end) {
+                return false;
+            }
+            if (*input == ')') {
+                break;
+            }
+            if (*input != ' ') {
+                return false;
+            }
+            ++input;
+        }
+    }
+    if (input == input_end) {
+        return false;
+    }
+    return canonical_parameters(input + 1, input_end, out_rest);
+}
+
+static bool canonical_list_member(const char *input, const char *input_end, const char **out_rest)
+{
+    if (input < input_end && *input == '(') {
+        return canonical_inner_list(input, input_end, out_rest);
+    }
+    return canonical_item(input, input_end, out_rest);
+}
+
+static bool canonical_dict_member(const char *input, const char *input_end, const char **out_rest)
+{
+    bool is_true;
+
+    if (!hsfv_skip_key(input, input_end, &input)) {
+        return false;
+    }
+    if (input < input_end && *input == '=') {
+        ++input;
+        if (input < input_end && *input == '(') {
+            return canonical_inner_list(input, input_end, out_rest);
+        }
+        if (!canonical_bare_item(input, input_end, &is_true, &input) || is_true) {
+            return false;
+        }
+    }
+    return canonical_parameters(input, input_end, out_rest);
+}
+
+static bool canonical_members(bool (*member)(const char *, const char *, const char **), const char *input, const char *input_end,
+                              size_t *out_count)
+{
+    *out_count = 0;
+    while (input < input_end) {
+        if (!member(input, input_end, &input)) {
+            return false;
+        }
+        ++*out_count;
+        if (input == input_end) {
+            break;
+        }
+        if (input_end - input < 2 || input[0] != ',' || input[1] != ' ') {
+            return false;
+        }
+        input += 2;
+        if (input == input_end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool hsfv_is_canonical(hsfv_field_value_type_t field_type, const char *input, const char *input_end)
+{
+    const char *rest;
+    size_t count;
+
+    switch (field_type) {
+    case HSFV_FIELD_VALUE_TYPE_LIST:
+        return canonical_members(canonical_list_member, input, input_end, &count);
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY:
+        return canonical_members(canonical_dict_member, input, input_end, &count) &&
+               canonical_keys_distinct(hsfv_keyed_next_dict_member, input, input_end, count);
+    case HSFV_FIELD_VALUE_TYPE_ITEM:
+        return canonical_item(input, input_end, &rest) && rest == input_end;
+    default:
+        return false;
+    }
+}
+
+hsfv_err_t hsfv_canonicalize(hsfv_field_value_type_t field_type, const char *input, const char *input_end,
+                             hsfv_allocator_t *allocator, hsfv_buffer_t *buf, const char **out, size_t *out_len)
+{
+    hsfv_arena_t arena;
+    hsfv_field_value_t field_value;
+    size_t start_len = buf->bytes.len;
+    hsfv_err_t err;
+
+    if (hsfv_is_canonical(field_type, input, input_end)) {
+        *out = input;
+        *out_len = input_end - input;
+        return HSFV_OK;
+    }
+
+    hsfv_arena_init(&arena, allocator, HSFV_ARENA_DEFAULT_CHUNK_SIZE);
+    err = hsfv_parse_field_value(&field_value, field_type, &arena.allocator, input, input_end, NULL);
+    if (err) {
+        goto exit;
+    }
+    err = hsfv_serialize_field_value(&field_value, allocator, buf);
+    if (err) {
+        buf->bytes.len = start_len;
+        goto exit;
+    }
+    *out = (const char *)buf->bytes.base + start_len;
+    *out_len = buf->bytes.len - start_len;
+
+exit:
+    hsfv_arena_deinit(&arena);
+    return err;
+}
@@ -0,0 +1,206 @@
+#include "hsfv.h"
+
+/*
+ * A clone is one block: the hsfv_field_value_t, then every member, item and
+ * parameter array, then the bytes of the keys, tokens, strings and byte
+ * sequences which are neither inline nor interned. One walk over the tree
+ * serves three purposes: sizing the two areas of the block from the source,
+ * turning a shallow copy of the source into a clone by moving everything
+ * it points to into the block, and adding the distance a clone was moved
+ * by to each of its pointers. Sizing never writes to the tree.
+ */
+typedef enum {
+    CLONE_WALK_SIZE,
+    CLONE_WALK_COPY,
+    CLONE_WALK_RELOCATE,
+} clone_walk_mode_t;
+
+typedef struct st_clone_walk_t {
+    clone_walk_mode_t mode;
+    size_t nodes_size;
+    size_t bytes_size;
+    hsfv_byte_t *nodes;
+    hsfv_byte_t *bytes;
+    uintptr_t delta;
+} clone_walk_t;
+
+static void walk_item(clone_walk_t *walk, hsfv_item_t *item);
+
+/* returns how many bytes of a key, token, string or byte sequence live outside its struct and the intern table */
+static size_t span_clone_len(const void *base, size_t len)
+{
+    return (len & HSFV_INLINE_FLAG) || base == NULL || hsfv_is_interned(base) ? 0 : len;
+}
+
+static void walk_span(clone_walk_t *walk, const void **base, size_t len)
+{
+    size_t n = span_clone_len(*base, len);
+
+    if (n == 0) {
+        return;
+    }
+    switch (walk->mode) {
+    case CLONE_WALK_SIZE:
+        walk->bytes_size += n;
+        break;
+    case CLONE_WALK_COPY:
+        memcpy(walk->bytes, *base, n);
+        *base = walk->bytes;
+        walk->bytes += n;
+        break;
+    case CLONE_WALK_RELOCATE:
+        *base = (const void *)((uintptr_t)*base + walk->delta);
+        break;
+    }
+}
+
+static void walk_array(clone_walk_t *walk, void **array, size_t *capacity, size_t len, size_t element_size)
+{
+    if (*array == NULL) {
+        return;
+    }
+    switch (walk->mode) {
+    case CLONE_WALK_SIZE:
+        walk->nodes_size += len * element_size;
+        break;
+    case CLONE_WALK_COPY:
+        memcpy(walk->nodes, *array, len * element_size);
+        *array = walk->nodes;
+        *capacity = len;
+        walk->nodes += len * element_size;
+        break;
+    case CLONE_WALK_RELOCATE:
+        *array = (void *)((uintptr_t)*array + walk->delta);
+        break;
+    }
+}
+
+static void walk_bare_item(clone_walk_t *walk, hsfv_bare_item_t *bare_item)
+{
+    switch (bare_item->type) {
+    case HSFV_BARE_ITEM_TYPE_STRING:
+        walk_span(walk, (const void **)&bare_item->string.base, bare_item->string.len);
+        break;
+    case HSFV_BARE_ITEM_TYPE_TOKEN:
+        walk_span(walk, (const void **)&bare_item->token.base, bare_item->token.len);
+        break;
+    case HSFV_BARE_ITEM_TYPE_BYTE_SEQ:
+        walk_span(walk, (const void **)&bare_item->byte_seq.base, bare_item->byte_seq.len);
+        break;
+    default:
+        break;
+    }
+}
+
+static void walk_parameters(clone_walk_t *walk, hsfv_parameters_t *parameters)
+{
+    walk_array(walk, (void **)&parameters->params, &parameters->capacity, parameters->len, sizeof(hsfv_parameter_t));
+    for (size_t i = 0; i < parameters->len; i++) {
+        hsfv_parameter_t *param = &parameters->params[i];
+        walk_span(walk, (const void **)&param->key.base, param->key.len);
+        walk_bare_item(walk, &param->value);
+    }
+}
+
+static void walk_inner_list(clone_walk_t *walk, hsfv_inner_list_t *inner_list)
+{
+    walk_array(walk, (void **)&inner_list->items, &inner_list->capacity, inner_list->len, sizeof(hsfv_item_t));
+    for (size_t i = 0; i < inner_list->len; i++) {
+        walk_item(walk, &inner_list->items[i]);
+    }
+    walk_parameters(walk, &inner_list->parameters);
+}
+
+static void walk_item(clone_walk_t *walk, hsfv_item_t *item)
+{
+    walk_bare_item(walk, &item->bare_item);
+    walk_parameters(walk, &item->parameters);
+}
+
+static void walk_field_value(clone_walk_t *walk, hsfv_field_value_t *field_value)
+{
+    switch (field_value->type) {
+    case HSFV_FIELD_VALUE_TYPE_LIST: {
+        hsfv_list_t *list = &field_value->list;
+        walk_array(walk, (void **)&list->members, &list->capacity, list->len, sizeof(hsfv_list_member_t));
+        for (size_t i = 0; i < list->len; i++) {
+            hsfv_list_member_t *member = &list->members[i];
+            if (member->type == HSFV_LIST_MEMBER_TYPE_INNER_LIST) {
+                walk_inner_list(walk, &member->inner_list);
+            } else {
+                walk_item(walk, &member->item);
+            }
+        }
+        break;
+    }
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY: {
+        hsfv_dictionary_t *dictionary = &field_value->dictionary;
+        walk_array(walk, (void **)&dictionary->members, &dictionary->capacity, dictionary->len, sizeof(hsfv_dict_member_t));
+        for (size_t i = 0; i < dictionary->len; i++) {
+            hsfv_dict_member_t *member = &dictionary->members[i];
+            walk_span(walk, (const void **)&member->key.base, member->key.len);
+            if (member->value.type == HSFV_DICT_MEMBER_TYPE_INNER_LIST) {
+                walk_inner_list(walk, &member->value.inner_list);
+            } else {
+                walk_item(walk, &member->value.item);
+            }
+        }
+        break;
+    }
+    case HSFV_FIELD_VALUE_TYPE_ITEM:
+        walk_item(walk, &field_value->item);
+        break;
+    }
+}
+
+/* every node size is a multiple of the pointer size, so the bytes area needs no padding */
+static clone_walk_t clone_measure(const hsfv_field_value_t *src)
+{
+    clone_walk_t walk = {.mode = CLONE_WALK_SIZE};
+    walk_field_value(&walk, (hsfv_field_value_t *)src);
+    return walk;
+}
+
+size_t hsfv_field_value_clone_size(const hsfv_field_value_t *src)
+{
+    clone_walk_t walk = clone_measure(src);
+    return sizeof(hsfv_field_value_t) + walk.nodes_size + walk.bytes_size;
+}
+
+static hsfv_field_value_t *clone_fill(void *block, const hsfv_field_value_t *src, clone_walk_t *walk)
+{
+    hsfv_field_value_t *clone = block;
+
+    *clone = *src;
+    walk->mode = CLONE_WALK_COPY;
+    walk->nodes = (hsfv_byte_t *)(clone + 1);
+    walk->bytes = walk->nodes + walk->nodes_size;
+    walk_field_value(walk, clone);
+    return clone;
+}
+
+hsfv_field_value_t *hsfv_field_value_clone_to(void *block, const hsfv_field_value_t *src)
+{
+    clone_walk_t walk = clone_measure(src);
+    return clone_fill(block, src, &walk);
+}
+
+hsfv_err_t hsfv_field_value_clone(const hsfv_field_value_t *src, hsfv_allocator_t *allocator, hsfv_field_value_t **out_clone)
+{
+    clone_walk_t walk = clone_measure(src);
+    void *block = allocator->alloc(allocator, sizeof(hsfv_field_value_t) + walk.nodes_size + walk.bytes_size);
+    if (block == NULL) {
+        return HSFV_ERR_OUT_OF_MEMORY;
+    }
+    *out_clone = clone_fill(block, src, &walk);
+    return HSFV_OK;
+}
+
+void hsfv_field_value_clone_relocate(hsfv_field_value_t *clone, const void *old_block)
+{
+    clone_walk_t walk = {
+        .mode = CLONE_WALK_RELOCATE,
+        .delta = (uintptr_t)clone - (uintptr_t)old_block,
+    };
+    walk_field_value(&walk, clone);
+}
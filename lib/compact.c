@@ -0,0 +1,365 @@
+#include "hsfv.h"
+
+_Static_assert(sizeof(hsfv_compact_bare_item_t) == 16, "compact bare items must be 16 bytes");
+_Static_assert(sizeof(hsfv_compact_item_t) == 24, "compact items must be 24 bytes");
+_Static_assert(sizeof(hsfv_compact_member_t) == 32, "compact members must be 32 bytes");
+
+/*
+ * A compact field value is built from a tape. The pool holds the node
+ * arrays followed by a copy of the tape's string area, so the offset of a
+ * string is its tape offset plus the size of the node arrays. The member
+ * counts in the tape give the size of every node array before any node is
+ * written, so the pool is allocated once and nodes never move. All node
+ * sizes are multiples of 8, which keeps every array aligned.
+ */
+typedef struct st_compact_builder_t {
+    hsfv_compact_t *compact;
+    uint32_t next_node;
+    uint32_t strings;
+} compact_builder_t;
+
+static size_t compact_nodes_size(const hsfv_tape_t *tape)
+{
+    const hsfv_tape_entry_t *entry;
+    size_t size = 0;
+
+    for (entry = tape->entries; entry < tape->entries + tape->len; ++entry) {
+        switch (entry->type) {
+        case HSFV_TAPE_TYPE_LIST:
+        case HSFV_TAPE_TYPE_INNER_LIST:
+            size += entry->len * sizeof(hsfv_compact_item_t);
+            break;
+        case HSFV_TAPE_TYPE_DICTIONARY:
+            size += entry->len * sizeof(hsfv_compact_member_t);
+            break;
+        case HSFV_TAPE_TYPE_PARAMETERS:
+            size += entry->len * sizeof(hsfv_compact_parameter_t);
+            break;
+        default:
+            break;
+        }
+    }
+    return size;
+}
+
+static void *compact_push_nodes(compact_builder_t *builder, uint32_t len, size_t node_size, hsfv_compact_span_t *out_span)
+{
+    void *nodes = builder->compact->pool + builder->next_node;
+
+    out_span->offset = builder->next_node;
+    out_span->len = len;
+    builder->next_node += len * node_size;
+    return nodes;
+}
+
+static hsfv_compact_span_t compact_chars(const compact_builder_t *builder, const hsfv_tape_entry_t *entry)
+{
+    return (hsfv_compact_span_t){.offset = builder->strings + (uint32_t)entry->offset, .len = entry->len};
+}
+
+static void build_bare_item(const compact_builder_t *builder, const hsfv_tape_entry_t *entry, hsfv_compact_bare_item_t *out_item)
+{
+    *out_item = (hsfv_compact_bare_item_t){0};
+    switch (entry->type) {
+    case HSFV_TAPE_TYPE_INTEGER:
+        out_item->type = HSFV_BARE_ITEM_TYPE_INTEGER;
+        out_item->integer = entry->integer;
+        break;
+    case HSFV_TAPE_TYPE_DECIMAL:
+        out_item->type = HSFV_BARE_ITEM_TYPE_DECIMAL;
+        out_item->decimal = entry->decimal;
+        break;
+    case HSFV_TAPE_TYPE_STRING:
+        out_item->type = HSFV_BARE_ITEM_TYPE_STRING;
+        out_item->bytes = compact_chars(builder, entry);
+        break;
+    case HSFV_TAPE_TYPE_TOKEN:
+        out_item->type = HSFV_BARE_ITEM_TYPE_TOKEN;
+        out_item->bytes = compact_chars(builder, entry);
+        break;
+    case HSFV_TAPE_TYPE_BYTE_SEQ:
+        out_item->type = HSFV_BARE_ITEM_TYPE_BYTE_SEQ;
+        out_item->bytes = compact_chars(builder, entry);
+        break;
+    case HSFV_TAPE_TYPE_BOOLEAN:
+        out_item->type = HSFV_BARE_ITEM_TYPE_BOOLEAN;
+        out_item->boolean = entry->boolean;
+        break;
+    }
+}
+
+static void build_parameters(compact_builder_t *builder, const hsfv_tape_entry_t *owner, hsfv_compact_span_t *out_span)
+{
+    const hsfv_tape_entry_t *params, *entry;
+    hsfv_compact_parameter_t *param;
+    uint32_t i;
+
+    params = hsfv_tape_parameters(owner);
+    if (params == NULL) {
+        *out_span = (hsfv_compact_span_t){0};
+        return;
+    }
+    param = compact_push_nodes(builder, params->len, sizeof(hsfv_compact_parameter_t), out_span);
+    for (entry = params + 1, i = 0; i < params->len; ++i, entry += 2, ++param) {
+        param->key = compact_chars(builder, entry);
+        build_bare_item(builder, &entry[1], &param->value);
+    }
+}
+
+static void build_item(compact_builder_t *builder, const hsfv_tape_entry_t *entry, hsfv_compact_item_t *out_item)
+{
+    const hsfv_tape_entry_t *item_entry;
+    hsfv_compact_item_t *items;
+    uint32_t i;
+
+    if (entry->type == HSFV_TAPE_TYPE_INNER_LIST) {
+        out_item->bare_item = (hsfv_compact_bare_item_t){.type = HSFV_COMPACT_TYPE_INNER_LIST};
+        items = compact_push_nodes(builder, entry->len, sizeof(hsfv_compact_item_t), &out_item->bare_item.bytes);
+        for (item_entry = entry + 1, i = 0; i < entry->len; ++i, item_entry = hsfv_tape_next(item_entry)) {
+            build_item(builder, item_entry, &items[i]);
+        }
+    } else {
+        build_bare_item(builder, entry, &out_item->bare_item);
+    }
+    build_parameters(builder, entry, &out_item->parameters);
+}
+
+hsfv_err_t hsfv_compact_from_tape(hsfv_compact_t *compact, const hsfv_tape_t *tape, hsfv_allocator_t *allocator)
+{
+    const hsfv_tape_entry_t *root, *entry;
+    hsfv_compact_member_t *members;
+    hsfv_compact_item_t *items;
+    compact_builder_t builder;
+    size_t nodes_size, pool_size;
+    uint32_t i;
+
+    root = hsfv_tape_root(tape);
+    if (root == NULL) {
+        return HSFV_ERR_INVALID;
+    }
+
+    nodes_size = compact_nodes_size(tape);
+    pool_size = nodes_size + tape->strings_len;
+    if (pool_size > UINT32_MAX) {
+        return HSFV_ERR_NUMBER_OUT_OF_RANGE;
+    }
+    if (pool_size > compact->pool_capacity) {
+        /* the old contents are not needed, so do not let realloc copy them */
+        hsfv_byte_t *pool = allocator->alloc(allocator, pool_size);
+        if (pool == NULL) {
+            return HSFV_ERR_OUT_OF_MEMORY;
+        }
+        hsfv_allocator_free_sized(allocator, compact->pool, compact->pool_capacity);
+        compact->pool = pool;
+        compact->pool_capacity = pool_size;
+    }
+    compact->pool_len = pool_size;
+    if (tape->strings_len) {
+        memcpy(compact->pool + nodes_size, tape->strings, tape->strings_len);
+    }
+
+    builder = (compact_builder_t){.compact = compact, .next_node = 0, .strings = nodes_size};
+    compact->members = (hsfv_compact_span_t){0};
+    compact->item = (hsfv_compact_item_t){0};
+    switch (root->type) {
+    case HSFV_TAPE_TYPE_LIST:
+        compact->type = HSFV_FIELD_VALUE_TYPE_LIST;
+        items = compact_push_nodes(&builder, root->len, sizeof(hsfv_compact_item_t), &compact->members);
+        for (entry = root + 1, i = 0; i < root->len; ++i, entry = hsfv_tape_next(entry)) {
+            build_item(&builder, entry, &items[i]);
+        }
+        break;
+    case HSFV_TAPE_TYPE_DICTIONARY:
+        compact->type = HSFV_FIELD_VALUE_TYPE_DICTIONARY;
+        members = compact_push_nodes(&builder, root->len, sizeof(hsfv_compact_member_t), &compact->members);
+        for (entry = root + 1, i = 0; i < root->len; ++i, entry = hsfv_tape_next(entry + 1)) {
+            members[i].key = compact_chars(&builder, entry);
+            build_item(&builder, &entry[1], &members[i].value);
+        }
+        break;
+    default:
+        compact->type = HSFV_FIELD_VALUE_TYPE_ITEM;
+        build_item(&builder, root, &compact->item);
+        break;
+    }
+    return HSFV_OK;
+}
+
+hsfv_err_t hsfv_parse_compact(hsfv_compact_t *compact, hsfv_field_value_type_t field_type, hsfv_allocator_t *allocator,
+                              const char *input, const char *input_end, const char **out_rest)
+{
+    hsfv_tape_t tape = (hsfv_tape_t){0};
+    hsfv_err_t err;
+
+    err = hsfv_parse_tape(&tape, field_type, allocator, input, input_end, out_rest);
+    if (err == HSFV_OK) {
+        err = hsfv_compact_from_tape(compact, &tape, allocator);
+    }
+    hsfv_tape_deinit(&tape, allocator);
+    return err;
+}
+
+void hsfv_compact_deinit(hsfv_compact_t *compact, hsfv_allocator_t *allocator)
+{
+    hsfv_allocator_free_sized(allocator, compact->pool, compact->pool_capacity);
+    *compact = (hsfv_compact_t){0};
+}
+
+/* Serialize */
+
+static hsfv_err_t serialize_compact_bare_item(const hsfv_compact_t *compact, const hsfv_compact_bare_item_t *item,
+                                              hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    switch (item->type) {
+    case HSFV_BARE_ITEM_TYPE_INTEGER:
+        return hsfv_serialize_integer(item->integer, allocator, dest);
+    case HSFV_BARE_ITEM_TYPE_DECIMAL:
+        return hsfv_serialize_decimal(item->decimal, allocator, dest);
+    case HSFV_BARE_ITEM_TYPE_STRING: {
+        hsfv_string_t string = {.base = hsfv_compact_bytes(compact, item->bytes), .len = item->bytes.len};
+        return hsfv_serialize_string(&string, allocator, dest);
+    }
+    case HSFV_BARE_ITEM_TYPE_TOKEN: {
+        hsfv_token_t token = {.base = hsfv_compact_bytes(compact, item->bytes), .len = item->bytes.len};
+        return hsfv_serialize_token(&token, allocator, dest);
+    }
+    case HSFV_BARE_ITEM_TYPE_BYTE_SEQ: {
+        hsfv_byte_seq_t byte_seq = {.base = (const hsfv_byte_t *)hsfv_compact_bytes(compact, item->bytes), .len = item->bytes.len};
+        return hsfv_serialize_byte_seq(&byte_seq, allocator, dest);
+    }
+    case HSFV_BARE_ITEM_TYPE_BOOLEAN:
+        return hsfv_serialize_boolean(item->boolean, allocator, dest);
+    default:
+        return HSFV_ERR_INVALID;
+    }
+}
+
+static hsfv_err_t serialize_compact_key(const hsfv_compact_t *compact, hsfv_compact_span_t span, hsfv_allocator_t *allocator,
+                                        hsfv_buffer_t *dest)
+{
+    hsfv_key_t key = {.base = hsfv_compact_bytes(compact, span), .len = span.len};
+    return hsfv_serialize_key(&key, allocator, dest);
+}
+
+static hsfv_err_t serialize_compact_parameters(const hsfv_compact_t *compact, hsfv_compact_span_t span, hsfv_allocator_t *allocator,
+                                               hsfv_buffer_t *dest)
+{
+    const hsfv_compact_parameter_t *params = hsfv_compact_parameters(compact, span);
+    hsfv_err_t err;
+    uint32_t i;
+
+    for (i = 0; i < span.len; ++i) {
+        err = hsfv_buffer_append_byte(dest, allocator, ';');
+        if (err) {
+            return err;
+        }
+        err = serialize_compact_key(compact, params[i].key, allocator, dest);
+        if (err) {
+            return err;
+        }
+        if (params[i].value.type == HSFV_BARE_ITEM_TYPE_BOOLEAN && params[i].value.boolean) {
+            continue;
+        }
+        err = hsfv_buffer_append_byte(dest, allocator, '=');
+        if (err) {
+            return err;
+        }
+        err = serialize_compact_bare_item(compact, &params[i].value, allocator, dest);
+        if (err) {
+            return err;
+        }
+    }
+    return HSFV_OK;
+}
+
+static hsfv_err_t serialize_compact_item(const hsfv_compact_t *compact, const hsfv_compact_item_t *item, hsfv_allocator_t *allocator,
+                                         hsfv_buffer_t *dest)
+{
+    const hsfv_compact_item_t *items;
+    hsfv_err_t err;
+    uint32_t i;
+
+    if (item->bare_item.type == HSFV_COMPACT_TYPE_INNER_LIST) {
+        err = hsfv_buffer_append_byte(dest, allocator, '(');
+        if (err) {
+            return err;
+        }
+        items = hsfv_compact_items(compact, item->bare_item.bytes);
+        for (i = 0; i < item->bare_item.bytes.len; ++i) {
+            if (i > 0) {
+                err = hsfv_buffer_append_byte(dest, allocator, ' ');
+                if (err) {
+                    return err;
+                }
+            }
+            err = serialize_compact_item(compact, &items[i], allocator, dest);
+            if (err) {
+                return err;
+            }
+        }
+        err = hsfv_buffer_append_byte(dest, allocator, ')');
+    } else {
+        err = serialize_compact_bare_item(compact, &item->bare_item, allocator, dest);
+    }
+    if (err) {
+        return err;
+    }
+    return serialize_compact_parameters(compact, item->parameters, allocator, dest);
+}
+
+hsfv_err_t hsfv_serialize_compact(const hsfv_compact_t *compact, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    const hsfv_compact_member_t *members;
+    const hsfv_compact_item_t *items;
+    hsfv_err_t err;
+    uint32_t i;
+
+    switch (compact->type) {
+    case HSFV_FIELD_VALUE_TYPE_LIST:
+        items = hsfv_compact_items(compact, compact->members);
+        for (i = 0; i < compact->members.len; ++i) {
+            if (i > 0) {
+                err = hsfv_buffer_append_bytes(dest, allocator, ", ", 2);
+                if (err) {
+                    return err;
+                }
+            }
+            err = serialize_compact_item(compact, &items[i], allocator, dest);
+            if (err) {
+                return err;
+            }
+        }
+        return HSFV_OK;
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY:
+        members = hsfv_compact_members(compact, compact->members);
+        for (i = 0; i < compact->members.len; ++i) {
+            if (i > 0) {
+                err = hsfv_buffer_append_bytes(dest, allocator, ", ", 2);
+                if (err) {
+                    return err;
+                }
+            }
+            err = serialize_compact_key(compact, members[i].key, allocator, dest);
+            if (err) {
+                return err;
+            }
+            if (members[i].value.bare_item.type == HSFV_BARE_ITEM_TYPE_BOOLEAN && members[i].value.bare_item.boolean) {
+                err = serialize_compact_parameters(compact, members[i].value.parameters, allocator, dest);
+            } else {
+                err = hsfv_buffer_append_byte(dest, allocator, '=');
+                if (err) {
+                    return err;
+                }
+                err = serialize_compact_item(compact, &members[i].value, allocator, dest);
+            }
+            if (err) {
+                return err;
+            }
+        }
+        return HSFV_OK;
+    case HSFV_FIELD_VALUE_TYPE_ITEM:
+        return serialize_compact_item(compact, &compact->item, allocator, dest);
+    default:
+        return HSFV_ERR_INVALID;
+    }
+}
@@ -1,4 +1,5 @@
 #include "hsfv.h"
+#include "stats.h"
 
 static bool hsfv_dict_member_value_eq(const hsfv_dict_member_value_t *self, const hsfv_dict_member_value_t *other)
 {
@@ -56,7 +57,7 @@ void hsfv_dictionary_deinit(hsfv_dictionary_t *self, hsfv_allocator_t *allocator
     for (size_t i = 0; i < self->len; i++) {
         hsfv_dict_member_deinit(&self->members[i], allocator);
     }
-    allocator->free(allocator, self->members);
+    hsfv_allocator_free_sized(allocator, self->members, self->capacity * sizeof(hsfv_dict_member_t));
 }
 
 #define DICT_INITIAL_CAPACITY 8
@@ -70,6 +71,7 @@ static hsfv_err_t hsfv_dictionary_append(hsfv_dictionary_t *dictionary, hsfv_all
             return HSFV_ERR_OUT_OF_MEMORY;
         }
         dictionary->members = members2;
+        HSFV_STATS_INC(reallocs);
         dictionary->capacity = new_capacity;
     }
     dictionary->members[dictionary->len] = *member;
@@ -87,10 +89,101 @@ size_t hsfv_dictionary_index_of(const hsfv_dictionary_t *dictionary, const hsfv_
     return -1;
 }
 
+/* gives dest its own copy of the members array of src with room for extra members */
+static hsfv_err_t dictionary_edit_copy(hsfv_dictionary_t *dest, const hsfv_dictionary_t *src, size_t extra,
+                                       hsfv_allocator_t *allocator)
+{
+    hsfv_dict_member_t *members = NULL;
+    size_t capacity = src->len + extra;
+
+    if (capacity > 0) {
+        members = allocator->alloc(allocator, capacity * sizeof(hsfv_dict_member_t));
+        if (members == NULL) {
+            return HSFV_ERR_OUT_OF_MEMORY;
+        }
+        if (src->len != 0) {
+            memcpy(members, src->members, src->len * sizeof(hsfv_dict_member_t));
+        }
+    }
+    *dest = (hsfv_dictionary_t){.members = members, .len = src->len, .capacity = capacity};
+    return HSFV_OK;
+}
+
+hsfv_err_t hsfv_dictionary_set(hsfv_dictionary_t *dest, const hsfv_dictionary_t *src, const char *key, size_t key_len,
+                               const hsfv_dict_member_value_t *value, hsfv_allocator_t *allocator)
+{
+    hsfv_dict_member_t member = {.key = hsfv_key_ref(key, key_len), .value = *value};
+    size_t i = hsfv_dictionary_index_of(src, &member.key);
+    hsfv_err_t err;
+
+    if (dest != src) {
+        err = dictionary_edit_copy(dest, src, i == -1 ? 1 : 0, allocator);
+        if (err) {
+            return err;
+        }
+    }
+    if (i == -1) {
+        return hsfv_dictionary_append(dest, allocator, &member);
+    }
+    dest->members[i].value = *value;
+    return HSFV_OK;
+}
+
+hsfv_err_t hsfv_dictionary_remove(hsfv_dictionary_t *dest, const hsfv_dictionary_t *src, const char *key, size_t key_len,
+                                  hsfv_allocator_t *allocator)
+{
+    hsfv_key_t k = hsfv_key_ref(key, key_len);
+    size_t i = hsfv_dictionary_index_of(src, &k);
+    hsfv_err_t err;
+
+    if (i == -1) {
+        return HSFV_ERR_EOF;
+    }
+    if (dest != src) {
+        err = dictionary_edit_copy(dest, src, 0, allocator);
+        if (err) {
+            return err;
+        }
+    }
+    memmove(&dest->members[i], &dest->members[i + 1], (dest->len - i - 1) * sizeof(hsfv_dict_member_t));
+    dest->len--;
+    return HSFV_OK;
+}
+
+void hsfv_dictionary_edit_deinit(hsfv_dictionary_t *edited, hsfv_allocator_t *allocator)
+{
+    hsfv_allocator_free_sized(allocator, edited->members, edited->capacity * sizeof(hsfv_dict_member_t));
+}
+
+static hsfv_err_t serialize_dict_member(const hsfv_dict_member_t *member, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    hsfv_err_t err;
+
+    err = hsfv_serialize_key(&member->key, allocator, dest);
+    if (err) {
+        return err;
+    }
+    if (member->value.type == HSFV_DICT_MEMBER_TYPE_ITEM && member->value.item.bare_item.type == HSFV_BARE_ITEM_TYPE_BOOLEAN &&
+        member->value.item.bare_item.boolean) {
+        return hsfv_serialize_parameters(&member->value.item.parameters, allocator, dest);
+    }
+
+    err = hsfv_buffer_append_byte(dest, allocator, '=');
+    if (err) {
+        return err;
+    }
+    switch (member->value.type) {
+    case HSFV_DICT_MEMBER_TYPE_ITEM:
+        return hsfv_serialize_item(&member->value.item, allocator, dest);
+    case HSFV_DICT_MEMBER_TYPE_INNER_LIST:
+        return hsfv_serialize_inner_list(&member->value.inner_list, allocator, dest);
+    }
+    return HSFV_OK;
+}
+
 hsfv_err_t hsfv_serialize_dictionary(const hsfv_dictionary_t *dictionary, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
 {
     hsfv_err_t err;
-    const hsfv_dict_member_t *member;
 
     for (size_t i = 0; i < dictionary->len; ++i) {
         if (i > 0) {
@@ -100,43 +193,181 @@ hsfv_err_t hsfv_serialize_dictionary(const hsfv_dictionary_t *dictionary, hsfv_a
             }
         }
 
-        member = &dictionary->members[i];
-        err = hsfv_serialize_key(&member->key, allocator, dest);
+        err = serialize_dict_member(&dictionary->members[i], allocator, dest);
         if (err) {
             return err;
         }
-        if (member->value.type == HSFV_DICT_MEMBER_TYPE_ITEM && member->value.item.bare_item.type == HSFV_BARE_ITEM_TYPE_BOOLEAN &&
-            member->value.item.bare_item.boolean) {
-            err = hsfv_serialize_parameters(&member->value.item.parameters, allocator, dest);
-            if (err) {
-                return err;
-            }
-        } else {
-            err = hsfv_buffer_append_byte(dest, allocator, '=');
-            if (err) {
-                return err;
-            }
+    }
 
-            switch (member->value.type) {
-            case HSFV_DICT_MEMBER_TYPE_ITEM:
-                err = hsfv_serialize_item(&member->value.item, allocator, dest);
-                if (err) {
-                    return err;
-                }
-                break;
-            case HSFV_DICT_MEMBER_TYPE_INNER_LIST:
-                err = hsfv_serialize_inner_list(&member->value.inner_list, allocator, dest);
-                if (err) {
-                    return err;
-                }
-                break;
-            }
+    return HSFV_OK;
+}
+
+/* tables of up to this many slots, for dictionaries of up to half as many members, live on the stack */
+#define DICTIONARY_DIFF_INLINE_SLOTS 64
+
+/* set in a slot of the key table once a member of b has been matched to the member of a it holds */
+#define DICTIONARY_DIFF_MATCHED ((size_t)1 << (sizeof(size_t) * 8 - 1))
+
+/*
+ * an open addressing table of the members of a, keyed by their keys. A
+ * slot holds the index of the member plus one, or 0 when it is empty.
+ */
+typedef struct st_dictionary_key_table_t {
+    size_t *slots;
+    size_t mask;
+    size_t inline_slots[DICTIONARY_DIFF_INLINE_SLOTS];
+} dictionary_key_table_t;
+
+static size_t dictionary_key_hash(const hsfv_key_t *key)
+{
+    const char *base = hsfv_key_base(key);
+    size_t len = hsfv_key_len(key);
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)base[i]) * 0x100000001b3ULL;
+    }
+    return (size_t)(h ^ (h >> 32));
+}
+
+static hsfv_err_t dictionary_key_table_init(dictionary_key_table_t *table, const hsfv_dictionary_t *dictionary,
+                                            hsfv_allocator_t *allocator)
+{
+    size_t capacity = 16;
+
+    while (capacity < dictionary->len * 2) {
+        capacity *= 2;
+    }
+    if (capacity <= DICTIONARY_DIFF_INLINE_SLOTS) {
+        table->slots = table->inline_slots;
+    } else {
+        table->slots = allocator->alloc(allocator, capacity * sizeof(size_t));
+        if (table->slots == NULL) {
+            return HSFV_ERR_OUT_OF_MEMORY;
+        }
+    }
+    table->mask = capacity - 1;
+    memset(table->slots, 0, capacity * sizeof(size_t));
+
+    for (size_t i = 0; i < dictionary->len; i++) {
+        size_t slot = dictionary_key_hash(&dictionary->members[i].key) & table->mask;
+        while (table->slots[slot] != 0) {
+            slot = (slot + 1) & table->mask;
+        }
+        table->slots[slot] = i + 1;
+    }
+    return HSFV_OK;
+}
+
+static void dictionary_key_table_deinit(dictionary_key_table_t *table, hsfv_allocator_t *allocator)
+{
+    if (table->slots != table->inline_slots) {
+        hsfv_allocator_free_sized(allocator, table->slots, (table->mask + 1) * sizeof(size_t));
+    }
+}
+
+/* returns the slot holding the first member of dictionary with key, or NULL */
+static size_t *dictionary_key_table_find(dictionary_key_table_t *table, const hsfv_dictionary_t *dictionary, const hsfv_key_t *key)
+{
+    size_t slot = dictionary_key_hash(key) & table->mask;
+
+    for (; table->slots[slot] != 0; slot = (slot + 1) & table->mask) {
+        size_t i = (table->slots[slot] & ~DICTIONARY_DIFF_MATCHED) - 1;
+        if (hsfv_key_eq(&dictionary->members[i].key, key)) {
+            return &table->slots[slot];
+        }
+    }
+    return NULL;
+}
+
+static void dictionary_diff_add(hsfv_dictionary_diff_t *diff, hsfv_dict_change_type_t type, size_t a_index, size_t b_index)
+{
+    diff->changes[diff->len++] = (hsfv_dict_change_t){.type = type, .a_index = a_index, .b_index = b_index};
+}
+
+hsfv_err_t hsfv_dictionary_diff(const hsfv_dictionary_t *a, const hsfv_dictionary_t *b, hsfv_allocator_t *allocator,
+                                hsfv_dictionary_diff_t *diff)
+{
+    dictionary_key_table_t table;
+    size_t capacity = a->len + b->len, *slot;
+    hsfv_err_t err;
+
+    *diff = (hsfv_dictionary_diff_t){0};
+    if (capacity == 0) {
+        return HSFV_OK;
+    }
+    diff->changes = allocator->alloc(allocator, capacity * sizeof(hsfv_dict_change_t));
+    if (diff->changes == NULL) {
+        return HSFV_ERR_OUT_OF_MEMORY;
+    }
+    diff->capacity = capacity;
+    err = dictionary_key_table_init(&table, a, allocator);
+    if (err) {
+        hsfv_dictionary_diff_deinit(diff, allocator);
+        return err;
+    }
+
+    for (size_t j = 0; j < b->len; j++) {
+        slot = dictionary_key_table_find(&table, a, &b->members[j].key);
+        if (slot == NULL || (*slot & DICTIONARY_DIFF_MATCHED)) {
+            dictionary_diff_add(diff, HSFV_DICT_CHANGE_ADDED, HSFV_DICT_DIFF_NONE, j);
+            continue;
+        }
+        size_t i = *slot - 1;
+        *slot |= DICTIONARY_DIFF_MATCHED;
+        if (!hsfv_dict_member_value_eq(&a->members[i].value, &b->members[j].value)) {
+            dictionary_diff_add(diff, HSFV_DICT_CHANGE_CHANGED, i, j);
+        }
+    }
+    for (size_t i = 0; i < a->len; i++) {
+        /* a later member with the key of an earlier one, which only a hand-built dictionary has, is never matched */
+        slot = dictionary_key_table_find(&table, a, &a->members[i].key);
+        if (!(*slot & DICTIONARY_DIFF_MATCHED) || (*slot & ~DICTIONARY_DIFF_MATCHED) - 1 != i) {
+            dictionary_diff_add(diff, HSFV_DICT_CHANGE_REMOVED, i, HSFV_DICT_DIFF_NONE);
         }
     }
 
+    dictionary_key_table_deinit(&table, allocator);
     return HSFV_OK;
 }
 
+void hsfv_dictionary_diff_deinit(hsfv_dictionary_diff_t *diff, hsfv_allocator_t *allocator)
+{
+    hsfv_allocator_free_sized(allocator, diff->changes, diff->capacity * sizeof(hsfv_dict_change_t));
+}
+
+static hsfv_err_t serialize_dict_diff_separator(hsfv_buffer_t *dest, size_t start_len, hsfv_allocator_t *allocator)
+{
+    return dest->bytes.len > start_len ? hsfv_buffer_append_bytes(dest, allocator, ", ", 2) : HSFV_OK;
+}
+
+hsfv_err_t hsfv_serialize_dictionary_diff(const hsfv_dictionary_diff_t *diff, const hsfv_dictionary_t *a, const hsfv_dictionary_t *b,
+                                          hsfv_allocator_t *allocator, hsfv_buffer_t *upserts, hsfv_buffer_t *removals)
+{
+    size_t upserts_start = upserts->bytes.len, removals_start = removals->bytes.len;
+    hsfv_err_t err = HSFV_OK;
+
+    for (size_t i = 0; i < diff->len && !err; i++) {
+        const hsfv_dict_change_t *change = &diff->changes[i];
+        if (change->type == HSFV_DICT_CHANGE_REMOVED) {
+            err = serialize_dict_diff_separator(removals, removals_start, allocator);
+            if (!err) {
+                err = hsfv_serialize_key(&a->members[change->a_index].key, allocator, removals);
+            }
+        } else {
+            err = serialize_dict_diff_separator(upserts, upserts_start, allocator);
+            if (!err) {
+                err = serialize_dict_member(&b->members[change->b_index], allocator, upserts);
+            }
+        }
+    }
+    if (err) {
+        upserts->bytes.len = upserts_start;
+        removals->bytes.len = removals_start;
+    }
+    return err;
+}
+
 hsfv_err_t hsfv_parse_dictionary(hsfv_dictionary_t *dictionary, hsfv_allocator_t *allocator, const char *input,
                                  const char *input_end, const char **out_rest)
 {
@@ -184,6 +415,7 @@ hsfv_err_t hsfv_parse_dictionary(hsfv_dictionary_t *dictionary, hsfv_allocator_t
                 goto error1;
             }
         } else {
+            HSFV_STATS_INC(dictionary_duplicate_keys);
             hsfv_dict_member_deinit(&dictionary->members[i], allocator);
             dictionary->members[i] = member;
         }
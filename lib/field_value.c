@@ -1,4 +1,5 @@
 #include "hsfv.h"
+#include "stats.h"
 #include <limits.h>
 
 bool hsfv_field_value_eq(const hsfv_field_value_t *self, const hsfv_field_value_t *other)
@@ -47,6 +48,7 @@ bool hsfv_field_value_is_empty(const hsfv_field_value_t *self)
 
 hsfv_err_t hsfv_serialize_field_value(const hsfv_field_value_t *field_value, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
 {
+    HSFV_STATS_INC(serialized_field_values);
     switch (field_value->type) {
     case HSFV_FIELD_VALUE_TYPE_LIST:
         return hsfv_serialize_list(&field_value->list, allocator, dest);
@@ -59,17 +61,12 @@ hsfv_err_t hsfv_serialize_field_value(const hsfv_field_value_t *field_value, hsf
     }
 }
 
-hsfv_err_t hsfv_parse_field_value(hsfv_field_value_t *field_value, hsfv_field_value_type_t field_type, hsfv_allocator_t *allocator,
-                                  const char *input, const char *input_end, const char **out_rest)
+static hsfv_err_t parse_ascii_field_value(hsfv_field_value_t *field_value, hsfv_field_value_type_t field_type,
+                                          hsfv_allocator_t *allocator, const char *input, const char *input_end,
+                                          const char **out_rest)
 {
-    _Static_assert(CHAR_BIT == 8, "non-8bit character is not supported");
-
     hsfv_err_t err;
 
-    if (!hsfv_is_ascii_string(input, input_end)) {
-        return HSFV_ERR_INVALID;
-    }
-
     hsfv_skip_sp(input, input_end, &input);
     switch (field_type) {
     case HSFV_FIELD_VALUE_TYPE_LIST:
@@ -105,9 +102,192 @@ hsfv_err_t hsfv_parse_field_value(hsfv_field_value_t *field_value, hsfv_field_va
     if (out_rest) {
         *out_rest = input;
     }
+    HSFV_STATS_INC(parsed_field_values);
     return HSFV_OK;
 
 error:
     hsfv_field_value_deinit(field_value, allocator);
     return err;
 }
+
+hsfv_err_t hsfv_parse_field_value(hsfv_field_value_t *field_value, hsfv_field_value_type_t field_type, hsfv_allocator_t *allocator,
+                                  const char *input, const char *input_end, const char **out_rest)
+{
+    _Static_assert(CHAR_BIT == 8, "non-8bit character is not supported");
+
+    hsfv_err_t err;
+
+    if (!hsfv_is_ascii_string(input, input_end)) {
+        err = HSFV_ERR_INVALID;
+    } else {
+        err = parse_ascii_field_value(field_value, field_type, allocator, input, input_end, out_rest);
+    }
+    if (err) {
+        HSFV_STATS_INC_PARSE_ERROR(err);
+    }
+    return err;
+}
+
+size_t hsfv_parse_batch(hsfv_batch_entry_t *entries, size_t n, hsfv_arena_t *arena)
+{
+    hsfv_allocator_t *allocator = &arena->allocator;
+    hsfv_batch_entry_t *entry;
+    size_t failed = 0;
+
+    for (entry = entries; entry < entries + n; ++entry) {
+        entry->err = hsfv_parse_field_value(&entry->field_value, entry->type, allocator, entry->input, entry->input_end, NULL);
+        if (entry->err) {
+            entry->field_value = (hsfv_field_value_t){.type = entry->type};
+            failed++;
+        }
+    }
+    return failed;
+}
+
+void hsfv_field_value_clear(hsfv_field_value_t *field_value, hsfv_allocator_t *allocator)
+{
+    hsfv_field_value_type_t type = field_value->type;
+
+    hsfv_field_value_deinit(field_value, allocator);
+    *field_value = (hsfv_field_value_t){.type = type};
+}
+
+/*
+ * Every block handed out by a parse target starts with this header. Block
+ * capacities are rounded up to a power of two, and freed blocks are kept in
+ * one spare list per capacity instead of going back to the backing
+ * allocator. An allocation takes a block from the first non-empty list
+ * whose blocks are large enough, so it looks at a bounded number of list
+ * heads however many blocks a large value left behind. Blocks larger than
+ * the largest class are not kept.
+ */
+struct st_hsfv_spare_block_t {
+    hsfv_spare_block_t *next;
+    size_t capacity;
+};
+
+#define SPARE_BLOCK_HEADER_SIZE hsfv_align(sizeof(hsfv_spare_block_t), 16)
+#define SPARE_MIN_CAPACITY ((size_t)16)
+
+static hsfv_spare_block_t *spare_block_of(void *ptr)
+{
+    return (hsfv_spare_block_t *)((hsfv_byte_t *)ptr - SPARE_BLOCK_HEADER_SIZE);
+}
+
+/* returns the smallest class whose blocks hold size bytes, or HSFV_PARSE_TARGET_SIZE_CLASSES if none does */
+static size_t spare_class_of(size_t size)
+{
+    size_t c;
+
+    for (c = 0; c < HSFV_PARSE_TARGET_SIZE_CLASSES && (SPARE_MIN_CAPACITY << c) < size; c++) {
+    }
+    return c;
+}
+
+static void *target_alloc(hsfv_allocator_t *self, size_t size)
+{
+    hsfv_parse_target_t *target = (hsfv_parse_target_t *)self;
+    hsfv_spare_block_t *block;
+    size_t c = spare_class_of(size), capacity;
+
+    for (; c < HSFV_PARSE_TARGET_SIZE_CLASSES; c++) {
+        if ((block = target->spare[c]) != NULL) {
+            target->spare[c] = block->next;
+            return (hsfv_byte_t *)block + SPARE_BLOCK_HEADER_SIZE;
+        }
+    }
+
+    c = spare_class_of(size);
+    capacity = c < HSFV_PARSE_TARGET_SIZE_CLASSES ? SPARE_MIN_CAPACITY << c : size;
+    block = target->backing->alloc(target->backing, SPARE_BLOCK_HEADER_SIZE + capacity);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->capacity = capacity;
+    return (hsfv_byte_t *)block + SPARE_BLOCK_HEADER_SIZE;
+}
+
+static void target_free(hsfv_allocator_t *self, void *ptr)
+{
+    hsfv_parse_target_t *target = (hsfv_parse_target_t *)self;
+    hsfv_spare_block_t *block;
+    size_t c;
+
+    if (ptr == NULL) {
+        return;
+    }
+    block = spare_block_of(ptr);
+    c = spare_class_of(block->capacity);
+    if (c == HSFV_PARSE_TARGET_SIZE_CLASSES) {
+        hsfv_allocator_free_sized(target->backing, block, SPARE_BLOCK_HEADER_SIZE + block->capacity);
+        return;
+    }
+    block->next = target->spare[c];
+    target->spare[c] = block;
+}
+
+static bool target_try_expand_in_place(hsfv_allocator_t *self, void *ptr, size_t size)
+{
+    return spare_block_of(ptr)->capacity >= size;
+}
+
+static void *target_realloc(hsfv_allocator_t *self, void *ptr, size_t size)
+{
+    void *ptr2;
+
+    if (ptr == NULL) {
+        return target_alloc(self, size);
+    }
+    if (target_try_expand_in_place(self, ptr, size)) {
+        return ptr;
+    }
+    ptr2 = target_alloc(self, size);
+    if (ptr2 == NULL) {
+        return NULL;
+    }
+    memcpy(ptr2, ptr, spare_block_of(ptr)->capacity);
+    target_free(self, ptr);
+    return ptr2;
+}
+
+void hsfv_parse_target_init(hsfv_parse_target_t *target, hsfv_allocator_t *backing)
+{
+    *target = (hsfv_parse_target_t){
+        .allocator =
+            {
+                .alloc = target_alloc,
+                .realloc = target_realloc,
+                .free = target_free,
+                .try_expand_in_place = target_try_expand_in_place,
+            },
+        .backing = backing,
+    };
+}
+
+void hsfv_parse_target_deinit(hsfv_parse_target_t *target)
+{
+    hsfv_spare_block_t *block, *next;
+
+    hsfv_field_value_deinit(&target->field_value, &target->allocator);
+    for (size_t c = 0; c < HSFV_PARSE_TARGET_SIZE_CLASSES; c++) {
+        for (block = target->spare[c]; block; block = next) {
+            next = block->next;
+            hsfv_allocator_free_sized(target->backing, block, SPARE_BLOCK_HEADER_SIZE + block->capacity);
+        }
+        target->spare[c] = NULL;
+    }
+    target->field_value = (hsfv_field_value_t){0};
+}
+
+hsfv_err_t hsfv_parse_field_value_into(hsfv_parse_target_t *target, hsfv_field_value_type_t field_type, const char *input,
+                                       const char *input_end, const char **out_rest)
+{
+    hsfv_err_t err;
+
+    hsfv_field_value_clear(&target->field_value, &target->allocator);
+    err = hsfv_parse_field_value(&target->field_value, field_type, &target->allocator, input, input_end, out_rest);
+    if (err) {
+        target->field_value = (hsfv_field_value_t){.type = field_type};
+    }
+    return err;
+}
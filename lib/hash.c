@@ -0,0 +1,432 @@
+#include "hsfv.h"
+#include "keyed.h"
+
+#include <math.h>
+
+/*
+ * Both hashes feed one hasher the same stream: a tag byte for each value,
+ * then its content as the parsed tree holds it, that is an unescaped string,
+ * a decoded byte sequence or a decimal rounded to three digits, with the
+ * length of variable length content written before it. The raw hash reads
+ * those values straight from the input with the skip functions, so inputs
+ * which parse to the same value, and so serialize the same, hash the same.
+ */
+
+/* base64 characters decoded at a time, a multiple of 4 */
+#define HASH_DECODE_CHUNK 64
+
+enum {
+    HASH_TAG_INTEGER = 1,
+    HASH_TAG_DECIMAL,
+    HASH_TAG_STRING,
+    HASH_TAG_TOKEN,
+    HASH_TAG_BYTE_SEQ,
+    HASH_TAG_BOOLEAN,
+    HASH_TAG_PARAMETER,
+    HASH_TAG_INNER_LIST,
+    HASH_TAG_INNER_LIST_END,
+    HASH_TAG_MEMBER,
+};
+
+static const uint64_t hash_m = 0xff51afd7ed558ccdULL;
+
+typedef struct st_hash_state_t {
+    uint64_t h;
+    uint64_t word;
+    size_t word_len;
+} hash_state_t;
+
+static void hash_init(hash_state_t *s, uint64_t seed, hsfv_field_value_type_t field_type)
+{
+    s->h = ((0x9e3779b97f4a7c15ULL ^ seed) * hash_m) ^ (uint64_t)field_type;
+    s->word = 0;
+    s->word_len = 0;
+}
+
+static void hash_mix(hash_state_t *s, uint64_t w)
+{
+    s->h = (s->h ^ w) * hash_m;
+    s->h ^= s->h >> 32;
+}
+
+static void hash_byte(hash_state_t *s, hsfv_byte_t b)
+{
+    s->word |= (uint64_t)b << (8 * s->word_len);
+    if (++s->word_len == 8) {
+        hash_mix(s, s->word);
+        s->word = 0;
+        s->word_len = 0;
+    }
+}
+
+/* words are assembled little endian so that how the stream is split into calls does not matter on any host */
+static void hash_bytes(hash_state_t *s, const void *bytes, size_t len)
+{
+    const hsfv_byte_t *p = bytes;
+
+    for (; len > 0 && s->word_len != 0; p++, len--) {
+        hash_byte(s, *p);
+    }
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t w = 0;
+        for (int i = 7; i >= 0; i--) {
+            w = (w << 8) | p[i];
+        }
+        hash_mix(s, w);
+    }
+    for (; len > 0; p++, len--) {
+        hash_byte(s, *p);
+    }
+}
+
+static void hash_u64(hash_state_t *s, uint64_t v)
+{
+    for (int i = 0; i < 8; i++) {
+        hash_byte(s, (hsfv_byte_t)(v >> (8 * i)));
+    }
+}
+
+static void hash_span(hash_state_t *s, hsfv_byte_t tag, const void *base, size_t len)
+{
+    hash_byte(s, tag);
+    hash_u64(s, len);
+    hash_bytes(s, base, len);
+}
+
+static uint64_t hash_final(hash_state_t *s)
+{
+    uint64_t h;
+
+    hash_mix(s, s->word ^ ((uint64_t)s->word_len << 56));
+    h = s->h;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static void hash_bare_item(hash_state_t *s, const hsfv_bare_item_t *item)
+{
+    double rounded;
+
+    switch (item->type) {
+    case HSFV_BARE_ITEM_TYPE_INTEGER:
+        hash_byte(s, HASH_TAG_INTEGER);
+        hash_u64(s, (uint64_t)item->integer);
+        break;
+    case HSFV_BARE_ITEM_TYPE_DECIMAL:
+        /* rounded as hsfv_serialize_decimal rounds; out of range values, which do not serialize, all hash alike */
+        rounded = rint(item->decimal * 1000);
+        hash_byte(s, HASH_TAG_DECIMAL);
+        hash_u64(s, fabs(rounded) < 1e18 ? (uint64_t)(int64_t)rounded : 0);
+        break;
+    case HSFV_BARE_ITEM_TYPE_STRING:
+        hash_span(s, HASH_TAG_STRING, hsfv_string_base(&item->string), hsfv_string_len(&item->string));
+        break;
+    case HSFV_BARE_ITEM_TYPE_TOKEN:
+        hash_span(s, HASH_TAG_TOKEN, hsfv_token_base(&item->token), hsfv_token_len(&item->token));
+        break;
+    case HSFV_BARE_ITEM_TYPE_BYTE_SEQ:
+        hash_span(s, HASH_TAG_BYTE_SEQ, hsfv_byte_seq_base(&item->byte_seq), hsfv_byte_seq_len(&item->byte_seq));
+        break;
+    case HSFV_BARE_ITEM_TYPE_BOOLEAN:
+        hash_byte(s, HASH_TAG_BOOLEAN);
+        hash_byte(s, item->boolean ? 1 : 0);
+        break;
+    }
+}
+
+static void hash_parameters(hash_state_t *s, const hsfv_parameters_t *parameters)
+{
+    for (size_t i = 0; i < parameters->len; i++) {
+        const hsfv_parameter_t *param = &parameters->params[i];
+        hash_span(s, HASH_TAG_PARAMETER, hsfv_key_base(&param->key), hsfv_key_len(&param->key));
+        hash_bare_item(s, &param->value);
+    }
+}
+
+static void hash_item(hash_state_t *s, const hsfv_item_t *item)
+{
+    hash_bare_item(s, &item->bare_item);
+    hash_parameters(s, &item->parameters);
+}
+
+static void hash_inner_list(hash_state_t *s, const hsfv_inner_list_t *inner_list)
+{
+    hash_byte(s, HASH_TAG_INNER_LIST);
+    for (size_t i = 0; i < inner_list->len; i++) {
+        hash_item(s, &inner_list->items[i]);
+    }
+    hash_byte(s, HASH_TAG_INNER_LIST_END);
+    hash_parameters(s, &inner_list->parameters);
+}
+
+uint64_t hsfv_field_value_hash(const hsfv_field_value_t *field_value, uint64_t seed)
+{
+    hash_state_t s;
+
+    hash_init(&s, seed, field_value->type);
+    switch (field_value->type) {
+    case HSFV_FIELD_VALUE_TYPE_LIST:
+        for (size_t i = 0; i < field_value->list.len; i++) {
+            const hsfv_list_member_t *member = &field_value->list.members[i];
+            hash_byte(&s, HASH_TAG_MEMBER);
+            if (member->type == HSFV_LIST_MEMBER_TYPE_INNER_LIST) {
+                hash_inner_list(&s, &member->inner_list);
+            } else {
+                hash_item(&s, &member->item);
+            }
+        }
+        break;
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY:
+        for (size_t i = 0; i < field_value->dictionary.len; i++) {
+            const hsfv_dict_member_t *member = &field_value->dictionary.members[i];
+            hash_span(&s, HASH_TAG_MEMBER, hsfv_key_base(&member->key), hsfv_key_len(&member->key));
+            if (member->value.type == HSFV_DICT_MEMBER_TYPE_INNER_LIST) {
+                hash_inner_list(&s, &member->value.inner_list);
+            } else {
+                hash_item(&s, &member->value.item);
+            }
+        }
+        break;
+    case HSFV_FIELD_VALUE_TYPE_ITEM:
+        hash_item(&s, &field_value->item);
+        break;
+    }
+    return hash_final(&s);
+}
+
+typedef bool (*hash_value_t)(hash_state_t *s, const char *value, const char *value_end);
+
+static bool raw_hash_string(hash_state_t *s, const char *input, const char *input_end, const char **out_rest)
+{
+    const char *end, *last, *run, *p;
+    size_t len;
+
+    if (!hsfv_skip_string(input, input_end, &end)) {
+        return false;
+    }
+    last = end - 1;
+    len = last - (input + 1);
+    for (p = input + 1; p < last; p++) {
+        if (*p == '\\') {
+            len--;
+            p++;
+        }
+    }
+
+    hash_byte(s, HASH_TAG_STRING);
+    hash_u64(s, len);
+    for (run = p = input + 1; p < last; p++) {
+        if (*p == '\\') {
+            hash_bytes(s, run, p - run);
+            /* the escaped character starts the next run and the loop steps over it */
+            run = ++p;
+        }
+    }
+    hash_bytes(s, run, last - run);
+    *out_rest = end;
+    return true;
+}
+
+static bool raw_hash_byte_seq(hash_state_t *s, const char *input, const char *input_end, const char **out_rest)
+{
+    hsfv_byte_t decoded_bytes[HASH_DECODE_CHUNK / 4 * 3];
+    const char *end, *padding;
+    size_t encoded_len;
+
+    if (!hsfv_skip_byte_seq(input, input_end, &end)) {
+        return false;
+    }
+    hsfv_iovec_const_t encoded = {.base = (const hsfv_byte_t *)input + 1, .len = end - input - 2};
+    padding = memchr(encoded.base, '=', encoded.len);
+    encoded_len = padding ? (size_t)((const hsfv_byte_t *)padding - encoded.base) : encoded.len;
+
+    hash_byte(s, HASH_TAG_BYTE_SEQ);
+    hash_u64(s, encoded_len * 3 / 4);
+    while (encoded_len > 0) {
+        hsfv_iovec_const_t chunk = {.base = encoded.base, .len = hsfv_min(encoded_len, HASH_DECODE_CHUNK)};
+        hsfv_iovec_t decoded = {.base = decoded_bytes, .len = sizeof(decoded_bytes)};
+        if (hsfv_decode_base64(&decoded, &chunk)) {
+            return false;
+        }
+        hash_bytes(s, decoded.base, decoded.len);
+        encoded.base += chunk.len;
+        encoded_len -= chunk.len;
+    }
+    *out_rest = end;
+    return true;
+}
+
+static bool raw_hash_bare_item(hash_state_t *s, const char *input, const char *input_end, const char **out_rest)
+{
+    hsfv_bare_item_t item;
+
+    if (input == input_end) {
+        return false;
+    }
+    switch (*input) {
+    case '"':
+        return raw_hash_string(s, input, input_end, out_rest);
+    case ':':
+        return raw_hash_byte_seq(s, input, input_end, out_rest);
+    case '?':
+        if (!hsfv_skip_boolean(input, input_end, out_rest)) {
+            return false;
+        }
+        item.type = HSFV_BARE_ITEM_TYPE_BOOLEAN;
+        item.boolean = input[1] == '1';
+        break;
+    default:
+        if (*input == '-' || HSFV_IS_DIGIT(*input)) {
+            if (hsfv_parse_number(&item, input, input_end, out_rest)) {
+                return false;
+            }
+        } else {
+            if (!hsfv_skip_token(input, input_end, out_rest)) {
+                return false;
+            }
+            item.type = HSFV_BARE_ITEM_TYPE_TOKEN;
+            item.token.base = input;
+            item.token.len = *out_rest - input;
+        }
+        break;
+    }
+    hash_bare_item(s, &item);
+    return true;
+}
+
+static void hash_true(hash_state_t *s)
+{
+    hsfv_bare_item_t item = {.type = HSFV_BARE_ITEM_TYPE_BOOLEAN, .boolean = true};
+    hash_bare_item(s, &item);
+}
+
+/*
+ * hashes the members of a dictionary or parameter list in the order a
+ * parser would keep them: each key at its first position with the value of
+ * its last occurrence.
+ */
+static bool raw_hash_keyed(hash_state_t *s, hsfv_byte_t tag, hsfv_keyed_next_t next, hash_value_t value, const char *input,
+                           const char *input_end)
+{
+    hsfv_keyed_iter_t iter;
+    hsfv_keyed_member_t member;
+
+    if (!hsfv_keyed_iter_init(&iter, next, input, input_end)) {
+        return false;
+    }
+    while (hsfv_keyed_iter_next(&iter, &member)) {
+        hash_span(s, tag, member.key, member.key_len);
+        if (!value(s, member.value, member.value_end)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool raw_hash_param_value(hash_state_t *s, const char *value, const char *value_end)
+{
+    if (value == value_end) {
+        hash_true(s);
+        return true;
+    }
+    return raw_hash_bare_item(s, value + 1, value_end, &value);
+}
+
+static bool raw_hash_parameters(hash_state_t *s, const char *input, const char *input_end, const char **out_rest)
+{
+    if (!hsfv_skip_parameters(input, input_end, out_rest)) {
+        return false;
+    }
+    return raw_hash_keyed(s, HASH_TAG_PARAMETER, hsfv_keyed_next_param, raw_hash_param_value, input, *out_rest);
+}
+
+static bool raw_hash_item(hash_state_t *s, const char *input, const char *input_end, const char **out_rest)
+{
+    return raw_hash_bare_item(s, input, input_end, &input) && raw_hash_parameters(s, input, input_end, out_rest);
+}
+
+static bool raw_hash_inner_list(hash_state_t *s, const char *input, const char *input_end, const char **out_rest)
+{
+    if (input == input_end || *input != '(') {
+        return false;
+    }
+    ++input;
+    hash_byte(s, HASH_TAG_INNER_LIST);
+    for (;;) {
+        hsfv_skip_sp(input, input_end, &input);
+        if (input == input_end) {
+            return false;
+        }
+        if (*input == ')') {
+            break;
+        }
+        if (!raw_hash_item(s, input, input_end, &input) || input == input_end || (*input != ' ' && *input != ')')) {
+            return false;
+        }
+    }
+    hash_byte(s, HASH_TAG_INNER_LIST_END);
+    return raw_hash_parameters(s, input + 1, input_end, out_rest);
+}
+
+static bool raw_hash_list_member(hash_state_t *s, const char *input, const char *input_end, const char **out_rest)
+{
+    hash_byte(s, HASH_TAG_MEMBER);
+    if (*input == '(') {
+        return raw_hash_inner_list(s, input, input_end, out_rest);
+    }
+    return raw_hash_item(s, input, input_end, out_rest);
+}
+
+static bool raw_hash_dict_value(hash_state_t *s, const char *value, const char *value_end)
+{
+    if (value < value_end && *value == '=') {
+        ++value;
+        if (*value == '(') {
+            return raw_hash_inner_list(s, value, value_end, &value);
+        }
+        return raw_hash_item(s, value, value_end, &value);
+    }
+    hash_true(s);
+    return raw_hash_parameters(s, value, value_end, &value);
+}
+
+bool hsfv_raw_semantic_hash(hsfv_field_value_type_t field_type, const char *input, const char *input_end, uint64_t seed,
+                            uint64_t *out_hash)
+{
+    hash_state_t s;
+
+    if (!hsfv_is_ascii_string(input, input_end)) {
+        return false;
+    }
+    hsfv_skip_sp(input, input_end, &input);
+    hash_init(&s, seed, field_type);
+    switch (field_type) {
+    case HSFV_FIELD_VALUE_TYPE_LIST:
+        while (input < input_end) {
+            if (!raw_hash_list_member(&s, input, input_end, &input) || !hsfv_skip_ows_comma_ows(input, input_end, &input)) {
+                return false;
+            }
+        }
+        break;
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY:
+        if (!raw_hash_keyed(&s, HASH_TAG_MEMBER, hsfv_keyed_next_dict_member, raw_hash_dict_value, input, input_end)) {
+            return false;
+        }
+        break;
+    case HSFV_FIELD_VALUE_TYPE_ITEM:
+        if (!raw_hash_item(&s, input, input_end, &input)) {
+            return false;
+        }
+        hsfv_skip_sp(input, input_end, &input);
+        if (input < input_end) {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    *out_hash = hash_final(&s);
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "hsfv.h"
+#include "stats.h"
 
 #define INNER_LIST_INITIAL_CAPACITY 8
 
@@ -20,7 +21,7 @@ void hsfv_inner_list_deinit(hsfv_inner_list_t *self, hsfv_allocator_t *allocator
     for (size_t i = 0; i < self->len; i++) {
         hsfv_item_deinit(&self->items[i], allocator);
     }
-    allocator->free(allocator, self->items);
+    hsfv_allocator_free_sized(allocator, self->items, self->capacity * sizeof(hsfv_item_t));
     hsfv_parameters_deinit(&self->parameters, allocator);
 }
 
@@ -33,6 +34,7 @@ static hsfv_err_t hsfv_inner_list_append(hsfv_inner_list_t *self, hsfv_allocator
             return HSFV_ERR_OUT_OF_MEMORY;
         }
         self->items = items2;
+        HSFV_STATS_INC(reallocs);
         self->capacity = new_capacity;
     }
     self->items[self->len] = *item;
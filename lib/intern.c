@@ -0,0 +1,122 @@
+#include "hsfv.h"
+
+#define INTERN_SLOT_SIZE (HSFV_INTERN_MAX_LEN + 1)
+#define INTERN_TABLE_SIZE (HSFV_INTERN_CAPACITY * 2)
+
+_Static_assert(HSFV_ID_VOCABULARY_END - 1 <= HSFV_INTERN_CAPACITY, "vocabulary must fit in the intern pool");
+_Static_assert(HSFV_INTERN_CAPACITY < 256, "slot numbers must fit in the lookup table");
+
+#define INTERN_CHECK_LEN(name, str) _Static_assert(sizeof(str) <= INTERN_SLOT_SIZE, str " is too long to intern");
+HSFV_INTERN_VOCABULARY(INTERN_CHECK_LEN)
+#undef INTERN_CHECK_LEN
+
+/*
+ * Interned strings live in fixed-size slots, so the id of an interned
+ * pointer is its slot number plus one and needs no lookup. The vocabulary
+ * is laid out at compile time. Lookups by content go through an
+ * open-addressing table of slot numbers which is filled before main runs
+ * and at most half full.
+ */
+static char intern_pool[HSFV_INTERN_CAPACITY][INTERN_SLOT_SIZE] = {
+#define INTERN_SLOT(name, str) [HSFV_ID_##name - 1] = str,
+    HSFV_INTERN_VOCABULARY(INTERN_SLOT)
+#undef INTERN_SLOT
+};
+
+static uint8_t intern_lens[HSFV_INTERN_CAPACITY] = {
+#define INTERN_LEN(name, str) [HSFV_ID_##name - 1] = sizeof(str) - 1,
+    HSFV_INTERN_VOCABULARY(INTERN_LEN)
+#undef INTERN_LEN
+};
+
+static size_t intern_count = HSFV_ID_VOCABULARY_END - 1;
+
+/* slot number plus one, or zero for an empty bucket */
+static uint8_t intern_table[INTERN_TABLE_SIZE];
+
+static uint32_t intern_hash(const char *s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void intern_table_insert(size_t slot)
+{
+    uint32_t h = intern_hash(intern_pool[slot], intern_lens[slot]) & (INTERN_TABLE_SIZE - 1);
+    while (intern_table[h]) {
+        h = (h + 1) & (INTERN_TABLE_SIZE - 1);
+    }
+    intern_table[h] = slot + 1;
+}
+
+__attribute__((constructor)) static void intern_init(void)
+{
+    for (size_t slot = 0; slot < intern_count; slot++) {
+        intern_table_insert(slot);
+    }
+}
+
+const char *hsfv_intern_lookup(const char *s, size_t len)
+{
+    uint32_t h;
+    uint8_t entry;
+
+    if (len == 0 || len > HSFV_INTERN_MAX_LEN) {
+        return NULL;
+    }
+
+    h = intern_hash(s, len) & (INTERN_TABLE_SIZE - 1);
+    while ((entry = intern_table[h])) {
+        size_t slot = entry - 1;
+        if (intern_lens[slot] == len && !memcmp(intern_pool[slot], s, len)) {
+            return intern_pool[slot];
+        }
+        h = (h + 1) & (INTERN_TABLE_SIZE - 1);
+    }
+    return NULL;
+}
+
+hsfv_err_t hsfv_intern_register(const char *s, size_t len, hsfv_id_t *out_id)
+{
+    const char *interned = hsfv_intern_lookup(s, len);
+
+    if (interned == NULL) {
+        if (len == 0 || len > HSFV_INTERN_MAX_LEN) {
+            return HSFV_ERR_INVALID;
+        }
+        if (intern_count == HSFV_INTERN_CAPACITY) {
+            return HSFV_ERR_OUT_OF_MEMORY;
+        }
+        memcpy(intern_pool[intern_count], s, len);
+        intern_lens[intern_count] = len;
+        intern_table_insert(intern_count);
+        interned = intern_pool[intern_count];
+        intern_count++;
+    }
+    if (out_id) {
+        *out_id = hsfv_intern_id(interned);
+    }
+    return HSFV_OK;
+}
+
+bool hsfv_is_interned(const char *p)
+{
+    uintptr_t addr = (uintptr_t)p, base = (uintptr_t)intern_pool;
+    return base <= addr && addr < base + sizeof(intern_pool);
+}
+
+hsfv_id_t hsfv_intern_id(const char *p)
+{
+    if (!hsfv_is_interned(p)) {
+        return HSFV_ID_NONE;
+    }
+    size_t offset = (uintptr_t)p - (uintptr_t)intern_pool;
+    if (offset % INTERN_SLOT_SIZE) {
+        return HSFV_ID_NONE;
+    }
+    return (hsfv_id_t)(offset / INTERN_SLOT_SIZE + 1);
+}
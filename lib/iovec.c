@@ -2,20 +2,20 @@
 
 bool hsfv_iovec_eq(const hsfv_iovec_t *self, const hsfv_iovec_t *other)
 {
-    return self->len == other->len && !memcmp(self->base, other->base, self->len);
+    return self->len == other->len && (self->len == 0 || !memcmp(self->base, other->base, self->len));
 }
 
 bool hsfv_iovec_const_eq(const hsfv_iovec_const_t *self, const hsfv_iovec_const_t *other)
 {
-    return self->len == other->len && !memcmp(self->base, other->base, self->len);
+    return self->len == other->len && (self->len == 0 || !memcmp(self->base, other->base, self->len));
 }
 
 void hsfv_iovec_deinit(hsfv_iovec_t *v, hsfv_allocator_t *allocator)
 {
-    allocator->free(allocator, (void *)v->base);
+    hsfv_allocator_free_sized(allocator, v->base, v->len);
 }
 
 void hsfv_iovec_const_deinit(hsfv_iovec_const_t *v, hsfv_allocator_t *allocator)
 {
-    allocator->free(allocator, (void *)v->base);
+    hsfv_allocator_free_sized(allocator, (void *)v->base, v->len);
 }
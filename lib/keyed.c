@@ -0,0 +1,166 @@
+#include "hsfv.h"
+#include "keyed.h"
+#include "stats.h"
+
+/*
+ * A window holds the keys of a run of members, sorted so that each lookup
+ * is a binary search rather than a hash probe, which input cannot make
+ * collide. Indexing a window passes over the whole container once: the
+ * members before the window mark the keys which were already returned, and
+ * the members after it supply the last value of each key.
+ */
+
+static int keyed_key_cmp(const hsfv_keyed_member_t *a, const hsfv_keyed_member_t *b)
+{
+    if (a->key_len != b->key_len) {
+        return a->key_len < b->key_len ? -1 : 1;
+    }
+    return memcmp(a->key, b->key, a->key_len);
+}
+
+/* returns where member's key is in iter->sorted, or where it would be inserted */
+static size_t keyed_search(const hsfv_keyed_iter_t *iter, const hsfv_keyed_member_t *member, bool *found)
+{
+    size_t lo = 0, hi = iter->len, mid;
+    int cmp;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        cmp = keyed_key_cmp(&iter->members[iter->sorted[mid]], member);
+        if (cmp == 0) {
+            *found = true;
+            return mid;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *found = false;
+    return lo;
+}
+
+static bool keyed_index_window(hsfv_keyed_iter_t *iter)
+{
+    hsfv_keyed_member_t member, *indexed;
+    const char *p, *q;
+    size_t i;
+    bool found;
+
+    if (iter->window_end != iter->input) {
+        HSFV_STATS_INC(raw_key_rescans);
+    }
+    iter->window_start = iter->window_end;
+    iter->len = 0;
+    iter->pos = 0;
+    for (p = iter->window_start; p < iter->input_end; p = q) {
+        q = p;
+        if (!iter->next(&q, iter->input_end, &member)) {
+            return false;
+        }
+        i = keyed_search(iter, &member, &found);
+        if (found) {
+            indexed = &iter->members[iter->sorted[i]];
+            indexed->value = member.value;
+            indexed->value_end = member.value_end;
+            continue;
+        }
+        if (iter->len == HSFV_KEYED_WINDOW) {
+            break;
+        }
+        memmove(iter->sorted + i + 1, iter->sorted + i, iter->len - i);
+        iter->sorted[i] = (uint8_t)iter->len;
+        iter->seen[iter->len] = false;
+        iter->members[iter->len++] = member;
+    }
+    iter->window_end = p;
+
+    /* the members before the window were validated when the first window was indexed */
+    for (p = iter->input; p < iter->window_start;) {
+        iter->next(&p, iter->input_end, &member);
+        i = keyed_search(iter, &member, &found);
+        if (found) {
+            iter->seen[iter->sorted[i]] = true;
+        }
+    }
+    for (p = iter->window_end; p < iter->input_end;) {
+        if (!iter->next(&p, iter->input_end, &member)) {
+            return false;
+        }
+        i = keyed_search(iter, &member, &found);
+        if (found) {
+            indexed = &iter->members[iter->sorted[i]];
+            indexed->value = member.value;
+            indexed->value_end = member.value_end;
+        }
+    }
+    return true;
+}
+
+bool hsfv_keyed_iter_init(hsfv_keyed_iter_t *iter, hsfv_keyed_next_t next, const char *input, const char *input_end)
+{
+    iter->next = next;
+    iter->input = input;
+    iter->input_end = input_end;
+    iter->window_end = input;
+    return keyed_index_window(iter);
+}
+
+bool hsfv_keyed_iter_next(hsfv_keyed_iter_t *iter, hsfv_keyed_member_t *member)
+{
+    for (;;) {
+        for (; iter->pos < iter->len; iter->pos++) {
+            if (!iter->seen[iter->pos]) {
+                *member = iter->members[iter->pos++];
+                return true;
+            }
+        }
+        if (iter->window_end == iter->input_end) {
+            return false;
+        }
+        /* input was validated when the first window was indexed */
+        keyed_index_window(iter);
+    }
+}
+
+bool hsfv_keyed_next_param(const char **input, const char *input_end, hsfv_keyed_member_t *member)
+{
+    const char *p = *input + 1;
+
+    hsfv_skip_sp(p, input_end, &p);
+    member->key = p;
+    if (!hsfv_skip_key(p, input_end, &p)) {
+        return false;
+    }
+    member->key_len = p - member->key;
+    member->value = p;
+    if (p < input_end && *p == '=' && !hsfv_skip_bare_item(p + 1, input_end, &p)) {
+        return false;
+    }
+    member->value_end = p;
+    *input = p;
+    return true;
+}
+
+bool hsfv_keyed_next_dict_member(const char **input, const char *input_end, hsfv_keyed_member_t *member)
+{
+    const char *p = *input;
+
+    member->key = p;
+    if (!hsfv_skip_key(p, input_end, &p)) {
+        return false;
+    }
+    member->key_len = p - member->key;
+    member->value = p;
+    if (p < input_end && *p == '=') {
+        ++p;
+        if ((p < input_end && *p == '(') ? !hsfv_skip_inner_list(p, input_end, &p) : !hsfv_skip_item(p, input_end, &p)) {
+            return false;
+        }
+    } else if (!hsfv_skip_parameters(p, input_end, &p)) {
+        return false;
+    }
+    member->value_end = p;
+    return hsfv_skip_ows_comma_ows(p, input_end, input);
+}
@@ -0,0 +1,54 @@
+#ifndef hsfv_keyed_h
+#define hsfv_keyed_h
+
+#include "hsfv.h"
+
+/*
+ * walks the members of a dictionary or parameter list in the order a parser
+ * keeps them, each key at its first position with the value of its last
+ * occurrence, without allocating, for the raw functions. Keys are indexed
+ * HSFV_KEYED_WINDOW at a time in a sorted array on the stack, and each
+ * window costs one pass over the container, so a container with n members
+ * takes O(n log HSFV_KEYED_WINDOW) when it has at most HSFV_KEYED_WINDOW
+ * distinct keys and O(n^2 / HSFV_KEYED_WINDOW) at worst.
+ */
+#define HSFV_KEYED_WINDOW 128
+
+/* a dictionary member or parameter; value to value_end is what follows the key */
+typedef struct st_hsfv_keyed_member_t {
+    const char *key;
+    size_t key_len;
+    const char *value;
+    const char *value_end;
+} hsfv_keyed_member_t;
+
+typedef bool (*hsfv_keyed_next_t)(const char **input, const char *input_end, hsfv_keyed_member_t *member);
+
+typedef struct st_hsfv_keyed_iter_t {
+    hsfv_keyed_next_t next;
+    const char *input;
+    const char *input_end;
+    /* the members before window_end have been indexed */
+    const char *window_start;
+    const char *window_end;
+    /* the keys of the current window in order of their first occurrence in it */
+    hsfv_keyed_member_t members[HSFV_KEYED_WINDOW];
+    /* indexes into members in key order */
+    uint8_t sorted[HSFV_KEYED_WINDOW];
+    /* whether the key also occurs before the window */
+    bool seen[HSFV_KEYED_WINDOW];
+    size_t len;
+    size_t pos;
+} hsfv_keyed_iter_t;
+
+/** starts iter on input, returning false if a member of input is invalid */
+bool hsfv_keyed_iter_init(hsfv_keyed_iter_t *iter, hsfv_keyed_next_t next, const char *input, const char *input_end);
+/** sets *member to the next merged member, returning false after the last one */
+bool hsfv_keyed_iter_next(hsfv_keyed_iter_t *iter, hsfv_keyed_member_t *member);
+
+/** reads the parameter at *input, which starts with ';' */
+bool hsfv_keyed_next_param(const char **input, const char *input_end, hsfv_keyed_member_t *member);
+/** reads the dictionary member at *input and the separator after it */
+bool hsfv_keyed_next_dict_member(const char **input, const char *input_end, hsfv_keyed_member_t *member);
+
+#endif
@@ -1,4 +1,5 @@
 #include "hsfv.h"
+#include "stats.h"
 
 #define LIST_INITIAL_CAPACITY 8
 
@@ -47,7 +48,7 @@ void hsfv_list_deinit(hsfv_list_t *self, hsfv_allocator_t *allocator)
     for (size_t i = 0; i < self->len; i++) {
         sfv_list_member_deinit(&self->members[i], allocator);
     }
-    allocator->free(allocator, self->members);
+    hsfv_allocator_free_sized(allocator, self->members, self->capacity * sizeof(hsfv_list_member_t));
 }
 
 hsfv_err_t hsfv_serialize_list(const hsfv_list_t *list, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
@@ -92,6 +93,7 @@ static hsfv_err_t hsfv_list_append(hsfv_list_t *self, hsfv_allocator_t *allocato
             return HSFV_ERR_OUT_OF_MEMORY;
         }
         self->members = members2;
+        HSFV_STATS_INC(reallocs);
         self->capacity = new_capacity;
     }
     self->members[self->len] = *member;
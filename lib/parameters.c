@@ -1,7 +1,16 @@
 #include "hsfv.h"
+#include "stats.h"
 
 #define PARAMETERS_INITIAL_CAPACITY 8
 
+/*
+ * hsfv_parse_parameters collects parameters in an array of this many slots
+ * on the stack and then copies them into one exactly sized allocation, so
+ * parsing parameters allocates once at most and items without parameters
+ * not at all. Only longer parameter lists move to a growing heap array.
+ */
+#define PARAMETERS_STACK_CAPACITY 8
+
 bool hsfv_parameter_eq(const hsfv_parameter_t *self, const hsfv_parameter_t *other)
 {
     return hsfv_key_eq(&self->key, &other->key) && hsfv_bare_item_eq(&self->value, &other->value);
@@ -31,7 +40,7 @@ void hsfv_parameters_deinit(hsfv_parameters_t *parameters, hsfv_allocator_t *all
     for (size_t i = 0; i < parameters->len; i++) {
         hsfv_parameter_deinit(&parameters->params[i], allocator);
     }
-    allocator->free(allocator, parameters->params);
+    hsfv_allocator_free_sized(allocator, parameters->params, parameters->capacity * sizeof(hsfv_parameter_t));
 }
 
 hsfv_err_t hsfv_serialize_parameters(const hsfv_parameters_t *parameters, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
@@ -67,13 +76,24 @@ hsfv_err_t hsfv_serialize_parameters(const hsfv_parameters_t *parameters, hsfv_a
     return HSFV_OK;
 }
 
-static hsfv_err_t hsfv_parameters_append(hsfv_allocator_t *allocator, hsfv_parameters_t *parameters, hsfv_parameter_t *param)
+static hsfv_err_t hsfv_parameters_append(hsfv_allocator_t *allocator, hsfv_parameters_t *parameters, hsfv_parameter_t *param,
+                                         hsfv_parameter_t *stack_params)
 {
     if (parameters->len + 1 > parameters->capacity) {
         size_t new_capacity = hsfv_align(parameters->len + 1, PARAMETERS_INITIAL_CAPACITY);
-        void *params2 = allocator->realloc(allocator, parameters->params, new_capacity * sizeof(hsfv_parameter_t));
-        if (params2 == NULL) {
-            return HSFV_ERR_OUT_OF_MEMORY;
+        void *params2;
+        if (parameters->params == stack_params) {
+            params2 = allocator->alloc(allocator, new_capacity * sizeof(hsfv_parameter_t));
+            if (params2 == NULL) {
+                return HSFV_ERR_OUT_OF_MEMORY;
+            }
+            memcpy(params2, stack_params, parameters->len * sizeof(hsfv_parameter_t));
+        } else {
+            params2 = allocator->realloc(allocator, parameters->params, new_capacity * sizeof(hsfv_parameter_t));
+            if (params2 == NULL) {
+                return HSFV_ERR_OUT_OF_MEMORY;
+            }
+            HSFV_STATS_INC(reallocs);
         }
         parameters->params = params2;
         parameters->capacity = new_capacity;
@@ -93,13 +113,50 @@ size_t hsfv_parameters_index_of(const hsfv_parameters_t *parameters, const hsfv_
     return -1;
 }
 
+hsfv_err_t hsfv_parameters_set(hsfv_parameters_t *dest, const hsfv_parameters_t *src, const char *key, size_t key_len,
+                               const hsfv_bare_item_t *value, hsfv_allocator_t *allocator)
+{
+    hsfv_parameter_t param = {.key = hsfv_key_ref(key, key_len), .value = *value};
+    size_t i = hsfv_parameters_index_of(src, &param.key);
+    size_t len = i == -1 ? src->len + 1 : src->len;
+    hsfv_parameters_t edited = *src;
+
+    if (dest != src || len > src->capacity) {
+        hsfv_parameter_t *params = allocator->alloc(allocator, len * sizeof(hsfv_parameter_t));
+        if (params == NULL) {
+            return HSFV_ERR_OUT_OF_MEMORY;
+        }
+        if (src->len != 0) {
+            memcpy(params, src->params, src->len * sizeof(hsfv_parameter_t));
+        }
+        if (dest == src) {
+            hsfv_parameters_edit_deinit(dest, allocator);
+        }
+        edited.params = params;
+        edited.capacity = len;
+    }
+
+    if (i == -1) {
+        edited.params[edited.len++] = param;
+    } else {
+        edited.params[i].value = *value;
+    }
+    *dest = edited;
+    return HSFV_OK;
+}
+
+void hsfv_parameters_edit_deinit(hsfv_parameters_t *edited, hsfv_allocator_t *allocator)
+{
+    hsfv_allocator_free_sized(allocator, edited->params, edited->capacity * sizeof(hsfv_parameter_t));
+}
+
 hsfv_err_t hsfv_parse_parameters(hsfv_parameters_t *parameters, hsfv_allocator_t *allocator, const char *input,
                                  const char *input_end, const char **out_rest)
 {
     hsfv_err_t err;
     char c;
-    hsfv_parameter_t param;
-    hsfv_parameters_t temp = (hsfv_parameters_t){0};
+    hsfv_parameter_t param, stack_params[PARAMETERS_STACK_CAPACITY];
+    hsfv_parameters_t temp = (hsfv_parameters_t){.params = stack_params, .capacity = PARAMETERS_STACK_CAPACITY};
     size_t i;
 
     *parameters = (hsfv_parameters_t){0};
@@ -131,16 +188,31 @@ hsfv_err_t hsfv_parse_parameters(hsfv_parameters_t *parameters, hsfv_allocator_t
         }
         i = hsfv_parameters_index_of(&temp, &param.key);
         if (i == -1) {
-            err = hsfv_parameters_append(allocator, &temp, &param);
+            err = hsfv_parameters_append(allocator, &temp, &param, stack_params);
             if (err) {
                 goto error1;
             }
         } else {
+            HSFV_STATS_INC(parameter_duplicate_keys);
             hsfv_parameter_deinit(&temp.params[i], allocator);
             temp.params[i] = param;
         }
     }
 
+    if (temp.params == stack_params) {
+        if (temp.len == 0) {
+            temp = (hsfv_parameters_t){0};
+        } else {
+            temp.params = allocator->alloc(allocator, temp.len * sizeof(hsfv_parameter_t));
+            if (temp.params == NULL) {
+                temp.params = stack_params;
+                err = HSFV_ERR_OUT_OF_MEMORY;
+                goto error3;
+            }
+            memcpy(temp.params, stack_params, temp.len * sizeof(hsfv_parameter_t));
+            temp.capacity = temp.len;
+        }
+    }
     *parameters = temp;
     if (out_rest) {
         *out_rest = input;
@@ -154,6 +226,12 @@ error2:
     hsfv_key_deinit(&param.key, allocator);
 
 error3:
-    hsfv_parameters_deinit(&temp, allocator);
+    if (temp.params == stack_params) {
+        for (i = 0; i < temp.len; i++) {
+            hsfv_parameter_deinit(&stack_params[i], allocator);
+        }
+    } else {
+        hsfv_parameters_deinit(&temp, allocator);
+    }
     return err;
 }
@@ -0,0 +1,397 @@
+#include "hsfv.h"
+#include <pthread.h>
+
+/*
+ * Every block starts with a header holding its size class, or
+ * POOL_LARGE_CLASS for blocks which were passed straight to the backing
+ * allocator. While a block is free its payload links it into a free list
+ * and, for the first block of a batch in the depot, to the next batch.
+ */
+#define POOL_MAX_CLASS_COUNT 24
+#define POOL_MIN_CLASS_SIZE 16
+#define POOL_BLOCK_HEADER_SIZE 16
+#define POOL_LARGE_CLASS SIZE_MAX
+
+typedef struct st_pool_free_block_t pool_free_block_t;
+
+struct st_pool_free_block_t {
+    pool_free_block_t *next;
+    pool_free_block_t *next_batch;
+};
+
+typedef struct st_pool_free_list_t {
+    pool_free_block_t *head;
+    size_t len;
+} pool_free_list_t;
+
+typedef struct st_pool_thread_cache_t pool_thread_cache_t;
+
+struct st_pool_thread_cache_t {
+    hsfv_pool_t *pool;
+    pool_thread_cache_t *prev;
+    pool_thread_cache_t *next;
+    pool_free_list_t lists[POOL_MAX_CLASS_COUNT];
+};
+
+struct st_hsfv_pool_t {
+    hsfv_allocator_t allocator;
+    hsfv_allocator_t *backing;
+    size_t class_sizes[POOL_MAX_CLASS_COUNT];
+    size_t class_count;
+    pthread_key_t cache_key;
+    /* guards depot and caches */
+    pthread_mutex_t mutex;
+    pool_free_block_t *depot[POOL_MAX_CLASS_COUNT];
+    pool_thread_cache_t *caches;
+    hsfv_pool_stats_t stats;
+};
+
+static size_t *pool_block_class(void *ptr)
+{
+    return (size_t *)((hsfv_byte_t *)ptr - POOL_BLOCK_HEADER_SIZE);
+}
+
+static void *pool_block_of(pool_free_block_t *block)
+{
+    return (hsfv_byte_t *)block - POOL_BLOCK_HEADER_SIZE;
+}
+
+/* returns the smallest class which holds size bytes, or POOL_LARGE_CLASS */
+static size_t pool_class_of(const hsfv_pool_t *pool, size_t size)
+{
+    size_t lo = 0, hi = pool->class_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (pool->class_sizes[mid] < size) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < pool->class_count ? lo : POOL_LARGE_CLASS;
+}
+
+static void pool_add_class(hsfv_pool_t *pool, size_t size)
+{
+    size_t i, j;
+
+    size = hsfv_align(size, POOL_BLOCK_HEADER_SIZE);
+    for (i = 0; i < pool->class_count && pool->class_sizes[i] < size; i++) {
+    }
+    if ((i < pool->class_count && pool->class_sizes[i] == size) || pool->class_count == POOL_MAX_CLASS_COUNT) {
+        return;
+    }
+    for (j = pool->class_count; j > i; j--) {
+        pool->class_sizes[j] = pool->class_sizes[j - 1];
+    }
+    pool->class_sizes[i] = size;
+    pool->class_count++;
+}
+
+/*
+ * Member, item and parameter arrays start at 8 elements and grow 8 at a
+ * time, so most trees only ever use the first few multiples. Strings and
+ * serialize buffers are covered by the powers of two.
+ */
+static void pool_init_classes(hsfv_pool_t *pool)
+{
+    static const size_t element_sizes[] = {sizeof(hsfv_parameter_t), sizeof(hsfv_item_t), sizeof(hsfv_list_member_t),
+                                           sizeof(hsfv_dict_member_t)};
+
+    for (size_t size = POOL_MIN_CLASS_SIZE; size <= 512; size *= 2) {
+        pool_add_class(pool, size);
+    }
+    for (size_t i = 0; i < sizeof(element_sizes) / sizeof(element_sizes[0]); i++) {
+        for (size_t n = 8; n <= 32; n *= 2) {
+            pool_add_class(pool, n * element_sizes[i]);
+        }
+    }
+}
+
+/* moves the blocks linked from batch to the depot; called with the mutex held */
+static void pool_depot_push(hsfv_pool_t *pool, size_t class_index, pool_free_block_t *batch)
+{
+    batch->next_batch = pool->depot[class_index];
+    pool->depot[class_index] = batch;
+    __atomic_add_fetch(&pool->stats.depot_pushes, 1, __ATOMIC_RELAXED);
+}
+
+static void pool_thread_exit(void *arg)
+{
+    pool_thread_cache_t *cache = arg;
+    hsfv_pool_t *pool = cache->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (size_t i = 0; i < pool->class_count; i++) {
+        if (cache->lists[i].head) {
+            pool_depot_push(pool, i, cache->lists[i].head);
+        }
+    }
+    if (cache->prev) {
+        cache->prev->next = cache->next;
+    } else {
+        pool->caches = cache->next;
+    }
+    if (cache->next) {
+        cache->next->prev = cache->prev;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    hsfv_allocator_free_sized(pool->backing, cache, sizeof(*cache));
+}
+
+/* returns the free lists of the calling thread, or NULL if they cannot be allocated */
+static pool_thread_cache_t *pool_thread_cache(hsfv_pool_t *pool)
+{
+    pool_thread_cache_t *cache = pthread_getspecific(pool->cache_key);
+
+    if (cache) {
+        return cache;
+    }
+    cache = pool->backing->alloc(pool->backing, sizeof(*cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+    *cache = (pool_thread_cache_t){.pool = pool};
+    if (pthread_setspecific(pool->cache_key, cache) != 0) {
+        hsfv_allocator_free_sized(pool->backing, cache, sizeof(*cache));
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    cache->next = pool->caches;
+    if (pool->caches) {
+        pool->caches->prev = cache;
+    }
+    pool->caches = cache;
+    pthread_mutex_unlock(&pool->mutex);
+    return cache;
+}
+
+static void *pool_alloc_from_backing(hsfv_pool_t *pool, size_t class_index, size_t size)
+{
+    hsfv_byte_t *block = pool->backing->alloc(pool->backing, POOL_BLOCK_HEADER_SIZE + size);
+    if (block == NULL) {
+        return NULL;
+    }
+    *(size_t *)block = class_index;
+    return block + POOL_BLOCK_HEADER_SIZE;
+}
+
+static void *pool_alloc(hsfv_allocator_t *self, size_t size)
+{
+    hsfv_pool_t *pool = (hsfv_pool_t *)self;
+    size_t class_index = pool_class_of(pool, size);
+    pool_thread_cache_t *cache;
+    pool_free_list_t *list;
+    pool_free_block_t *block;
+
+    if (class_index == POOL_LARGE_CLASS) {
+        return pool_alloc_from_backing(pool, POOL_LARGE_CLASS, size);
+    }
+
+    cache = pool_thread_cache(pool);
+    if (cache) {
+        list = &cache->lists[class_index];
+        if (list->head == NULL) {
+            pthread_mutex_lock(&pool->mutex);
+            block = pool->depot[class_index];
+            if (block) {
+                pool->depot[class_index] = block->next_batch;
+            }
+            pthread_mutex_unlock(&pool->mutex);
+            if (block) {
+                __atomic_add_fetch(&pool->stats.depot_pops, 1, __ATOMIC_RELAXED);
+                list->head = block;
+                for (list->len = 0; block; block = block->next) {
+                    list->len++;
+                }
+            }
+        }
+        if (list->head) {
+            block = list->head;
+            list->head = block->next;
+            list->len--;
+            return block;
+        }
+    }
+
+    __atomic_add_fetch(&pool->stats.backing_allocs, 1, __ATOMIC_RELAXED);
+    return pool_alloc_from_backing(pool, class_index, pool->class_sizes[class_index]);
+}
+
+static void pool_free(hsfv_allocator_t *self, void *ptr)
+{
+    hsfv_pool_t *pool = (hsfv_pool_t *)self;
+    pool_free_block_t *block = ptr, *last;
+    pool_thread_cache_t *cache;
+    pool_free_list_t *list;
+    size_t class_index;
+
+    if (ptr == NULL) {
+        return;
+    }
+    class_index = *pool_block_class(ptr);
+    if (class_index == POOL_LARGE_CLASS) {
+        pool->backing->free(pool->backing, pool_block_of(block));
+        return;
+    }
+
+    block->next = NULL;
+    cache = pool_thread_cache(pool);
+    if (cache == NULL) {
+        pthread_mutex_lock(&pool->mutex);
+        pool_depot_push(pool, class_index, block);
+        pthread_mutex_unlock(&pool->mutex);
+        return;
+    }
+
+    list = &cache->lists[class_index];
+    block->next = list->head;
+    list->head = block;
+    if (++list->len <= HSFV_POOL_THREAD_CACHE_LIMIT) {
+        return;
+    }
+
+    /* keep the most recently freed blocks, which are likely still in the CPU cache */
+    last = list->head;
+    for (size_t i = 1; i < list->len - HSFV_POOL_BATCH_SIZE; i++) {
+        last = last->next;
+    }
+    list->len -= HSFV_POOL_BATCH_SIZE;
+    block = last->next;
+    last->next = NULL;
+    pthread_mutex_lock(&pool->mutex);
+    pool_depot_push(pool, class_index, block);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/* blocks of a size class are freed as by pool_free; only large blocks have a use for the size */
+static void pool_free_sized(hsfv_allocator_t *self, void *ptr, size_t size)
+{
+    hsfv_pool_t *pool = (hsfv_pool_t *)self;
+
+    if (ptr != NULL && *pool_block_class(ptr) == POOL_LARGE_CLASS) {
+        hsfv_allocator_free_sized(pool->backing, pool_block_of(ptr), POOL_BLOCK_HEADER_SIZE + size);
+        return;
+    }
+    pool_free(self, ptr);
+}
+
+static bool pool_try_expand_in_place(hsfv_allocator_t *self, void *ptr, size_t size)
+{
+    hsfv_pool_t *pool = (hsfv_pool_t *)self;
+    size_t class_index = *pool_block_class(ptr);
+
+    return class_index != POOL_LARGE_CLASS && size <= pool->class_sizes[class_index];
+}
+
+static void *pool_realloc(hsfv_allocator_t *self, void *ptr, size_t size)
+{
+    hsfv_pool_t *pool = (hsfv_pool_t *)self;
+    size_t class_index, old_capacity;
+    hsfv_byte_t *block;
+    void *ptr2;
+
+    if (ptr == NULL) {
+        return pool_alloc(self, size);
+    }
+
+    class_index = *pool_block_class(ptr);
+    if (class_index == POOL_LARGE_CLASS) {
+        if (pool_class_of(pool, size) == POOL_LARGE_CLASS) {
+            block = pool->backing->realloc(pool->backing, pool_block_of(ptr), POOL_BLOCK_HEADER_SIZE + size);
+            return block ? block + POOL_BLOCK_HEADER_SIZE : NULL;
+        }
+        /* shrinking into a class: the old block is larger than every class */
+        old_capacity = size;
+    } else {
+        old_capacity = pool->class_sizes[class_index];
+        if (size <= old_capacity) {
+            return ptr;
+        }
+    }
+
+    ptr2 = pool_alloc(self, size);
+    if (ptr2 == NULL) {
+        return NULL;
+    }
+    memcpy(ptr2, ptr, hsfv_min(old_capacity, size));
+    pool_free(self, ptr);
+    return ptr2;
+}
+
+hsfv_pool_t *hsfv_pool_create(hsfv_allocator_t *backing)
+{
+    hsfv_pool_t *pool = backing->alloc(backing, sizeof(hsfv_pool_t));
+    if (pool == NULL) {
+        return NULL;
+    }
+    *pool = (hsfv_pool_t){
+        .allocator =
+            {
+                .alloc = pool_alloc,
+                .realloc = pool_realloc,
+                .free = pool_free,
+                .free_sized = pool_free_sized,
+                .try_expand_in_place = pool_try_expand_in_place,
+            },
+        .backing = backing,
+    };
+    if (pthread_key_create(&pool->cache_key, pool_thread_exit) != 0) {
+        hsfv_allocator_free_sized(backing, pool, sizeof(*pool));
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pool_init_classes(pool);
+    return pool;
+}
+
+static void pool_free_list(hsfv_pool_t *pool, size_t class_index, pool_free_block_t *block)
+{
+    pool_free_block_t *next;
+    for (; block; block = next) {
+        next = block->next;
+        hsfv_allocator_free_sized(pool->backing, pool_block_of(block), POOL_BLOCK_HEADER_SIZE + pool->class_sizes[class_index]);
+    }
+}
+
+void hsfv_pool_destroy(hsfv_pool_t *pool)
+{
+    pool_thread_cache_t *cache, *next_cache;
+    pool_free_block_t *batch, *next_batch;
+
+    if (pool == NULL) {
+        return;
+    }
+    /* no thread exit handler may run once the caches below are freed */
+    pthread_key_delete(pool->cache_key);
+    for (cache = pool->caches; cache; cache = next_cache) {
+        next_cache = cache->next;
+        for (size_t i = 0; i < pool->class_count; i++) {
+            pool_free_list(pool, i, cache->lists[i].head);
+        }
+        hsfv_allocator_free_sized(pool->backing, cache, sizeof(*cache));
+    }
+    for (size_t i = 0; i < pool->class_count; i++) {
+        for (batch = pool->depot[i]; batch; batch = next_batch) {
+            next_batch = batch->next_batch;
+            pool_free_list(pool, i, batch);
+        }
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    hsfv_allocator_free_sized(pool->backing, pool, sizeof(*pool));
+}
+
+hsfv_allocator_t *hsfv_pool_allocator(hsfv_pool_t *pool)
+{
+    return &pool->allocator;
+}
+
+void hsfv_pool_stats(const hsfv_pool_t *pool, hsfv_pool_stats_t *out_stats)
+{
+    out_stats->backing_allocs = __atomic_load_n(&pool->stats.backing_allocs, __ATOMIC_RELAXED);
+    out_stats->depot_pushes = __atomic_load_n(&pool->stats.depot_pushes, __ATOMIC_RELAXED);
+    out_stats->depot_pops = __atomic_load_n(&pool->stats.depot_pops, __ATOMIC_RELAXED);
+}
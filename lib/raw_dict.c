@@ -0,0 +1,105 @@
+#include "hsfv.h"
+
+typedef enum {
+    RAW_DICT_REMOVE,
+    RAW_DICT_REPLACE,
+    RAW_DICT_APPEND,
+} raw_dict_op_t;
+
+static bool raw_dict_is_whole(bool (*skip)(const char *, const char *, const char **), const char *input, size_t len)
+{
+    const char *rest;
+    return skip(input, input + len, &rest) && rest == input + len;
+}
+
+static void raw_dict_write_member(hsfv_buffer_t *dest, size_t start_len, const char *sep, size_t sep_len, const char *key,
+                                  size_t key_len, const char *value, size_t value_len)
+{
+    if (dest->bytes.len > start_len) {
+        hsfv_buffer_append_bytes_unchecked(dest, sep, sep_len);
+    }
+    hsfv_buffer_append_bytes_unchecked(dest, key, key_len);
+    if (value_len > 0) {
+        hsfv_buffer_append_bytes_unchecked(dest, value, value_len);
+    }
+}
+
+/*
+ * Members are copied with the separator that preceded them in input, so
+ * the output is never longer than input plus the member an edit writes and
+ * one ", ", and the buffer is grown once before anything is written.
+ */
+static hsfv_err_t raw_dict_edit(raw_dict_op_t op, const char *input, const char *input_end, const char *key, size_t key_len,
+                                const char *value, size_t value_len, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    size_t start_len = dest->bytes.len;
+    const char *member_start, *member_end, *sep = input;
+    bool found = false;
+    hsfv_err_t err;
+
+    if (!raw_dict_is_whole(hsfv_skip_key, key, key_len) ||
+        (op != RAW_DICT_REMOVE && !raw_dict_is_whole(hsfv_skip_dictionary_member_value, value, value_len))) {
+        return HSFV_ERR_INVALID;
+    }
+    err = hsfv_buffer_ensure_unused_bytes(dest, allocator, (input_end - input) + key_len + value_len + 2);
+    if (err) {
+        return err;
+    }
+
+    hsfv_skip_sp(input, input_end, &input);
+    while (input < input_end) {
+        member_start = input;
+        if (!hsfv_skip_key(input, input_end, &input)) {
+            goto invalid;
+        }
+        bool match = input - member_start == key_len && !memcmp(member_start, key, key_len);
+        if (!hsfv_skip_dictionary_member_value(input, input_end, &input)) {
+            goto invalid;
+        }
+        member_end = input;
+        if (!hsfv_skip_ows_comma_ows(input, input_end, &input)) {
+            goto invalid;
+        }
+
+        /* later duplicates of key are dropped: the first one holds the position a parser would give the member */
+        if (match) {
+            if (op == RAW_DICT_REPLACE && !found) {
+                raw_dict_write_member(dest, start_len, sep, member_start - sep, key, key_len, value, value_len);
+            }
+            found = true;
+        } else {
+            raw_dict_write_member(dest, start_len, sep, member_start - sep, member_start, member_end - member_start, NULL, 0);
+        }
+        sep = member_end;
+    }
+
+    if (op == RAW_DICT_APPEND) {
+        raw_dict_write_member(dest, start_len, ", ", 2, key, key_len, value, value_len);
+    } else if (!found) {
+        dest->bytes.len = start_len;
+        return HSFV_ERR_EOF;
+    }
+    return HSFV_OK;
+
+invalid:
+    dest->bytes.len = start_len;
+    return HSFV_ERR_INVALID;
+}
+
+hsfv_err_t hsfv_raw_dict_remove(const char *input, const char *input_end, const char *key, size_t key_len,
+                                hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    return raw_dict_edit(RAW_DICT_REMOVE, input, input_end, key, key_len, NULL, 0, allocator, dest);
+}
+
+hsfv_err_t hsfv_raw_dict_replace(const char *input, const char *input_end, const char *key, size_t key_len, const char *value,
+                                 size_t value_len, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    return raw_dict_edit(RAW_DICT_REPLACE, input, input_end, key, key_len, value, value_len, allocator, dest);
+}
+
+hsfv_err_t hsfv_raw_dict_append(const char *input, const char *input_end, const char *key, size_t key_len, const char *value,
+                                size_t value_len, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    return raw_dict_edit(RAW_DICT_APPEND, input, input_end, key, key_len, value, value_len, allocator, dest);
+}
@@ -0,0 +1,300 @@
+#include "hsfv.h"
+#include "keyed.h"
+
+/*
+ * Both inputs are walked together and compared value by value, stopping at
+ * the first difference. Values are only decoded where their text differs,
+ * since equal text is an equal value: strings are unescaped, byte
+ * sequences decoded a chunk at a time and numbers parsed only then. The
+ * members of a dictionary or parameter list are merged as the parser
+ * merges duplicate keys, by walking both with a hsfv_keyed_iter_t, and then
+ * compared in order.
+ */
+
+/* base64 characters decoded at a time, a multiple of 4 */
+#define RAW_EQ_DECODE_CHUNK 64
+
+typedef struct st_raw_eq_side_t {
+    const char *p;
+    const char *end;
+} raw_eq_side_t;
+
+typedef bool (*raw_eq_value_t)(const char *a, const char *a_end, const char *b, const char *b_end);
+
+/* what a dictionary member or parameter without a value stands for */
+static const char raw_eq_true[] = "?1";
+
+static bool raw_eq_text(const char *a, const char *a_end, const char *b, const char *b_end)
+{
+    return a_end - a == b_end - b && !memcmp(a, b, a_end - a);
+}
+
+static bool raw_eq_span(bool (*skip)(const char *, const char *, const char **), raw_eq_side_t *a, raw_eq_side_t *b)
+{
+    const char *a_end, *b_end;
+
+    if (!skip(a->p, a->end, &a_end) || !skip(b->p, b->end, &b_end) || !raw_eq_text(a->p, a_end, b->p, b_end)) {
+        return false;
+    }
+    a->p = a_end;
+    b->p = b_end;
+    return true;
+}
+
+static bool raw_eq_string(raw_eq_side_t *a, raw_eq_side_t *b)
+{
+    const char *a_end, *b_end, *p, *q;
+
+    if (!hsfv_skip_string(a->p, a->end, &a_end) || !hsfv_skip_string(b->p, b->end, &b_end)) {
+        return false;
+    }
+    if (!raw_eq_text(a->p, a_end, b->p, b_end)) {
+        for (p = a->p + 1, q = b->p + 1;; p++, q++) {
+            bool a_done = p == a_end - 1, b_done = q == b_end - 1;
+            if (a_done || b_done) {
+                if (a_done != b_done) {
+                    return false;
+                }
+                break;
+            }
+            if (*p == '\\') {
+                ++p;
+            }
+            if (*q == '\\') {
+                ++q;
+            }
+            if (*p != *q) {
+                return false;
+            }
+        }
+    }
+    a->p = a_end;
+    b->p = b_end;
+    return true;
+}
+
+static size_t raw_eq_base64_data_len(const hsfv_iovec_const_t *encoded)
+{
+    const hsfv_byte_t *padding = memchr(encoded->base, '=', encoded->len);
+    return padding ? (size_t)(padding - encoded->base) : encoded->len;
+}
+
+static bool raw_eq_byte_seq(raw_eq_side_t *a, raw_eq_side_t *b)
+{
+    hsfv_byte_t a_bytes[RAW_EQ_DECODE_CHUNK / 4 * 3], b_bytes[RAW_EQ_DECODE_CHUNK / 4 * 3];
+    const char *a_end, *b_end;
+    size_t len;
+
+    if (!hsfv_skip_byte_seq(a->p, a->end, &a_end) || !hsfv_skip_byte_seq(b->p, b->end, &b_end)) {
+        return false;
+    }
+    if (!raw_eq_text(a->p, a_end, b->p, b_end)) {
+        hsfv_iovec_const_t a_encoded = {.base = (const hsfv_byte_t *)a->p + 1, .len = a_end - a->p - 2};
+        hsfv_iovec_const_t b_encoded = {.base = (const hsfv_byte_t *)b->p + 1, .len = b_end - b->p - 2};
+        /* the number of base64 characters before any padding determines the decoded length */
+        len = raw_eq_base64_data_len(&a_encoded);
+        if (len != raw_eq_base64_data_len(&b_encoded)) {
+            return false;
+        }
+        while (len > 0) {
+            size_t chunk_len = hsfv_min(len, RAW_EQ_DECODE_CHUNK);
+            hsfv_iovec_const_t a_chunk = {.base = a_encoded.base, .len = chunk_len};
+            hsfv_iovec_const_t b_chunk = {.base = b_encoded.base, .len = chunk_len};
+            hsfv_iovec_t a_decoded = {.base = a_bytes, .len = sizeof(a_bytes)};
+            hsfv_iovec_t b_decoded = {.base = b_bytes, .len = sizeof(b_bytes)};
+            if (hsfv_decode_base64(&a_decoded, &a_chunk) || hsfv_decode_base64(&b_decoded, &b_chunk) ||
+                memcmp(a_decoded.base, b_decoded.base, a_decoded.len)) {
+                return false;
+            }
+            a_encoded.base += chunk_len;
+            b_encoded.base += chunk_len;
+            len -= chunk_len;
+        }
+    }
+    a->p = a_end;
+    b->p = b_end;
+    return true;
+}
+
+static bool raw_eq_number(raw_eq_side_t *a, raw_eq_side_t *b)
+{
+    hsfv_bare_item_t a_item, b_item;
+    const char *a_end, *b_end;
+
+    if (!hsfv_skip_number(a->p, a->end, &a_end) || !hsfv_skip_number(b->p, b->end, &b_end)) {
+        return false;
+    }
+    if (!raw_eq_text(a->p, a_end, b->p, b_end)) {
+        if (hsfv_parse_number(&a_item, a->p, a_end, &a_end) || hsfv_parse_number(&b_item, b->p, b_end, &b_end) ||
+            !hsfv_bare_item_eq(&a_item, &b_item)) {
+            return false;
+        }
+    }
+    a->p = a_end;
+    b->p = b_end;
+    return true;
+}
+
+static bool raw_eq_bare_item(raw_eq_side_t *a, raw_eq_side_t *b)
+{
+    if (a->p == a->end || b->p == b->end) {
+        return false;
+    }
+    switch (*a->p) {
+    case '"':
+        return raw_eq_string(a, b);
+    case ':':
+        return raw_eq_byte_seq(a, b);
+    case '?':
+        return raw_eq_span(hsfv_skip_boolean, a, b);
+    default:
+        if (*a->p == '-' || HSFV_IS_DIGIT(*a->p)) {
+            return raw_eq_number(a, b);
+        }
+        return raw_eq_span(hsfv_skip_token, a, b);
+    }
+}
+
+static bool raw_eq_keyed(hsfv_keyed_next_t next, raw_eq_value_t value_eq, const char *a, const char *a_end, const char *b,
+                         const char *b_end)
+{
+    hsfv_keyed_iter_t a_iter, b_iter;
+    hsfv_keyed_member_t a_member, b_member;
+
+    if (!hsfv_keyed_iter_init(&a_iter, next, a, a_end) || !hsfv_keyed_iter_init(&b_iter, next, b, b_end)) {
+        return false;
+    }
+    if (raw_eq_text(a, a_end, b, b_end)) {
+        return true;
+    }
+    for (;;) {
+        bool a_more = hsfv_keyed_iter_next(&a_iter, &a_member);
+        bool b_more = hsfv_keyed_iter_next(&b_iter, &b_member);
+        if (a_more != b_more) {
+            return false;
+        }
+        if (!a_more) {
+            return true;
+        }
+        if (a_member.key_len != b_member.key_len || memcmp(a_member.key, b_member.key, a_member.key_len) ||
+            !value_eq(a_member.value, a_member.value_end, b_member.value, b_member.value_end)) {
+            return false;
+        }
+    }
+}
+
+static bool raw_eq_param_value(const char *a, const char *a_end, const char *b, const char *b_end)
+{
+    raw_eq_side_t sa = {a + 1, a_end}, sb = {b + 1, b_end};
+
+    if (a == a_end) {
+        sa = (raw_eq_side_t){raw_eq_true, raw_eq_true + 2};
+    }
+    if (b == b_end) {
+        sb = (raw_eq_side_t){raw_eq_true, raw_eq_true + 2};
+    }
+    return raw_eq_bare_item(&sa, &sb);
+}
+
+static bool raw_eq_parameters(raw_eq_side_t *a, raw_eq_side_t *b)
+{
+    const char *a_end, *b_end;
+
+    if (!hsfv_skip_parameters(a->p, a->end, &a_end) || !hsfv_skip_parameters(b->p, b->end, &b_end) ||
+        !raw_eq_keyed(hsfv_keyed_next_param, raw_eq_param_value, a->p, a_end, b->p, b_end)) {
+        return false;
+    }
+    a->p = a_end;
+    b->p = b_end;
+    return true;
+}
+
+static bool raw_eq_item(raw_eq_side_t *a, raw_eq_side_t *b)
+{
+    return raw_eq_bare_item(a, b) && raw_eq_parameters(a, b);
+}
+
+static bool raw_eq_inner_list(raw_eq_side_t *a, raw_eq_side_t *b)
+{
+    if (a->p == a->end || *a->p != '(' || b->p == b->end || *b->p != '(') {
+        return false;
+    }
+    ++a->p;
+    ++b->p;
+    for (;;) {
+        hsfv_skip_sp(a->p, a->end, &a->p);
+        hsfv_skip_sp(b->p, b->end, &b->p);
+        if (a->p == a->end || b->p == b->end || (*a->p == ')') != (*b->p == ')')) {
+            return false;
+        }
+        if (*a->p == ')') {
+            break;
+        }
+        if (!raw_eq_item(a, b) || a->p == a->end || b->p == b->end || (*a->p != ' ' && *a->p != ')') ||
+            (*b->p != ' ' && *b->p != ')')) {
+            return false;
+        }
+    }
+    ++a->p;
+    ++b->p;
+    return raw_eq_parameters(a, b);
+}
+
+static bool raw_eq_dict_value(const char *a, const char *a_end, const char *b, const char *b_end)
+{
+    raw_eq_side_t sa = {a, a_end}, sb = {b, b_end};
+    bool a_has_value = a < a_end && *a == '=', b_has_value = b < b_end && *b == '=';
+
+    sa.p += a_has_value;
+    sb.p += b_has_value;
+    if ((a_has_value && *sa.p == '(') != (b_has_value && *sb.p == '(')) {
+        return false;
+    }
+    if (a_has_value && *sa.p == '(') {
+        return raw_eq_inner_list(&sa, &sb);
+    }
+
+    /* a member without a value is a true boolean, though it may still have parameters */
+    raw_eq_side_t ta = a_has_value ? sa : (raw_eq_side_t){raw_eq_true, raw_eq_true + 2};
+    raw_eq_side_t tb = b_has_value ? sb : (raw_eq_side_t){raw_eq_true, raw_eq_true + 2};
+    if (!raw_eq_bare_item(&ta, &tb)) {
+        return false;
+    }
+    if (a_has_value) {
+        sa.p = ta.p;
+    }
+    if (b_has_value) {
+        sb.p = tb.p;
+    }
+    return raw_eq_parameters(&sa, &sb);
+}
+
+bool hsfv_raw_field_value_eq(hsfv_field_value_type_t field_type, const char *a, const char *a_end, const char *b,
+                             const char *b_end)
+{
+    raw_eq_side_t sa = {a, a_end}, sb = {b, b_end};
+
+    hsfv_skip_sp(sa.p, sa.end, &sa.p);
+    hsfv_skip_sp(sb.p, sb.end, &sb.p);
+    switch (field_type) {
+    case HSFV_FIELD_VALUE_TYPE_LIST:
+        while (sa.p < sa.end && sb.p < sb.end) {
+            if ((*sa.p == '(') != (*sb.p == '(') || !(*sa.p == '(' ? raw_eq_inner_list(&sa, &sb) : raw_eq_item(&sa, &sb)) ||
+                !hsfv_skip_ows_comma_ows(sa.p, sa.end, &sa.p) || !hsfv_skip_ows_comma_ows(sb.p, sb.end, &sb.p)) {
+                return false;
+            }
+        }
+        return sa.p == sa.end && sb.p == sb.end;
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY:
+        return raw_eq_keyed(hsfv_keyed_next_dict_member, raw_eq_dict_value, sa.p, sa.end, sb.p, sb.end);
+    case HSFV_FIELD_VALUE_TYPE_ITEM:
+        if (!raw_eq_item(&sa, &sb)) {
+            return false;
+        }
+        hsfv_skip_sp(sa.p, sa.end, &sa.p);
+        hsfv_skip_sp(sb.p, sb.end, &sb.p);
+        return sa.p == sa.end && sb.p == sb.end;
+    default:
+        return false;
+    }
+}
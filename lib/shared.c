@@ -0,0 +1,71 @@
+#include "hsfv.h"
+
+/*
+ * The header is followed in the same block by a clone of the field value,
+ * so readers reach the tree without touching anything but the block, and
+ * the last release frees everything with one call.
+ */
+struct st_hsfv_shared_field_value_t {
+    hsfv_allocator_t *allocator;
+    size_t size;
+    size_t refcnt;
+};
+
+_Static_assert(sizeof(hsfv_shared_field_value_t) % _Alignof(hsfv_field_value_t) == 0, "the clone after the header must be aligned");
+
+hsfv_err_t hsfv_shared_field_value_create(const hsfv_field_value_t *src, hsfv_allocator_t *allocator,
+                                          hsfv_shared_field_value_t **out_shared)
+{
+    size_t size = sizeof(hsfv_shared_field_value_t) + hsfv_field_value_clone_size(src);
+    hsfv_shared_field_value_t *shared = allocator->alloc(allocator, size);
+    if (shared == NULL) {
+        return HSFV_ERR_OUT_OF_MEMORY;
+    }
+
+    *shared = (hsfv_shared_field_value_t){
+        .allocator = allocator,
+        .size = size,
+        .refcnt = 1,
+    };
+    hsfv_field_value_clone_to(shared + 1, src);
+    *out_shared = shared;
+    return HSFV_OK;
+}
+
+hsfv_err_t hsfv_shared_field_value_parse(hsfv_field_value_type_t field_type, hsfv_allocator_t *allocator, const char *input,
+                                         const char *input_end, hsfv_shared_field_value_t **out_shared)
+{
+    hsfv_arena_t arena;
+    hsfv_field_value_t field_value;
+    hsfv_err_t err;
+
+    /* the parsed tree only lives until it is cloned, so parse it into an arena */
+    hsfv_arena_init(&arena, allocator, HSFV_ARENA_DEFAULT_CHUNK_SIZE);
+    err = hsfv_parse_field_value(&field_value, field_type, &arena.allocator, input, input_end, NULL);
+    if (err) {
+        goto exit;
+    }
+    err = hsfv_shared_field_value_create(&field_value, allocator, out_shared);
+
+exit:
+    hsfv_arena_deinit(&arena);
+    return err;
+}
+
+const hsfv_field_value_t *hsfv_shared_field_value_get(const hsfv_shared_field_value_t *shared)
+{
+    return (const hsfv_field_value_t *)(shared + 1);
+}
+
+hsfv_shared_field_value_t *hsfv_shared_field_value_acquire(hsfv_shared_field_value_t *shared)
+{
+    __atomic_add_fetch(&shared->refcnt, 1, __ATOMIC_RELAXED);
+    return shared;
+}
+
+void hsfv_shared_field_value_release(hsfv_shared_field_value_t *shared)
+{
+    if (__atomic_sub_fetch(&shared->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
+        hsfv_allocator_free_sized(shared->allocator, shared, shared->size);
+    }
+}
@@ -0,0 +1,118 @@
+#include "hsfv.h"
+#include "stats.h"
+
+#ifdef HSFV_ENABLE_STATS
+
+#include <pthread.h>
+
+/*
+ * Each thread owns one slot and is the only writer of its counters, so the
+ * hot path is a plain load and store. hsfv_stats_snapshot walks every slot
+ * under the mutex, and a thread's counters are folded into retired_stats
+ * when it exits.
+ */
+typedef struct st_hsfv_stats_slot_t hsfv_stats_slot_t;
+
+struct st_hsfv_stats_slot_t {
+    hsfv_stats_t stats;
+    hsfv_stats_slot_t *prev;
+    hsfv_stats_slot_t *next;
+};
+
+_Thread_local hsfv_stats_t *hsfv_stats_thread_local;
+
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stats_key;
+static hsfv_stats_slot_t *stats_slots;
+static hsfv_stats_t retired_stats;
+
+#define STATS_FIELD_COUNT (sizeof(hsfv_stats_t) / sizeof(uint64_t))
+
+static void stats_add(hsfv_stats_t *dest, const hsfv_stats_t *src)
+{
+    uint64_t *d = (uint64_t *)dest;
+    const uint64_t *s = (const uint64_t *)src;
+    for (size_t i = 0; i < STATS_FIELD_COUNT; i++) {
+        d[i] += __atomic_load_n(&s[i], __ATOMIC_RELAXED);
+    }
+}
+
+static void stats_unregister_thread(void *arg)
+{
+    hsfv_stats_slot_t *slot = arg;
+
+    pthread_mutex_lock(&stats_mutex);
+    stats_add(&retired_stats, &slot->stats);
+    if (slot->prev) {
+        slot->prev->next = slot->next;
+    } else {
+        stats_slots = slot->next;
+    }
+    if (slot->next) {
+        slot->next->prev = slot->prev;
+    }
+    pthread_mutex_unlock(&stats_mutex);
+
+    /* a parse from a later thread-specific destructor registers a new slot instead of writing to this one */
+    hsfv_stats_thread_local = NULL;
+    free(slot);
+}
+
+static void stats_create_key(void)
+{
+    pthread_key_create(&stats_key, stats_unregister_thread);
+}
+
+hsfv_stats_t *hsfv_stats_register_thread(void)
+{
+    hsfv_stats_slot_t *slot = calloc(1, sizeof(*slot));
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    pthread_once(&stats_once, stats_create_key);
+    pthread_setspecific(stats_key, slot);
+
+    pthread_mutex_lock(&stats_mutex);
+    slot->next = stats_slots;
+    if (stats_slots) {
+        stats_slots->prev = slot;
+    }
+    stats_slots = slot;
+    pthread_mutex_unlock(&stats_mutex);
+
+    hsfv_stats_thread_local = &slot->stats;
+    return hsfv_stats_thread_local;
+}
+
+bool hsfv_stats_enabled(void)
+{
+    return true;
+}
+
+void hsfv_stats_snapshot(hsfv_stats_t *out)
+{
+    *out = (hsfv_stats_t){0};
+
+    pthread_mutex_lock(&stats_mutex);
+    stats_add(out, &retired_stats);
+    for (hsfv_stats_slot_t *slot = stats_slots; slot; slot = slot->next) {
+        stats_add(out, &slot->stats);
+    }
+    pthread_mutex_unlock(&stats_mutex);
+}
+
+#else
+
+bool hsfv_stats_enabled(void)
+{
+    return false;
+}
+
+void hsfv_stats_snapshot(hsfv_stats_t *out)
+{
+    *out = (hsfv_stats_t){0};
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef hsfv_stats_h
+#define hsfv_stats_h
+
+#include "hsfv.h"
+
+/*
+ * counters behind hsfv_stats_snapshot, for the library sources only. Each
+ * thread registers its own hsfv_stats_t on first use. Without
+ * HSFV_ENABLE_STATS the macros expand to nothing.
+ */
+#ifdef HSFV_ENABLE_STATS
+extern _Thread_local hsfv_stats_t *hsfv_stats_thread_local;
+hsfv_stats_t *hsfv_stats_register_thread(void);
+
+#define HSFV_STATS_ADD(field, n)                                                                                                   \
+    do {                                                                                                                           \
+        hsfv_stats_t *stats_ = hsfv_stats_thread_local;                                                                            \
+        if (stats_ == NULL) {                                                                                                      \
+            stats_ = hsfv_stats_register_thread();                                                                                 \
+        }                                                                                                                          \
+        if (stats_) {                                                                                                              \
+            __atomic_store_n(&stats_->field, __atomic_load_n(&stats_->field, __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED);          \
+        }                                                                                                                          \
+    } while (0)
+#else
+#define HSFV_STATS_ADD(field, n)                                                                                                   \
+    do {                                                                                                                           \
+    } while (0)
+#endif
+
+#define HSFV_STATS_INC(field) HSFV_STATS_ADD(field, 1)
+#define HSFV_STATS_INC_PARSE_ERROR(err)                                                                                            \
+    HSFV_STATS_INC(parse_errors[-(err) < HSFV_STATS_ERR_COUNT ? -(err) : -HSFV_ERR])
+
+#endif
@@ -0,0 +1,834 @@
+#include "hsfv.h"
+#include "stats.h"
+
+_Static_assert(sizeof(hsfv_tape_entry_t) == 16, "tape entries must be 16 bytes");
+
+#define TAPE_MIN_CAPACITY 8
+
+/*
+ * A tape block holds capacity entries followed by strings_capacity bytes of
+ * string area. The string area never outgrows the input, since every decoded
+ * string, token, key and byte sequence is no longer than its encoding, so it
+ * is sized once per parse. Entries are estimated from the input length and
+ * the block grows when an input has more entries than expected; entries refer
+ * to strings by offset so moving the string area is just a memmove.
+ */
+static size_t tape_block_size(size_t capacity, size_t strings_capacity)
+{
+    return capacity * sizeof(hsfv_tape_entry_t) + strings_capacity;
+}
+
+static char *tape_strings(hsfv_tape_t *tape)
+{
+    return (char *)tape->strings;
+}
+
+static hsfv_err_t tape_reserve(hsfv_tape_t *tape, hsfv_allocator_t *allocator, size_t capacity, size_t strings_capacity)
+{
+    if (capacity <= tape->capacity && strings_capacity <= tape->strings_capacity) {
+        return HSFV_OK;
+    }
+
+    capacity = hsfv_max(capacity, tape->capacity);
+    strings_capacity = hsfv_max(strings_capacity, tape->strings_capacity);
+    hsfv_tape_entry_t *entries = allocator->realloc(allocator, tape->entries, tape_block_size(capacity, strings_capacity));
+    if (entries == NULL) {
+        return HSFV_ERR_OUT_OF_MEMORY;
+    }
+    HSFV_STATS_INC(reallocs);
+
+    char *strings = (char *)(entries + capacity);
+    if (tape->strings_len) {
+        memmove(strings, (char *)(entries + tape->capacity), tape->strings_len);
+    }
+    tape->entries = entries;
+    tape->capacity = capacity;
+    tape->strings = strings;
+    tape->strings_capacity = strings_capacity;
+    return HSFV_OK;
+}
+
+static hsfv_err_t tape_push(hsfv_tape_t *tape, hsfv_allocator_t *allocator, hsfv_tape_entry_t **out_entry)
+{
+    hsfv_err_t err;
+
+    if (tape->len == tape->capacity) {
+        err = tape_reserve(tape, allocator, tape->capacity * 2, tape->strings_capacity);
+        if (err) {
+            return err;
+        }
+    }
+    *out_entry = &tape->entries[tape->len++];
+    **out_entry = (hsfv_tape_entry_t){0};
+    return HSFV_OK;
+}
+
+static hsfv_err_t tape_push_chars(hsfv_tape_t *tape, hsfv_allocator_t *allocator, uint8_t type, const char *chars, size_t len)
+{
+    hsfv_tape_entry_t *entry;
+    hsfv_err_t err;
+
+    err = tape_push(tape, allocator, &entry);
+    if (err) {
+        return err;
+    }
+    entry->type = type;
+    entry->len = len;
+    entry->offset = tape->strings_len;
+    memcpy(tape_strings(tape) + tape->strings_len, chars, len);
+    tape->strings_len += len;
+    return HSFV_OK;
+}
+
+static bool tape_chars_eq(const hsfv_tape_t *tape, const hsfv_tape_entry_t *a, const hsfv_tape_entry_t *b)
+{
+    return a->len == b->len && !memcmp(hsfv_tape_chars(tape, a), hsfv_tape_chars(tape, b), a->len);
+}
+
+static void tape_reverse(hsfv_tape_entry_t *first, hsfv_tape_entry_t *last)
+{
+    hsfv_tape_entry_t tmp;
+
+    while (first < last) {
+        --last;
+        tmp = *first;
+        *first = *last;
+        *last = tmp;
+        ++first;
+    }
+}
+
+/* rotates [first, last) so that middle becomes first */
+static void tape_rotate(hsfv_tape_entry_t *first, hsfv_tape_entry_t *middle, hsfv_tape_entry_t *last)
+{
+    tape_reverse(first, middle);
+    tape_reverse(middle, last);
+    tape_reverse(first, last);
+}
+
+static hsfv_err_t parse_tape_key(hsfv_tape_t *tape, hsfv_allocator_t *allocator, const char *input, const char *input_end,
+                                 const char **out_rest)
+{
+    const char *p = input;
+    hsfv_err_t err;
+
+    if (p == input_end) {
+        return HSFV_ERR_EOF;
+    }
+    if (!HSFV_IS_KEY_LEADING_CHAR(*p)) {
+        return HSFV_ERR_INVALID;
+    }
+    for (++p; p < input_end; ++p) {
+        if (!HSFV_IS_KEY_TRAILING_CHAR(*p)) {
+            break;
+        }
+    }
+
+    err = tape_push_chars(tape, allocator, HSFV_TAPE_TYPE_KEY, input, p - input);
+    if (err) {
+        return err;
+    }
+    HSFV_STATS_INC(parsed_keys);
+    *out_rest = p;
+    return HSFV_OK;
+}
+
+static hsfv_err_t parse_tape_string(hsfv_tape_t *tape, hsfv_allocator_t *allocator, const char *input, const char *input_end,
+                                    const char **out_rest)
+{
+    hsfv_tape_entry_t *entry;
+    hsfv_err_t err;
+    char *strings, *d;
+    char c;
+    bool escaped = false;
+
+    err = tape_push(tape, allocator, &entry);
+    if (err) {
+        return err;
+    }
+    strings = tape_strings(tape);
+    d = strings + tape->strings_len;
+
+    /* the caller has checked the opening quote */
+    for (++input; input < input_end; ++input) {
+        c = *input;
+        if (c == '"') {
+            entry->type = HSFV_TAPE_TYPE_STRING;
+            entry->offset = tape->strings_len;
+            entry->len = d - (strings + tape->strings_len);
+            tape->strings_len += entry->len;
+            HSFV_STATS_INC(parsed_strings);
+            if (escaped) {
+                HSFV_STATS_INC(parsed_escaped_strings);
+            }
+            *out_rest = ++input;
+            return HSFV_OK;
+        }
+
+        if (c == '\\') {
+            ++input;
+            if (input == input_end) {
+                return HSFV_ERR_INVALID;
+            }
+            c = *input;
+            if (c != '"' && c != '\\') {
+                return HSFV_ERR_INVALID;
+            }
+            escaped = true;
+        } else if (c <= '\x1f' || '\x7f' <= c) {
+            break;
+        }
+        *d++ = c;
+    }
+    return HSFV_ERR_EOF;
+}
+
+static hsfv_err_t parse_tape_byte_seq(hsfv_tape_t *tape, hsfv_allocator_t *allocator, const char *input, const char *input_end,
+                                      const char **out_rest)
+{
+    hsfv_tape_entry_t *entry;
+    hsfv_err_t err;
+    const char *start;
+    hsfv_iovec_t dest;
+    hsfv_iovec_const_t src;
+
+    /* the caller has checked the opening colon */
+    start = ++input;
+    for (; input < input_end; ++input) {
+        if (*input == ':') {
+            break;
+        }
+        if (!HSFV_IS_BASE64_CHAR(*input)) {
+            return HSFV_ERR_INVALID;
+        }
+    }
+    if (input == input_end) {
+        return HSFV_ERR_EOF;
+    }
+
+    err = tape_push(tape, allocator, &entry);
+    if (err) {
+        return err;
+    }
+    dest.base = (hsfv_byte_t *)tape_strings(tape) + tape->strings_len;
+    dest.len = HSFV_BASE64_DECODED_LENGTH(input - start);
+    src.base = (const hsfv_byte_t *)start;
+    src.len = input - start;
+    if (hsfv_decode_base64(&dest, &src)) {
+        return HSFV_ERR_INVALID;
+    }
+    entry->type = HSFV_TAPE_TYPE_BYTE_SEQ;
+    entry->offset = tape->strings_len;
+    entry->len = dest.len;
+    tape->strings_len += dest.len;
+    HSFV_STATS_INC(parsed_byte_seqs);
+    *out_rest = ++input;
+    return HSFV_OK;
+}
+
+static hsfv_err_t parse_tape_bare_item(hsfv_tape_t *tape, hsfv_allocator_t *allocator, const char *input, const char *input_end,
+                                       const char **out_rest)
+{
+    hsfv_tape_entry_t *entry;
+    hsfv_bare_item_t item;
+    hsfv_err_t err;
+    const char *p;
+    char c;
+
+    if (input == input_end) {
+        return HSFV_ERR_EOF;
+    }
+
+    c = *input;
+    switch (c) {
+    case '"':
+        return parse_tape_string(tape, allocator, input, input_end, out_rest);
+    case ':':
+        return parse_tape_byte_seq(tape, allocator, input, input_end, out_rest);
+    case '?':
+        err = hsfv_parse_boolean(&item, input, input_end, out_rest);
+        if (err) {
+            return err;
+        }
+        err = tape_push(tape, allocator, &entry);
+        if (err) {
+            return err;
+        }
+        entry->type = HSFV_TAPE_TYPE_BOOLEAN;
+        entry->boolean = item.boolean;
+        return HSFV_OK;
+    default:
+        if (c == '-' || HSFV_IS_DIGIT(c)) {
+            err = hsfv_parse_number(&item, input, input_end, out_rest);
+            if (err) {
+                return err;
+            }
+            err = tape_push(tape, allocator, &entry);
+            if (err) {
+                return err;
+            }
+            if (item.type == HSFV_BARE_ITEM_TYPE_INTEGER) {
+                entry->type = HSFV_TAPE_TYPE_INTEGER;
+                entry->integer = item.integer;
+            } else {
+                entry->type = HSFV_TAPE_TYPE_DECIMAL;
+                entry->decimal = item.decimal;
+            }
+            return HSFV_OK;
+        }
+        if (HSFV_IS_TOKEN_LEADING_CHAR(c)) {
+            for (p = input + 1; p < input_end; ++p) {
+                if (!HSFV_IS_TOKEN_TRAILING_CHAR(*p)) {
+                    break;
+                }
+            }
+            err = tape_push_chars(tape, allocator, HSFV_TAPE_TYPE_TOKEN, input, p - input);
+            if (err) {
+                return err;
+            }
+            HSFV_STATS_INC(parsed_tokens);
+            *out_rest = p;
+            return HSFV_OK;
+        }
+        return HSFV_ERR_INVALID;
+    }
+}
+
+/*
+ * parses parameters following the entry at owner, if any. A parameter whose
+ * key is already present overwrites the value in place, so every parameter
+ * value spans exactly one entry.
+ */
+static hsfv_err_t parse_tape_parameters(hsfv_tape_t *tape, hsfv_allocator_t *allocator, size_t owner, const char *input,
+                                        const char *input_end, const char **out_rest)
+{
+    hsfv_tape_entry_t *entry, *params, *key;
+    size_t start, key_index, i;
+    hsfv_err_t err;
+
+    if (input == input_end || *input != ';') {
+        *out_rest = input;
+        return HSFV_OK;
+    }
+
+    start = tape->len;
+    err = tape_push(tape, allocator, &entry);
+    if (err) {
+        return err;
+    }
+    entry->type = HSFV_TAPE_TYPE_PARAMETERS;
+
+    while (input < input_end && *input == ';') {
+        ++input;
+        hsfv_skip_sp(input, input_end, &input);
+
+        key_index = tape->len;
+        err = parse_tape_key(tape, allocator, input, input_end, &input);
+        if (err) {
+            return err;
+        }
+
+        if (input < input_end && *input == '=') {
+            ++input;
+            err = parse_tape_bare_item(tape, allocator, input, input_end, &input);
+            if (err) {
+                return err;
+            }
+        } else {
+            err = tape_push(tape, allocator, &entry);
+            if (err) {
+                return err;
+            }
+            entry->type = HSFV_TAPE_TYPE_BOOLEAN;
+            entry->boolean = true;
+        }
+
+        key = &tape->entries[key_index];
+        for (i = start + 1; i < key_index; i += 2) {
+            if (tape_chars_eq(tape, &tape->entries[i], key)) {
+                break;
+            }
+        }
+        if (i < key_index) {
+            HSFV_STATS_INC(parameter_duplicate_keys);
+            tape->entries[i + 1] = tape->entries[key_index + 1];
+            tape->len = key_index;
+        } else {
+            tape->entries[start].len++;
+        }
+    }
+
+    params = &tape->entries[start];
+    params->skip = tape->len - start;
+    tape->entries[owner].flags |= HSFV_TAPE_FLAG_HAS_PARAMETERS;
+    *out_rest = input;
+    return HSFV_OK;
+}
+
+static hsfv_err_t parse_tape_item(hsfv_tape_t *tape, hsfv_allocator_t *allocator, const char *input, const char *input_end,
+                                  const char **out_rest)
+{
+    size_t owner = tape->len;
+    hsfv_err_t err;
+
+    err = parse_tape_bare_item(tape, allocator, input, input_end, &input);
+    if (err) {
+        return err;
+    }
+    return parse_tape_parameters(tape, allocator, owner, input, input_end, out_rest);
+}
+
+static hsfv_err_t parse_tape_inner_list(hsfv_tape_t *tape, hsfv_allocator_t *allocator, const char *input, const char *input_end,
+                                        const char **out_rest)
+{
+    hsfv_tape_entry_t *entry;
+    size_t start = tape->len;
+    hsfv_err_t err;
+    char c;
+
+    err = tape_push(tape, allocator, &entry);
+    if (err) {
+        return err;
+    }
+    entry->type = HSFV_TAPE_TYPE_INNER_LIST;
+
+    /* the caller has checked the opening parenthesis */
+    ++input;
+    while (input < input_end) {
+        hsfv_skip_sp(input, input_end, &input);
+
+        if (input == input_end) {
+            return HSFV_ERR_EOF;
+        }
+        if (*input == ')') {
+            ++input;
+            err = parse_tape_parameters(tape, allocator, start, input, input_end, out_rest);
+            if (err) {
+                return err;
+            }
+            tape->entries[start].skip = tape->len - start;
+            return HSFV_OK;
+        }
+
+        err = parse_tape_item(tape, allocator, input, input_end, &input);
+        if (err) {
+            return err;
+        }
+        tape->entries[start].len++;
+
+        if (input == input_end) {
+            return HSFV_ERR_EOF;
+        }
+        c = *input;
+        if (c != ' ' && c != ')') {
+            return HSFV_ERR_INVALID;
+        }
+    }
+    return HSFV_ERR_EOF;
+}
+
+static hsfv_err_t parse_tape_member(hsfv_tape_t *tape, hsfv_allocator_t *allocator, const char *input, const char *input_end,
+                                    const char **out_rest)
+{
+    if (input < input_end && *input == '(') {
+        return parse_tape_inner_list(tape, allocator, input, input_end, out_rest);
+    }
+    return parse_tape_item(tape, allocator, input, input_end, out_rest);
+}
+
+static hsfv_err_t parse_tape_list(hsfv_tape_t *tape, hsfv_allocator_t *allocator, const char *input, const char *input_end,
+                                  const char **out_rest)
+{
+    hsfv_tape_entry_t *entry;
+    size_t start = tape->len;
+    hsfv_err_t err;
+
+    err = tape_push(tape, allocator, &entry);
+    if (err) {
+        return err;
+    }
+    entry->type = HSFV_TAPE_TYPE_LIST;
+
+    while (input < input_end) {
+        err = parse_tape_member(tape, allocator, input, input_end, &input);
+        if (err) {
+            return err;
+        }
+        tape->entries[start].len++;
+
+        hsfv_skip_ows(input, input_end, &input);
+        if (input < input_end) {
+            if (*input != ',') {
+                return HSFV_ERR_INVALID;
+            }
+            ++input;
+            hsfv_skip_ows(input, input_end, &input);
+            if (input == input_end) {
+                return HSFV_ERR_EOF;
+            }
+        }
+    }
+
+    tape->entries[start].skip = tape->len - start;
+    *out_rest = input;
+    return HSFV_OK;
+}
+
+/*
+ * A member whose key is already present replaces the earlier value but keeps
+ * the earlier position, as hsfv_parse_dictionary does. The new value is
+ * rotated into the place of the old one and the old value and the new key
+ * are dropped.
+ */
+static void tape_replace_dictionary_value(hsfv_tape_t *tape, size_t old_key, size_t new_key)
+{
+    hsfv_tape_entry_t *entries = tape->entries;
+    hsfv_tape_entry_t *old_value = &entries[old_key + 1];
+    size_t old_len = hsfv_tape_next(old_value) - old_value;
+    size_t new_len = tape->len - (new_key + 1);
+
+    /* old value, members in between, new key, new value -> new value, old value, members in between, new key */
+    tape_rotate(old_value, &entries[new_key + 1], &entries[tape->len]);
+    memmove(old_value + new_len, old_value + new_len + old_len,
+            (tape->len - (old_key + 1 + new_len + old_len)) * sizeof(hsfv_tape_entry_t));
+    tape->len -= old_len + 1;
+}
+
+static hsfv_err_t parse_tape_dictionary(hsfv_tape_t *tape, hsfv_allocator_t *allocator, const char *input, const char *input_end,
+                                        const char **out_rest)
+{
+    const hsfv_tape_entry_t *key, *member;
+    hsfv_tape_entry_t *entry;
+    size_t start = tape->len, key_index;
+    hsfv_err_t err;
+
+    err = tape_push(tape, allocator, &entry);
+    if (err) {
+        return err;
+    }
+    entry->type = HSFV_TAPE_TYPE_DICTIONARY;
+
+    while (input < input_end) {
+        key_index = tape->len;
+        err = parse_tape_key(tape, allocator, input, input_end, &input);
+        if (err) {
+            return err;
+        }
+
+        if (input < input_end && *input == '=') {
+            ++input;
+            err = parse_tape_member(tape, allocator, input, input_end, &input);
+            if (err) {
+                return err;
+            }
+        } else {
+            err = tape_push(tape, allocator, &entry);
+            if (err) {
+                return err;
+            }
+            entry->type = HSFV_TAPE_TYPE_BOOLEAN;
+            entry->boolean = true;
+            err = parse_tape_parameters(tape, allocator, key_index + 1, input, input_end, &input);
+            if (err) {
+                return err;
+            }
+        }
+
+        key = &tape->entries[key_index];
+        for (member = &tape->entries[start + 1]; member < key; member = hsfv_tape_next(member + 1)) {
+            if (tape_chars_eq(tape, member, key)) {
+                break;
+            }
+        }
+        if (member < key) {
+            HSFV_STATS_INC(dictionary_duplicate_keys);
+            tape_replace_dictionary_value(tape, member - tape->entries, key_index);
+        } else {
+            tape->entries[start].len++;
+        }
+
+        hsfv_skip_ows(input, input_end, &input);
+        if (input < input_end) {
+            if (*input != ',') {
+                return HSFV_ERR_INVALID;
+            }
+            ++input;
+            hsfv_skip_ows(input, input_end, &input);
+            if (input == input_end) {
+                return HSFV_ERR_EOF;
+            }
+        }
+    }
+
+    tape->entries[start].skip = tape->len - start;
+    *out_rest = input;
+    return HSFV_OK;
+}
+
+hsfv_err_t hsfv_parse_tape(hsfv_tape_t *tape, hsfv_field_value_type_t field_type, hsfv_allocator_t *allocator, const char *input,
+                           const char *input_end, const char **out_rest)
+{
+    size_t input_len = input_end - input;
+    hsfv_err_t err;
+
+    tape->len = 0;
+    tape->strings_len = 0;
+
+    if (!hsfv_is_ascii_string(input, input_end)) {
+        err = HSFV_ERR_INVALID;
+        goto error;
+    }
+
+    /* most field values need far fewer entries than bytes; see tape_reserve */
+    err = tape_reserve(tape, allocator, hsfv_max(input_len / 2 + 1, TAPE_MIN_CAPACITY), input_len);
+    if (err) {
+        goto error;
+    }
+
+    hsfv_skip_sp(input, input_end, &input);
+    switch (field_type) {
+    case HSFV_FIELD_VALUE_TYPE_LIST:
+        err = parse_tape_list(tape, allocator, input, input_end, &input);
+        break;
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY:
+        err = parse_tape_dictionary(tape, allocator, input, input_end, &input);
+        break;
+    case HSFV_FIELD_VALUE_TYPE_ITEM:
+        err = parse_tape_item(tape, allocator, input, input_end, &input);
+        break;
+    default:
+        err = HSFV_ERR_INVALID;
+        break;
+    }
+    if (err) {
+        goto error;
+    }
+
+    hsfv_skip_sp(input, input_end, &input);
+    if (input < input_end) {
+        err = HSFV_ERR_INVALID;
+        goto error;
+    }
+
+    if (out_rest) {
+        *out_rest = input;
+    }
+    HSFV_STATS_INC(parsed_field_values);
+    return HSFV_OK;
+
+error:
+    HSFV_STATS_INC_PARSE_ERROR(err);
+    tape->len = 0;
+    tape->strings_len = 0;
+    return err;
+}
+
+void hsfv_tape_deinit(hsfv_tape_t *tape, hsfv_allocator_t *allocator)
+{
+    hsfv_allocator_free_sized(allocator, tape->entries, tape_block_size(tape->capacity, tape->strings_capacity));
+    *tape = (hsfv_tape_t){0};
+}
+
+hsfv_err_t hsfv_tape_clone(hsfv_tape_t *dest, const hsfv_tape_t *src, hsfv_allocator_t *allocator)
+{
+    hsfv_tape_entry_t *entries;
+
+    entries = allocator->alloc(allocator, tape_block_size(src->len, src->strings_len));
+    if (entries == NULL) {
+        return HSFV_ERR_OUT_OF_MEMORY;
+    }
+    memcpy(entries, src->entries, src->len * sizeof(hsfv_tape_entry_t));
+    memcpy((char *)(entries + src->len), src->strings, src->strings_len);
+
+    dest->entries = entries;
+    dest->len = dest->capacity = src->len;
+    dest->strings = (const char *)(entries + src->len);
+    dest->strings_len = dest->strings_capacity = src->strings_len;
+    return HSFV_OK;
+}
+
+const hsfv_tape_entry_t *hsfv_tape_parameters(const hsfv_tape_entry_t *entry)
+{
+    const hsfv_tape_entry_t *p;
+    uint32_t i;
+
+    if (!(entry->flags & HSFV_TAPE_FLAG_HAS_PARAMETERS)) {
+        return NULL;
+    }
+    if (entry->type != HSFV_TAPE_TYPE_INNER_LIST) {
+        return entry + 1;
+    }
+    for (p = entry + 1, i = 0; i < entry->len; ++i) {
+        p = hsfv_tape_next(p);
+    }
+    return p;
+}
+
+/* Serialize */
+
+static hsfv_err_t serialize_tape_bare_item(const hsfv_tape_t *tape, const hsfv_tape_entry_t *entry, hsfv_allocator_t *allocator,
+                                           hsfv_buffer_t *dest)
+{
+    switch (entry->type) {
+    case HSFV_TAPE_TYPE_INTEGER:
+        return hsfv_serialize_integer(entry->integer, allocator, dest);
+    case HSFV_TAPE_TYPE_DECIMAL:
+        return hsfv_serialize_decimal(entry->decimal, allocator, dest);
+    case HSFV_TAPE_TYPE_STRING: {
+        hsfv_string_t string = {.base = hsfv_tape_chars(tape, entry), .len = entry->len};
+        return hsfv_serialize_string(&string, allocator, dest);
+    }
+    case HSFV_TAPE_TYPE_TOKEN: {
+        hsfv_token_t token = {.base = hsfv_tape_chars(tape, entry), .len = entry->len};
+        return hsfv_serialize_token(&token, allocator, dest);
+    }
+    case HSFV_TAPE_TYPE_BYTE_SEQ: {
+        hsfv_byte_seq_t byte_seq = {.base = (const hsfv_byte_t *)hsfv_tape_chars(tape, entry), .len = entry->len};
+        return hsfv_serialize_byte_seq(&byte_seq, allocator, dest);
+    }
+    case HSFV_TAPE_TYPE_BOOLEAN:
+        return hsfv_serialize_boolean(entry->boolean, allocator, dest);
+    default:
+        return HSFV_ERR_INVALID;
+    }
+}
+
+static hsfv_err_t serialize_tape_key(const hsfv_tape_t *tape, const hsfv_tape_entry_t *entry, hsfv_allocator_t *allocator,
+                                     hsfv_buffer_t *dest)
+{
+    if (entry->type != HSFV_TAPE_TYPE_KEY) {
+        return HSFV_ERR_INVALID;
+    }
+    hsfv_key_t key = {.base = hsfv_tape_chars(tape, entry), .len = entry->len};
+    return hsfv_serialize_key(&key, allocator, dest);
+}
+
+static hsfv_err_t serialize_tape_parameters(const hsfv_tape_t *tape, const hsfv_tape_entry_t *owner, hsfv_allocator_t *allocator,
+                                            hsfv_buffer_t *dest)
+{
+    const hsfv_tape_entry_t *params, *entry, *end;
+    hsfv_err_t err;
+
+    params = hsfv_tape_parameters(owner);
+    if (params == NULL) {
+        return HSFV_OK;
+    }
+    end = hsfv_tape_end(params);
+    for (entry = params + 1; entry < end; entry += 2) {
+        err = hsfv_buffer_append_byte(dest, allocator, ';');
+        if (err) {
+            return err;
+        }
+        err = serialize_tape_key(tape, entry, allocator, dest);
+        if (err) {
+            return err;
+        }
+        if (entry[1].type == HSFV_TAPE_TYPE_BOOLEAN && entry[1].boolean) {
+            continue;
+        }
+        err = hsfv_buffer_append_byte(dest, allocator, '=');
+        if (err) {
+            return err;
+        }
+        err = serialize_tape_bare_item(tape, &entry[1], allocator, dest);
+        if (err) {
+            return err;
+        }
+    }
+    return HSFV_OK;
+}
+
+static hsfv_err_t serialize_tape_member(const hsfv_tape_t *tape, const hsfv_tape_entry_t *entry, hsfv_allocator_t *allocator,
+                                        hsfv_buffer_t *dest)
+{
+    const hsfv_tape_entry_t *item;
+    hsfv_err_t err;
+    uint32_t i;
+
+    if (entry->type == HSFV_TAPE_TYPE_INNER_LIST) {
+        err = hsfv_buffer_append_byte(dest, allocator, '(');
+        if (err) {
+            return err;
+        }
+        for (item = entry + 1, i = 0; i < entry->len; ++i, item = hsfv_tape_next(item)) {
+            if (i > 0) {
+                err = hsfv_buffer_append_byte(dest, allocator, ' ');
+                if (err) {
+                    return err;
+                }
+            }
+            err = serialize_tape_member(tape, item, allocator, dest);
+            if (err) {
+                return err;
+            }
+        }
+        err = hsfv_buffer_append_byte(dest, allocator, ')');
+        if (err) {
+            return err;
+        }
+    } else {
+        err = serialize_tape_bare_item(tape, entry, allocator, dest);
+        if (err) {
+            return err;
+        }
+    }
+    return serialize_tape_parameters(tape, entry, allocator, dest);
+}
+
+hsfv_err_t hsfv_serialize_tape(const hsfv_tape_t *tape, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    const hsfv_tape_entry_t *root, *entry, *end;
+    hsfv_err_t err;
+
+    root = hsfv_tape_root(tape);
+    if (root == NULL) {
+        return HSFV_ERR_INVALID;
+    }
+
+    switch (root->type) {
+    case HSFV_TAPE_TYPE_LIST:
+        end = hsfv_tape_end(root);
+        for (entry = root + 1; entry < end; entry = hsfv_tape_next(entry)) {
+            if (entry > root + 1) {
+                err = hsfv_buffer_append_bytes(dest, allocator, ", ", 2);
+                if (err) {
+                    return err;
+                }
+            }
+            err = serialize_tape_member(tape, entry, allocator, dest);
+            if (err) {
+                return err;
+            }
+        }
+        return HSFV_OK;
+    case HSFV_TAPE_TYPE_DICTIONARY:
+        end = hsfv_tape_end(root);
+        for (entry = root + 1; entry < end; entry = hsfv_tape_next(entry + 1)) {
+            if (entry > root + 1) {
+                err = hsfv_buffer_append_bytes(dest, allocator, ", ", 2);
+                if (err) {
+                    return err;
+                }
+            }
+            err = serialize_tape_key(tape, entry, allocator, dest);
+            if (err) {
+                return err;
+            }
+            if (entry[1].type == HSFV_TAPE_TYPE_BOOLEAN && entry[1].boolean) {
+                err = serialize_tape_parameters(tape, &entry[1], allocator, dest);
+            } else {
+                err = hsfv_buffer_append_byte(dest, allocator, '=');
+                if (err) {
+                    return err;
+                }
+                err = serialize_tape_member(tape, &entry[1], allocator, dest);
+            }
+            if (err) {
+                return err;
+            }
+        }
+        return HSFV_OK;
+    default:
+        return serialize_tape_member(tape, root, allocator, dest);
+    }
+}
@@ -0,0 +1,451 @@
+#include "hsfv.h"
+
+/*
+ * The transcoder follows the parser's grammar but writes each value to the
+ * output as soon as it has read it, so the only state it keeps is where the
+ * members and parameters of the open containers were written. A duplicate
+ * key is written like any other member and then moved over the bytes of
+ * the first one, which leaves the value of the last at the position of the
+ * first, as the parser does.
+ */
+
+#define TRANSCODE_INLINE_SPANS 16
+
+typedef struct st_transcode_span_t {
+    size_t start;
+    size_t end;
+    size_t key_start;
+    size_t key_len;
+} transcode_span_t;
+
+typedef struct st_transcode_index_t {
+    transcode_span_t *spans;
+    size_t len;
+    size_t capacity;
+    transcode_span_t inline_spans[TRANSCODE_INLINE_SPANS];
+} transcode_index_t;
+
+typedef struct st_transcoder_t {
+    hsfv_allocator_t *allocator;
+    hsfv_buffer_t *dest;
+    transcode_index_t members;
+    transcode_index_t params;
+} transcoder_t;
+
+static void transcode_index_init(transcode_index_t *index)
+{
+    index->spans = index->inline_spans;
+    index->len = 0;
+    index->capacity = TRANSCODE_INLINE_SPANS;
+}
+
+static void transcode_index_deinit(transcode_index_t *index, hsfv_allocator_t *allocator)
+{
+    if (index->spans != index->inline_spans) {
+        hsfv_allocator_free_sized(allocator, index->spans, index->capacity * sizeof(transcode_span_t));
+    }
+}
+
+static hsfv_err_t transcode_index_add(transcode_index_t *index, hsfv_allocator_t *allocator, const transcode_span_t *span)
+{
+    if (index->len == index->capacity) {
+        size_t new_capacity = index->capacity * 2;
+        transcode_span_t *spans2;
+        if (index->spans == index->inline_spans) {
+            spans2 = allocator->alloc(allocator, new_capacity * sizeof(transcode_span_t));
+            if (spans2 != NULL) {
+                memcpy(spans2, index->inline_spans, sizeof(index->inline_spans));
+            }
+        } else {
+            spans2 = allocator->realloc(allocator, index->spans, new_capacity * sizeof(transcode_span_t));
+        }
+        if (spans2 == NULL) {
+            return HSFV_ERR_OUT_OF_MEMORY;
+        }
+        index->spans = spans2;
+        index->capacity = new_capacity;
+    }
+    index->spans[index->len++] = *span;
+    return HSFV_OK;
+}
+
+/*
+ * moves the member written last, from new_start to the end of the output,
+ * over the bytes of index->spans[i], and drops the drop bytes of separator
+ * in front of it. The member is parked in the spare capacity of the output
+ * while the members in between are moved.
+ */
+static hsfv_err_t transcode_splice(transcoder_t *t, transcode_index_t *index, size_t i, size_t new_start, size_t drop)
+{
+    hsfv_buffer_t *dest = t->dest;
+    transcode_span_t *old = &index->spans[i];
+    size_t new_len = dest->bytes.len - new_start;
+    size_t between = new_start - drop - old->end;
+    hsfv_err_t err;
+
+    err = hsfv_buffer_ensure_unused_bytes(dest, t->allocator, new_len);
+    if (err) {
+        return err;
+    }
+    hsfv_byte_t *base = dest->bytes.base;
+    memcpy(base + dest->bytes.len, base + new_start, new_len);
+    memmove(base + old->start + new_len, base + old->end, between);
+    memcpy(base + old->start, base + dest->bytes.len, new_len);
+    dest->bytes.len = old->start + new_len + between;
+
+    /* unsigned wraparound makes this a subtraction when the member got shorter */
+    size_t shift = new_len - (old->end - old->start);
+    old->end = old->start + new_len;
+    for (size_t j = i + 1; j < index->len; j++) {
+        index->spans[j].start += shift;
+        index->spans[j].end += shift;
+        index->spans[j].key_start += shift;
+    }
+    return HSFV_OK;
+}
+
+static hsfv_err_t transcode_member_done(transcoder_t *t, transcode_index_t *index, size_t start, size_t key_start, size_t key_len,
+                                        size_t drop)
+{
+    const hsfv_byte_t *base = t->dest->bytes.base;
+
+    for (size_t i = 0; i < index->len; i++) {
+        if (index->spans[i].key_len == key_len && !memcmp(base + index->spans[i].key_start, base + key_start, key_len)) {
+            return transcode_splice(t, index, i, start, drop);
+        }
+    }
+    transcode_span_t span = {.start = start, .end = t->dest->bytes.len, .key_start = key_start, .key_len = key_len};
+    return transcode_index_add(index, t->allocator, &span);
+}
+
+static hsfv_err_t transcode_copy(transcoder_t *t, bool (*skip)(const char *, const char *, const char **), const char *input,
+                                 const char *input_end, const char **out_rest)
+{
+    if (!skip(input, input_end, out_rest)) {
+        return HSFV_ERR_INVALID;
+    }
+    return hsfv_buffer_append_bytes(t->dest, t->allocator, input, *out_rest - input);
+}
+
+static hsfv_err_t transcode_byte_seq(transcoder_t *t, const char *input, const char *input_end, const char **out_rest)
+{
+    hsfv_buffer_t *dest = t->dest;
+    const char *end, *padding;
+    hsfv_err_t err;
+
+    if (!hsfv_skip_byte_seq(input, input_end, &end)) {
+        return HSFV_ERR_INVALID;
+    }
+    *out_rest = end;
+    hsfv_iovec_const_t encoded = {.base = (const hsfv_byte_t *)input + 1, .len = end - input - 2};
+    if (hsfv_is_base64_canonical(&encoded)) {
+        return hsfv_buffer_append_bytes(dest, t->allocator, input, end - input);
+    }
+
+    /* decode into the spare capacity behind where the encoded bytes go, then encode from there */
+    padding = memchr(encoded.base, '=', encoded.len);
+    size_t decoded_len = (padding ? (size_t)((const hsfv_byte_t *)padding - encoded.base) : encoded.len) * 3 / 4;
+    size_t encoded_len = HSFV_BASE64_ENCODED_LENGTH(decoded_len);
+    err = hsfv_buffer_ensure_unused_bytes(dest, t->allocator, encoded_len + 2 + decoded_len);
+    if (err) {
+        return err;
+    }
+    hsfv_iovec_t decoded = {.base = dest->bytes.base + dest->bytes.len + encoded_len + 2, .len = decoded_len};
+    if (hsfv_decode_base64(&decoded, &encoded)) {
+        return HSFV_ERR_INVALID;
+    }
+    hsfv_iovec_const_t src = {.base = decoded.base, .len = decoded.len};
+    hsfv_iovec_t dst = {.base = dest->bytes.base + dest->bytes.len + 1, .len = encoded_len};
+    hsfv_buffer_append_byte_unchecked(dest, ':');
+    hsfv_encode_base64(&dst, &src);
+    dest->bytes.len += encoded_len;
+    hsfv_buffer_append_byte_unchecked(dest, ':');
+    return HSFV_OK;
+}
+
+static hsfv_err_t transcode_bare_item(transcoder_t *t, const char *input, const char *input_end, bool *out_is_true,
+                                      const char **out_rest)
+{
+    hsfv_bare_item_t item;
+    hsfv_err_t err;
+
+    *out_is_true = false;
+    if (input == input_end) {
+        return HSFV_ERR_EOF;
+    }
+    switch (*input) {
+    case '"':
+        return transcode_copy(t, hsfv_skip_string, input, input_end, out_rest);
+    case ':':
+        return transcode_byte_seq(t, input, input_end, out_rest);
+    case '?':
+        err = hsfv_parse_boolean(&item, input, input_end, out_rest);
+        if (err) {
+            return err;
+        }
+        *out_is_true = item.boolean;
+        return hsfv_serialize_boolean(item.boolean, t->allocator, t->dest);
+    default:
+        if (*input == '-' || HSFV_IS_DIGIT(*input)) {
+            err = hsfv_parse_number(&item, input, input_end, out_rest);
+            if (err) {
+                return err;
+            }
+            return hsfv_serialize_bare_item(&item, t->allocator, t->dest);
+        }
+        return transcode_copy(t, hsfv_skip_token, input, input_end, out_rest);
+    }
+}
+
+/* writes "=" and a bare item, or nothing for a true boolean */
+static hsfv_err_t transcode_member_bare_item(transcoder_t *t, const char *input, const char *input_end, const char **out_rest)
+{
+    size_t eq = t->dest->bytes.len;
+    bool is_true;
+    hsfv_err_t err;
+
+    err = hsfv_buffer_append_byte(t->dest, t->allocator, '=');
+    if (err) {
+        return err;
+    }
+    err = transcode_bare_item(t, input, input_end, &is_true, out_rest);
+    if (err) {
+        return err;
+    }
+    if (is_true) {
+        t->dest->bytes.len = eq;
+    }
+    return HSFV_OK;
+}
+
+static hsfv_err_t transcode_key(transcoder_t *t, const char *input, const char *input_end, size_t *out_key_len,
+                                const char **out_rest)
+{
+    if (input == input_end) {
+        return HSFV_ERR_EOF;
+    }
+    if (!hsfv_skip_key(input, input_end, out_rest)) {
+        return HSFV_ERR_INVALID;
+    }
+    *out_key_len = *out_rest - input;
+    return hsfv_buffer_append_bytes(t->dest, t->allocator, input, *out_key_len);
+}
+
+static hsfv_err_t transcode_parameters(transcoder_t *t, const char *input, const char *input_end, const char **out_rest)
+{
+    size_t start, key_len;
+    hsfv_err_t err;
+
+    t->params.len = 0;
+    while (input < input_end && *input == ';') {
+        ++input;
+        hsfv_skip_sp(input, input_end, &input);
+
+        start = t->dest->bytes.len;
+        err = hsfv_buffer_append_byte(t->dest, t->allocator, ';');
+        if (err) {
+            return err;
+        }
+        err = transcode_key(t, input, input_end, &key_len, &input);
+        if (err) {
+            return err;
+        }
+        if (input < input_end && *input == '=') {
+            err = transcode_member_bare_item(t, input + 1, input_end, &input);
+            if (err) {
+                return err;
+            }
+        }
+        err = transcode_member_done(t, &t->params, start, start + 1, key_len, 0);
+        if (err) {
+            return err;
+        }
+    }
+    *out_rest = input;
+    return HSFV_OK;
+}
+
+static hsfv_err_t transcode_item(transcoder_t *t, const char *input, const char *input_end, const char **out_rest)
+{
+    bool is_true;
+    hsfv_err_t err;
+
+    err = transcode_bare_item(t, input, input_end, &is_true, &input);
+    if (err) {
+        return err;
+    }
+    return transcode_parameters(t, input, input_end, out_rest);
+}
+
+static hsfv_err_t transcode_inner_list(transcoder_t *t, const char *input, const char *input_end, const char **out_rest)
+{
+    bool first = true;
+    hsfv_err_t err;
+
+    if (input == input_end) {
+        return HSFV_ERR_EOF;
+    }
+    if (*input != '(') {
+        return HSFV_ERR_INVALID;
+    }
+    ++input;
+    err = hsfv_buffer_append_byte(t->dest, t->allocator, '(');
+    if (err) {
+        return err;
+    }
+
+    for (;;) {
+        hsfv_skip_sp(input, input_end, &input);
+        if (input == input_end) {
+            return HSFV_ERR_EOF;
+        }
+        if (*input == ')') {
+            err = hsfv_buffer_append_byte(t->dest, t->allocator, ')');
+            if (err) {
+                return err;
+            }
+            return transcode_parameters(t, input + 1, input_end, out_rest);
+        }
+
+        if (!first) {
+            err = hsfv_buffer_append_byte(t->dest, t->allocator, ' ');
+            if (err) {
+                return err;
+            }
+        }
+        first = false;
+        err = transcode_item(t, input, input_end, &input);
+        if (err) {
+            return err;
+        }
+        if (input == input_end) {
+            return HSFV_ERR_EOF;
+        }
+        if (*input != ' ' && *input != ')') {
+            return HSFV_ERR_INVALID;
+        }
+    }
+}
+
+static hsfv_err_t transcode_list_member(transcoder_t *t, const char *input, const char *input_end, const char **out_rest)
+{
+    if (*input == '(') {
+        return transcode_inner_list(t, input, input_end, out_rest);
+    }
+    return transcode_item(t, input, input_end, out_rest);
+}
+
+static hsfv_err_t transcode_dict_member(transcoder_t *t, const char *input, const char *input_end, const char **out_rest)
+{
+    size_t start = t->dest->bytes.len, key_len;
+    hsfv_err_t err;
+
+    err = transcode_key(t, input, input_end, &key_len, &input);
+    if (err) {
+        return err;
+    }
+    if (input < input_end && *input == '=') {
+        ++input;
+        if (input < input_end && *input == '(') {
+            err = hsfv_buffer_append_byte(t->dest, t->allocator, '=');
+            if (!err) {
+                err = transcode_inner_list(t, input, input_end, &input);
+            }
+        } else {
+            err = transcode_member_bare_item(t, input, input_end, &input);
+            if (!err) {
+                err = transcode_parameters(t, input, input_end, &input);
+            }
+        }
+    } else {
+        err = transcode_parameters(t, input, input_end, &input);
+    }
+    if (err) {
+        return err;
+    }
+    *out_rest = input;
+    /* a duplicate is never the first member, so it always follows a ", " */
+    return transcode_member_done(t, &t->members, start, start, key_len, 2);
+}
+
+static hsfv_err_t transcode_members(transcoder_t *t, hsfv_err_t (*member)(transcoder_t *, const char *, const char *, const char **),
+                                    const char *input, const char *input_end, const char **out_rest)
+{
+    size_t start_len = t->dest->bytes.len;
+    hsfv_err_t err;
+
+    while (input < input_end) {
+        if (t->dest->bytes.len > start_len) {
+            err = hsfv_buffer_append_bytes(t->dest, t->allocator, ", ", 2);
+            if (err) {
+                return err;
+            }
+        }
+        err = member(t, input, input_end, &input);
+        if (err) {
+            return err;
+        }
+
+        hsfv_skip_ows(input, input_end, &input);
+        if (input < input_end) {
+            if (*input != ',') {
+                return HSFV_ERR_INVALID;
+            }
+            ++input;
+            hsfv_skip_ows(input, input_end, &input);
+            if (input == input_end) {
+                return HSFV_ERR_EOF;
+            }
+        }
+    }
+    *out_rest = input;
+    return HSFV_OK;
+}
+
+hsfv_err_t hsfv_transcode(hsfv_field_value_type_t field_type, const char *input, const char *input_end, hsfv_allocator_t *allocator,
+                          hsfv_buffer_t *dest)
+{
+    transcoder_t t = {.allocator = allocator, .dest = dest};
+    size_t start_len = dest->bytes.len;
+    hsfv_err_t err;
+
+    if (!hsfv_is_ascii_string(input, input_end)) {
+        return HSFV_ERR_INVALID;
+    }
+    /* canonical output is rarely longer than the input, so this is usually the only allocation */
+    err = hsfv_buffer_ensure_unused_bytes(dest, allocator, input_end - input);
+    if (err) {
+        return err;
+    }
+    transcode_index_init(&t.members);
+    transcode_index_init(&t.params);
+
+    hsfv_skip_sp(input, input_end, &input);
+    switch (field_type) {
+    case HSFV_FIELD_VALUE_TYPE_LIST:
+        err = transcode_members(&t, transcode_list_member, input, input_end, &input);
+        break;
+    case HSFV_FIELD_VALUE_TYPE_DICTIONARY:
+        err = transcode_members(&t, transcode_dict_member, input, input_end, &input);
+        break;
+    case HSFV_FIELD_VALUE_TYPE_ITEM:
+        err = transcode_item(&t, input, input_end, &input);
+        break;
+    default:
+        err = HSFV_ERR_INVALID;
+        break;
+    }
+    if (!err) {
+        hsfv_skip_sp(input, input_end, &input);
+        if (input < input_end) {
+            err = HSFV_ERR_INVALID;
+        }
+    }
+
+    if (err) {
+        dest->bytes.len = start_len;
+    }
+    transcode_index_deinit(&t.members, allocator);
+    transcode_index_deinit(&t.params, allocator);
+    return err;
+}
@@ -61,3 +61,343 @@ TEST_CASE("hsfv_bytes_dup", "[allocator]")
         CHECK(copy == NULL);
     }
 }
+
+TEST_CASE("arena", "[allocator][arena]")
+{
+    SECTION("alloc and free")
+    {
+        hsfv_arena_t arena;
+        hsfv_arena_init(&arena, &hsfv_global_allocator, 64);
+        hsfv_allocator_t *allocator = &arena.allocator;
+
+        char *buf1 = (char *)allocator->alloc(allocator, 3);
+        REQUIRE(buf1 != NULL);
+        memcpy(buf1, "abc", 3);
+        char *buf2 = (char *)allocator->alloc(allocator, 5);
+        REQUIRE(buf2 != NULL);
+        CHECK(buf2 >= buf1 + 3);
+        memcpy(buf2, "defgh", 5);
+        CHECK(!memcmp(buf1, "abc", 3));
+
+        /* freeing the last block makes its space available again */
+        allocator->free(allocator, buf2);
+        char *buf3 = (char *)allocator->alloc(allocator, 5);
+        CHECK(buf3 == buf2);
+
+        /* freeing other blocks is a no-op */
+        allocator->free(allocator, buf1);
+        CHECK(!memcmp(buf1, "abc", 3));
+
+        hsfv_arena_deinit(&arena);
+    }
+
+    SECTION("realloc")
+    {
+        hsfv_arena_t arena;
+        hsfv_arena_init(&arena, &hsfv_global_allocator, 64);
+        hsfv_allocator_t *allocator = &arena.allocator;
+
+        char *buf1 = (char *)allocator->realloc(allocator, NULL, 3);
+        REQUIRE(buf1 != NULL);
+        memcpy(buf1, "abc", 3);
+
+        /* the last block grows in place */
+        char *buf2 = (char *)allocator->realloc(allocator, buf1, 16);
+        CHECK(buf2 == buf1);
+        CHECK(!memcmp(buf2, "abc", 3));
+
+        char *other = (char *)allocator->alloc(allocator, 8);
+        REQUIRE(other != NULL);
+
+        /* other blocks are copied */
+        char *buf3 = (char *)allocator->realloc(allocator, buf2, 24);
+        REQUIRE(buf3 != NULL);
+        CHECK(buf3 != buf2);
+        CHECK(!memcmp(buf3, "abc", 3));
+
+        /* shrinking never moves */
+        CHECK(allocator->realloc(allocator, buf2, 4) == buf2);
+
+        /* growing beyond the chunk size takes a new chunk */
+        char *big = (char *)allocator->realloc(allocator, buf3, 256);
+        REQUIRE(big != NULL);
+        CHECK(!memcmp(big, "abc", 3));
+
+        hsfv_arena_deinit(&arena);
+    }
+
+    SECTION("reset merges chunks")
+    {
+        hsfv_allocator_t *backing = &hsfv_failing_allocator.allocator;
+        hsfv_failing_allocator.fail_index = -1;
+        hsfv_failing_allocator.alloc_count = 0;
+
+        hsfv_arena_t arena;
+        hsfv_arena_init(&arena, backing, 64);
+        hsfv_allocator_t *allocator = &arena.allocator;
+
+        for (int i = 0; i < 10; i++) {
+            CHECK(allocator->alloc(allocator, 32) != NULL);
+        }
+        CHECK(hsfv_failing_allocator.alloc_count == 10);
+
+        hsfv_arena_reset(&arena);
+        CHECK(hsfv_failing_allocator.alloc_count == 11);
+
+        for (int i = 0; i < 10; i++) {
+            CHECK(allocator->alloc(allocator, 32) != NULL);
+        }
+        CHECK(hsfv_failing_allocator.alloc_count == 11);
+
+        hsfv_arena_deinit(&arena);
+    }
+
+    SECTION("alloc error")
+    {
+        hsfv_allocator_t *backing = &hsfv_failing_allocator.allocator;
+        hsfv_failing_allocator.fail_index = 0;
+        hsfv_failing_allocator.alloc_count = 0;
+
+        hsfv_arena_t arena;
+        hsfv_arena_init(&arena, backing, 64);
+        hsfv_allocator_t *allocator = &arena.allocator;
+        CHECK(allocator->alloc(allocator, 8) == NULL);
+        CHECK(allocator->realloc(allocator, NULL, 8) == NULL);
+        hsfv_arena_reset(&arena);
+        hsfv_arena_deinit(&arena);
+    }
+}
+
+TEST_CASE("counting_allocator", "[allocator][counting]")
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_allocator_t *allocator = &counter.allocator;
+
+    void *buf = allocator->alloc(allocator, 8);
+    REQUIRE(buf != NULL);
+    CHECK(counter.alloc_count == 1);
+    CHECK(counter.live_bytes == 8);
+
+    void *buf2 = allocator->realloc(allocator, buf, 100);
+    REQUIRE(buf2 != NULL);
+    CHECK(counter.realloc_count == 1);
+    CHECK(counter.live_bytes == 100);
+
+    void *buf3 = allocator->realloc(allocator, NULL, 1);
+    REQUIRE(buf3 != NULL);
+    CHECK(counter.realloc_count == 2);
+    CHECK(counter.live_bytes == 101);
+    CHECK(counter.peak_bytes == 101);
+
+    allocator->free(allocator, buf2);
+    allocator->free(allocator, NULL);
+    CHECK(counter.free_count == 1);
+    CHECK(counter.live_bytes == 1);
+    CHECK(counter.peak_bytes == 101);
+
+    CHECK(counter.size_histogram[0] == 1);
+    CHECK(counter.size_histogram[3] == 1);
+    CHECK(counter.size_histogram[7] == 1);
+
+    hsfv_counting_allocator_reset_stats(&counter);
+    CHECK(counter.alloc_count == 0);
+    CHECK(counter.realloc_count == 0);
+    CHECK(counter.free_count == 0);
+    CHECK(counter.peak_bytes == 1);
+    CHECK(counter.size_histogram[0] == 0);
+
+    allocator->free(allocator, buf3);
+    CHECK(counter.live_bytes == 0);
+
+    SECTION("alloc error")
+    {
+        hsfv_failing_allocator.fail_index = 0;
+        hsfv_failing_allocator.alloc_count = 0;
+        hsfv_counting_allocator_init(&counter, &hsfv_failing_allocator.allocator);
+        CHECK(allocator->alloc(allocator, 8) == NULL);
+        CHECK(allocator->realloc(allocator, NULL, 8) == NULL);
+        CHECK(counter.alloc_count == 0);
+        CHECK(counter.realloc_count == 0);
+        CHECK(counter.live_bytes == 0);
+    }
+}
+
+TEST_CASE("optional allocator hooks", "[allocator]")
+{
+    SECTION("global_allocator")
+    {
+        hsfv_allocator_t *allocator = &hsfv_global_allocator;
+        void *buf = hsfv_allocator_alloc_aligned(allocator, 100, 64);
+        REQUIRE(buf != NULL);
+        CHECK((uintptr_t)buf % 64 == 0);
+        allocator->free(allocator, buf);
+        hsfv_allocator_free_sized(allocator, allocator->alloc(allocator, 8), 8);
+        CHECK(!hsfv_allocator_try_expand_in_place(allocator, NULL, 8));
+    }
+
+    SECTION("fallbacks")
+    {
+        hsfv_allocator_t *allocator = &hsfv_failing_allocator.allocator;
+        hsfv_failing_allocator.fail_index = -1;
+        hsfv_failing_allocator.alloc_count = 0;
+        void *buf = hsfv_allocator_alloc_aligned(allocator, 8, HSFV_ALLOCATOR_MIN_ALIGNMENT);
+        REQUIRE(buf != NULL);
+        CHECK(hsfv_failing_allocator.alloc_count == 1);
+        CHECK(hsfv_allocator_alloc_aligned(allocator, 8, 64) == NULL);
+        CHECK(!hsfv_allocator_try_expand_in_place(allocator, buf, 4));
+        hsfv_allocator_free_sized(allocator, buf, 8);
+    }
+
+    SECTION("arena")
+    {
+        hsfv_arena_t arena;
+        hsfv_arena_init(&arena, &hsfv_global_allocator, 256);
+        hsfv_allocator_t *allocator = &arena.allocator;
+
+        void *buf = allocator->alloc(allocator, 3);
+        void *buf2 = hsfv_allocator_alloc_aligned(allocator, 10, 64);
+        REQUIRE(buf2 != NULL);
+        CHECK((uintptr_t)buf2 % 64 == 0);
+        CHECK(!hsfv_allocator_try_expand_in_place(allocator, buf, 16));
+        CHECK(hsfv_allocator_try_expand_in_place(allocator, buf, 2));
+        CHECK(hsfv_allocator_try_expand_in_place(allocator, buf2, 100));
+        CHECK(!hsfv_allocator_try_expand_in_place(allocator, buf2, 1000));
+        void *buf3 = allocator->alloc(allocator, 8);
+        CHECK((hsfv_byte_t *)buf3 >= (hsfv_byte_t *)buf2 + 100);
+
+        /* an aligned block which does not fit the current chunk goes to a new one */
+        void *buf4 = hsfv_allocator_alloc_aligned(allocator, 200, 128);
+        REQUIRE(buf4 != NULL);
+        CHECK((uintptr_t)buf4 % 128 == 0);
+        hsfv_arena_deinit(&arena);
+    }
+
+    SECTION("counting_allocator")
+    {
+        hsfv_arena_t arena;
+        hsfv_arena_init(&arena, &hsfv_global_allocator, 0);
+        hsfv_counting_allocator_t counter;
+        hsfv_counting_allocator_init(&counter, &arena.allocator);
+        hsfv_allocator_t *allocator = &counter.allocator;
+
+        void *buf = allocator->alloc(allocator, 8);
+        CHECK(hsfv_allocator_try_expand_in_place(allocator, buf, 24));
+        CHECK(counter.live_bytes == 24);
+        hsfv_allocator_free_sized(allocator, buf, 8);
+        CHECK(counter.free_size_mismatches == 1);
+        buf = allocator->alloc(allocator, 8);
+        hsfv_allocator_free_sized(allocator, buf, 8);
+        CHECK(counter.free_size_mismatches == 1);
+        CHECK(counter.live_bytes == 0);
+
+        buf = hsfv_allocator_alloc_aligned(allocator, 40, 64);
+        REQUIRE(buf != NULL);
+        CHECK((uintptr_t)buf % 64 == 0);
+        CHECK(counter.live_bytes == 40);
+        CHECK(hsfv_allocator_try_expand_in_place(allocator, buf, 48));
+        hsfv_allocator_free_sized(allocator, buf, 48);
+        CHECK(counter.free_size_mismatches == 1);
+        CHECK(counter.live_bytes == 0);
+        hsfv_arena_deinit(&arena);
+    }
+}
+
+TEST_CASE("library frees pass allocation sizes", "[allocator][counting]")
+{
+    const char *list_input = "a-long-enough-token;param-one=1;param-two=\"a long enough string value\";p3=:AQIDBAUGBwgJCgsMDQ4PEBES:, "
+                             "(abcdefghijklmnopqrstuvwxyz b c d e f g h i j);x;y;z, :AQIDBAUGBwgJCgsMDQ4PEA==:, :AQIDBAUGBwgJCgsMDQ4PEBE=:, "
+                             "1, 2, 3, 4, 5, 6, 7, 8";
+    const char *dict_input = "a-long-enough-key-name=1, b, c, d, e, f, g, h, i=\"another string long enough\"";
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_allocator_t *allocator = &counter.allocator;
+    hsfv_field_value_t list, dict, decoded;
+    hsfv_buffer_t buf = (hsfv_buffer_t){0}, encoded = (hsfv_buffer_t){0};
+    hsfv_tape_t tape = (hsfv_tape_t){0};
+    hsfv_compact_t compact = (hsfv_compact_t){0};
+    hsfv_err_t err;
+
+    err = hsfv_parse_field_value(&list, HSFV_FIELD_VALUE_TYPE_LIST, allocator, list_input, list_input + strlen(list_input), NULL);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_parse_field_value(&dict, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, dict_input, dict_input + strlen(dict_input),
+                                 NULL);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_serialize_field_value(&list, allocator, &buf);
+    CHECK(err == HSFV_OK);
+    err = hsfv_encode_binary(&list, allocator, &encoded);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_decode_binary(&decoded, allocator, (const hsfv_byte_t *)encoded.bytes.base, encoded.bytes.len);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_parse_tape(&tape, HSFV_FIELD_VALUE_TYPE_LIST, allocator, list_input, list_input + strlen(list_input), NULL);
+    CHECK(err == HSFV_OK);
+    err = hsfv_parse_compact(&compact, HSFV_FIELD_VALUE_TYPE_LIST, allocator, list_input, list_input + strlen(list_input), NULL);
+    CHECK(err == HSFV_OK);
+
+    hsfv_field_value_deinit(&list, allocator);
+    hsfv_field_value_deinit(&dict, allocator);
+    hsfv_field_value_deinit(&decoded, allocator);
+    hsfv_buffer_deinit(&buf, allocator);
+    hsfv_buffer_deinit(&encoded, allocator);
+    hsfv_tape_deinit(&tape, allocator);
+    hsfv_compact_deinit(&compact, allocator);
+    CHECK(counter.free_size_mismatches == 0);
+    CHECK(counter.live_bytes == 0);
+}
+
+/*
+ * Allocation budgets for representative header values. When a change makes
+ * parsing allocate more, these fail; when it allocates less, lower them.
+ */
+static void parse_allocation_budget_test(hsfv_field_value_type_t field_type, const char *input, size_t max_allocations,
+                                         size_t max_peak_bytes)
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+
+    hsfv_field_value_t field_value;
+    hsfv_err_t err = hsfv_parse_field_value(&field_value, field_type, &counter.allocator, input, input + strlen(input), NULL);
+    REQUIRE(err == HSFV_OK);
+    hsfv_field_value_deinit(&field_value, &counter.allocator);
+
+    if (counter.alloc_count + counter.realloc_count > max_allocations || counter.peak_bytes > max_peak_bytes) {
+        printf("input=[%s]\n", input);
+        hsfv_counting_allocator_report(&counter, stdout);
+    }
+    CHECK(counter.alloc_count + counter.realloc_count <= max_allocations);
+    CHECK(counter.peak_bytes <= max_peak_bytes);
+    CHECK(counter.live_bytes == 0);
+    CHECK(counter.free_size_mismatches == 0);
+}
+
+TEST_CASE("parse allocation budget", "[allocator][counting][budget]")
+{
+    SECTION("10-member dictionary")
+    {
+        parse_allocation_budget_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=1, b=2, c=3, d=4, e=5, f=6, g=7, h=8, i=9, j=10", 2, 1152);
+    }
+    SECTION("cache-status")
+    {
+        parse_allocation_budget_test(HSFV_FIELD_VALUE_TYPE_LIST,
+                                     "ExampleCache; hit; ttl=376, OriginCache; fwd=stale; fwd-status=304; stored", 3, 648);
+    }
+    SECTION("priority")
+    {
+        parse_allocation_budget_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "u=1, i", 1, 576);
+    }
+    SECTION("signature-input")
+    {
+        parse_allocation_budget_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY,
+                                     "sig1=(\"@method\" \"@authority\" \"@path\" \"content-digest\");created=1618884475;keyid=\"test-key\"",
+                                     3, 1040);
+    }
+    SECTION("cdn-cache-control")
+    {
+        parse_allocation_budget_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "max-age=3600, stale-while-revalidate=60, must-revalidate", 1,
+                                     576);
+    }
+    SECTION("item")
+    {
+        parse_allocation_budget_test(HSFV_FIELD_VALUE_TYPE_ITEM, "?1", 0, 0);
+    }
+}
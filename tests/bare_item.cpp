@@ -1243,3 +1243,114 @@ TEST_CASE("parse bare_item", "[parse][bare_item]")
         parse_bare_item_ng_test("~", HSFV_ERR_INVALID);
     }
 }
+
+/* Inline storage */
+
+static void parse_inline_test(hsfv_bare_item_type_t type, const char *input, const char *want, size_t want_len, bool want_inline)
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    const char *input_end = input + strlen(input);
+    hsfv_bare_item_t item;
+    hsfv_err_t err;
+    const char *rest;
+
+    err = hsfv_parse_bare_item(&item, &counter.allocator, input, input_end, &rest);
+    REQUIRE(err == HSFV_OK);
+    REQUIRE(item.type == type);
+    switch (type) {
+    case HSFV_BARE_ITEM_TYPE_STRING:
+        CHECK(!!(item.string.len & HSFV_INLINE_FLAG) == want_inline);
+        CHECK(hsfv_string_len(&item.string) == want_len);
+        CHECK(!memcmp(hsfv_string_base(&item.string), want, want_len));
+        break;
+    case HSFV_BARE_ITEM_TYPE_TOKEN:
+        CHECK(!!(item.token.len & HSFV_INLINE_FLAG) == want_inline);
+        CHECK(hsfv_token_len(&item.token) == want_len);
+        CHECK(!memcmp(hsfv_token_base(&item.token), want, want_len));
+        break;
+    case HSFV_BARE_ITEM_TYPE_BYTE_SEQ:
+        CHECK(!!(item.byte_seq.len & HSFV_INLINE_FLAG) == want_inline);
+        CHECK(hsfv_byte_seq_len(&item.byte_seq) == want_len);
+        CHECK(!memcmp(hsfv_byte_seq_base(&item.byte_seq), want, want_len));
+        break;
+    default:
+        FAIL("unexpected type");
+    }
+    CHECK((counter.alloc_count == 0) == want_inline);
+
+    hsfv_bare_item_t copy = item;
+    CHECK(hsfv_bare_item_eq(&item, &copy));
+
+    hsfv_bare_item_deinit(&item, &counter.allocator);
+    CHECK(counter.live_bytes == 0);
+}
+
+TEST_CASE("parse inline storage", "[parse][inline]")
+{
+    char longest[HSFV_INLINE_CAPACITY + 1];
+    char too_long[HSFV_INLINE_CAPACITY + 2];
+    memset(longest, 'a', HSFV_INLINE_CAPACITY);
+    longest[HSFV_INLINE_CAPACITY] = '\0';
+    memset(too_long, 'a', HSFV_INLINE_CAPACITY + 1);
+    too_long[HSFV_INLINE_CAPACITY + 1] = '\0';
+
+    SECTION("short token")
+    {
+        parse_inline_test(HSFV_BARE_ITEM_TYPE_TOKEN, "foo/bar", "foo/bar", 7, true);
+    }
+    SECTION("longest inline token")
+    {
+        parse_inline_test(HSFV_BARE_ITEM_TYPE_TOKEN, longest, longest, HSFV_INLINE_CAPACITY, true);
+    }
+    SECTION("token too long to inline")
+    {
+        parse_inline_test(HSFV_BARE_ITEM_TYPE_TOKEN, too_long, too_long, HSFV_INLINE_CAPACITY + 1, false);
+    }
+    SECTION("empty string")
+    {
+        parse_inline_test(HSFV_BARE_ITEM_TYPE_STRING, "\"\"", "", 0, true);
+    }
+    SECTION("escaped string")
+    {
+        parse_inline_test(HSFV_BARE_ITEM_TYPE_STRING, "\"a\\\"b\\\\c\"", "a\"b\\c", 5, true);
+    }
+    SECTION("string too long to inline")
+    {
+        parse_inline_test(HSFV_BARE_ITEM_TYPE_STRING, "\"content-digest-sha\"", "content-digest-sha", 18, false);
+    }
+    SECTION("short byte_seq")
+    {
+        parse_inline_test(HSFV_BARE_ITEM_TYPE_BYTE_SEQ, ":aGVsbG8=:", "hello", 5, true);
+    }
+    SECTION("byte_seq too long to inline")
+    {
+        parse_inline_test(HSFV_BARE_ITEM_TYPE_BYTE_SEQ, ":cHJldGVuZCB0aGlzIGlzIGJpbmFyeSBjb250ZW50Lg==:",
+                          "pretend this is binary content.", 31, false);
+    }
+}
+
+TEST_CASE("inline and allocated values compare equal", "[eq][inline]")
+{
+    hsfv_key_t parsed;
+    hsfv_err_t err;
+    const char *input = "k1";
+    const char *rest;
+
+    err = hsfv_parse_key(&parsed, &hsfv_global_allocator, input, input + strlen(input), &rest);
+    REQUIRE(err == HSFV_OK);
+    REQUIRE((parsed.len & HSFV_INLINE_FLAG));
+
+    hsfv_key_t built = {.base = "k1", .len = 2};
+    CHECK(hsfv_key_eq(&parsed, &built));
+    CHECK(hsfv_key_eq(&built, &parsed));
+    CHECK(hsfv_key_id(&parsed) == HSFV_ID_NONE);
+
+    hsfv_buffer_t buf = (hsfv_buffer_t){0};
+    err = hsfv_serialize_key(&parsed, &hsfv_global_allocator, &buf);
+    CHECK(err == HSFV_OK);
+    CHECK(buf.bytes.len == 2);
+    CHECK(!memcmp(buf.bytes.base, "k1", 2));
+    hsfv_buffer_deinit(&buf, &hsfv_global_allocator);
+    hsfv_key_deinit(&parsed, &hsfv_global_allocator);
+}
@@ -0,0 +1,176 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+
+static void encode_binary_round_trip_test(hsfv_field_value_type_t field_type, const char *input)
+{
+    hsfv_allocator_t *allocator = &hsfv_global_allocator;
+    hsfv_field_value_t parsed, decoded;
+    hsfv_buffer_t encoded = (hsfv_buffer_t){0};
+    hsfv_err_t err;
+
+    err = hsfv_parse_field_value(&parsed, field_type, allocator, input, input + strlen(input), NULL);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_encode_binary(&parsed, allocator, &encoded);
+    CHECK(err == HSFV_OK);
+
+    err = hsfv_decode_binary(&decoded, allocator, encoded.bytes.base, encoded.bytes.len);
+    CHECK(err == HSFV_OK);
+    CHECK(hsfv_field_value_eq(&parsed, &decoded));
+    hsfv_field_value_deinit(&decoded, allocator);
+
+    /* every truncation must be rejected without reading past the end */
+    for (size_t len = 0; len < encoded.bytes.len; len++) {
+        hsfv_byte_t *truncated = (hsfv_byte_t *)malloc(hsfv_max(len, 1));
+        memcpy(truncated, encoded.bytes.base, len);
+        err = hsfv_decode_binary(&decoded, allocator, truncated, len);
+        CHECK(err != HSFV_OK);
+        free(truncated);
+    }
+
+    hsfv_buffer_deinit(&encoded, allocator);
+    hsfv_field_value_deinit(&parsed, allocator);
+}
+
+TEST_CASE("binary round trip", "[binary]")
+{
+    SECTION("item")
+    {
+        encode_binary_round_trip_test(HSFV_FIELD_VALUE_TYPE_ITEM, "?1");
+        encode_binary_round_trip_test(HSFV_FIELD_VALUE_TYPE_ITEM, "-99999999999999");
+        encode_binary_round_trip_test(HSFV_FIELD_VALUE_TYPE_ITEM, "99999999999.99;a=-0.01;b=-1.125");
+        encode_binary_round_trip_test(HSFV_FIELD_VALUE_TYPE_ITEM, "\"\";e=:: ");
+        encode_binary_round_trip_test(HSFV_FIELD_VALUE_TYPE_ITEM, ":cHJldGVuZCB0aGlzIGlzIGJpbmFyeSBjb250ZW50Lg==:;x=tok");
+    }
+    SECTION("list")
+    {
+        encode_binary_round_trip_test(HSFV_FIELD_VALUE_TYPE_LIST, "");
+        encode_binary_round_trip_test(HSFV_FIELD_VALUE_TYPE_LIST, "ExampleCache; hit; ttl=376, OriginCache; fwd=stale; stored");
+        encode_binary_round_trip_test(HSFV_FIELD_VALUE_TYPE_LIST, "(), (a b);c=?0, \"str\"");
+    }
+    SECTION("dictionary")
+    {
+        encode_binary_round_trip_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "u=1, i");
+        encode_binary_round_trip_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY,
+                                      "sig1=(\"@method\" \"@authority\" \"@path\");created=1618884475;keyid=\"test-key\"");
+    }
+}
+
+TEST_CASE("binary view", "[binary]")
+{
+    hsfv_allocator_t *allocator = &hsfv_global_allocator;
+    const char *input = "ExampleCache; hit; ttl=376, (a b);x, OriginCache; fwd=stale";
+    hsfv_field_value_t parsed;
+    hsfv_buffer_t encoded = (hsfv_buffer_t){0};
+    hsfv_field_value_type_t type;
+    hsfv_binary_cursor_t root;
+    hsfv_binary_member_t member, param, item;
+    hsfv_err_t err;
+
+    err = hsfv_parse_field_value(&parsed, HSFV_FIELD_VALUE_TYPE_LIST, allocator, input, input + strlen(input), NULL);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_encode_binary(&parsed, allocator, &encoded);
+    REQUIRE(err == HSFV_OK);
+
+    err = hsfv_binary_view(encoded.bytes.base, encoded.bytes.len, &type, &root);
+    REQUIRE(err == HSFV_OK);
+    CHECK(type == HSFV_FIELD_VALUE_TYPE_LIST);
+    CHECK(root.remaining == 3);
+
+    REQUIRE(hsfv_binary_next(&root, &member) == HSFV_OK);
+    CHECK(!member.is_inner_list);
+    CHECK(member.bare_item.type == HSFV_BARE_ITEM_TYPE_TOKEN);
+    CHECK(hsfv_token_eq(&member.bare_item.token, &parsed.list.members[0].item.bare_item.token));
+    /* the token points into the encoded bytes */
+    CHECK((const hsfv_byte_t *)hsfv_token_base(&member.bare_item.token) > encoded.bytes.base);
+    CHECK((const hsfv_byte_t *)hsfv_token_base(&member.bare_item.token) < encoded.bytes.base + encoded.bytes.len);
+    REQUIRE(hsfv_binary_lookup(&member.parameters, "ttl", 3, &param) == HSFV_OK);
+    CHECK(param.bare_item.type == HSFV_BARE_ITEM_TYPE_INTEGER);
+    CHECK(param.bare_item.integer == 376);
+    CHECK(hsfv_binary_lookup(&member.parameters, "fwd", 3, &param) == HSFV_ERR_EOF);
+
+    REQUIRE(hsfv_binary_next(&root, &member) == HSFV_OK);
+    CHECK(member.is_inner_list);
+    CHECK(member.items.remaining == 2);
+    REQUIRE(hsfv_binary_next(&member.items, &item) == HSFV_OK);
+    REQUIRE(hsfv_binary_next(&member.items, &item) == HSFV_OK);
+    CHECK(hsfv_token_len(&item.bare_item.token) == 1);
+    CHECK(hsfv_binary_next(&member.items, &item) == HSFV_ERR_EOF);
+    CHECK(member.parameters.remaining == 1);
+
+    REQUIRE(hsfv_binary_next(&root, &member) == HSFV_OK);
+    REQUIRE(hsfv_binary_lookup(&member.parameters, "fwd", 3, &param) == HSFV_OK);
+    CHECK(param.bare_item.type == HSFV_BARE_ITEM_TYPE_TOKEN);
+    CHECK(hsfv_binary_next(&root, &member) == HSFV_ERR_EOF);
+    CHECK(hsfv_binary_lookup(&root, "fwd", 3, &param) == HSFV_ERR_INVALID);
+
+    hsfv_buffer_deinit(&encoded, allocator);
+    hsfv_field_value_deinit(&parsed, allocator);
+}
+
+TEST_CASE("binary decode ng", "[binary]")
+{
+    hsfv_field_value_t decoded;
+
+    SECTION("wrong version")
+    {
+        const hsfv_byte_t input[] = {HSFV_BINARY_VERSION + 1, HSFV_FIELD_VALUE_TYPE_LIST, 0};
+        CHECK(hsfv_decode_binary(&decoded, &hsfv_global_allocator, input, sizeof(input)) == HSFV_ERR_INVALID);
+    }
+    SECTION("trailing bytes")
+    {
+        const hsfv_byte_t input[] = {HSFV_BINARY_VERSION, HSFV_FIELD_VALUE_TYPE_ITEM, 6, 0};
+        CHECK(hsfv_decode_binary(&decoded, &hsfv_global_allocator, input, sizeof(input)) == HSFV_ERR_INVALID);
+    }
+    SECTION("count larger than members")
+    {
+        const hsfv_byte_t input[] = {HSFV_BINARY_VERSION, HSFV_FIELD_VALUE_TYPE_LIST, 2, 2, 6};
+        CHECK(hsfv_decode_binary(&decoded, &hsfv_global_allocator, input, sizeof(input)) == HSFV_ERR_INVALID);
+    }
+    SECTION("inner list in inner list")
+    {
+        const hsfv_byte_t input[] = {HSFV_BINARY_VERSION, HSFV_FIELD_VALUE_TYPE_LIST, 5, 1, 8, 2, 1, 8, 0};
+        CHECK(hsfv_decode_binary(&decoded, &hsfv_global_allocator, input, sizeof(input)) == HSFV_ERR_INVALID);
+    }
+    SECTION("integer out of range")
+    {
+        hsfv_bare_item_t bare_item = {.type = HSFV_BARE_ITEM_TYPE_INTEGER, .integer = HSFV_MAX_INT + 1};
+        hsfv_field_value_t field_value = {.type = HSFV_FIELD_VALUE_TYPE_ITEM};
+        field_value.item.bare_item = bare_item;
+        hsfv_buffer_t encoded = (hsfv_buffer_t){0};
+        CHECK(hsfv_encode_binary(&field_value, &hsfv_global_allocator, &encoded) == HSFV_ERR_INVALID);
+        CHECK(encoded.bytes.len == 0);
+        hsfv_buffer_deinit(&encoded, &hsfv_global_allocator);
+    }
+}
+
+TEST_CASE("binary decode alloc error", "[binary]")
+{
+    hsfv_allocator_t *allocator = &hsfv_failing_allocator.allocator;
+    const char *input = "a=(x \"y\");p=:AQ==:, b;q=1, c=tok";
+    hsfv_field_value_t parsed, decoded;
+    hsfv_buffer_t encoded = (hsfv_buffer_t){0};
+    hsfv_err_t err;
+
+    err = hsfv_parse_field_value(&parsed, HSFV_FIELD_VALUE_TYPE_DICTIONARY, &hsfv_global_allocator, input, input + strlen(input),
+                                 NULL);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_encode_binary(&parsed, &hsfv_global_allocator, &encoded);
+    REQUIRE(err == HSFV_OK);
+
+    hsfv_failing_allocator.fail_index = -1;
+    hsfv_failing_allocator.alloc_count = 0;
+    err = hsfv_decode_binary(&decoded, allocator, encoded.bytes.base, encoded.bytes.len);
+    CHECK(err == HSFV_OK);
+    hsfv_field_value_deinit(&decoded, allocator);
+
+    int alloc_count = hsfv_failing_allocator.alloc_count;
+    for (int i = 0; i < alloc_count; i++) {
+        hsfv_failing_allocator.fail_index = i;
+        hsfv_failing_allocator.alloc_count = 0;
+        err = hsfv_decode_binary(&decoded, allocator, encoded.bytes.base, encoded.bytes.len);
+        CHECK(err == HSFV_ERR_OUT_OF_MEMORY);
+    }
+
+    hsfv_buffer_deinit(&encoded, &hsfv_global_allocator);
+    hsfv_field_value_deinit(&parsed, &hsfv_global_allocator);
+}
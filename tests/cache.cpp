@@ -0,0 +1,255 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const hsfv_field_value_t *cache_parse(hsfv_cache_t *cache, hsfv_field_value_type_t field_type, const char *input)
+{
+    const hsfv_field_value_t *field_value = NULL;
+    hsfv_err_t err = hsfv_cache_parse(cache, field_type, input, input + strlen(input), &field_value);
+    CHECK(err == HSFV_OK);
+    return field_value;
+}
+
+TEST_CASE("cache parse", "[cache]")
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_cache_t *cache = hsfv_cache_create(&counter.allocator, 4);
+    REQUIRE(cache != NULL);
+    hsfv_cache_stats_t stats;
+
+    SECTION("hit")
+    {
+        const char *input = "ExampleCache; hit; ttl=376, OriginCache; fwd=stale";
+        const hsfv_field_value_t *v1 = cache_parse(cache, HSFV_FIELD_VALUE_TYPE_LIST, input);
+        REQUIRE(v1 != NULL);
+        size_t alloc_count = counter.alloc_count;
+
+        /* equal bytes at a different address hit the same entry without allocating */
+        std::string copy(input);
+        const hsfv_field_value_t *v2 = cache_parse(cache, HSFV_FIELD_VALUE_TYPE_LIST, copy.c_str());
+        CHECK(v2 == v1);
+        CHECK(counter.alloc_count == alloc_count);
+
+        hsfv_field_value_t parsed;
+        REQUIRE(hsfv_parse_field_value(&parsed, HSFV_FIELD_VALUE_TYPE_LIST, &hsfv_global_allocator, input, input + strlen(input),
+                                       NULL) == HSFV_OK);
+        CHECK(hsfv_field_value_eq(v1, &parsed));
+        hsfv_field_value_deinit(&parsed, &hsfv_global_allocator);
+
+        hsfv_cache_stats(cache, &stats);
+        CHECK(stats.hits == 1);
+        CHECK(stats.misses == 1);
+        CHECK(stats.len == 1);
+        CHECK(stats.capacity == 4);
+
+        hsfv_cache_release(v1);
+        hsfv_cache_release(v2);
+    }
+    SECTION("keyed by field type")
+    {
+        const hsfv_field_value_t *item = cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, "a");
+        const hsfv_field_value_t *list = cache_parse(cache, HSFV_FIELD_VALUE_TYPE_LIST, "a");
+        const hsfv_field_value_t *dict = cache_parse(cache, HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a");
+        CHECK(item->type == HSFV_FIELD_VALUE_TYPE_ITEM);
+        CHECK(list->type == HSFV_FIELD_VALUE_TYPE_LIST);
+        CHECK(dict->type == HSFV_FIELD_VALUE_TYPE_DICTIONARY);
+        hsfv_cache_stats(cache, &stats);
+        CHECK(stats.misses == 3);
+        hsfv_cache_release(item);
+        hsfv_cache_release(list);
+        hsfv_cache_release(dict);
+    }
+    SECTION("parse error is not cached")
+    {
+        const hsfv_field_value_t *field_value = NULL;
+        const char *input = "a=";
+        CHECK(hsfv_cache_parse(cache, HSFV_FIELD_VALUE_TYPE_DICTIONARY, input, input + strlen(input), &field_value) == HSFV_ERR_EOF);
+        CHECK(hsfv_cache_parse(cache, HSFV_FIELD_VALUE_TYPE_DICTIONARY, input, input + strlen(input), &field_value) == HSFV_ERR_EOF);
+        CHECK(field_value == NULL);
+        hsfv_cache_stats(cache, &stats);
+        CHECK(stats.misses == 2);
+        CHECK(stats.len == 0);
+    }
+    SECTION("clock eviction")
+    {
+        const char *inputs[] = {"a", "b", "c", "d"};
+        for (const char *input : inputs) {
+            hsfv_cache_release(cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, input));
+        }
+        /* hit a and c so that the hand passes over them */
+        hsfv_cache_release(cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, "a"));
+        hsfv_cache_release(cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, "c"));
+
+        hsfv_cache_release(cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, "e"));
+        hsfv_cache_release(cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, "f"));
+        hsfv_cache_stats(cache, &stats);
+        CHECK(stats.evictions == 2);
+        CHECK(stats.len == 4);
+
+        uint64_t misses = stats.misses;
+        hsfv_cache_release(cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, "a"));
+        hsfv_cache_release(cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, "c"));
+        hsfv_cache_stats(cache, &stats);
+        CHECK(stats.misses == misses);
+        hsfv_cache_release(cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, "b"));
+        hsfv_cache_stats(cache, &stats);
+        CHECK(stats.misses == misses + 1);
+    }
+    SECTION("value outlives eviction and cache")
+    {
+        const hsfv_field_value_t *held = cache_parse(cache, HSFV_FIELD_VALUE_TYPE_DICTIONARY, "u=1, i");
+        hsfv_cache_retain(held);
+        const char *inputs[] = {"a", "b", "c", "d", "e"};
+        for (const char *input : inputs) {
+            hsfv_cache_release(cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, input));
+        }
+        hsfv_cache_stats(cache, &stats);
+        CHECK(stats.evictions == 2);
+
+        hsfv_cache_destroy(cache);
+        cache = NULL;
+        REQUIRE(held->dictionary.len == 2);
+        CHECK(hsfv_key_id(&held->dictionary.members[0].key) == HSFV_ID_U);
+        hsfv_cache_release(held);
+        CHECK(counter.live_bytes > 0);
+        hsfv_cache_release(held);
+    }
+
+    hsfv_cache_destroy(cache);
+    CHECK(counter.live_bytes == 0);
+    CHECK(counter.free_size_mismatches == 0);
+}
+
+TEST_CASE("cache parse alloc error", "[cache]")
+{
+    hsfv_allocator_t *allocator = &hsfv_failing_allocator.allocator;
+    const char *input = "sig1=(\"@method\" \"@authority\" \"@path\");created=1618884475;keyid=\"test-key\"";
+    const hsfv_field_value_t *field_value;
+    hsfv_err_t err;
+
+    hsfv_failing_allocator.fail_index = -1;
+    hsfv_failing_allocator.alloc_count = 0;
+    hsfv_cache_t *cache = hsfv_cache_create(allocator, 1);
+    REQUIRE(cache != NULL);
+    int base_count = hsfv_failing_allocator.alloc_count;
+    err = hsfv_cache_parse(cache, HSFV_FIELD_VALUE_TYPE_DICTIONARY, input, input + strlen(input), &field_value);
+    CHECK(err == HSFV_OK);
+    hsfv_cache_release(field_value);
+    hsfv_cache_destroy(cache);
+
+    int alloc_count = hsfv_failing_allocator.alloc_count;
+    for (int i = 0; i < alloc_count; i++) {
+        hsfv_failing_allocator.fail_index = i;
+        hsfv_failing_allocator.alloc_count = 0;
+        cache = hsfv_cache_create(allocator, 1);
+        if (i < base_count) {
+            CHECK(cache == NULL);
+            continue;
+        }
+        REQUIRE(cache != NULL);
+        err = hsfv_cache_parse(cache, HSFV_FIELD_VALUE_TYPE_DICTIONARY, input, input + strlen(input), &field_value);
+        CHECK(err == HSFV_ERR_OUT_OF_MEMORY);
+        hsfv_cache_stats_t stats;
+        hsfv_cache_stats(cache, &stats);
+        CHECK(stats.len == 0);
+        hsfv_cache_destroy(cache);
+    }
+}
+
+TEST_CASE("shared cache parse", "[cache][shared]")
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_shared_cache_t *cache = hsfv_shared_cache_create(&counter.allocator, 8, 3);
+    REQUIRE(cache != NULL);
+    CHECK((uintptr_t)cache % 64 == 0);
+    hsfv_cache_stats_t stats;
+
+    hsfv_shared_cache_stats(cache, &stats);
+    CHECK(stats.capacity == 8);
+
+    const char *input = "max-age=3600, must-revalidate";
+    const hsfv_field_value_t *v1, *v2;
+    REQUIRE(hsfv_shared_cache_parse(cache, HSFV_FIELD_VALUE_TYPE_DICTIONARY, input, input + strlen(input), &v1) == HSFV_OK);
+    REQUIRE(hsfv_shared_cache_parse(cache, HSFV_FIELD_VALUE_TYPE_DICTIONARY, input, input + strlen(input), &v2) == HSFV_OK);
+    CHECK(v1 == v2);
+    CHECK(v1->dictionary.len == 2);
+    hsfv_cache_release(v1);
+    hsfv_cache_release(v2);
+
+    /* keep one value across many evictions */
+    const char *held_input = "held";
+    const hsfv_field_value_t *held;
+    REQUIRE(hsfv_shared_cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, held_input, held_input + strlen(held_input), &held) ==
+            HSFV_OK);
+    for (int i = 0; i < 100; i++) {
+        std::string s = std::to_string(i);
+        const hsfv_field_value_t *v;
+        REQUIRE(hsfv_shared_cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, s.data(), s.data() + s.size(), &v) == HSFV_OK);
+        CHECK(v->item.bare_item.integer == i);
+        hsfv_cache_release(v);
+    }
+    hsfv_shared_cache_stats(cache, &stats);
+    CHECK(stats.hits == 1);
+    CHECK(stats.misses == 102);
+    CHECK(stats.evictions > 0);
+    CHECK(stats.len <= stats.capacity);
+    CHECK(held->item.bare_item.type == HSFV_BARE_ITEM_TYPE_TOKEN);
+    hsfv_cache_release(held);
+
+    const hsfv_field_value_t *field_value = NULL;
+    CHECK(hsfv_shared_cache_parse(cache, HSFV_FIELD_VALUE_TYPE_ITEM, "", "", &field_value) == HSFV_ERR_EOF);
+    CHECK(field_value == NULL);
+
+    hsfv_shared_cache_destroy(cache);
+    CHECK(counter.live_bytes == 0);
+    CHECK(counter.free_size_mismatches == 0);
+}
+
+TEST_CASE("shared cache from multiple threads", "[cache][shared]")
+{
+    const int thread_count = 8;
+    const int parse_count = 2000;
+    std::vector<std::string> inputs;
+    for (int i = 0; i < 64; i++) {
+        inputs.push_back("a=" + std::to_string(i) + ", b=tok;p=" + std::to_string(i % 7));
+    }
+    /* smaller than the working set so that lookups race with evictions */
+    hsfv_shared_cache_t *cache = hsfv_shared_cache_create(&hsfv_global_allocator, 32, 4);
+    REQUIRE(cache != NULL);
+
+    std::vector<std::thread> threads;
+    std::vector<int> errors(thread_count);
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < parse_count; i++) {
+                int n = (i * 7 + t) % (int)inputs.size();
+                const std::string &s = inputs[n];
+                const hsfv_field_value_t *v;
+                if (hsfv_shared_cache_parse(cache, HSFV_FIELD_VALUE_TYPE_DICTIONARY, s.data(), s.data() + s.size(), &v) != HSFV_OK) {
+                    errors[t]++;
+                    continue;
+                }
+                if (v->dictionary.len != 2 || v->dictionary.members[0].value.item.bare_item.integer != n) {
+                    errors[t]++;
+                }
+                hsfv_cache_release(v);
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    for (int t = 0; t < thread_count; t++) {
+        CHECK(errors[t] == 0);
+    }
+
+    hsfv_cache_stats_t stats;
+    hsfv_shared_cache_stats(cache, &stats);
+    CHECK(stats.hits + stats.misses == (uint64_t)thread_count * parse_count);
+    CHECK(stats.len <= stats.capacity);
+    hsfv_shared_cache_destroy(cache);
+}
@@ -0,0 +1,141 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+/* hsfv_is_canonical must agree with a parse and serialize round trip */
+static void canonical_test(hsfv_field_value_type_t field_type, const char *input, bool want)
+{
+    const char *input_end = input + strlen(input);
+    hsfv_field_value_t field_value;
+    hsfv_buffer_t buf = (hsfv_buffer_t){0};
+    bool round_trips = false;
+
+    if (hsfv_parse_field_value(&field_value, field_type, &hsfv_global_allocator, input, input_end, NULL) == HSFV_OK) {
+        REQUIRE(hsfv_serialize_field_value(&field_value, &hsfv_global_allocator, &buf) == HSFV_OK);
+        round_trips = std::string((const char *)buf.bytes.base, buf.bytes.len) == input;
+        hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+    }
+    INFO(input);
+    CHECK(round_trips == want);
+    CHECK(hsfv_is_canonical(field_type, input, input_end) == want);
+    hsfv_buffer_deinit(&buf, &hsfv_global_allocator);
+}
+
+TEST_CASE("hsfv_is_canonical item", "[canonical]")
+{
+    SECTION("canonical")
+    {
+        const char *inputs[] = {"0",   "-1",         "999999999999999", "1.5",          "-0.25",  "-0.0",  "1.0",   "123.456", "\"a\\\"b\\\\c\"",
+                                "tok", "*foo/bar:1", ":AQID:",          ":AQI=:",       ":AQ==:", "::",    "?0",      "?1",
+                                "a;b", "a;b=?0",     "a;b=1;c=\"d\"",   "1;x=:AQI=:;y"};
+        for (const char *input : inputs) {
+            canonical_test(HSFV_FIELD_VALUE_TYPE_ITEM, input, true);
+        }
+    }
+    SECTION("not canonical")
+    {
+        const char *inputs[] = {"-0",   "01",       "1.50",      "00.5",    ":AQI:", ":AQJ=:", ":AR==:", " 1",
+                                "1 ",   "a; b",     "a;b=?1",    "a;b;b=1", "1.000", "",       "a;",     ":AQ=:"};
+        for (const char *input : inputs) {
+            canonical_test(HSFV_FIELD_VALUE_TYPE_ITEM, input, false);
+        }
+    }
+}
+
+TEST_CASE("hsfv_is_canonical list", "[canonical]")
+{
+    SECTION("canonical")
+    {
+        const char *inputs[] = {"", "a", "a, b", "(a b);p=1, ()", "(\"x\";y z), 1.5;q", "();a, ?1"};
+        for (const char *input : inputs) {
+            canonical_test(HSFV_FIELD_VALUE_TYPE_LIST, input, true);
+        }
+    }
+    SECTION("not canonical")
+    {
+        const char *inputs[] = {"a,b", "a,  b", "a ,b", "( a)", "(a )", "(a  b)", "a, ", "a,\tb", "(a b) ;p"};
+        for (const char *input : inputs) {
+            canonical_test(HSFV_FIELD_VALUE_TYPE_LIST, input, false);
+        }
+    }
+}
+
+TEST_CASE("hsfv_is_canonical dictionary", "[canonical]")
+{
+    SECTION("canonical")
+    {
+        const char *inputs[] = {"", "a", "a=1, b", "max-age=60, private, no-cache=\"set-cookie\"", "a;p, b=?0", "a=(1 2);x, b=()"};
+        for (const char *input : inputs) {
+            canonical_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, input, true);
+        }
+    }
+    SECTION("not canonical")
+    {
+        const char *inputs[] = {"a=?1", "a=?1;p", "a=1,b", "a=1, a=2", "a, b, a", "a=1;p;p", " a"};
+        for (const char *input : inputs) {
+            canonical_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, input, false);
+        }
+    }
+}
+
+TEST_CASE("hsfv_is_canonical many keys", "[canonical]")
+{
+    /* more keys than are indexed at once, with a duplicate of the first key at the end */
+    std::string dict, params = "a";
+    for (int i = 0; i < 300; i++) {
+        dict += (i ? ", k" : "k") + std::to_string(i) + "=" + std::to_string(i);
+        params += ";k" + std::to_string(i) + "=" + std::to_string(i);
+    }
+    canonical_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, dict.c_str(), true);
+    canonical_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, (dict + ", k0=1").c_str(), false);
+    canonical_test(HSFV_FIELD_VALUE_TYPE_ITEM, params.c_str(), true);
+    canonical_test(HSFV_FIELD_VALUE_TYPE_ITEM, (params + ";k0=1").c_str(), false);
+}
+
+TEST_CASE("hsfv_canonicalize", "[canonical]")
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_buffer_t buf = (hsfv_buffer_t){0};
+    const char *out;
+    size_t out_len;
+
+    SECTION("canonical input is returned as is")
+    {
+        const char *input = "max-age=60, private";
+        REQUIRE(hsfv_canonicalize(HSFV_FIELD_VALUE_TYPE_DICTIONARY, input, input + strlen(input), &counter.allocator, &buf, &out,
+                                  &out_len) == HSFV_OK);
+        CHECK(out == input);
+        CHECK(out_len == strlen(input));
+        CHECK(counter.alloc_count + counter.realloc_count == 0);
+    }
+    SECTION("canonical input with many keys is returned as is")
+    {
+        std::string input;
+        for (int i = 0; i < 300; i++) {
+            input += (i ? ", k" : "k") + std::to_string(i);
+        }
+        REQUIRE(hsfv_canonicalize(HSFV_FIELD_VALUE_TYPE_DICTIONARY, input.data(), input.data() + input.size(), &counter.allocator, &buf,
+                                  &out, &out_len) == HSFV_OK);
+        CHECK(out == input.data());
+        CHECK(counter.alloc_count + counter.realloc_count == 0);
+    }
+    SECTION("other input is rewritten")
+    {
+        const char *input = "max-age=060,private=?1,   no-store";
+        REQUIRE(hsfv_canonicalize(HSFV_FIELD_VALUE_TYPE_DICTIONARY, input, input + strlen(input), &counter.allocator, &buf, &out,
+                                  &out_len) == HSFV_OK);
+        CHECK(std::string(out, out_len) == "max-age=60, private, no-store");
+        CHECK(out == (const char *)buf.bytes.base);
+    }
+    SECTION("invalid input")
+    {
+        const char *input = "a=1,";
+        CHECK(hsfv_canonicalize(HSFV_FIELD_VALUE_TYPE_DICTIONARY, input, input + strlen(input), &counter.allocator, &buf, &out,
+                                &out_len) == HSFV_ERR_EOF);
+        CHECK(buf.bytes.len == 0);
+    }
+
+    hsfv_buffer_deinit(&buf, &counter.allocator);
+    CHECK(counter.live_bytes == 0);
+}
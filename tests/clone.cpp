@@ -0,0 +1,150 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <vector>
+
+static void check_serializes_to(const hsfv_field_value_t *field_value, const char *want)
+{
+    hsfv_buffer_t buf = (hsfv_buffer_t){0};
+    hsfv_err_t err = hsfv_serialize_field_value(field_value, &hsfv_global_allocator, &buf);
+    CHECK(err == HSFV_OK);
+    CHECK(std::string((const char *)buf.bytes.base, buf.bytes.len) == want);
+    hsfv_buffer_deinit(&buf, &hsfv_global_allocator);
+}
+
+static void clone_ok_test(hsfv_field_value_type_t field_type, const char *input)
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_field_value_t field_value, *clone;
+    hsfv_buffer_t want = (hsfv_buffer_t){0};
+    hsfv_err_t err;
+
+    err = hsfv_parse_field_value(&field_value, field_type, &hsfv_global_allocator, input, input + strlen(input), NULL);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_serialize_field_value(&field_value, &hsfv_global_allocator, &want);
+    REQUIRE(err == HSFV_OK);
+    hsfv_buffer_append_byte(&want, &hsfv_global_allocator, '\0');
+
+    err = hsfv_field_value_clone(&field_value, &counter.allocator, &clone);
+    REQUIRE(err == HSFV_OK);
+    CHECK(counter.alloc_count == 1);
+    CHECK(counter.live_bytes == hsfv_field_value_clone_size(&field_value));
+    CHECK(hsfv_field_value_eq(clone, &field_value));
+
+    /* the clone does not share anything the original frees */
+    hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+    check_serializes_to(clone, (const char *)want.bytes.base);
+
+    hsfv_allocator_free_sized(&counter.allocator, clone, hsfv_field_value_clone_size(clone));
+    CHECK(counter.free_size_mismatches == 0);
+    CHECK(counter.live_bytes == 0);
+    hsfv_buffer_deinit(&want, &hsfv_global_allocator);
+}
+
+TEST_CASE("clone field_value", "[field_value][clone]")
+{
+    SECTION("item")
+    {
+        clone_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, "42");
+        clone_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, "\"a string longer than the inline capacity\";a=1;b=?0;c=:AQIDBAUGBwgJCgsMDQ4PEBES:");
+    }
+    SECTION("list")
+    {
+        clone_ok_test(HSFV_FIELD_VALUE_TYPE_LIST, "");
+        clone_ok_test(HSFV_FIELD_VALUE_TYPE_LIST, "ExampleCache; hit; ttl=376, OriginCache-for-a-long-name; fwd=stale; fwd-status=304; "
+                                                  "stored; collapsed; key=\"some long cache key\"");
+        clone_ok_test(HSFV_FIELD_VALUE_TYPE_LIST, "(\"foo\" \"a longer string value\";x);a;b=1, (), (a-long-token-value b c d e f g h i j)");
+    }
+    SECTION("dictionary")
+    {
+        clone_ok_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "max-age=3600, must-revalidate, private");
+        clone_ok_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY,
+                      "sig1=(\"@method\" \"@target-uri\" \"content-digest\");created=1618884473;keyid=\"test-key-rsa-pss\", "
+                      "a-rather-long-dictionary-key=:cHJldGVuZCB0aGlzIGlzIGJpbmFyeSBjb250ZW50Lg==:");
+    }
+}
+
+TEST_CASE("clone keeps interned names shared", "[field_value][clone]")
+{
+    const char *input = "max-age=3600, public";
+    hsfv_field_value_t field_value, *clone;
+    hsfv_err_t err;
+
+    err = hsfv_parse_field_value(&field_value, HSFV_FIELD_VALUE_TYPE_DICTIONARY, &hsfv_global_allocator, input, input + strlen(input),
+                                 NULL);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_field_value_clone(&field_value, &hsfv_global_allocator, &clone);
+    REQUIRE(err == HSFV_OK);
+    CHECK(hsfv_field_value_clone_size(&field_value) == sizeof(hsfv_field_value_t) + 2 * sizeof(hsfv_dict_member_t));
+    CHECK(hsfv_key_base(&clone->dictionary.members[0].key) == hsfv_key_base(&field_value.dictionary.members[0].key));
+    CHECK(hsfv_key_id(&clone->dictionary.members[1].key) == HSFV_ID_PUBLIC);
+
+    hsfv_global_allocator.free(&hsfv_global_allocator, clone);
+    hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+}
+
+TEST_CASE("clone can be moved with memcpy", "[field_value][clone]")
+{
+    const char *input = "a-long-key-for-the-test=(\"a long enough string\" tok;p1=1;p2=2;p3=\"three is not inline\");q, "
+                        "b=:AQIDBAUGBwgJCgsMDQ4PEBES:";
+    hsfv_field_value_t field_value, *clone, *moved;
+    hsfv_err_t err;
+
+    err = hsfv_parse_field_value(&field_value, HSFV_FIELD_VALUE_TYPE_DICTIONARY, &hsfv_global_allocator, input, input + strlen(input),
+                                 NULL);
+    REQUIRE(err == HSFV_OK);
+    size_t size = hsfv_field_value_clone_size(&field_value);
+
+    SECTION("to another allocation")
+    {
+        err = hsfv_field_value_clone(&field_value, &hsfv_global_allocator, &clone);
+        REQUIRE(err == HSFV_OK);
+        moved = (hsfv_field_value_t *)malloc(size);
+        memcpy(moved, clone, size);
+        free(clone);
+        hsfv_field_value_clone_relocate(moved, clone);
+        CHECK(hsfv_field_value_eq(moved, &field_value));
+        free(moved);
+    }
+
+    SECTION("into a caller's block")
+    {
+        std::vector<uint64_t> block(size / sizeof(uint64_t) + 1), block2(size / sizeof(uint64_t) + 1);
+        clone = hsfv_field_value_clone_to(block.data(), &field_value);
+        CHECK((void *)clone == block.data());
+        CHECK(hsfv_field_value_eq(clone, &field_value));
+        memcpy(block2.data(), block.data(), size);
+        memset(block.data(), 0, size);
+        hsfv_field_value_clone_relocate((hsfv_field_value_t *)block2.data(), block.data());
+        CHECK(hsfv_field_value_eq((hsfv_field_value_t *)block2.data(), &field_value));
+    }
+
+    hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+}
+
+TEST_CASE("clone hand-built field_value", "[field_value][clone]")
+{
+    char token[] = "tok";
+    hsfv_parameter_t params[] = {{.key = {.base = "key", .len = 3}, .value = {.type = HSFV_BARE_ITEM_TYPE_INTEGER, .integer = 1}}};
+    hsfv_field_value_t field_value = (hsfv_field_value_t){.type = HSFV_FIELD_VALUE_TYPE_ITEM};
+    field_value.item.bare_item.type = HSFV_BARE_ITEM_TYPE_TOKEN;
+    field_value.item.bare_item.token = (hsfv_token_t){.base = token, .len = 3};
+    field_value.item.parameters = (hsfv_parameters_t){.params = params, .len = 1};
+
+    hsfv_field_value_t *clone;
+    hsfv_err_t err = hsfv_field_value_clone(&field_value, &hsfv_global_allocator, &clone);
+    REQUIRE(err == HSFV_OK);
+    token[0] = 'x';
+    check_serializes_to(clone, "tok;key=1");
+    hsfv_global_allocator.free(&hsfv_global_allocator, clone);
+}
+
+TEST_CASE("clone alloc error", "[field_value][clone]")
+{
+    hsfv_field_value_t field_value = (hsfv_field_value_t){.type = HSFV_FIELD_VALUE_TYPE_LIST}, *clone = NULL;
+    hsfv_failing_allocator.fail_index = 0;
+    hsfv_failing_allocator.alloc_count = 0;
+    CHECK(hsfv_field_value_clone(&field_value, &hsfv_failing_allocator.allocator, &clone) == HSFV_ERR_OUT_OF_MEMORY);
+    CHECK(clone == NULL);
+}
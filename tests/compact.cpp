@@ -0,0 +1,173 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+static void parse_compact_ok_test(hsfv_field_value_type_t field_type, const char *input, const char *want)
+{
+    hsfv_compact_t compact = (hsfv_compact_t){0};
+    hsfv_field_value_t field_value;
+    hsfv_buffer_t compact_buf = (hsfv_buffer_t){0}, tree_buf = (hsfv_buffer_t){0};
+    hsfv_err_t err;
+    const char *input_end = input + strlen(input);
+
+    err = hsfv_parse_compact(&compact, field_type, &hsfv_global_allocator, input, input_end, NULL);
+    REQUIRE(err == HSFV_OK);
+    CHECK(compact.type == field_type);
+    err = hsfv_serialize_compact(&compact, &hsfv_global_allocator, &compact_buf);
+    CHECK(err == HSFV_OK);
+    CHECK(std::string((const char *)compact_buf.bytes.base, compact_buf.bytes.len) == want);
+
+    err = hsfv_parse_field_value(&field_value, field_type, &hsfv_global_allocator, input, input_end, NULL);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_serialize_field_value(&field_value, &hsfv_global_allocator, &tree_buf);
+    CHECK(err == HSFV_OK);
+    CHECK(hsfv_iovec_eq(&compact_buf.bytes, &tree_buf.bytes));
+
+    hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+    hsfv_buffer_deinit(&tree_buf, &hsfv_global_allocator);
+    hsfv_buffer_deinit(&compact_buf, &hsfv_global_allocator);
+    hsfv_compact_deinit(&compact, &hsfv_global_allocator);
+}
+
+static void parse_compact_ng_test(hsfv_field_value_type_t field_type, const char *input, hsfv_err_t want)
+{
+    hsfv_compact_t compact = (hsfv_compact_t){0};
+    hsfv_err_t err;
+
+    err = hsfv_parse_compact(&compact, field_type, &hsfv_global_allocator, input, input + strlen(input), NULL);
+    CHECK(err == want);
+    hsfv_compact_deinit(&compact, &hsfv_global_allocator);
+}
+
+TEST_CASE("parse compact", "[parse][compact]")
+{
+    SECTION("ok item")
+    {
+        parse_compact_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, "  42  ", "42");
+        parse_compact_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, "-1.5;a=?0;b", "-1.5;a=?0;b");
+        parse_compact_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, "\"a \\\"b\\\\\"", "\"a \\\"b\\\\\"");
+        parse_compact_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, ":cHJldGVuZCB0aGlzIGlzIGJpbmFyeSBjb250ZW50Lg==:",
+                              ":cHJldGVuZCB0aGlzIGlzIGJpbmFyeSBjb250ZW50Lg==:");
+        parse_compact_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, "foo/bar:baz;q=\"x\"", "foo/bar:baz;q=\"x\"");
+    }
+    SECTION("ok list")
+    {
+        parse_compact_ok_test(HSFV_FIELD_VALUE_TYPE_LIST, "", "");
+        parse_compact_ok_test(HSFV_FIELD_VALUE_TYPE_LIST, "a, (b c);d=1, (), (e;f);g, ?1", "a, (b c);d=1, (), (e;f);g, ?1");
+        parse_compact_ok_test(HSFV_FIELD_VALUE_TYPE_LIST, "ExampleCache; hit; ttl=376, OriginCache; fwd=stale; fwd-status=304; stored",
+                              "ExampleCache;hit;ttl=376, OriginCache;fwd=stale;fwd-status=304;stored");
+    }
+    SECTION("ok dictionary")
+    {
+        parse_compact_ok_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=?0, b, c;foo=bar", "a=?0, b, c;foo=bar");
+        parse_compact_ok_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "sig1=(\"@method\" \"@path\");created=1618884473;keyid=\"k\"",
+                              "sig1=(\"@method\" \"@path\");created=1618884473;keyid=\"k\"");
+        parse_compact_ok_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=1, b=2, a=(x y);z", "a=(x y);z, b=2");
+    }
+    SECTION("ng")
+    {
+        parse_compact_ng_test(HSFV_FIELD_VALUE_TYPE_ITEM, "", HSFV_ERR_EOF);
+        parse_compact_ng_test(HSFV_FIELD_VALUE_TYPE_LIST, "(a b", HSFV_ERR_EOF);
+        parse_compact_ng_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "A=1", HSFV_ERR_INVALID);
+    }
+}
+
+TEST_CASE("compact random access", "[compact]")
+{
+    const char *input = "a=1;x, b=(c \"d\";y=?0);z, e";
+    hsfv_compact_t compact = (hsfv_compact_t){0};
+    hsfv_err_t err;
+
+    err = hsfv_parse_compact(&compact, HSFV_FIELD_VALUE_TYPE_DICTIONARY, &hsfv_global_allocator, input, input + strlen(input), NULL);
+    REQUIRE(err == HSFV_OK);
+    REQUIRE(compact.members.len == 3);
+
+    const hsfv_compact_member_t *members = hsfv_compact_members(&compact, compact.members);
+    CHECK(members[2].key.len == 1);
+    CHECK(*hsfv_compact_bytes(&compact, members[2].key) == 'e');
+    CHECK(members[2].value.bare_item.type == HSFV_BARE_ITEM_TYPE_BOOLEAN);
+
+    const hsfv_compact_item_t *b = &members[1].value;
+    REQUIRE(b->bare_item.type == HSFV_COMPACT_TYPE_INNER_LIST);
+    REQUIRE(b->bare_item.bytes.len == 2);
+    CHECK(b->parameters.len == 1);
+
+    const hsfv_compact_item_t *d = &hsfv_compact_items(&compact, b->bare_item.bytes)[1];
+    CHECK(d->bare_item.type == HSFV_BARE_ITEM_TYPE_STRING);
+    CHECK(d->bare_item.bytes.len == 1);
+    CHECK(*hsfv_compact_bytes(&compact, d->bare_item.bytes) == 'd');
+    REQUIRE(d->parameters.len == 1);
+    const hsfv_compact_parameter_t *y = hsfv_compact_parameters(&compact, d->parameters);
+    CHECK(*hsfv_compact_bytes(&compact, y->key) == 'y');
+    CHECK(y->value.type == HSFV_BARE_ITEM_TYPE_BOOLEAN);
+    CHECK(!y->value.boolean);
+
+    CHECK(members[0].value.bare_item.integer == 1);
+    CHECK(members[0].value.parameters.len == 1);
+
+    hsfv_compact_deinit(&compact, &hsfv_global_allocator);
+}
+
+TEST_CASE("compact from tape reuses its pool", "[compact]")
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_allocator_t *allocator = &counter.allocator;
+    hsfv_tape_t tape = (hsfv_tape_t){0};
+    hsfv_compact_t compact = (hsfv_compact_t){0};
+    const char *input1 = "max-age=3600, must-revalidate, private";
+    const char *input2 = "a=1, b=2";
+    hsfv_err_t err;
+
+    err = hsfv_parse_tape(&tape, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, input1, input1 + strlen(input1), NULL);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_compact_from_tape(&compact, &tape, allocator);
+    REQUIRE(err == HSFV_OK);
+    CHECK(compact.pool_len == 3 * sizeof(hsfv_compact_member_t) + strlen("max-agemust-revalidateprivate"));
+
+    hsfv_counting_allocator_reset_stats(&counter);
+    err = hsfv_parse_tape(&tape, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, input2, input2 + strlen(input2), NULL);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_compact_from_tape(&compact, &tape, allocator);
+    REQUIRE(err == HSFV_OK);
+    CHECK(counter.alloc_count + counter.realloc_count == 0);
+    CHECK(compact.members.len == 2);
+
+    hsfv_tape_deinit(&tape, allocator);
+    hsfv_compact_deinit(&compact, allocator);
+    CHECK(counter.live_bytes == 0);
+}
+
+TEST_CASE("parse compact alloc error", "[parse][compact]")
+{
+    hsfv_allocator_t *allocator = &hsfv_failing_allocator.allocator;
+    const char *input = "a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q,r,s,t";
+    hsfv_compact_t compact;
+    hsfv_err_t err;
+
+    hsfv_failing_allocator.fail_index = -1;
+    hsfv_failing_allocator.alloc_count = 0;
+    compact = (hsfv_compact_t){0};
+    err = hsfv_parse_compact(&compact, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, input, input + strlen(input), NULL);
+    CHECK(err == HSFV_OK);
+    hsfv_compact_deinit(&compact, allocator);
+
+    int alloc_count = hsfv_failing_allocator.alloc_count;
+    CHECK(alloc_count > 1);
+    for (int i = 0; i < alloc_count; i++) {
+        hsfv_failing_allocator.fail_index = i;
+        hsfv_failing_allocator.alloc_count = 0;
+        compact = (hsfv_compact_t){0};
+        err = hsfv_parse_compact(&compact, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, input, input + strlen(input), NULL);
+        CHECK(err == HSFV_ERR_OUT_OF_MEMORY);
+        hsfv_compact_deinit(&compact, allocator);
+    }
+}
+
+TEST_CASE("compact node sizes", "[compact]")
+{
+    CHECK(sizeof(hsfv_compact_span_t) * 2 == sizeof(hsfv_key_t));
+    CHECK(sizeof(hsfv_compact_bare_item_t) < sizeof(hsfv_bare_item_t));
+    CHECK(sizeof(hsfv_compact_item_t) * 2 <= sizeof(hsfv_item_t));
+    CHECK(sizeof(hsfv_compact_member_t) * 2 <= sizeof(hsfv_dict_member_t));
+}
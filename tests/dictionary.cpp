@@ -1,5 +1,6 @@
 #include "hsfv.h"
 #include <catch2/catch_test_macros.hpp>
+#include <string>
 
 /* Dictionary test data */
 
@@ -381,3 +382,207 @@ TEST_CASE("parse dictionary", "[parse][dictionary]")
         parse_dictionary_alloc_error_test("a=(a b c d e f g h i), b;a=1;b=2;c=3;d=4;e=5;f=6;g=7;h=8;i=9");
     }
 }
+
+static void check_dictionary_serializes_to(const hsfv_dictionary_t *dictionary, const char *want)
+{
+    hsfv_buffer_t buf = (hsfv_buffer_t){0};
+    hsfv_err_t err = hsfv_serialize_dictionary(dictionary, &hsfv_global_allocator, &buf);
+    CHECK(err == HSFV_OK);
+    CHECK(std::string((const char *)buf.bytes.base, buf.bytes.len) == want);
+    hsfv_buffer_deinit(&buf, &hsfv_global_allocator);
+}
+
+TEST_CASE("copy-on-write dictionary edits", "[edit][dictionary]")
+{
+    const char *input = "a=1, b=\"a string too long to be inline\";p=1, c=(x y);q";
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_dictionary_t dictionary, edited;
+    hsfv_err_t err;
+
+    err = hsfv_parse_dictionary(&dictionary, &hsfv_global_allocator, input, input + strlen(input), NULL);
+    REQUIRE(err == HSFV_OK);
+    hsfv_dict_member_value_t value = (hsfv_dict_member_value_t){.type = HSFV_DICT_MEMBER_TYPE_ITEM};
+    value.item.bare_item = (hsfv_bare_item_t){.type = HSFV_BARE_ITEM_TYPE_INTEGER, .integer = 2};
+
+    SECTION("replace")
+    {
+        err = hsfv_dictionary_set(&edited, &dictionary, "a", 1, &value, &counter.allocator);
+        REQUIRE(err == HSFV_OK);
+        CHECK(counter.alloc_count == 1);
+        check_dictionary_serializes_to(&edited, "a=2, b=\"a string too long to be inline\";p=1, c=(x y);q");
+        check_dictionary_serializes_to(&dictionary, input);
+        CHECK(hsfv_string_base(&edited.members[1].value.item.bare_item.string) == hsfv_string_base(&dictionary.members[1].value.item.bare_item.string));
+        CHECK(edited.members[2].value.inner_list.items == dictionary.members[2].value.inner_list.items);
+    }
+
+    SECTION("append, then edit the result in place")
+    {
+        err = hsfv_dictionary_set(&edited, &dictionary, "max-age", 7, &value, &counter.allocator);
+        REQUIRE(err == HSFV_OK);
+        CHECK(hsfv_key_id(&edited.members[3].key) == HSFV_ID_MAX_AGE);
+        err = hsfv_dictionary_remove(&edited, &edited, "b", 1, &counter.allocator);
+        REQUIRE(err == HSFV_OK);
+        err = hsfv_dictionary_set(&edited, &edited, "d", 1, &value, &counter.allocator);
+        REQUIRE(err == HSFV_OK);
+        check_dictionary_serializes_to(&edited, "a=1, c=(x y);q, max-age=2, d=2");
+        check_dictionary_serializes_to(&dictionary, input);
+    }
+
+    SECTION("remove")
+    {
+        err = hsfv_dictionary_remove(&edited, &dictionary, "a", 1, &counter.allocator);
+        REQUIRE(err == HSFV_OK);
+        check_dictionary_serializes_to(&edited, "b=\"a string too long to be inline\";p=1, c=(x y);q");
+        CHECK(hsfv_dictionary_remove(&edited, &edited, "z", 1, &counter.allocator) == HSFV_ERR_EOF);
+        check_dictionary_serializes_to(&dictionary, input);
+    }
+
+    SECTION("parameters of a member")
+    {
+        hsfv_bare_item_t token = (hsfv_bare_item_t){.type = HSFV_BARE_ITEM_TYPE_TOKEN, .token = {.base = "tok", .len = 3}};
+        value = dictionary.members[1].value;
+        err = hsfv_parameters_set(&value.item.parameters, &dictionary.members[1].value.item.parameters, "p", 1, &token,
+                                  &counter.allocator);
+        REQUIRE(err == HSFV_OK);
+        CHECK(counter.alloc_count == 1);
+        err = hsfv_dictionary_set(&edited, &dictionary, "b", 1, &value, &counter.allocator);
+        REQUIRE(err == HSFV_OK);
+        check_dictionary_serializes_to(&edited, "a=1, b=\"a string too long to be inline\";p=tok, c=(x y);q");
+        check_dictionary_serializes_to(&dictionary, input);
+        hsfv_parameters_edit_deinit(&value.item.parameters, &counter.allocator);
+    }
+
+    hsfv_dictionary_edit_deinit(&edited, &counter.allocator);
+    CHECK(counter.live_bytes == 0);
+    CHECK(counter.free_size_mismatches == 0);
+    hsfv_dictionary_deinit(&dictionary, &hsfv_global_allocator);
+}
+
+TEST_CASE("copy-on-write dictionary edit alloc error", "[edit][dictionary]")
+{
+    hsfv_dictionary_t dictionary = (hsfv_dictionary_t){0}, edited = (hsfv_dictionary_t){0};
+    hsfv_dict_member_value_t value = (hsfv_dict_member_value_t){.type = HSFV_DICT_MEMBER_TYPE_ITEM};
+    hsfv_failing_allocator.fail_index = 0;
+    hsfv_failing_allocator.alloc_count = 0;
+    CHECK(hsfv_dictionary_set(&edited, &dictionary, "a", 1, &value, &hsfv_failing_allocator.allocator) == HSFV_ERR_OUT_OF_MEMORY);
+    CHECK(edited.members == NULL);
+}
+
+static std::string dictionary_diff_summary(const hsfv_dictionary_diff_t *diff, const hsfv_dictionary_t *a, const hsfv_dictionary_t *b)
+{
+    static const char marks[] = {'+', '-', '~'};
+    std::string summary;
+    for (size_t i = 0; i < diff->len; i++) {
+        const hsfv_dict_change_t *change = &diff->changes[i];
+        CHECK((change->a_index == HSFV_DICT_DIFF_NONE) == (change->type == HSFV_DICT_CHANGE_ADDED));
+        CHECK((change->b_index == HSFV_DICT_DIFF_NONE) == (change->type == HSFV_DICT_CHANGE_REMOVED));
+        const hsfv_key_t *key = change->type == HSFV_DICT_CHANGE_REMOVED ? &a->members[change->a_index].key
+                                                                          : &b->members[change->b_index].key;
+        summary += (i ? " " : "") + std::string(1, marks[change->type]) + std::string(hsfv_key_base(key), hsfv_key_len(key));
+    }
+    return summary;
+}
+
+/* checks the diff from a to b and that applying the serialized delta to a gives b when added keys are at the end of b */
+static void dictionary_diff_test(const char *a_input, const char *b_input, const char *want_summary, const char *want_upserts,
+                                 const char *want_removals, bool applies_in_order)
+{
+    hsfv_dictionary_t a, b, upserts, patched = (hsfv_dictionary_t){0};
+    hsfv_list_t removals;
+    hsfv_dictionary_diff_t diff;
+    hsfv_buffer_t upserts_buf = (hsfv_buffer_t){0}, removals_buf = (hsfv_buffer_t){0};
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+
+    INFO(a_input << " -> " << b_input);
+    REQUIRE(hsfv_parse_dictionary(&a, &hsfv_global_allocator, a_input, a_input + strlen(a_input), NULL) == HSFV_OK);
+    REQUIRE(hsfv_parse_dictionary(&b, &hsfv_global_allocator, b_input, b_input + strlen(b_input), NULL) == HSFV_OK);
+    REQUIRE(hsfv_dictionary_diff(&a, &b, &counter.allocator, &diff) == HSFV_OK);
+    CHECK(dictionary_diff_summary(&diff, &a, &b) == want_summary);
+    REQUIRE(hsfv_serialize_dictionary_diff(&diff, &a, &b, &hsfv_global_allocator, &upserts_buf, &removals_buf) == HSFV_OK);
+    std::string upserts_str((const char *)upserts_buf.bytes.base, upserts_buf.bytes.len);
+    std::string removals_str((const char *)removals_buf.bytes.base, removals_buf.bytes.len);
+    CHECK(upserts_str == want_upserts);
+    CHECK(removals_str == want_removals);
+
+    REQUIRE(hsfv_parse_dictionary(&upserts, &hsfv_global_allocator, upserts_str.data(), upserts_str.data() + upserts_str.size(),
+                                  NULL) == HSFV_OK);
+    REQUIRE(hsfv_parse_list(&removals, &hsfv_global_allocator, removals_str.data(), removals_str.data() + removals_str.size(),
+                            NULL) == HSFV_OK);
+    /* the first edit copies a into patched and the rest edit patched in place */
+    const hsfv_dictionary_t *src = &a;
+    for (size_t i = 0; i < removals.len; i++, src = &patched) {
+        const hsfv_token_t *token = &removals.members[i].item.bare_item.token;
+        REQUIRE(hsfv_dictionary_remove(&patched, src, hsfv_token_base(token), hsfv_token_len(token), &hsfv_global_allocator) ==
+                HSFV_OK);
+    }
+    for (size_t i = 0; i < upserts.len; i++, src = &patched) {
+        const hsfv_key_t *key = &upserts.members[i].key;
+        REQUIRE(hsfv_dictionary_set(&patched, src, hsfv_key_base(key), hsfv_key_len(key), &upserts.members[i].value,
+                                    &hsfv_global_allocator) == HSFV_OK);
+    }
+    CHECK(hsfv_dictionary_eq(src, &b) == applies_in_order);
+
+    hsfv_dictionary_edit_deinit(&patched, &hsfv_global_allocator);
+    hsfv_list_deinit(&removals, &hsfv_global_allocator);
+    hsfv_dictionary_deinit(&upserts, &hsfv_global_allocator);
+    hsfv_buffer_deinit(&upserts_buf, &hsfv_global_allocator);
+    hsfv_buffer_deinit(&removals_buf, &hsfv_global_allocator);
+    hsfv_dictionary_diff_deinit(&diff, &counter.allocator);
+    /* only the change array: the key table of small dictionaries is on the stack */
+    CHECK(counter.alloc_count == (a.len + b.len > 0 ? 1 : 0));
+    CHECK(counter.live_bytes == 0);
+    CHECK(counter.free_size_mismatches == 0);
+    hsfv_dictionary_deinit(&a, &hsfv_global_allocator);
+    hsfv_dictionary_deinit(&b, &hsfv_global_allocator);
+}
+
+TEST_CASE("dictionary diff", "[diff][dictionary]")
+{
+    dictionary_diff_test("", "", "", "", "", true);
+    dictionary_diff_test("a=1, b=2", "a=1, b=2", "", "", "", true);
+    dictionary_diff_test("a=1, b=2", "a=1, b=3", "~b", "b=3", "", true);
+    dictionary_diff_test("a=1, b=2", "a=1, b=2, c", "+c", "c", "", true);
+    dictionary_diff_test("a=1, b=2, c", "b=2", "-a -c", "", "a, c", true);
+    dictionary_diff_test("a=1;p, b=(x y), c=?0", "c=?0, b=(x), a=1;p=2, d=:AQID:", "~b ~a +d", "b=(x), a=1;p=2, d=:AQID:", "", false);
+    dictionary_diff_test("a, b", "c, b", "+c -a", "c", "a", false);
+    dictionary_diff_test("a", "", "-a", "", "a", true);
+    dictionary_diff_test("", "a=(1 2);q", "+a", "a=(1 2);q", "", true);
+}
+
+TEST_CASE("dictionary diff of large dictionaries", "[diff][dictionary]")
+{
+    std::string a_input, b_input, want_upserts, want_removals, want_summary;
+    for (int i = 0; i < 100; i++) {
+        a_input += (i ? ", k" : "k") + std::to_string(i) + "=" + std::to_string(i);
+        b_input += (i ? ", k" : "k") + std::to_string(i) + "=" + std::to_string(i % 10 ? i : -i);
+    }
+    hsfv_dictionary_t a, b;
+    hsfv_dictionary_diff_t diff;
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    REQUIRE(hsfv_parse_dictionary(&a, &hsfv_global_allocator, a_input.data(), a_input.data() + a_input.size(), NULL) == HSFV_OK);
+    REQUIRE(hsfv_parse_dictionary(&b, &hsfv_global_allocator, b_input.data(), b_input.data() + b_input.size(), NULL) == HSFV_OK);
+
+    REQUIRE(hsfv_dictionary_diff(&a, &b, &counter.allocator, &diff) == HSFV_OK);
+    /* the change array and the key table, which no longer fits on the stack */
+    CHECK(counter.alloc_count == 2);
+    CHECK(diff.len == 9);
+    for (size_t i = 0; i < diff.len; i++) {
+        CHECK(diff.changes[i].type == HSFV_DICT_CHANGE_CHANGED);
+        CHECK(diff.changes[i].a_index == (i + 1) * 10);
+        CHECK(diff.changes[i].b_index == (i + 1) * 10);
+    }
+    hsfv_dictionary_diff_deinit(&diff, &counter.allocator);
+    CHECK(counter.live_bytes == 0);
+    CHECK(counter.free_size_mismatches == 0);
+
+    for (int i = 0; i < 2; i++) {
+        hsfv_failing_allocator.fail_index = i;
+        hsfv_failing_allocator.alloc_count = 0;
+        CHECK(hsfv_dictionary_diff(&a, &b, &hsfv_failing_allocator.allocator, &diff) == HSFV_ERR_OUT_OF_MEMORY);
+    }
+    hsfv_dictionary_deinit(&a, &hsfv_global_allocator);
+    hsfv_dictionary_deinit(&b, &hsfv_global_allocator);
+}
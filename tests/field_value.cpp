@@ -1,5 +1,6 @@
 #include "hsfv.h"
 #include <catch2/catch_test_macros.hpp>
+#include <string>
 
 /* List test data */
 
@@ -434,3 +435,124 @@ TEST_CASE("parse field_value", "[parse][field_value]")
         parse_field_value_ng_test("  ?1;foo;*bar=tok  a", HSFV_FIELD_VALUE_TYPE_ITEM, HSFV_ERR_INVALID);
     }
 }
+
+TEST_CASE("parse batch", "[parse][field_value][batch]")
+{
+    hsfv_arena_t arena;
+    hsfv_arena_init(&arena, &hsfv_global_allocator, 0);
+
+    const char *list_input = "   (\"foo\";a;b=1936 bar;y=:AQMBAg==:);d=18.71, ?1;foo;*bar=tok   ";
+    const char *dict_input = "   a=?0, b, c; foo=bar  ";
+    const char *item_input = "  ?1;foo;*bar=tok  ";
+    const char *bad_input = "   a=?0, b, c; foo=bar  a";
+    const char *non_ascii_input = "a=\"\xc3\xa9\"";
+
+    hsfv_batch_entry_t entries[] = {
+        {.input = list_input, .input_end = list_input + strlen(list_input), .type = HSFV_FIELD_VALUE_TYPE_LIST},
+        {.input = bad_input, .input_end = bad_input + strlen(bad_input), .type = HSFV_FIELD_VALUE_TYPE_DICTIONARY},
+        {.input = dict_input, .input_end = dict_input + strlen(dict_input), .type = HSFV_FIELD_VALUE_TYPE_DICTIONARY},
+        {.input = non_ascii_input, .input_end = non_ascii_input + strlen(non_ascii_input), .type = HSFV_FIELD_VALUE_TYPE_DICTIONARY},
+        {.input = item_input, .input_end = item_input + strlen(item_input), .type = HSFV_FIELD_VALUE_TYPE_ITEM},
+    };
+    size_t n = sizeof(entries) / sizeof(entries[0]);
+
+    for (int round = 0; round < 2; round++) {
+        CHECK(hsfv_parse_batch(entries, n, &arena) == 2);
+
+        CHECK(entries[0].err == HSFV_OK);
+        CHECK(hsfv_field_value_eq(&entries[0].field_value, &test_list));
+        CHECK(entries[1].err == HSFV_ERR_INVALID);
+        CHECK(hsfv_field_value_is_empty(&entries[1].field_value));
+        CHECK(entries[2].err == HSFV_OK);
+        CHECK(hsfv_field_value_eq(&entries[2].field_value, &test_dict));
+        CHECK(entries[3].err == HSFV_ERR_INVALID);
+        CHECK(entries[4].err == HSFV_OK);
+        CHECK(hsfv_field_value_eq(&entries[4].field_value, &test_item));
+
+        hsfv_arena_reset(&arena);
+    }
+
+    hsfv_arena_deinit(&arena);
+}
+
+TEST_CASE("clear field_value", "[field_value]")
+{
+    const char *input = "a=(\"a long enough string\" b);c=1, d";
+    hsfv_field_value_t field_value;
+    hsfv_buffer_t buf = (hsfv_buffer_t){0};
+    hsfv_err_t err;
+
+    err = hsfv_parse_field_value(&field_value, HSFV_FIELD_VALUE_TYPE_DICTIONARY, &hsfv_global_allocator, input, input + strlen(input),
+                                 NULL);
+    REQUIRE(err == HSFV_OK);
+    hsfv_field_value_clear(&field_value, &hsfv_global_allocator);
+    CHECK(field_value.type == HSFV_FIELD_VALUE_TYPE_DICTIONARY);
+    CHECK(hsfv_field_value_is_empty(&field_value));
+    err = hsfv_serialize_field_value(&field_value, &hsfv_global_allocator, &buf);
+    CHECK(err == HSFV_OK);
+    CHECK(buf.bytes.len == 0);
+    hsfv_buffer_deinit(&buf, &hsfv_global_allocator);
+    hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+}
+
+TEST_CASE("parse field_value into a target", "[parse][field_value][target]")
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_parse_target_t target;
+    hsfv_parse_target_init(&target, &counter.allocator);
+
+    const char *list_input = "   (\"foo\";a;b=1936 bar;y=:AQMBAg==:);d=18.71, ?1;foo;*bar=tok   ";
+    const char *large_input = "a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p, q, r, s, \"a string that is not inline\";x;y;z";
+    hsfv_err_t err;
+
+    SECTION("steady state does not allocate")
+    {
+        for (int round = 0; round < 3; round++) {
+            if (round == 2) {
+                hsfv_counting_allocator_reset_stats(&counter);
+            }
+            err = hsfv_parse_field_value_into(&target, HSFV_FIELD_VALUE_TYPE_LIST, list_input, list_input + strlen(list_input), NULL);
+            REQUIRE(err == HSFV_OK);
+            CHECK(hsfv_field_value_eq(&target.field_value, &test_list));
+            err = hsfv_parse_field_value_into(&target, HSFV_FIELD_VALUE_TYPE_LIST, large_input, large_input + strlen(large_input), NULL);
+            REQUIRE(err == HSFV_OK);
+            CHECK(target.field_value.list.len == 20);
+        }
+        CHECK(counter.alloc_count + counter.realloc_count == 0);
+    }
+
+    SECTION("steady state with hundreds of strings does not allocate")
+    {
+        std::string many_strings;
+        for (int i = 0; i < 500; i++) {
+            many_strings += (i ? ", \"" : "\"") + std::string(16 + i % 50, 'a' + i % 26) + "\"";
+        }
+        for (int round = 0; round < 3; round++) {
+            if (round == 2) {
+                hsfv_counting_allocator_reset_stats(&counter);
+            }
+            err = hsfv_parse_field_value_into(&target, HSFV_FIELD_VALUE_TYPE_LIST, many_strings.data(),
+                                              many_strings.data() + many_strings.size(), NULL);
+            REQUIRE(err == HSFV_OK);
+            CHECK(target.field_value.list.len == 500);
+            err = hsfv_parse_field_value_into(&target, HSFV_FIELD_VALUE_TYPE_LIST, list_input, list_input + strlen(list_input), NULL);
+            REQUIRE(err == HSFV_OK);
+        }
+        CHECK(counter.alloc_count + counter.realloc_count == 0);
+        CHECK(counter.free_size_mismatches == 0);
+    }
+
+    SECTION("error leaves an empty value")
+    {
+        const char *bad_input = "a, b, (c";
+        err = hsfv_parse_field_value_into(&target, HSFV_FIELD_VALUE_TYPE_LIST, list_input, list_input + strlen(list_input), NULL);
+        REQUIRE(err == HSFV_OK);
+        err = hsfv_parse_field_value_into(&target, HSFV_FIELD_VALUE_TYPE_LIST, bad_input, bad_input + strlen(bad_input), NULL);
+        CHECK(err == HSFV_ERR_EOF);
+        CHECK(hsfv_field_value_is_empty(&target.field_value));
+    }
+
+    hsfv_parse_target_deinit(&target);
+    CHECK(counter.live_bytes == 0);
+}
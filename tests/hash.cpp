@@ -0,0 +1,123 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+static uint64_t raw_hash(hsfv_field_value_type_t field_type, const std::string &input, uint64_t seed = 0)
+{
+    uint64_t hash = 0;
+    INFO(input);
+    REQUIRE(hsfv_raw_semantic_hash(field_type, input.data(), input.data() + input.size(), seed, &hash));
+    return hash;
+}
+
+/* the raw hash must match the hash of the parsed value, which depends only on what it serializes to */
+static uint64_t tree_hash(hsfv_field_value_type_t field_type, const std::string &input, uint64_t seed = 0)
+{
+    hsfv_field_value_t field_value;
+    INFO(input);
+    REQUIRE(hsfv_parse_field_value(&field_value, field_type, &hsfv_global_allocator, input.data(), input.data() + input.size(),
+                                   NULL) == HSFV_OK);
+    uint64_t hash = hsfv_field_value_hash(&field_value, seed);
+    hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+    CHECK(raw_hash(field_type, input, seed) == hash);
+    return hash;
+}
+
+TEST_CASE("equal after canonicalization hash equal", "[hash]")
+{
+    SECTION("item")
+    {
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "1.50") == tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "1.5"));
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "-0") == tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "0"));
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "007") == tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "7"));
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, ":AQI:") == tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, ":AQI=:"));
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, ":AR==:") == tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, ":AQ==:"));
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "  a;b=?1  ") == tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "a;b"));
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "a; b=1;c;b=2") == tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "a;b=2;c"));
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "\"a\\\"b\\\\c\"") == tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "\"a\\\"b\\\\c\""));
+    }
+    SECTION("list")
+    {
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_LIST, "a,b ,\tc") == tree_hash(HSFV_FIELD_VALUE_TYPE_LIST, "a, b, c"));
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_LIST, "(  x   y );p=?1, ()") == tree_hash(HSFV_FIELD_VALUE_TYPE_LIST, "(x y);p, ()"));
+    }
+    SECTION("dictionary")
+    {
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=?1, b=2") == tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a, b=2"));
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=1, b=2, a=3") == tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=3, b=2"));
+        CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=(1 2), a;x") == tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a;x"));
+    }
+}
+
+TEST_CASE("different values hash differently", "[hash]")
+{
+    const char *items[] = {"1", "1.0", "\"1\"", "a", ":AQ==:", "?1", "?0", "a;b", "a;b=?0", "a;c", "\"a\"", "\"ab\"", "::", "\"\""};
+    for (const char *a : items) {
+        for (const char *b : items) {
+            if (a != b) {
+                INFO(a << " vs " << b);
+                CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, a) != tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, b));
+            }
+        }
+    }
+    CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a, b") != tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "b, a"));
+    CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_LIST, "(a b)") != tree_hash(HSFV_FIELD_VALUE_TYPE_LIST, "(a), b"));
+    CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_LIST, "a") != tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "a"));
+    CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "a", 1) != tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, "a", 2));
+}
+
+TEST_CASE("long values and many keys", "[hash]")
+{
+    std::string encoded(396, 'A'), dict, canonical;
+    CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, ":" + encoded + "AR:") == tree_hash(HSFV_FIELD_VALUE_TYPE_ITEM, ":" + encoded + "AQ==:"));
+
+    /* more keys than are indexed at once, each one duplicated */
+    for (int i = 0; i < 300; i++) {
+        dict += (i ? ", k" : "k") + std::to_string(i) + "=" + std::to_string(i);
+        canonical += (i ? ", k" : "k") + std::to_string(i) + "=" + std::to_string(i + 100);
+    }
+    for (int i = 0; i < 300; i++) {
+        dict += ", k" + std::to_string(i) + "=" + std::to_string(i + 100);
+    }
+    CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, dict) == tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, canonical));
+    CHECK(tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, dict + ", z=1, z=2") ==
+          tree_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, canonical + ", z=2"));
+}
+
+TEST_CASE("many keys are hashed in a pass per 128 keys", "[hash]")
+{
+    const int key_count = 8000;
+    std::string dict, spaced;
+    for (int i = 0; i < key_count; i++) {
+        dict += (i ? ",k" : "k") + std::to_string(i) + "=" + std::to_string(i);
+        spaced += (i ? ", k" : "k") + std::to_string(i) + "=" + std::to_string(i);
+    }
+
+    hsfv_stats_t before, after;
+    hsfv_stats_snapshot(&before);
+    uint64_t hash = raw_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, dict);
+    hsfv_stats_snapshot(&after);
+    if (hsfv_stats_enabled()) {
+        CHECK(after.raw_key_rescans - before.raw_key_rescans == (key_count + 127) / 128 - 1);
+    }
+    CHECK(raw_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, spaced) == hash);
+    CHECK(raw_hash(HSFV_FIELD_VALUE_TYPE_DICTIONARY, dict + ",k0=1") != hash);
+}
+
+TEST_CASE("invalid input is rejected", "[hash]")
+{
+    struct {
+        hsfv_field_value_type_t field_type;
+        const char *input;
+    } cases[] = {
+        {HSFV_FIELD_VALUE_TYPE_ITEM, ""},          {HSFV_FIELD_VALUE_TYPE_ITEM, "a b"},      {HSFV_FIELD_VALUE_TYPE_ITEM, "\"a"},
+        {HSFV_FIELD_VALUE_TYPE_ITEM, ":A:"},       {HSFV_FIELD_VALUE_TYPE_LIST, "a,"},       {HSFV_FIELD_VALUE_TYPE_LIST, "(a"},
+        {HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a="},  {HSFV_FIELD_VALUE_TYPE_DICTIONARY, "1"},  {HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a;"},
+        {HSFV_FIELD_VALUE_TYPE_ITEM, "\"\xc3\xa9\""},
+    };
+    uint64_t hash;
+    for (auto &c : cases) {
+        INFO(c.input);
+        CHECK_FALSE(hsfv_raw_semantic_hash(c.field_type, c.input, c.input + strlen(c.input), 0, &hash));
+    }
+}
@@ -407,6 +407,38 @@ static hsfv_err_t combine_field_lines(yyjson_val *raw, hsfv_allocator_t *allocat
 static const char *default_test_data_dir =
     "." PATH_SEPARATOR "HttpwgTests-prefix" PATH_SEPARATOR "src" PATH_SEPARATOR "HttpwgTests";
 
+/*
+ * the tape parser must accept the same inputs and serialize to the same
+ * bytes, and so must the compact layout built from the tape
+ */
+static void check_tape(hsfv_field_value_type_t field_type, const char *input, const char *input_end, const hsfv_field_value_t *got)
+{
+    hsfv_allocator_t *allocator = &hsfv_global_allocator;
+    hsfv_tape_t tape = {0};
+    hsfv_err_t err = hsfv_parse_tape(&tape, field_type, allocator, input, input_end, NULL);
+    if (got == NULL) {
+        CHECK(err != HSFV_OK);
+    } else {
+        CHECK(err == HSFV_OK);
+        hsfv_buffer_t tape_buf = {0}, got_buf = {0};
+        CHECK(hsfv_serialize_tape(&tape, allocator, &tape_buf) == HSFV_OK);
+        CHECK(hsfv_serialize_field_value(got, allocator, &got_buf) == HSFV_OK);
+        CHECK(hsfv_iovec_eq(&tape_buf.bytes, &got_buf.bytes));
+
+        hsfv_compact_t compact = {0};
+        hsfv_buffer_t compact_buf = {0};
+        CHECK(hsfv_compact_from_tape(&compact, &tape, allocator) == HSFV_OK);
+        CHECK(hsfv_serialize_compact(&compact, allocator, &compact_buf) == HSFV_OK);
+        CHECK(hsfv_iovec_eq(&compact_buf.bytes, &got_buf.bytes));
+        hsfv_buffer_deinit(&compact_buf, allocator);
+        hsfv_compact_deinit(&compact, allocator);
+
+        hsfv_buffer_deinit(&tape_buf, allocator);
+        hsfv_buffer_deinit(&got_buf, allocator);
+    }
+    hsfv_tape_deinit(&tape, allocator);
+}
+
 static void run_parse_test_for_json_file(const char *json_rel_path)
 {
     const char *test_dir = getenv("HTTPWG_TEST_DIR");
@@ -465,6 +497,7 @@ static void run_parse_test_for_json_file(const char *json_rel_path)
                 const char *input_end = input + input_len;
                 const char *rest;
                 err = hsfv_parse_field_value(&got, field_type, allocator, input, input_end, &rest);
+                check_tape(field_type, input, input_end, err == HSFV_OK ? &got : NULL);
                 if (must_fail) {
                     CHECK(err != HSFV_OK);
                 } else {
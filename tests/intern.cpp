@@ -0,0 +1,79 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("intern lookup", "[intern]")
+{
+    SECTION("vocabulary")
+    {
+#define CHECK_VOCABULARY(name, str)                                                                                                \
+    do {                                                                                                                           \
+        const char *interned = hsfv_intern_lookup(str, strlen(str));                                                              \
+        REQUIRE(interned != NULL);                                                                                                 \
+        CHECK(!strcmp(interned, str));                                                                                             \
+        CHECK(hsfv_intern_id(interned) == HSFV_ID_##name);                                                                         \
+    } while (0);
+        HSFV_INTERN_VOCABULARY(CHECK_VOCABULARY)
+#undef CHECK_VOCABULARY
+    }
+    SECTION("unknown")
+    {
+        CHECK(hsfv_intern_lookup("max-agex", 8) == NULL);
+        CHECK(hsfv_intern_lookup("max-ag", 6) == NULL);
+        CHECK(hsfv_intern_lookup("", 0) == NULL);
+        const char *key = "max-age";
+        CHECK(!hsfv_is_interned(key));
+        CHECK(hsfv_intern_id(key) == HSFV_ID_NONE);
+        CHECK(hsfv_intern_id(NULL) == HSFV_ID_NONE);
+        CHECK(hsfv_intern_id(hsfv_intern_lookup("max-age", 7) + 1) == HSFV_ID_NONE);
+    }
+}
+
+TEST_CASE("intern register", "[intern]")
+{
+    hsfv_id_t id, id2;
+
+    CHECK(hsfv_intern_register("max-age", 7, &id) == HSFV_OK);
+    CHECK(id == HSFV_ID_MAX_AGE);
+
+    CHECK(hsfv_intern_lookup("x-test-intern", 13) == NULL);
+    REQUIRE(hsfv_intern_register("x-test-intern", 13, &id) == HSFV_OK);
+    CHECK(id >= HSFV_ID_VOCABULARY_END);
+    CHECK(hsfv_intern_register("x-test-intern", 13, &id2) == HSFV_OK);
+    CHECK(id2 == id);
+    CHECK(hsfv_intern_id(hsfv_intern_lookup("x-test-intern", 13)) == id);
+
+    CHECK(hsfv_intern_register("", 0, &id) == HSFV_ERR_INVALID);
+    CHECK(hsfv_intern_register("this-key-is-longer-than-31-bytes", 32, &id) == HSFV_ERR_INVALID);
+}
+
+TEST_CASE("parse interned keys and tokens", "[intern][parse]")
+{
+    const char *input = "ExampleCache-edge; hit; ttl=376; key=sha-256, OriginCache-shield; fwd=stale";
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_field_value_t field_value;
+    hsfv_err_t err;
+
+    err = hsfv_parse_field_value(&field_value, HSFV_FIELD_VALUE_TYPE_LIST, &counter.allocator, input, input + strlen(input), NULL);
+    REQUIRE(err == HSFV_OK);
+    REQUIRE(field_value.list.len == 2);
+
+    const hsfv_item_t *item = &field_value.list.members[0].item;
+    CHECK(hsfv_token_id(&item->bare_item.token) == HSFV_ID_NONE);
+    REQUIRE(item->parameters.len == 3);
+    CHECK(hsfv_key_id(&item->parameters.params[0].key) == HSFV_ID_HIT);
+    CHECK(hsfv_key_id(&item->parameters.params[1].key) == HSFV_ID_TTL);
+    CHECK(hsfv_key_id(&item->parameters.params[2].key) == HSFV_ID_KEY);
+    CHECK(hsfv_token_id(&item->parameters.params[2].value.token) == HSFV_ID_SHA_256);
+
+    item = &field_value.list.members[1].item;
+    REQUIRE(item->parameters.len == 1);
+    CHECK(hsfv_key_id(&item->parameters.params[0].key) == HSFV_ID_FWD);
+    CHECK(hsfv_token_id(&item->parameters.params[0].value.token) == HSFV_ID_STALE);
+
+    /* only the two cache names are copied; both are too long to store inline */
+    CHECK(counter.size_histogram[5] == 2);
+
+    hsfv_field_value_deinit(&field_value, &counter.allocator);
+    CHECK(counter.live_bytes == 0);
+}
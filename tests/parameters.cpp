@@ -1,5 +1,6 @@
 #include "hsfv.h"
 #include <catch2/catch_test_macros.hpp>
+#include <string>
 
 TEST_CASE("hsfv_parameters_eq", "[eq][parameters]")
 {
@@ -229,4 +230,117 @@ TEST_CASE("parse parameters", "[parse][parameters]")
     {
         parse_parameters_alloc_error_test(";foo=?1;*bar=\"baz\"");
     }
+    SECTION("alloc error with more parameters than fit on the stack")
+    {
+        parse_parameters_alloc_error_test(";a;b;c;d;e;f;g;h;i=\"long enough to allocate\";j=\"another long enough string\"");
+    }
+}
+
+static void parse_parameters_storage_test(const char *input, size_t want_len, size_t want_allocations, size_t want_capacity)
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_parameters_t params;
+    hsfv_err_t err;
+    const char *rest;
+
+    err = hsfv_parse_parameters(&params, &counter.allocator, input, input + strlen(input), &rest);
+    REQUIRE(err == HSFV_OK);
+    REQUIRE(params.len == want_len);
+    CHECK((params.params == NULL) == (want_len == 0));
+    CHECK(counter.alloc_count + counter.realloc_count == want_allocations);
+    CHECK(params.capacity == want_capacity);
+    CHECK(counter.peak_bytes == want_capacity * sizeof(hsfv_parameter_t));
+    for (size_t i = 0; i < params.len; i++) {
+        CHECK(hsfv_key_len(&params.params[i].key) == 1);
+        CHECK(*hsfv_key_base(&params.params[i].key) == (char)('a' + i));
+    }
+
+    hsfv_parameters_deinit(&params, &counter.allocator);
+    CHECK(counter.live_bytes == 0);
+    CHECK(counter.free_size_mismatches == 0);
+}
+
+TEST_CASE("parse parameters storage", "[parse][parameters]")
+{
+    SECTION("none")
+    {
+        parse_parameters_storage_test("", 0, 0, 0);
+    }
+    SECTION("one")
+    {
+        parse_parameters_storage_test(";a=1", 1, 1, 1);
+    }
+    SECTION("two")
+    {
+        parse_parameters_storage_test(";a=1;b", 2, 1, 2);
+    }
+    SECTION("duplicate key")
+    {
+        parse_parameters_storage_test(";a=1;b;a=2", 2, 1, 2);
+    }
+    SECTION("as many as fit on the stack")
+    {
+        parse_parameters_storage_test(";a;b;c;d;e;f;g;h", 8, 1, 8);
+    }
+    SECTION("more than fit on the stack")
+    {
+        parse_parameters_storage_test(";a;b;c;d;e;f;g;h;i;j", 10, 1, 16);
+    }
+    SECTION("more than the first heap array")
+    {
+        parse_parameters_storage_test(";a;b;c;d;e;f;g;h;i;j;k;l;m;n;o;p;q", 17, 2, 24);
+    }
+}
+
+TEST_CASE("copy-on-write parameters edits", "[edit][parameters]")
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_parameters_t params, edited;
+    hsfv_bare_item_t value = (hsfv_bare_item_t){.type = HSFV_BARE_ITEM_TYPE_INTEGER, .integer = 9};
+    hsfv_buffer_t buf = (hsfv_buffer_t){0};
+    hsfv_err_t err;
+
+    SECTION("adds a parameter")
+    {
+        const char *input = ";a=1";
+        REQUIRE(hsfv_parse_parameters(&params, &hsfv_global_allocator, input, input + strlen(input), NULL) == HSFV_OK);
+        REQUIRE(hsfv_parameters_set(&edited, &params, "b", 1, &value, &counter.allocator) == HSFV_OK);
+        CHECK(edited.params != params.params);
+        CHECK(counter.alloc_count == 1);
+        REQUIRE(hsfv_serialize_parameters(&edited, &hsfv_global_allocator, &buf) == HSFV_OK);
+        CHECK(std::string((const char *)buf.bytes.base, buf.bytes.len) == ";a=1;b=9");
+    }
+
+    SECTION("copies the array, then edits in place")
+    {
+        const char *input = ";a=1;b=2";
+        REQUIRE(hsfv_parse_parameters(&params, &hsfv_global_allocator, input, input + strlen(input), NULL) == HSFV_OK);
+        REQUIRE(hsfv_parameters_set(&edited, &params, "c", 1, &value, &counter.allocator) == HSFV_OK);
+        CHECK(edited.params != params.params);
+        err = hsfv_parameters_set(&edited, &edited, "a", 1, &value, &counter.allocator);
+        REQUIRE(err == HSFV_OK);
+        err = hsfv_parameters_set(&edited, &edited, "d", 1, &value, &counter.allocator);
+        REQUIRE(err == HSFV_OK);
+        REQUIRE(hsfv_serialize_parameters(&edited, &hsfv_global_allocator, &buf) == HSFV_OK);
+        CHECK(std::string((const char *)buf.bytes.base, buf.bytes.len) == ";a=9;b=2;c=9;d=9");
+    }
+
+    SECTION("replaces a value")
+    {
+        const char *input = ";a=1;b=2;c=\"a string too long to be inline\"";
+        REQUIRE(hsfv_parse_parameters(&params, &hsfv_global_allocator, input, input + strlen(input), NULL) == HSFV_OK);
+        REQUIRE(hsfv_parameters_set(&edited, &params, "b", 1, &value, &counter.allocator) == HSFV_OK);
+        CHECK(hsfv_string_base(&edited.params[2].value.string) == hsfv_string_base(&params.params[2].value.string));
+        REQUIRE(hsfv_serialize_parameters(&edited, &hsfv_global_allocator, &buf) == HSFV_OK);
+        CHECK(std::string((const char *)buf.bytes.base, buf.bytes.len) == ";a=1;b=9;c=\"a string too long to be inline\"");
+        CHECK(params.params[1].value.integer == 2);
+    }
+
+    hsfv_parameters_edit_deinit(&edited, &counter.allocator);
+    CHECK(counter.live_bytes == 0);
+    CHECK(counter.free_size_mismatches == 0);
+    hsfv_parameters_deinit(&params, &hsfv_global_allocator);
+    hsfv_buffer_deinit(&buf, &hsfv_global_allocator);
 }
@@ -0,0 +1,157 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("pool alloc and realloc", "[allocator][pool]")
+{
+    hsfv_pool_t *pool = hsfv_pool_create(&hsfv_global_allocator);
+    REQUIRE(pool != NULL);
+    hsfv_allocator_t *allocator = hsfv_pool_allocator(pool);
+
+    SECTION("freed blocks are reused")
+    {
+        void *p = allocator->alloc(allocator, 40);
+        REQUIRE(p != NULL);
+        allocator->free(allocator, p);
+        void *q = allocator->alloc(allocator, 33);
+        CHECK(q == p);
+        allocator->free(allocator, q);
+
+        hsfv_pool_stats_t stats;
+        hsfv_pool_stats(pool, &stats);
+        CHECK(stats.backing_allocs == 1);
+    }
+
+    SECTION("realloc within a class keeps the block")
+    {
+        char *p = (char *)allocator->alloc(allocator, 20);
+        memcpy(p, "0123456789", 10);
+        CHECK(allocator->realloc(allocator, p, 32) == p);
+
+        char *q = (char *)allocator->realloc(allocator, p, 100);
+        REQUIRE(q != NULL);
+        CHECK(!memcmp(q, "0123456789", 10));
+
+        char *r = (char *)allocator->realloc(allocator, q, 1 << 20);
+        REQUIRE(r != NULL);
+        CHECK(!memcmp(r, "0123456789", 10));
+        r = (char *)allocator->realloc(allocator, r, 2 << 20);
+        REQUIRE(r != NULL);
+        CHECK(!memcmp(r, "0123456789", 10));
+        r = (char *)allocator->realloc(allocator, r, 10);
+        REQUIRE(r != NULL);
+        CHECK(!memcmp(r, "0123456789", 10));
+        allocator->free(allocator, r);
+    }
+
+    SECTION("full thread lists are returned to the depot in batches")
+    {
+        std::vector<void *> blocks;
+        for (int i = 0; i < 4 * HSFV_POOL_BATCH_SIZE; i++) {
+            blocks.push_back(allocator->alloc(allocator, 64));
+        }
+        for (void *p : blocks) {
+            allocator->free(allocator, p);
+        }
+
+        hsfv_pool_stats_t stats;
+        hsfv_pool_stats(pool, &stats);
+        CHECK(stats.backing_allocs == 4 * HSFV_POOL_BATCH_SIZE);
+        CHECK(stats.depot_pushes == 2);
+
+        for (size_t i = 0; i < blocks.size(); i++) {
+            blocks[i] = allocator->alloc(allocator, 64);
+        }
+        hsfv_pool_stats(pool, &stats);
+        CHECK(stats.backing_allocs == 4 * HSFV_POOL_BATCH_SIZE);
+        CHECK(stats.depot_pops == 2);
+        for (void *p : blocks) {
+            allocator->free(allocator, p);
+        }
+    }
+
+    hsfv_pool_destroy(pool);
+}
+
+TEST_CASE("parse and serialize with a pool", "[allocator][pool]")
+{
+    const char *input = "sig1=(\"@method\" \"@target-uri\" \"@authority\" \"content-digest\");created=1618884473;keyid=\"test-key\", "
+                        "sig2=(\"@authority\" \"content-type\");created=1618884473;keyid=\"test-key-rsa\";alg=\"rsa-v1_5-sha256\"";
+    hsfv_pool_t *pool = hsfv_pool_create(&hsfv_global_allocator);
+    REQUIRE(pool != NULL);
+    hsfv_allocator_t *allocator = hsfv_pool_allocator(pool);
+    hsfv_pool_stats_t stats;
+    uint64_t warm_allocs = 0;
+
+    for (int round = 0; round < 3; round++) {
+        hsfv_field_value_t field_value;
+        hsfv_buffer_t buf = (hsfv_buffer_t){0};
+        hsfv_err_t err;
+
+        err = hsfv_parse_field_value(&field_value, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, input, input + strlen(input), NULL);
+        REQUIRE(err == HSFV_OK);
+        err = hsfv_serialize_field_value(&field_value, allocator, &buf);
+        REQUIRE(err == HSFV_OK);
+        CHECK(buf.bytes.len == strlen(input));
+        CHECK(!memcmp(buf.bytes.base, input, buf.bytes.len));
+        hsfv_buffer_deinit(&buf, allocator);
+        hsfv_field_value_deinit(&field_value, allocator);
+
+        hsfv_pool_stats(pool, &stats);
+        if (round == 0) {
+            warm_allocs = stats.backing_allocs;
+        }
+    }
+    CHECK(stats.backing_allocs == warm_allocs);
+
+    hsfv_pool_destroy(pool);
+}
+
+TEST_CASE("pool used by several threads", "[allocator][pool]")
+{
+    const char *input = "ExampleCache; hit; ttl=376; key=\"a long enough cache key\", OriginCache; fwd=stale; fwd-status=304; stored";
+    hsfv_pool_t *pool = hsfv_pool_create(&hsfv_global_allocator);
+    REQUIRE(pool != NULL);
+    hsfv_allocator_t *allocator = hsfv_pool_allocator(pool);
+    const int thread_count = 4, rounds = 500;
+    std::vector<hsfv_field_value_t> handoff(thread_count * rounds);
+    std::vector<int> errors(thread_count);
+
+    /* every thread parses values which the next thread frees */
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < rounds; i++) {
+                if (hsfv_parse_field_value(&handoff[t * rounds + i], HSFV_FIELD_VALUE_TYPE_LIST, allocator, input,
+                                           input + strlen(input), NULL) != HSFV_OK) {
+                    errors[t]++;
+                }
+            }
+        });
+    }
+    for (std::thread &th : threads) {
+        th.join();
+    }
+    threads.clear();
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&, t]() {
+            int owner = (t + 1) % thread_count;
+            for (int i = 0; i < rounds; i++) {
+                hsfv_field_value_deinit(&handoff[owner * rounds + i], allocator);
+            }
+        });
+    }
+    for (std::thread &th : threads) {
+        th.join();
+    }
+
+    for (int t = 0; t < thread_count; t++) {
+        CHECK(errors[t] == 0);
+    }
+    hsfv_pool_stats_t stats;
+    hsfv_pool_stats(pool, &stats);
+    CHECK(stats.depot_pushes > 0);
+
+    hsfv_pool_destroy(pool);
+}
@@ -0,0 +1,118 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+typedef hsfv_err_t (*raw_dict_edit_t)(const char *input, const char *input_end, const char *key, size_t key_len, const char *value,
+                                      size_t value_len, hsfv_allocator_t *allocator, hsfv_buffer_t *dest);
+
+static hsfv_err_t raw_dict_remove(const char *input, const char *input_end, const char *key, size_t key_len, const char *value,
+                                  size_t value_len, hsfv_allocator_t *allocator, hsfv_buffer_t *dest)
+{
+    return hsfv_raw_dict_remove(input, input_end, key, key_len, allocator, dest);
+}
+
+static void raw_dict_ok_test(raw_dict_edit_t edit, const char *input, const char *key, const char *value, const char *want)
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_buffer_t buf = (hsfv_buffer_t){0};
+    hsfv_err_t err = edit(input, input + strlen(input), key, strlen(key), value, value ? strlen(value) : 0, &counter.allocator, &buf);
+    CHECK(err == HSFV_OK);
+    CHECK(std::string((const char *)buf.bytes.base, buf.bytes.len) == want);
+    CHECK(counter.alloc_count + counter.realloc_count == 1);
+
+    /* the result must parse to the dictionary a full edit would produce */
+    hsfv_dictionary_t dictionary;
+    err = hsfv_parse_dictionary(&dictionary, &hsfv_global_allocator, (const char *)buf.bytes.base,
+                                (const char *)buf.bytes.base + buf.bytes.len, NULL);
+    CHECK(err == HSFV_OK);
+    if (err == HSFV_OK) {
+        hsfv_dictionary_deinit(&dictionary, &hsfv_global_allocator);
+    }
+    hsfv_buffer_deinit(&buf, &counter.allocator);
+}
+
+static void raw_dict_ng_test(raw_dict_edit_t edit, const char *input, const char *key, const char *value, hsfv_err_t want)
+{
+    hsfv_buffer_t buf = (hsfv_buffer_t){0};
+    hsfv_buffer_append_bytes(&buf, &hsfv_global_allocator, "keep", 4);
+    hsfv_err_t err = edit(input, input + strlen(input), key, strlen(key), value, value ? strlen(value) : 0, &hsfv_global_allocator, &buf);
+    CHECK(err == want);
+    CHECK(std::string((const char *)buf.bytes.base, buf.bytes.len) == "keep");
+    hsfv_buffer_deinit(&buf, &hsfv_global_allocator);
+}
+
+TEST_CASE("raw dictionary remove", "[raw_dict]")
+{
+    SECTION("first")
+    {
+        raw_dict_ok_test(raw_dict_remove, "max-age=60, s-maxage=120, public", "max-age", NULL, "s-maxage=120, public");
+    }
+    SECTION("middle keeps separators verbatim")
+    {
+        raw_dict_ok_test(raw_dict_remove, "  a=(1 2);x, b=?0;p=\"v\",c ,\td", "b", NULL, "a=(1 2);x,c ,\td");
+    }
+    SECTION("last")
+    {
+        raw_dict_ok_test(raw_dict_remove, "a, b=:AQID:", "b", NULL, "a");
+    }
+    SECTION("duplicates")
+    {
+        raw_dict_ok_test(raw_dict_remove, "a=1, b, a=2", "a", NULL, "b");
+    }
+    SECTION("only member")
+    {
+        raw_dict_ok_test(raw_dict_remove, "a=1", "a", NULL, "");
+    }
+    SECTION("not found")
+    {
+        raw_dict_ng_test(raw_dict_remove, "a=1, b", "c", NULL, HSFV_ERR_EOF);
+    }
+    SECTION("invalid input")
+    {
+        raw_dict_ng_test(raw_dict_remove, "a=1, b,", "a", NULL, HSFV_ERR_INVALID);
+        raw_dict_ng_test(raw_dict_remove, "a=1; B", "a", NULL, HSFV_ERR_INVALID);
+    }
+}
+
+TEST_CASE("raw dictionary replace", "[raw_dict]")
+{
+    SECTION("keeps the position")
+    {
+        raw_dict_ok_test(hsfv_raw_dict_replace, "no-cache, max-age=60, private", "max-age", "=3600", "no-cache, max-age=3600, private");
+    }
+    SECTION("with a boolean and parameters")
+    {
+        raw_dict_ok_test(hsfv_raw_dict_replace, "a=1, b=2", "a", ";p=1", "a;p=1, b=2");
+    }
+    SECTION("with an inner list, dropping duplicates")
+    {
+        raw_dict_ok_test(hsfv_raw_dict_replace, "a=1, b, a=2", "a", "=(x \"y\");z", "a=(x \"y\");z, b");
+    }
+    SECTION("not found")
+    {
+        raw_dict_ng_test(hsfv_raw_dict_replace, "a=1", "b", "=2", HSFV_ERR_EOF);
+    }
+    SECTION("invalid value or key")
+    {
+        raw_dict_ng_test(hsfv_raw_dict_replace, "a=1", "a", "2", HSFV_ERR_INVALID);
+        raw_dict_ng_test(hsfv_raw_dict_replace, "a=1", "a", "=1, b", HSFV_ERR_INVALID);
+        raw_dict_ng_test(hsfv_raw_dict_replace, "a=1", "A", "=1", HSFV_ERR_INVALID);
+    }
+}
+
+TEST_CASE("raw dictionary append", "[raw_dict]")
+{
+    SECTION("new key")
+    {
+        raw_dict_ok_test(hsfv_raw_dict_append, "public,max-age=60", "stale-if-error", "=300", "public,max-age=60, stale-if-error=300");
+    }
+    SECTION("empty input")
+    {
+        raw_dict_ok_test(hsfv_raw_dict_append, "", "no-store", "", "no-store");
+    }
+    SECTION("existing key moves to the end")
+    {
+        raw_dict_ok_test(hsfv_raw_dict_append, "max-age=60, public", "max-age", "=0", "public, max-age=0");
+    }
+}
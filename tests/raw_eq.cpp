@@ -0,0 +1,130 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+/* parameters k0..k(count-1) with ki=i, written once, or twice with the values first and then in reverse order */
+static std::string key_params(int count, bool canonical)
+{
+    std::string params;
+    for (int i = 0; i < count; i++) {
+        params += ";k" + std::to_string(i) + "=" + (canonical ? std::to_string(i) : "0");
+    }
+    if (!canonical) {
+        for (int i = count - 1; i >= 0; i--) {
+            params += ";k" + std::to_string(i) + "=" + std::to_string(i);
+        }
+    }
+    return params;
+}
+
+/* hsfv_raw_field_value_eq must agree with parsing both inputs and comparing the trees */
+static void raw_eq_test(hsfv_field_value_type_t field_type, const std::string &a, const std::string &b, bool want)
+{
+    hsfv_field_value_t a_value, b_value;
+    bool parsed_eq = false;
+
+    if (hsfv_parse_field_value(&a_value, field_type, &hsfv_global_allocator, a.data(), a.data() + a.size(), NULL) == HSFV_OK) {
+        if (hsfv_parse_field_value(&b_value, field_type, &hsfv_global_allocator, b.data(), b.data() + b.size(), NULL) == HSFV_OK) {
+            parsed_eq = hsfv_field_value_eq(&a_value, &b_value);
+            hsfv_field_value_deinit(&b_value, &hsfv_global_allocator);
+        }
+        hsfv_field_value_deinit(&a_value, &hsfv_global_allocator);
+    }
+    INFO(a << " vs " << b);
+    CHECK(parsed_eq == want);
+    CHECK(hsfv_raw_field_value_eq(field_type, a.data(), a.data() + a.size(), b.data(), b.data() + b.size()) == want);
+    CHECK(hsfv_raw_field_value_eq(field_type, b.data(), b.data() + b.size(), a.data(), a.data() + a.size()) == want);
+}
+
+TEST_CASE("hsfv_raw_field_value_eq item", "[raw_eq]")
+{
+    SECTION("equal")
+    {
+        const char *pairs[][2] = {{"1", "1"},           {"007", "7"},          {"-0", "0"},          {"1.50", "1.5"},
+                                  {"-0.0", "0.000"},    {"\"a\"", "\"a\""},    {"\"\\\\\"", "\"\\\\\""}, {":AQI:", ":AQI=:"},
+                                  {":AR==:", ":AQ==:"}, {"tok", "tok"},        {"?1", "?1"},         {" a;b=?1 ", "a; b"},
+                                  {"a;b=1;b=2", "a;b=2"}, {"a;b;c=1;b=?0", "a;b=?0;c=1"}, {"a", "a "}};
+        for (auto &pair : pairs) {
+            raw_eq_test(HSFV_FIELD_VALUE_TYPE_ITEM, pair[0], pair[1], true);
+        }
+    }
+    SECTION("not equal")
+    {
+        const char *pairs[][2] = {{"1", "2"},          {"1", "1.0"},        {"1", "\"1\""},      {"\"a\"", "\"b\""},
+                                  {"\"a\"", "\"ab\""}, {"\"a\\\"\"", "\"a\\\\\""}, {":AQ==:", ":Ag==:"}, {":AQ==:", ":AQI=:"},
+                                  {"a", "b"},          {"?1", "?0"},        {"a;b", "a;b=?0"},   {"a;b;c", "a;c;b"},
+                                  {"a;b", "a"},        {"", ""},            {"a", "a,"}};
+        for (auto &pair : pairs) {
+            raw_eq_test(HSFV_FIELD_VALUE_TYPE_ITEM, pair[0], pair[1], false);
+        }
+    }
+}
+
+TEST_CASE("hsfv_raw_field_value_eq list", "[raw_eq]")
+{
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_LIST, "a,b ,\tc", "a, b, c", true);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_LIST, "(  x   y );p=?1, ()", "(x y);p, ()", true);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_LIST, "", "", true);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_LIST, "a, b", "a", false);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_LIST, "(a b)", "(a), b", false);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_LIST, "(a b)", "(a b c)", false);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_LIST, "(a);x", "(a)", false);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_LIST, "a, b", "a, b,", false);
+}
+
+TEST_CASE("hsfv_raw_field_value_eq dictionary", "[raw_eq]")
+{
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=?1, b=2", "a, b=2", true);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=1, b=2, a=3", "a=3,b=2", true);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=(1 2), a;x", "a;x", true);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=?1;x", "a;x", true);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a, b", "b, a", false);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=(1)", "a=1", false);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=?0", "a", false);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a", "a;x", false);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=1", "a=1, a=", false);
+
+    /* more keys than are indexed at once, with duplicates both adjacent and far apart */
+    std::string dict, canonical;
+    for (int i = 0; i < 300; i++) {
+        dict += (i ? ", k" : "k") + std::to_string(i) + "=" + std::to_string(i) + ", k" + std::to_string(i) + "=" + std::to_string(i + 1);
+        canonical += (i ? ", k" : "k") + std::to_string(i) + "=" + std::to_string(i + 100);
+    }
+    for (int i = 0; i < 300; i++) {
+        dict += ", k" + std::to_string(i) + "=" + std::to_string(i + 100);
+    }
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, dict, canonical, true);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, dict + ", k5=0", canonical, false);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, dict, canonical + ", z", false);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_ITEM, "a" + key_params(300, false), "a" + key_params(300, true), true);
+}
+
+TEST_CASE("hsfv_raw_field_value_eq passes over many keys", "[raw_eq]")
+{
+    const int key_count = 4000;
+    std::string a, b;
+    for (int i = 0; i < key_count; i++) {
+        a += (i ? ", k" : "k") + std::to_string(i) + "=" + std::to_string(i);
+        b += (i ? ",k" : "k") + std::to_string(i) + "=" + std::to_string(i);
+    }
+
+    hsfv_stats_t before, after;
+    hsfv_stats_snapshot(&before);
+    CHECK(hsfv_raw_field_value_eq(HSFV_FIELD_VALUE_TYPE_DICTIONARY, a.data(), a.data() + a.size(), b.data(), b.data() + b.size()));
+    hsfv_stats_snapshot(&after);
+    /* one pass per 128 keys on each side rather than one per member */
+    if (hsfv_stats_enabled()) {
+        CHECK(after.raw_key_rescans - before.raw_key_rescans == 2 * (key_count / 128));
+    }
+
+    b += ",k0=1";
+    CHECK(!hsfv_raw_field_value_eq(HSFV_FIELD_VALUE_TYPE_DICTIONARY, a.data(), a.data() + a.size(), b.data(), b.data() + b.size()));
+}
+
+TEST_CASE("hsfv_raw_field_value_eq long byte sequences", "[raw_eq]")
+{
+    std::string encoded(396, 'A');
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_ITEM, ":" + encoded + "AR:", ":" + encoded + "AQ==:", true);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_ITEM, ":" + encoded + "AR:", ":" + encoded + "Ag==:", false);
+    raw_eq_test(HSFV_FIELD_VALUE_TYPE_ITEM, ":B" + encoded.substr(1) + "AR:", ":" + encoded + "AQ==:", false);
+}
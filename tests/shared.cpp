@@ -0,0 +1,86 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("shared field value", "[field_value][shared]")
+{
+    const char *input = "geolocation=(), camera=(self \"https://a-rather-long-origin.example.com\"), fullscreen=*;report-to=main";
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_shared_field_value_t *shared;
+    hsfv_field_value_t field_value;
+    hsfv_err_t err;
+
+    err = hsfv_shared_field_value_parse(HSFV_FIELD_VALUE_TYPE_DICTIONARY, &counter.allocator, input, input + strlen(input), &shared);
+    REQUIRE(err == HSFV_OK);
+    CHECK(counter.alloc_count > 1);
+    CHECK(counter.live_bytes > sizeof(hsfv_field_value_t));
+    CHECK(counter.free_size_mismatches == 0);
+
+    err = hsfv_parse_field_value(&field_value, HSFV_FIELD_VALUE_TYPE_DICTIONARY, &hsfv_global_allocator, input, input + strlen(input),
+                                 NULL);
+    REQUIRE(err == HSFV_OK);
+    CHECK(hsfv_field_value_eq(hsfv_shared_field_value_get(shared), &field_value));
+
+    CHECK(hsfv_shared_field_value_acquire(shared) == shared);
+    hsfv_shared_field_value_release(shared);
+    CHECK(counter.live_bytes > 0);
+    hsfv_shared_field_value_release(shared);
+    CHECK(counter.live_bytes == 0);
+    CHECK(counter.free_size_mismatches == 0);
+
+    hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+}
+
+TEST_CASE("shared field value parse error", "[field_value][shared]")
+{
+    const char *input = "a=(";
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_shared_field_value_t *shared = NULL;
+
+    CHECK(hsfv_shared_field_value_parse(HSFV_FIELD_VALUE_TYPE_DICTIONARY, &counter.allocator, input, input + strlen(input), &shared) ==
+          HSFV_ERR_EOF);
+    CHECK(shared == NULL);
+    CHECK(counter.live_bytes == 0);
+}
+
+TEST_CASE("shared field value read by several threads", "[field_value][shared]")
+{
+    const char *input = "accelerometer=(), autoplay=(self), camera=(self \"https://trusted.example.com\"), geolocation=*, "
+                        "payment=(self \"https://checkout.example.com\" \"https://pay.example.net\")";
+    hsfv_shared_field_value_t *shared;
+    hsfv_err_t err = hsfv_shared_field_value_parse(HSFV_FIELD_VALUE_TYPE_DICTIONARY, &hsfv_global_allocator, input,
+                                                   input + strlen(input), &shared);
+    REQUIRE(err == HSFV_OK);
+    const int thread_count = 8, rounds = 1000;
+    std::vector<int> errors(thread_count);
+
+    /* every thread takes its own reference, and the creator's is dropped while they run */
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; t++) {
+        hsfv_shared_field_value_t *ref = hsfv_shared_field_value_acquire(shared);
+        threads.emplace_back([&, t, ref]() {
+            for (int i = 0; i < rounds; i++) {
+                hsfv_shared_field_value_t *local = hsfv_shared_field_value_acquire(ref);
+                hsfv_buffer_t buf = (hsfv_buffer_t){0};
+                if (hsfv_serialize_field_value(hsfv_shared_field_value_get(local), &hsfv_global_allocator, &buf) != HSFV_OK ||
+                    buf.bytes.len != strlen(input) || memcmp(buf.bytes.base, input, buf.bytes.len)) {
+                    errors[t]++;
+                }
+                hsfv_buffer_deinit(&buf, &hsfv_global_allocator);
+                hsfv_shared_field_value_release(local);
+            }
+            hsfv_shared_field_value_release(ref);
+        });
+    }
+    hsfv_shared_field_value_release(shared);
+    for (std::thread &th : threads) {
+        th.join();
+    }
+
+    for (int t = 0; t < thread_count; t++) {
+        CHECK(errors[t] == 0);
+    }
+}
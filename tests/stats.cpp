@@ -0,0 +1,117 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+
+static void parse_dictionary_for_stats(const char *input, hsfv_err_t want)
+{
+    hsfv_field_value_t field_value;
+    hsfv_err_t err = hsfv_parse_field_value(&field_value, HSFV_FIELD_VALUE_TYPE_DICTIONARY, &hsfv_global_allocator, input,
+                                            input + strlen(input), NULL);
+    CHECK(err == want);
+    if (err == HSFV_OK) {
+        hsfv_buffer_t buf = (hsfv_buffer_t){0};
+        CHECK(hsfv_serialize_field_value(&field_value, &hsfv_global_allocator, &buf) == HSFV_OK);
+        hsfv_buffer_deinit(&buf, &hsfv_global_allocator);
+        hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+    }
+}
+
+TEST_CASE("stats", "[stats]")
+{
+    const char *input = "a=\"x\\\"y\", b=tok;p;p=2, a=\"z\", c=:AQMBAg==:, d=1.5, e=?0, f=1";
+
+    hsfv_stats_t before, after;
+    hsfv_stats_snapshot(&before);
+    parse_dictionary_for_stats(input, HSFV_OK);
+    parse_dictionary_for_stats("a=", HSFV_ERR_EOF);
+    parse_dictionary_for_stats("a=\xc3\xa9", HSFV_ERR_INVALID);
+    hsfv_stats_snapshot(&after);
+
+    if (!hsfv_stats_enabled()) {
+        CHECK(after.parsed_field_values == 0);
+        CHECK(after.parsed_tokens == 0);
+        return;
+    }
+
+    CHECK(after.parsed_field_values - before.parsed_field_values == 1);
+    CHECK(after.parsed_keys - before.parsed_keys == 10);
+    CHECK(after.parsed_tokens - before.parsed_tokens == 1);
+    CHECK(after.parsed_strings - before.parsed_strings == 2);
+    CHECK(after.parsed_escaped_strings - before.parsed_escaped_strings == 1);
+    CHECK(after.parsed_byte_seqs - before.parsed_byte_seqs == 1);
+    CHECK(after.parsed_integers - before.parsed_integers == 2);
+    CHECK(after.parsed_decimals - before.parsed_decimals == 1);
+    CHECK(after.parsed_booleans - before.parsed_booleans == 1);
+    CHECK(after.interned_keys - before.interned_keys == 0);
+    CHECK(after.interned_tokens - before.interned_tokens == 0);
+    CHECK(after.dictionary_duplicate_keys - before.dictionary_duplicate_keys == 1);
+    CHECK(after.parameter_duplicate_keys - before.parameter_duplicate_keys == 1);
+    CHECK(after.reallocs - before.reallocs > 0);
+    CHECK(after.serialized_field_values - before.serialized_field_values == 1);
+    CHECK(after.serialized_strings - before.serialized_strings == 1);
+    CHECK(after.serialized_escaped_strings - before.serialized_escaped_strings == 0);
+    CHECK(after.parse_errors[-HSFV_ERR_EOF] - before.parse_errors[-HSFV_ERR_EOF] == 1);
+    CHECK(after.parse_errors[-HSFV_ERR_INVALID] - before.parse_errors[-HSFV_ERR_INVALID] == 1);
+}
+
+TEST_CASE("stats from multiple threads", "[stats]")
+{
+    if (!hsfv_stats_enabled()) {
+        return;
+    }
+
+    const int thread_count = 4;
+    const int parse_count = 100;
+
+    hsfv_stats_t before, after;
+    hsfv_stats_snapshot(&before);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; i++) {
+        threads.emplace_back([] {
+            for (int j = 0; j < parse_count; j++) {
+                parse_dictionary_for_stats("a=tok", HSFV_OK);
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    /* counters of exited threads are kept */
+    hsfv_stats_snapshot(&after);
+    CHECK(after.parsed_tokens - before.parsed_tokens == thread_count * parse_count);
+    CHECK(after.parsed_field_values - before.parsed_field_values == thread_count * parse_count);
+}
+
+static void parse_in_thread_destructor(void *arg)
+{
+    (void)arg;
+    parse_dictionary_for_stats("a=tok", HSFV_OK);
+}
+
+TEST_CASE("stats from a thread-specific destructor", "[stats]")
+{
+    if (!hsfv_stats_enabled()) {
+        return;
+    }
+
+    /* register the main thread first so that the library's key is created before ours and destroyed first */
+    parse_dictionary_for_stats("a=tok", HSFV_OK);
+    pthread_key_t key;
+    REQUIRE(pthread_key_create(&key, parse_in_thread_destructor) == 0);
+
+    hsfv_stats_t before, after;
+    hsfv_stats_snapshot(&before);
+    std::thread t([key] {
+        parse_dictionary_for_stats("a=tok", HSFV_OK);
+        pthread_setspecific(key, (void *)1);
+    });
+    t.join();
+    hsfv_stats_snapshot(&after);
+    pthread_key_delete(key);
+
+    CHECK(after.parsed_tokens - before.parsed_tokens == 2);
+}
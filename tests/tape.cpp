@@ -0,0 +1,196 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+static void parse_tape_ok_test(hsfv_field_value_type_t field_type, const char *input, const char *want)
+{
+    hsfv_tape_t tape = (hsfv_tape_t){0};
+    hsfv_field_value_t field_value;
+    hsfv_buffer_t tape_buf = (hsfv_buffer_t){0}, tree_buf = (hsfv_buffer_t){0};
+    hsfv_err_t err;
+    const char *input_end = input + strlen(input);
+
+    err = hsfv_parse_tape(&tape, field_type, &hsfv_global_allocator, input, input_end, NULL);
+    CHECK(err == HSFV_OK);
+    err = hsfv_serialize_tape(&tape, &hsfv_global_allocator, &tape_buf);
+    CHECK(err == HSFV_OK);
+    CHECK(std::string((const char *)tape_buf.bytes.base, tape_buf.bytes.len) == want);
+
+    err = hsfv_parse_field_value(&field_value, field_type, &hsfv_global_allocator, input, input_end, NULL);
+    REQUIRE(err == HSFV_OK);
+    err = hsfv_serialize_field_value(&field_value, &hsfv_global_allocator, &tree_buf);
+    CHECK(err == HSFV_OK);
+    CHECK(hsfv_iovec_eq(&tape_buf.bytes, &tree_buf.bytes));
+
+    hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+    hsfv_buffer_deinit(&tree_buf, &hsfv_global_allocator);
+    hsfv_buffer_deinit(&tape_buf, &hsfv_global_allocator);
+    hsfv_tape_deinit(&tape, &hsfv_global_allocator);
+}
+
+static void parse_tape_ng_test(hsfv_field_value_type_t field_type, const char *input, hsfv_err_t want)
+{
+    hsfv_tape_t tape = (hsfv_tape_t){0};
+    hsfv_err_t err;
+
+    err = hsfv_parse_tape(&tape, field_type, &hsfv_global_allocator, input, input + strlen(input), NULL);
+    CHECK(err == want);
+    CHECK(tape.len == 0);
+    hsfv_tape_deinit(&tape, &hsfv_global_allocator);
+}
+
+TEST_CASE("parse tape", "[parse][tape]")
+{
+    SECTION("ok item")
+    {
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, "  42  ", "42");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, "-1.5;a=?0;b", "-1.5;a=?0;b");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, "\"a \\\"b\\\\\"", "\"a \\\"b\\\\\"");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, ":cHJldGVuZCB0aGlzIGlzIGJpbmFyeSBjb250ZW50Lg==:",
+                           ":cHJldGVuZCB0aGlzIGlzIGJpbmFyeSBjb250ZW50Lg==:");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, "foo/bar:baz;q=\"x\"", "foo/bar:baz;q=\"x\"");
+    }
+    SECTION("ok list")
+    {
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_LIST, "", "");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_LIST, "a, (b c);d=1, (), (e;f);g, ?1", "a, (b c);d=1, (), (e;f);g, ?1");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_LIST, "(a;x=1);y=2,b;z", "(a;x=1);y=2, b;z");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_LIST, "(a);y", "(a);y");
+    }
+    SECTION("ok dictionary")
+    {
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=?0, b, c;foo=bar", "a=?0, b, c;foo=bar");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "sig1=(\"@method\" \"@path\");created=1618884473;keyid=\"k\"",
+                           "sig1=(\"@method\" \"@path\");created=1618884473;keyid=\"k\"");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p",
+                           "a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p");
+    }
+    SECTION("duplicate keys")
+    {
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=1, b=2, a=(x y);z", "a=(x y);z, b=2");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=(x y), b=(z), a=3, b", "a=3, b");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a;p=1, a;p=2;q", "a;p=2;q");
+        parse_tape_ok_test(HSFV_FIELD_VALUE_TYPE_ITEM, "x;a=1;b;a=2", "x;a=2;b");
+    }
+    SECTION("ng")
+    {
+        parse_tape_ng_test(HSFV_FIELD_VALUE_TYPE_ITEM, "", HSFV_ERR_EOF);
+        parse_tape_ng_test(HSFV_FIELD_VALUE_TYPE_ITEM, "a b", HSFV_ERR_INVALID);
+        parse_tape_ng_test(HSFV_FIELD_VALUE_TYPE_ITEM, "\"abc", HSFV_ERR_EOF);
+        parse_tape_ng_test(HSFV_FIELD_VALUE_TYPE_ITEM, ":abc", HSFV_ERR_EOF);
+        parse_tape_ng_test(HSFV_FIELD_VALUE_TYPE_LIST, "a,", HSFV_ERR_EOF);
+        parse_tape_ng_test(HSFV_FIELD_VALUE_TYPE_LIST, "(a b", HSFV_ERR_EOF);
+        parse_tape_ng_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "a=", HSFV_ERR_EOF);
+        parse_tape_ng_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, "A=1", HSFV_ERR_INVALID);
+        parse_tape_ng_test(HSFV_FIELD_VALUE_TYPE_ITEM, "\xc3\xa9", HSFV_ERR_INVALID);
+    }
+}
+
+TEST_CASE("tape traversal", "[tape]")
+{
+    const char *input = "a=1;x, b=(c \"d\";y=?0);z, e";
+    hsfv_tape_t tape = (hsfv_tape_t){0};
+    hsfv_err_t err;
+
+    err = hsfv_parse_tape(&tape, HSFV_FIELD_VALUE_TYPE_DICTIONARY, &hsfv_global_allocator, input, input + strlen(input), NULL);
+    REQUIRE(err == HSFV_OK);
+
+    const hsfv_tape_entry_t *root = hsfv_tape_root(&tape);
+    REQUIRE(root != NULL);
+    CHECK(root->type == HSFV_TAPE_TYPE_DICTIONARY);
+    CHECK(root->len == 3);
+    CHECK(root->skip == tape.len);
+
+    const hsfv_tape_entry_t *key = root + 1;
+    CHECK(key->type == HSFV_TAPE_TYPE_KEY);
+    CHECK(!memcmp(hsfv_tape_chars(&tape, key), "a", key->len));
+    CHECK(key[1].type == HSFV_TAPE_TYPE_INTEGER);
+    CHECK(key[1].integer == 1);
+    const hsfv_tape_entry_t *params = hsfv_tape_parameters(&key[1]);
+    REQUIRE(params != NULL);
+    CHECK(params->len == 1);
+    CHECK(params[2].type == HSFV_TAPE_TYPE_BOOLEAN);
+
+    key = hsfv_tape_next(key + 1);
+    CHECK(key->type == HSFV_TAPE_TYPE_KEY);
+    CHECK(!memcmp(hsfv_tape_chars(&tape, key), "b", key->len));
+    const hsfv_tape_entry_t *inner_list = key + 1;
+    CHECK(inner_list->type == HSFV_TAPE_TYPE_INNER_LIST);
+    CHECK(inner_list->len == 2);
+    const hsfv_tape_entry_t *item = inner_list + 1;
+    CHECK(item->type == HSFV_TAPE_TYPE_TOKEN);
+    CHECK(hsfv_tape_parameters(item) == NULL);
+    item = hsfv_tape_next(item);
+    CHECK(item->type == HSFV_TAPE_TYPE_STRING);
+    CHECK(!memcmp(hsfv_tape_chars(&tape, item), "d", item->len));
+    CHECK(hsfv_tape_parameters(item) == item + 1);
+    params = hsfv_tape_parameters(inner_list);
+    REQUIRE(params != NULL);
+    CHECK(params == hsfv_tape_next(item));
+    CHECK(!memcmp(hsfv_tape_chars(&tape, &params[1]), "z", params[1].len));
+
+    key = hsfv_tape_next(inner_list);
+    CHECK(!memcmp(hsfv_tape_chars(&tape, key), "e", key->len));
+    CHECK(hsfv_tape_next(key + 1) == hsfv_tape_end(root));
+
+    hsfv_tape_deinit(&tape, &hsfv_global_allocator);
+}
+
+TEST_CASE("tape reuse and clone", "[tape]")
+{
+    hsfv_counting_allocator_t counter;
+    hsfv_counting_allocator_init(&counter, &hsfv_global_allocator);
+    hsfv_allocator_t *allocator = &counter.allocator;
+    hsfv_tape_t tape = (hsfv_tape_t){0}, clone;
+    hsfv_buffer_t buf = (hsfv_buffer_t){0};
+    const char *input1 = "max-age=3600, must-revalidate, private";
+    const char *input2 = "a=1, b=2";
+    hsfv_err_t err;
+
+    err = hsfv_parse_tape(&tape, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, input1, input1 + strlen(input1), NULL);
+    REQUIRE(err == HSFV_OK);
+    CHECK(counter.alloc_count + counter.realloc_count == 1);
+
+    hsfv_counting_allocator_reset_stats(&counter);
+    err = hsfv_parse_tape(&tape, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, input2, input2 + strlen(input2), NULL);
+    REQUIRE(err == HSFV_OK);
+    CHECK(counter.alloc_count + counter.realloc_count == 0);
+
+    err = hsfv_tape_clone(&clone, &tape, allocator);
+    REQUIRE(err == HSFV_OK);
+    hsfv_tape_deinit(&tape, allocator);
+    err = hsfv_serialize_tape(&clone, &hsfv_global_allocator, &buf);
+    CHECK(err == HSFV_OK);
+    CHECK(buf.bytes.len == strlen(input2));
+    CHECK(!memcmp(buf.bytes.base, input2, buf.bytes.len));
+
+    hsfv_buffer_deinit(&buf, &hsfv_global_allocator);
+    hsfv_tape_deinit(&clone, allocator);
+    CHECK(counter.live_bytes == 0);
+}
+
+TEST_CASE("parse tape alloc error", "[parse][tape]")
+{
+    hsfv_allocator_t *allocator = &hsfv_failing_allocator.allocator;
+    const char *input = "a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,q,r,s,t";
+    hsfv_tape_t tape;
+    hsfv_err_t err;
+
+    hsfv_failing_allocator.fail_index = -1;
+    hsfv_failing_allocator.alloc_count = 0;
+    tape = (hsfv_tape_t){0};
+    err = hsfv_parse_tape(&tape, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, input, input + strlen(input), NULL);
+    CHECK(err == HSFV_OK);
+    hsfv_tape_deinit(&tape, allocator);
+
+    int alloc_count = hsfv_failing_allocator.alloc_count;
+    CHECK(alloc_count > 1);
+    for (int i = 0; i < alloc_count; i++) {
+        hsfv_failing_allocator.fail_index = i;
+        hsfv_failing_allocator.alloc_count = 0;
+        tape = (hsfv_tape_t){0};
+        err = hsfv_parse_tape(&tape, HSFV_FIELD_VALUE_TYPE_DICTIONARY, allocator, input, input + strlen(input), NULL);
+        CHECK(err == HSFV_ERR_OUT_OF_MEMORY);
+        hsfv_tape_deinit(&tape, allocator);
+    }
+}
@@ -0,0 +1,80 @@
+#include "hsfv.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+/* hsfv_transcode must write what parsing and serializing writes, and fail where parsing fails */
+static void transcode_test(hsfv_field_value_type_t field_type, const char *input)
+{
+    const char *input_end = input + strlen(input);
+    hsfv_field_value_t field_value;
+    hsfv_buffer_t want = (hsfv_buffer_t){0}, got = (hsfv_buffer_t){0};
+    hsfv_err_t parse_err, err;
+
+    hsfv_buffer_append_bytes(&got, &hsfv_global_allocator, "prefix", 6);
+    parse_err = hsfv_parse_field_value(&field_value, field_type, &hsfv_global_allocator, input, input_end, NULL);
+    if (parse_err == HSFV_OK) {
+        REQUIRE(hsfv_serialize_field_value(&field_value, &hsfv_global_allocator, &want) == HSFV_OK);
+        hsfv_field_value_deinit(&field_value, &hsfv_global_allocator);
+    }
+    err = hsfv_transcode(field_type, input, input_end, &hsfv_global_allocator, &got);
+
+    INFO(input);
+    CHECK((err == HSFV_OK) == (parse_err == HSFV_OK));
+    std::string prefixed = "prefix" + std::string((const char *)want.bytes.base, want.bytes.len);
+    CHECK(std::string((const char *)got.bytes.base, got.bytes.len) == (err == HSFV_OK ? prefixed : "prefix"));
+    hsfv_buffer_deinit(&want, &hsfv_global_allocator);
+    hsfv_buffer_deinit(&got, &hsfv_global_allocator);
+}
+
+TEST_CASE("transcode item", "[transcode]")
+{
+    const char *inputs[] = {"  42  ",   "-0",          "007",      "1.50",     "-00.250",   "1.0",          "\"a \\\"q\\\" \\\\\"",
+                            "tok/en:1", ":AQID:",      ":AQI:",    ":AQJ=:",   ":AR==:",    ":AQ=Z:",       "::",
+                            "?1",       "a;b=?1;c=?0", "a; b; b=1", "a;b;c=1;b=2;c", "1.2345", "\"unterminated", "a;",
+                            "(a)",      "a b",         "",          "?2",       ":A:",       "\"\x01\""};
+    for (const char *input : inputs) {
+        transcode_test(HSFV_FIELD_VALUE_TYPE_ITEM, input);
+    }
+}
+
+TEST_CASE("transcode list", "[transcode]")
+{
+    const char *inputs[] = {"",          "a,b",       "a ,\t b",  "(  a   b  );p=?1 , c", "()",   "( )",        "(a b)c",
+                            "a, (x;y=1", "a,",        "a, , b",   "1,2,3,4,5",             "(a)(b)", "(:AQI: 1.10)", "a;x;x=2"};
+    for (const char *input : inputs) {
+        transcode_test(HSFV_FIELD_VALUE_TYPE_LIST, input);
+    }
+}
+
+TEST_CASE("transcode dictionary", "[transcode]")
+{
+    const char *inputs[] = {"a=?1, b=?0",
+                            "a=?1;p=1,b",
+                            "max-age=060,private,max-age=30",
+                            "a=1, b=2, a=\"a much longer value than before\", c=3",
+                            "a=\"long enough to shrink\", b=2, a=1",
+                            "a=(1 2);x, b, a;y, a=3;z=?1",
+                            "a=(), b=(x y);q=1;q=2",
+                            "a=1, b=2, c=3, b=?1, a=(z), d",
+                            "a=1,",
+                            "A=1",
+                            "a=(",
+                            "a=1 b=2"};
+    for (const char *input : inputs) {
+        transcode_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, input);
+    }
+}
+
+TEST_CASE("transcode many duplicate keys", "[transcode]")
+{
+    std::string input;
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 40; i++) {
+            if (!input.empty()) {
+                input += ",";
+            }
+            input += "k" + std::to_string(i) + "=" + std::to_string(round * 100 + i) + ";p;q=" + std::to_string(round);
+        }
+    }
+    transcode_test(HSFV_FIELD_VALUE_TYPE_DICTIONARY, input.c_str());
+}